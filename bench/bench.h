@@ -0,0 +1,94 @@
+#ifndef SENTRY_BENCH_H
+#define SENTRY_BENCH_H
+
+#include "json.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+
+/*
+ * Minimal benchmark harness, every result is printed as a single JSON line:
+ * {"benchmark": "...", "iterations": N, "ns_per_op": X}
+ * or, for memory and throughput measurements:
+ * {"benchmark": "...", "bytes": N}
+ * {"benchmark": "...", "events": N, "events_per_second": X}
+ */
+
+using json = nlohmann::json;
+
+namespace SentryBench
+{
+
+template<typename T>
+inline void doNotOptimize(T&& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// results go to stdout, or to the file given with --output
+inline std::ostream*& output()
+{
+    static std::ostream* stream = &std::cout;
+    return stream;
+}
+
+inline void reportResult(const json& result)
+{
+    *output() << result.dump() << std::endl;
+}
+
+inline void report(const std::string& name, size_t iterations, double nsPerOp)
+{
+    reportResult({{"benchmark", name}, {"iterations", iterations}, {"ns_per_op", nsPerOp}});
+}
+
+inline void reportMemory(const std::string& name, size_t bytes)
+{
+    reportResult({{"benchmark", name}, {"bytes", bytes}});
+}
+
+template<typename F>
+void run(const std::string& name, size_t iterations, F&& function)
+{
+    // warm up caches and lazy initialisation
+    for (size_t i=0; i<iterations/10+1; i++)
+    {
+        function();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i=0; i<iterations; i++)
+    {
+        function();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double totalNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    report(name, iterations, totalNs / static_cast<double>(iterations));
+}
+
+// benchmark groups
+void benchEventProcessors();
+void benchScope();
+void benchDsn();
+void benchMemory();
+void benchStats();
+void benchHub();
+void benchLog();
+void benchBacktrace();
+void benchThroughput();
+void benchTracing();
+void benchProfiler();
+void benchSessions();
+void benchMetrics();
+void benchAttachments();
+void benchEventSize();
+void benchTransport();
+void benchHttps();
+
+} // namespace SentryBench
+
+#endif // SENTRY_BENCH_H
@@ -0,0 +1,228 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+
+#include "hub.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <malloc.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t ATTACHMENT_BYTES = 64 * 1024 * 1024;
+constexpr size_t EVENTS = 8;
+
+const std::chrono::milliseconds FLUSH_TIMEOUT(60000);
+
+size_t heapInUse()
+{
+    // large blocks are mapped on their own
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// a file of the given size in a new temporary directory, removed with it
+class TemporaryFile
+{
+public:
+
+    explicit TemporaryFile(size_t size)
+    :
+    m_directory(),
+    m_path()
+    {
+        char directory[] = "/tmp/sentry_bench_XXXXXX";
+        m_directory = mkdtemp(directory);
+        m_path = m_directory + "/attachment.bin";
+
+        FILE* file = fopen(m_path.c_str(), "wb");
+        std::vector<char> block(1024 * 1024);
+        for (size_t i=0; i<block.size(); i++)
+        {
+            block[i] = static_cast<char>('a' + i % 26);
+        }
+        for (size_t written=0; written<size; written+=block.size())
+        {
+            fwrite(block.data(), 1, std::min(block.size(), size - written), file);
+        }
+        fclose(file);
+    }
+
+    ~TemporaryFile()
+    {
+        unlink(m_path.c_str());
+        rmdir(m_directory.c_str());
+    }
+
+    const std::string& directory() const
+    {
+        return m_directory;
+    }
+
+    const std::string& path() const
+    {
+        return m_path;
+    }
+
+private:
+
+    std::string m_directory;
+    std::string m_path;
+};
+
+// the relay end of the UNIX_SOCKET transport: counts the bytes and samples the heap while the envelopes arrive
+class SocketDrain
+{
+public:
+
+    explicit SocketDrain(const std::string& path)
+    :
+    m_path(path),
+    m_listener(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)),
+    m_bytes(0),
+    m_peakHeap(0),
+    m_thread()
+    {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        m_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+        bind(m_listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        listen(m_listener, 1);
+
+        m_thread = std::thread([this]()
+        {
+            const int connection = accept(m_listener, nullptr, nullptr);
+            std::vector<char> buffer(256 * 1024);
+            ssize_t received;
+            while ((received = recv(connection, buffer.data(), buffer.size(), 0)) > 0)
+            {
+                m_bytes += static_cast<size_t>(received);
+                m_peakHeap = std::max(m_peakHeap.load(), heapInUse());
+            }
+            close(connection);
+        });
+    }
+
+    ~SocketDrain()
+    {
+        shutdown(m_listener, SHUT_RDWR);
+        close(m_listener);
+        m_thread.join();
+        unlink(m_path.c_str());
+    }
+
+    bool waitForBytes(size_t bytes) const
+    {
+        const auto deadline = std::chrono::steady_clock::now() + FLUSH_TIMEOUT;
+        while (m_bytes < bytes && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return m_bytes >= bytes;
+    }
+
+    size_t bytes() const
+    {
+        return m_bytes;
+    }
+
+    size_t peakHeap() const
+    {
+        return m_peakHeap;
+    }
+
+private:
+
+    std::string m_path;
+    int m_listener;
+    std::atomic<size_t> m_bytes;
+    std::atomic<size_t> m_peakHeap;
+    std::thread m_thread;
+};
+
+void reportThroughput(const std::string& name, std::chrono::steady_clock::duration elapsed, size_t bytes, bool complete)
+{
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    reportResult({{"benchmark", name}, {"events", EVENTS}, {"attachment_bytes", ATTACHMENT_BYTES},
+                  {"bytes_per_second", static_cast<double>(bytes) / seconds}, {"complete", complete}});
+}
+
+} // namespace
+
+void benchAttachments()
+{
+    TemporaryFile attachment(ATTACHMENT_BYTES);
+
+    // streamed with sendfile: the heap does not grow with the size of the file
+    {
+        const std::string socketPath = attachment.directory() + "/relay.sock";
+        SocketDrain drain(socketPath);
+
+        Sentry::SentryOptions options;
+        options.transport = Sentry::TransportType::UNIX_SOCKET;
+        options.transportPath = socketPath;
+        Sentry::Hub hub;
+        hub.init("", options);
+        hub.addAttachment(attachment.path(), "application/octet-stream");
+
+        const size_t heapBefore = heapInUse();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i=0; i<EVENTS; i++)
+        {
+            hub.captureEvent({{"message", "attachment " + std::to_string(i)}});   // identical ones are rate limited
+        }
+        hub.flush(FLUSH_TIMEOUT);
+        const bool complete = drain.waitForBytes(EVENTS * ATTACHMENT_BYTES);
+        reportThroughput("attachments/unix_socket", std::chrono::steady_clock::now() - start, drain.bytes(), complete);
+        reportMemory("attachments/unix_socket/peak_heap_growth", drain.peakHeap() - std::min(drain.peakHeap(), heapBefore));
+    }
+
+    // the whole envelope in memory, as every attachment was before streaming
+    {
+        Sentry::SentryOptions options;
+        options.transport = Sentry::TransportType::MEMORY;
+        Sentry::Hub hub;
+        hub.init("", options);
+        hub.addAttachment(attachment.path(), "application/octet-stream");
+
+        const size_t heapBefore = heapInUse();
+        hub.captureEvent({{"message", "attachment"}});
+        hub.flush(FLUSH_TIMEOUT);
+        const size_t heapAfter = heapInUse();
+        reportMemory("attachments/in_memory/heap_growth", heapAfter - std::min(heapAfter, heapBefore));
+        std::vector<std::string> envelopes = hub.takeCapturedEvents();
+        doNotOptimize(envelopes);
+    }
+
+    // chunked transfer encoding to the mock ingest, which keeps the whole request itself
+    {
+        MockSentryServer server;
+        Sentry::SentryOptions options;
+        Sentry::Hub hub;
+        hub.init(server.dsn(), options);
+        hub.addAttachment(attachment.path(), "application/octet-stream");
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i=0; i<EVENTS; i++)
+        {
+            hub.captureEvent({{"message", "attachment " + std::to_string(i)}});
+        }
+        const bool complete = hub.flush(FLUSH_TIMEOUT) && server.envelopeItems()["attachment"] == EVENTS;
+        reportThroughput("attachments/http", std::chrono::steady_clock::now() - start, server.bytesReceived(), complete);
+    }
+}
+
+} // namespace SentryBench
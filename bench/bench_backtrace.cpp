@@ -0,0 +1,197 @@
+#include "bench.h"
+
+#include "backtracehandler.h"
+#include "threadsampler.h"
+#include "throwhook.h"
+#include "unwinder.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+json makePayload(size_t numberOfBreadcrumbs)
+{
+    json breadcrumbs = json::array();
+    for (size_t i=0; i<numberOfBreadcrumbs; i++)
+    {
+        breadcrumbs.push_back({{"timestamp", "2011-10-08T07:07:09Z"},
+                               {"type", "default"},
+                               {"level", "info"},
+                               {"category", "info"},
+                               {"message", "Breadcrumb message number " + std::to_string(i)}});
+    }
+
+    return
+    {
+        {"event_id", "fc6d8c0c43fc4630ad850ee518f1b9d0"},
+        {"timestamp", "2011-10-08T07:07:09Z"},
+        {"platform", "other"},
+        {"message", "Benchmark event"},
+        {"level", "error"},
+        {"breadcrumbs", {{"values", breadcrumbs}}},
+        {"tags", {{"server_name", "bench"}, {"user_login", "bench"}}},
+    };
+}
+
+constexpr size_t UNWIND_MAX_FRAMES = 512;
+
+// depth calls deep (with frame pointers, through a pointer so the calls are neither inlined nor turned into a loop),
+// then the stack is walked
+__attribute__((noinline, optimize("no-omit-frame-pointer")))
+size_t unwindAtDepth(size_t depth, Sentry::StackUnwinder method);
+size_t (*volatile unwindAtDepthCall)(size_t, Sentry::StackUnwinder) = unwindAtDepth;
+
+size_t unwindAtDepth(size_t depth, Sentry::StackUnwinder method)
+{
+    if (depth == 0)
+    {
+        void* frames[UNWIND_MAX_FRAMES];
+        return Sentry::Unwinder::unwind(method, frames, UNWIND_MAX_FRAMES);
+    }
+    const size_t frameCount = unwindAtDepthCall(depth - 1, method);
+    doNotOptimize(frameCount);
+    return frameCount;
+}
+
+void runUnwind(const std::string& name, Sentry::StackUnwinder method)
+{
+    for (size_t depth : {16, 64, 256})
+    {
+        run("backtrace/unwind/" + name + "/" + std::to_string(depth), 10000, [depth, method]()
+        {
+            size_t frameCount = unwindAtDepth(depth, method);
+            doNotOptimize(frameCount);
+        });
+    }
+}
+
+// throws depth calls deep, caught here
+__attribute__((noinline, optimize("no-omit-frame-pointer")))
+size_t throwAtDepth(size_t depth);
+size_t (*volatile throwAtDepthCall)(size_t) = throwAtDepth;
+
+size_t throwAtDepth(size_t depth)
+{
+    if (depth == 0)
+    {
+        throw std::runtime_error("bench");
+    }
+    const size_t result = throwAtDepthCall(depth - 1);
+    doNotOptimize(result);
+    return result;
+}
+
+void runThrow(const std::string& name)
+{
+    run("backtrace/throw/" + name + "/16", 10000, []()
+    {
+        try
+        {
+            throwAtDepth(16);
+        }
+        catch (const std::exception& exception)
+        {
+            doNotOptimize(exception);
+        }
+    });
+}
+
+// a snapshot of the stacks of numberOfThreads idle threads (plus the bench ones)
+void runThreadSnapshot(size_t numberOfThreads, size_t iterations)
+{
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool stop = false;
+    std::vector<std::thread> threads;
+    for (size_t i=0; i<numberOfThreads; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopped.wait(lock, [&]() { return stop; });
+        });
+    }
+
+    run("backtrace/threads/" + std::to_string(numberOfThreads), iterations, []()
+    {
+        json threads = Sentry::ThreadSampler::captureThreads(false, Sentry::StackUnwinder::BACKTRACE);
+        doNotOptimize(threads);
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    stopped.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+} // namespace
+
+void benchBacktrace()
+{
+    backtraceHandler withoutSource(false);
+    run("backtrace/get_stacktrace_json", 1000, [&]()
+    {
+        json frames = withoutSource.getStacktraceJSON();
+        doNotOptimize(frames);
+    });
+
+    // the same stack every time, symbolized once
+    backtraceHandler cached(false, Sentry::StackUnwinder::BACKTRACE, 128, true);
+    run("backtrace/get_stacktrace_json/cached", 1000, [&]()
+    {
+        json frames = cached.getStacktraceJSON();
+        doNotOptimize(frames);
+    });
+
+    backtraceHandler withSource(true);
+    run("backtrace/get_stacktrace_json/context_lines", 1000, [&]()
+    {
+        json frames = withSource.getStacktraceJSON();
+        doNotOptimize(frames);
+    });
+
+    Sentry::Unwinder::refreshModules();
+    runUnwind("backtrace", Sentry::StackUnwinder::BACKTRACE);
+    runUnwind("frame_pointer", Sentry::StackUnwinder::FRAME_POINTER);
+    runUnwind("eh_frame", Sentry::StackUnwinder::EH_FRAME);
+
+    // the throw hook, if the library was built with it
+    runThrow("disabled");
+    if (Sentry::ThrowHook::isAvailable())
+    {
+        Sentry::ThrowHook::enable(Sentry::StackUnwinder::BACKTRACE);
+        runThrow("backtrace");
+        Sentry::ThrowHook::enable(Sentry::StackUnwinder::FRAME_POINTER);
+        runThrow("frame_pointer");
+        Sentry::ThrowHook::enable(Sentry::StackUnwinder::EH_FRAME);
+        runThrow("eh_frame");
+        Sentry::ThrowHook::disable();
+    }
+
+    runThreadSnapshot(16, 100);
+    runThreadSnapshot(256, 10);
+
+    const json payload = makePayload(100);
+    run("payload/dump/100_breadcrumbs", 10000, [&]()
+    {
+        std::string contents = payload.dump();
+        doNotOptimize(contents);
+    });
+}
+
+} // namespace SentryBench
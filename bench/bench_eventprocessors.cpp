@@ -0,0 +1,50 @@
+#include "bench.h"
+
+#include "eventprocessor.h"
+
+#include <string>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+json makeEvent()
+{
+    return
+    {
+        {"message", "Benchmark event"},
+        {"level", "error"},
+        {"tags", {{"server_name", "bench"}, {"user_login", "bench"}}},
+    };
+}
+
+void benchPipeline(size_t numberOfProcessors)
+{
+    Sentry::EventProcessorPipeline pipeline;
+    for (size_t i=0; i<numberOfProcessors; i++)
+    {
+        // cheap processor, so the pipeline overhead dominates
+        pipeline.addEventProcessor([](json& event) { return event.is_object(); });
+    }
+
+    json event = makeEvent();
+    run("event_processors/" + std::to_string(numberOfProcessors), 1000000, [&]()
+    {
+        bool keep = pipeline.apply(event);
+        doNotOptimize(keep);
+    });
+}
+
+} // namespace
+
+void benchEventProcessors()
+{
+    benchPipeline(0);
+    benchPipeline(1);
+    benchPipeline(10);
+}
+
+} // namespace SentryBench
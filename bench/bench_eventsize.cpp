@@ -0,0 +1,98 @@
+#include "bench.h"
+
+#include "eventserializer.h"
+#include "scope.h"
+
+#include <string>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t ITERATIONS = 20;
+
+json framesEvent(size_t frames, size_t contextLines, size_t lineLength)
+{
+    json frameList = json::array();
+    for (size_t i=0; i<frames; i++)
+    {
+        json context = json::array();
+        for (size_t line=0; line<contextLines; line++)
+        {
+            context.push_back(std::string(lineLength, 'x'));
+        }
+        frameList.push_back({{"function", "function_" + std::to_string(i)}, {"filename", "src/file.cpp"},
+                             {"lineno", i}, {"context_line", std::string(lineLength, 'y')},
+                             {"pre_context", context}, {"post_context", context}});
+    }
+    return {{"message", "frames"}, {"level", "error"},
+            {"exception", {{"values", {{{"type", "std::runtime_error"}, {"value", "frames"},
+                                        {"stacktrace", {{"frames", frameList}}}}}}}}};
+}
+
+// the serializer against a plain dump of the same event, which has no limits
+void compare(const std::string& name, const json& event, const Sentry::EventLimits& limits)
+{
+    std::string limited;
+    run("event_size/" + name, ITERATIONS, [&]()
+    {
+        limited = Sentry::EventSerializer::serializeEvent(event, limits);
+        doNotOptimize(limited);
+    });
+
+    std::string dumped;
+    run("event_size/" + name + "/dump", ITERATIONS, [&]()
+    {
+        dumped = event.dump();
+        doNotOptimize(dumped);
+    });
+
+    reportResult({{"benchmark", "event_size/" + name + "/bytes"},
+                  {"serialized_bytes", limited.size()}, {"dump_bytes", dumped.size()}});
+}
+
+} // namespace
+
+void benchEventSize()
+{
+    const Sentry::EventLimits limits;
+
+    compare("long_message", {{"message", std::string(10 * 1024 * 1024, 'm')}, {"level", "error"}}, limits);
+
+    compare("1000_frames", framesEvent(1000, 20, 1024), limits);
+
+    json extra = json::object();
+    for (size_t i=0; i<500; i++)
+    {
+        extra["key_" + std::to_string(i)] = std::string(4096, 'e');
+    }
+    compare("large_extra", {{"message", "extra"}, {"extra", extra}}, limits);
+
+    // the breadcrumbs of the scope are serialized once, the serializer picks the newest that fit
+    Sentry::Scope scope;
+    scope.setEventLimits(limits);
+    scope.setMaxBreadcrumbs(100);
+    for (size_t i=0; i<100; i++)
+    {
+        Sentry::Breadcrumb breadcrumb;
+        breadcrumb.message = std::string(10 * 1024, static_cast<char>('a' + i % 26));
+        breadcrumb.data = {{"payload", std::string(1024, 'd')}};
+        scope.addBreadcrumb(std::move(breadcrumb));
+    }
+    const json event = {{"message", "breadcrumbs"}, {"level", "error"}};
+    Sentry::EventLimits smallLimits = limits;
+    smallLimits.maxEventBytes = 256 * 1024;
+    scope.setEventLimits(smallLimits);
+    std::string serialized;
+    run("event_size/100_breadcrumbs_over_budget", ITERATIONS, [&]()
+    {
+        serialized = scope.serializeEvent(event);
+        doNotOptimize(serialized);
+    });
+    reportResult({{"benchmark", "event_size/100_breadcrumbs_over_budget/bytes"}, {"serialized_bytes", serialized.size()}});
+}
+
+} // namespace SentryBench
@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+#include "selfsignedcertificate.h"
+
+#include "httpclient.h"
+#include "sdkstats.h"
+
+#include <memory>
+#include <string>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+const std::string STORE_PATH = "/api/1/store/";
+const std::string EVENT = "{\"event_id\": \"0123456789abcdef0123456789abcdef\", \"message\": \"benchmark\", \"level\": \"error\"}";
+
+http::Header eventHeader()
+{
+    http::Header header;
+    header.emplace("Content-Type", "application/json");
+    return header;
+}
+
+// one event per iteration, synchronously, also reports how many handshakes the events needed
+void runPosts(const std::string& name, size_t iterations, http::Client& client)
+{
+    const http::Header header = eventHeader();
+    const Sentry::SdkStatistics before = Sentry::SdkStats::instance().snapshot();
+    size_t posts = 0;
+
+    run(name, iterations, [&]()
+    {
+        auto response = client.post(STORE_PATH, EVENT, header);
+        doNotOptimize(response);
+        posts++;
+    });
+
+    const Sentry::SdkStatistics after = Sentry::SdkStats::instance().snapshot();
+    reportResult({{"benchmark", name + "/tls"}, {"events", posts},
+                  {"handshakes_per_event", static_cast<double>(after.tlsHandshakes - before.tlsHandshakes) / static_cast<double>(posts)},
+                  {"resumed_per_event", static_cast<double>(after.tlsSessionsResumed - before.tlsSessionsResumed) / static_cast<double>(posts)}});
+}
+
+// the first event of a new client, with the connection opened on its own (on the transport worker) or with the request
+void runFirstPost(const std::string& name, size_t iterations, unsigned short port, const http::TlsOptions& tlsOptions, bool prewarm)
+{
+    const http::Header header = eventHeader();
+    double totalNs = 0;
+    for (size_t i=0; i<iterations; i++)
+    {
+        auto client = http::Client::create("https", "127.0.0.1", port, HTTP_CLIENT_TIMOUT_IN_SECONDS, tlsOptions);
+        if (prewarm)
+        {
+            client->prewarm();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto response = client->post(STORE_PATH, EVENT, header);
+        const auto end = std::chrono::steady_clock::now();
+        doNotOptimize(response);
+        totalNs += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    report(name, iterations, totalNs / static_cast<double>(iterations));
+}
+
+} // namespace
+
+void benchHttps()
+{
+    SelfSignedCertificate certificate;
+    http::TlsOptions tlsOptions;
+    tlsOptions.caCertsPath = certificate.certificatePath();
+
+    MockSentryServer plainServer;
+    MockSentryTlsServer keepAliveServer(FaultProfile(), certificate.certificatePath(), certificate.privateKeyPath());
+    FaultProfile closing;
+    closing.name = "close";
+    closing.closeConnections = true;
+    MockSentryTlsServer closingServer(closing, certificate.certificatePath(), certificate.privateKeyPath());
+
+    // reference, no TLS
+    auto plainClient = http::Client::create("http", "127.0.0.1", plainServer.port(), HTTP_CLIENT_TIMOUT_IN_SECONDS);
+    runPosts("https/post/http_keep_alive", 2000, *plainClient);
+
+    auto keepAliveClient = http::Client::create("https", "127.0.0.1", keepAliveServer.port(), HTTP_CLIENT_TIMOUT_IN_SECONDS, tlsOptions);
+    runPosts("https/post/keep_alive", 2000, *keepAliveClient);
+
+    // every event on a new connection, as with a server or proxy closing idle connections
+    auto resumingClient = http::Client::create("https", "127.0.0.1", closingServer.port(), HTTP_CLIENT_TIMOUT_IN_SECONDS, tlsOptions);
+    runPosts("https/post/reconnect_resumed", 500, *resumingClient);
+
+    http::TlsOptions noReuse = tlsOptions;
+    noReuse.reuseSessions = false;
+    auto fullHandshakeClient = http::Client::create("https", "127.0.0.1", closingServer.port(), HTTP_CLIENT_TIMOUT_IN_SECONDS, noReuse);
+    runPosts("https/post/reconnect_full_handshake", 500, *fullHandshakeClient);
+
+    runFirstPost("https/first_post/cold", 200, keepAliveServer.port(), tlsOptions, false);
+    runFirstPost("https/first_post/prewarmed", 200, keepAliveServer.port(), tlsOptions, true);
+}
+
+} // namespace SentryBench
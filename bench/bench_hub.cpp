@@ -0,0 +1,185 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+
+#include "hub.h"
+
+#include <stdexcept>
+#include <string>
+
+
+namespace Sentry
+{
+
+class HubBenchmark
+{
+public:
+
+    static std::string generateUuid(Hub& hub)
+    {
+        return hub.generateUuid();
+    }
+
+    static std::string ISO8601_timestamp(Hub& hub)
+    {
+        return hub.ISO8601_timestamp();
+    }
+
+    static bool checkIfEventTooOften(Hub& hub, const json& event, const std::string& timestamp)
+    {
+        return hub.checkIfEventTooOften(event, timestamp);
+    }
+};
+
+} // namespace Sentry
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t CAPTURE_ITERATIONS = 2000;
+const std::chrono::seconds DRAIN_TIMEOUT(60);
+
+// events without "message" are not checked for repetitions
+json makeEvent()
+{
+    return
+    {
+        {"level", "error"},
+        {"logger", "bench"},
+        {"extra", {{"key", "value"}}},
+    };
+}
+
+void benchPrivateHotPaths(Sentry::Hub& hub)
+{
+    run("hub/generate_uuid", 100000, [&]()
+    {
+        std::string uuid = Sentry::HubBenchmark::generateUuid(hub);
+        doNotOptimize(uuid);
+    });
+
+    run("hub/iso8601_timestamp", 100000, [&]()
+    {
+        std::string timestamp = Sentry::HubBenchmark::ISO8601_timestamp(hub);
+        doNotOptimize(timestamp);
+    });
+
+    // 100 distinct messages, so the list of recent events stays at its steady state size
+    const std::string timestamp = Sentry::HubBenchmark::ISO8601_timestamp(hub);
+    size_t messageNo = 0;
+    run("hub/check_if_event_too_often/100_messages", 10000, [&]()
+    {
+        const json event = {{"message", "message " + std::to_string(messageNo++ % 100)}};
+        bool tooOften = Sentry::HubBenchmark::checkIfEventTooOften(hub, event, timestamp);
+        doNotOptimize(tooOften);
+    });
+}
+
+void benchCoalescing()
+{
+    constexpr size_t stormEvents = 10000;
+    const std::runtime_error exception("Benchmark storm");
+
+    // the same exception in a loop: sent one by one, or once with its count
+    for (const unsigned int window : {0u, 1000u})
+    {
+        Sentry::SentryOptions options;
+        options.transport = Sentry::TransportType::MEMORY;
+        options.coalesceWindowMilliseconds = window;
+        Sentry::Hub hub;
+        hub.init("", options);
+
+        const std::string name = (window == 0) ? "hub/exception_storm" : "hub/exception_storm/coalesced";
+        run(name, stormEvents, [&]()
+        {
+            std::string eventId = hub.captureException(exception, nullptr, true);
+            doNotOptimize(eventId);
+        });
+        hub.flush(DRAIN_TIMEOUT);
+
+        size_t bytes = 0;
+        const std::vector<std::string> events = hub.takeCapturedEvents();
+        for (const std::string& event : events)
+        {
+            bytes += event.size();
+        }
+        reportResult({{"benchmark", name + "/sent"}, {"captured", stormEvents},
+                      {"events_sent", events.size()}, {"bytes_sent", bytes}});
+    }
+}
+
+} // namespace
+
+void benchHub()
+{
+    MockSentryServer server;
+
+    Sentry::SentryOptions options;
+    Sentry::Hub hub;
+    hub.init(server.dsn(), options);
+
+    benchPrivateHotPaths(hub);
+
+    const json crumb = {{"type", "default"}, {"level", "info"}, {"message", "Benchmark breadcrumb"}};
+    run("hub/add_breadcrumb", 100000, [&]()
+    {
+        hub.addBreadcrumb(crumb);
+    });
+
+    size_t tagNo = 0;
+    run("hub/set_tag", 100000, [&]()
+    {
+        hub.setTag("tag_" + std::to_string(tagNo++ % 50), "value");
+    });
+
+    const json event = makeEvent();
+    run("hub/capture_event", CAPTURE_ITERATIONS, [&]()
+    {
+        std::string eventId = hub.captureEvent(event);
+        doNotOptimize(eventId);
+    });
+
+    const std::runtime_error exception("Benchmark exception");
+    run("hub/capture_exception_with_stacktrace", CAPTURE_ITERATIONS, [&]()
+    {
+        std::string eventId = hub.captureException(exception, nullptr, true);
+        doNotOptimize(eventId);
+    });
+
+    // do not measure the transport draining the queue when the hub is destroyed
+    server.waitForEvents(2 * (CAPTURE_ITERATIONS + CAPTURE_ITERATIONS/10 + 1), DRAIN_TIMEOUT);
+
+    benchCoalescing();
+}
+
+void benchThroughput()
+{
+    constexpr size_t numberOfEvents = 5000;
+
+    MockSentryServer server;
+
+    Sentry::SentryOptions options;
+    Sentry::Hub hub;
+    hub.init(server.dsn(), options);
+
+    const json event = makeEvent();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i=0; i<numberOfEvents; i++)
+    {
+        hub.captureEvent(event);
+    }
+    const bool allReceived = server.waitForEvents(numberOfEvents, DRAIN_TIMEOUT);
+    const auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    reportResult({{"benchmark", "throughput/capture_to_ingest"},
+                  {"events", numberOfEvents},
+                  {"events_received", server.eventsReceived()},
+                  {"complete", allReceived},
+                  {"events_per_second", static_cast<double>(server.eventsReceived()) / seconds},
+                  {"bytes_per_second", static_cast<double>(server.bytesReceived()) / seconds}});
+}
+
+} // namespace SentryBench
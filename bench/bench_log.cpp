@@ -0,0 +1,109 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+
+#include "sentry.h"
+#define SENTRY_NO_SPDLOG
+#include "sentry_logsink.h"
+
+#include <functional>
+#include <malloc.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t LOG_ITERATIONS = 100000;
+
+constexpr size_t NUMBER_OF_THREADS = 4;
+
+size_t heapInUse()
+{
+    return mallinfo2().uordblks;
+}
+
+// every thread logs LOG_ITERATIONS lines, reports ns per line of the whole run
+void runConcurrently(const std::string& name, const std::function<void(size_t)>& logLine)
+{
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t threadNo=0; threadNo<NUMBER_OF_THREADS; threadNo++)
+    {
+        threads.emplace_back([&logLine]()
+        {
+            for (size_t i=0; i<LOG_ITERATIONS; i++)
+            {
+                logLine(i);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double totalNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    report(name, NUMBER_OF_THREADS * LOG_ITERATIONS, totalNs / static_cast<double>(NUMBER_OF_THREADS * LOG_ITERATIONS));
+}
+
+} // namespace
+
+void benchLog()
+{
+    MockSentryServer server;
+
+    Sentry::SentryOptions options;
+    options.dsn = server.dsn();
+    Sentry::init(options);
+
+    const std::string key = "user_cache";
+    size_t i = 0;
+
+    Sentry::setLogLevel(Sentry::EventLevel::LEVEL_INFO);
+    run("log/debug/disabled_at_runtime", LOG_ITERATIONS * 100, [&]()
+    {
+        SENTRY_LOG_DEBUG("cache miss for {} after {} ms", key, i++);
+    });
+
+    Sentry::setLogLevel(Sentry::EventLevel::LEVEL_DEBUG);
+    run("log/debug/lazy_breadcrumb", LOG_ITERATIONS, [&]()
+    {
+        SENTRY_LOG_DEBUG("cache miss for {} after {} ms", key, i++);
+    });
+
+    // formats up front, as the callers of Sentry::log have to
+    run("log/debug/eager_string_breadcrumb", LOG_ITERATIONS, [&]()
+    {
+        Sentry::log(Sentry::EventLevel::LEVEL_DEBUG, "cache miss for " + key + " after " + std::to_string(i++) + " ms");
+    });
+
+    // the ring buffer is full at this point, so the slots are reused
+    const size_t before = heapInUse();
+    SENTRY_LOG_DEBUG("cache miss for {} after {} ms", key, i++);
+    reportMemory("log/debug/lazy_breadcrumb/heap_growth", heapInUse() - before);
+
+    // log sinks stage breadcrumbs per thread, Sentry::log takes the scope lock for every line
+    const Sentry::LogSink sink("bench");
+    run("log/sink/staged_breadcrumb", LOG_ITERATIONS, [&]()
+    {
+        sink(Sentry::EventLevel::LEVEL_INFO, "connection pool exhausted, waiting");
+    });
+
+    runConcurrently("log/sink/staged_breadcrumb/4_threads", [&sink](size_t)
+    {
+        sink(Sentry::EventLevel::LEVEL_INFO, "connection pool exhausted, waiting");
+    });
+
+    runConcurrently("log/direct_breadcrumb/4_threads", [](size_t)
+    {
+        Sentry::log(Sentry::EventLevel::LEVEL_INFO, "connection pool exhausted, waiting");
+    });
+}
+
+} // namespace SentryBench
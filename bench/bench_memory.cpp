@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include "scope.h"
+
+#include <list>
+#include <malloc.h>
+#include <string>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t NUMBER_OF_BREADCRUMBS = 100;
+
+size_t heapInUse()
+{
+    return mallinfo2().uordblks;
+}
+
+std::string breadcrumbMessage(size_t i)
+{
+    return "Breadcrumb message number " + std::to_string(i);
+}
+
+// breadcrumbs as the hub stored them before interning
+size_t jsonBreadcrumbsBytes()
+{
+    const size_t before = heapInUse();
+    {
+        std::list<json> breadcrumbs;
+        for (size_t i=0; i<NUMBER_OF_BREADCRUMBS; i++)
+        {
+            breadcrumbs.push_back({{"timestamp", "2011-10-08T07:07:09Z"},
+                                   {"type", "default"},
+                                   {"level", "info"},
+                                   {"category", "info"},
+                                   {"message", breadcrumbMessage(i)}});
+        }
+        const size_t after = heapInUse();
+        return after - before;
+    }
+}
+
+size_t internedBreadcrumbsBytes()
+{
+    const Sentry::InternedString type("default");
+    const Sentry::InternedString level("info");
+
+    const size_t before = heapInUse();
+    {
+        std::list<Sentry::Breadcrumb> breadcrumbs;
+        for (size_t i=0; i<NUMBER_OF_BREADCRUMBS; i++)
+        {
+            Sentry::Breadcrumb crumb;
+            crumb.timestamp = 1318057629;  // 2011-10-08T07:07:09Z
+            crumb.type = type;
+            crumb.level = level;
+            crumb.category = level;
+            crumb.message = breadcrumbMessage(i);
+            breadcrumbs.push_back(std::move(crumb));
+        }
+        const size_t after = heapInUse();
+        return after - before;
+    }
+}
+
+// the whole scope also keeps every breadcrumb pre-serialized
+size_t scopeBreadcrumbsBytes()
+{
+    const Sentry::InternedString type("default");
+    const Sentry::InternedString level("info");
+
+    Sentry::Scope scope;
+    const size_t before = heapInUse();
+    for (size_t i=0; i<NUMBER_OF_BREADCRUMBS; i++)
+    {
+        Sentry::Breadcrumb crumb;
+        crumb.timestamp = 1318057629;  // 2011-10-08T07:07:09Z
+        crumb.type = type;
+        crumb.level = level;
+        crumb.category = level;
+        crumb.message = breadcrumbMessage(i);
+        scope.addBreadcrumb(std::move(crumb));
+    }
+    return heapInUse() - before;
+}
+
+} // namespace
+
+void benchMemory()
+{
+    reportMemory("memory/breadcrumbs/json/100", jsonBreadcrumbsBytes());
+    reportMemory("memory/breadcrumbs/interned/100", internedBreadcrumbsBytes());
+    reportMemory("memory/scope/breadcrumbs/100", scopeBreadcrumbsBytes());
+
+    run("string_interner/intern_existing", 1000000, []()
+    {
+        static const std::string key = "server_name";
+        Sentry::InternedString interned(key);
+        doNotOptimize(interned);
+    });
+}
+
+} // namespace SentryBench
@@ -0,0 +1,109 @@
+#include "bench.h"
+
+#include "hub.h"
+#include "metricsaggregator.h"
+
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t RECORD_ITERATIONS = 10000000;
+constexpr size_t FLUSH_KEYS = 100;
+
+const std::chrono::milliseconds FLUSH_TIMEOUT(1000);
+
+} // namespace
+
+void benchMetrics()
+{
+    Sentry::metrics::Counter counter("bench.counter");
+
+    // before a hub enables the metrics
+    run("metrics/counter/disabled", RECORD_ITERATIONS, [&]()
+    {
+        counter.increment();
+    });
+
+    Sentry::SentryOptions options;
+    options.transport = Sentry::TransportType::MEMORY;
+    options.enableMetrics = true;
+    options.release = "bench@1.0";
+    Sentry::Hub hub;
+    hub.init("", options);
+
+    // the hot path: an accumulator of the thread, nothing locked or sent
+    run("metrics/counter", RECORD_ITERATIONS, [&]()
+    {
+        counter.increment();
+    });
+
+    run("metrics/counter/by_name", RECORD_ITERATIONS, [&]()
+    {
+        Sentry::metrics::increment("bench.counter.by_name");
+    });
+
+    Sentry::metrics::Gauge gauge("bench.gauge", "byte");
+    double gaugeValue = 0.0;
+    run("metrics/gauge", RECORD_ITERATIONS, [&]()
+    {
+        gauge.set(gaugeValue);
+        gaugeValue += 1.0;
+    });
+
+    Sentry::metrics::Distribution distribution("bench.distribution", "millisecond");
+    double distributionValue = 0.001;
+    run("metrics/distribution", RECORD_ITERATIONS, [&]()
+    {
+        distribution.record(distributionValue);
+        distributionValue = (distributionValue > 1e6) ? 0.001 : distributionValue * 1.001;
+    });
+
+    Sentry::metrics::Set set("bench.set");
+    uint32_t setValue = 0;
+    run("metrics/set", RECORD_ITERATIONS, [&]()
+    {
+        set.add(setValue++ % 512);
+    });
+
+    // the whole way of a bucket: taking the accumulators, the statsd lines and the envelope
+    std::vector<Sentry::metrics::Distribution> distributions;
+    for (size_t i=0; i<FLUSH_KEYS; i++)
+    {
+        distributions.emplace_back("bench.flush." + std::to_string(i), "millisecond");
+    }
+    hub.flush(FLUSH_TIMEOUT);
+    hub.takeCapturedEvents();
+    run("metrics/flush/100_distributions", 1000, [&]()
+    {
+        for (size_t i=0; i<FLUSH_KEYS; i++)
+        {
+            for (size_t value=1; value<=100; value++)
+            {
+                distributions[i].record(static_cast<double>(value));
+            }
+        }
+        hub.flush(FLUSH_TIMEOUT);
+        std::vector<std::string> envelopes = hub.takeCapturedEvents();
+        doNotOptimize(envelopes);
+    });
+
+    // the error of the sketch, over 12 orders of magnitude
+    double maxRelativeError = 0.0;
+    for (double value=1e-6; value<1e6; value*=1.0001)
+    {
+        const double estimate = Sentry::MetricsAggregator::sketchValue(Sentry::MetricsAggregator::sketchIndex(value));
+        maxRelativeError = std::max(maxRelativeError, std::fabs(estimate - value) / value);
+    }
+    reportResult({{"benchmark", "metrics/distribution/sketch_error"},
+                  {"max_relative_error", maxRelativeError}});
+}
+
+} // namespace SentryBench
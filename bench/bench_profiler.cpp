@@ -0,0 +1,150 @@
+#include "bench.h"
+
+#include "hub.h"
+#include "profiler.h"
+#include "sdkstats.h"
+#include "spanrecorder.h"
+
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t SAMPLE_BATCHES = 100;
+constexpr size_t SAMPLES_PER_BATCH = PROFILER_RING_SAMPLES / 2;     // collected between the batches, never dropped
+constexpr int STACK_DEPTH = 16;
+constexpr size_t WORKLOAD_ROUNDS = 3;
+
+const std::chrono::milliseconds FLUSH_TIMEOUT(1000);
+
+// the sampled stack is STACK_DEPTH frames deeper than the caller
+template<typename F>
+__attribute__((noinline)) void atDepth(int depth, F&& function)
+{
+    if (depth > 0)
+    {
+        atDepth(depth - 1, function);
+    }
+    else
+    {
+        function();
+    }
+    asm volatile("");   // not a tail call
+}
+
+// CPU bound work, the same amount every call
+__attribute__((noinline)) uint64_t workload()
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i=0; i<300000000; i++)
+    {
+        hash = (hash ^ i) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+double measureWorkloadNs()
+{
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t hash = 0;
+    atDepth(STACK_DEPTH, [&hash]() { hash = workload(); });
+    doNotOptimize(hash);
+    const auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// the handler of one SIGPROF (its delivery included), measured with raise
+double measureSampleNs(Sentry::StackUnwinder unwinder)
+{
+    Sentry::Profiler& profiler = Sentry::Profiler::instance();
+    const int64_t start = Sentry::SpanRecorder::steadyNanoseconds();
+    if (!profiler.start(start, PROFILER_MIN_FREQUENCY_HZ, unwinder))
+        return 0.0;
+
+    double totalNs = 0.0;
+    atDepth(STACK_DEPTH, [&]()
+    {
+        for (size_t batch=0; batch<SAMPLE_BATCHES; batch++)
+        {
+            const auto batchStart = std::chrono::steady_clock::now();
+            for (size_t i=0; i<SAMPLES_PER_BATCH; i++)
+            {
+                raise(SIGPROF);
+            }
+            const auto batchEnd = std::chrono::steady_clock::now();
+            totalNs += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(batchEnd - batchStart).count());
+
+            profiler.collectSamples();
+        }
+    });
+
+    profiler.cancel(start);
+    return totalNs / static_cast<double>(SAMPLE_BATCHES * SAMPLES_PER_BATCH);
+}
+
+} // namespace
+
+void benchProfiler()
+{
+    const std::vector<std::pair<const char*, Sentry::StackUnwinder>> unwinders =
+    {
+        {"backtrace", Sentry::StackUnwinder::BACKTRACE},
+        {"frame_pointer", Sentry::StackUnwinder::FRAME_POINTER},
+        {"eh_frame", Sentry::StackUnwinder::EH_FRAME},
+    };
+
+    double sampleNs = 0.0;
+    for (const auto& unwinder : unwinders)
+    {
+        const double ns = measureSampleNs(unwinder.second);
+        report(std::string("profiler/sample/") + unwinder.first, SAMPLE_BATCHES * SAMPLES_PER_BATCH, ns);
+        if (unwinder.second == Sentry::StackUnwinder::EH_FRAME)
+        {
+            sampleNs = ns;
+        }
+    }
+
+    // the same workload without and with a profiled transaction sampling it at 100 Hz
+    Sentry::SentryOptions options;
+    options.transport = Sentry::TransportType::MEMORY;
+    options.tracesSampleRate = 100;
+    options.profilesSampleRate = 100;
+    options.profilingFrequencyHz = 100;
+    options.stackUnwinder = Sentry::StackUnwinder::EH_FRAME;
+    Sentry::Hub hub;
+    hub.init("", options);
+
+    // alternating, the fastest round of each: the others were disturbed by something else
+    measureWorkloadNs();
+    const uint64_t samplesBefore = Sentry::SdkStats::instance().snapshot().profileSamples;
+    double withoutNs = 0.0;
+    double withNs = 0.0;
+    for (size_t round=0; round<WORKLOAD_ROUNDS; round++)
+    {
+        const double ns = measureWorkloadNs();
+        withoutNs = (round == 0 || ns < withoutNs) ? ns : withoutNs;
+
+        Sentry::Span transaction = hub.startTransaction("benchmark", "bench");
+        const double profiledNs = measureWorkloadNs();
+        withNs = (round == 0 || profiledNs < withNs) ? profiledNs : withNs;
+    }
+    hub.flush(FLUSH_TIMEOUT);
+    std::vector<std::string> envelopes = hub.takeCapturedEvents();
+    doNotOptimize(envelopes);
+    const uint64_t samples = Sentry::SdkStats::instance().snapshot().profileSamples - samplesBefore;
+
+    reportResult({{"benchmark", "profiler/overhead/100hz"},
+                  {"samples", samples},
+                  {"cpu_percent_measured", (withNs - withoutNs) * 100.0 / withoutNs},
+                  {"cpu_percent_from_sample_cost", sampleNs * 100.0 * 100.0 / 1e9}});
+}
+
+} // namespace SentryBench
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include "scope.h"
+
+#include <string>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+void fillScope(Sentry::Scope& scope, size_t numberOfTags)
+{
+    for (size_t i=0; i<numberOfTags; i++)
+    {
+        scope.setTag("tag_" + std::to_string(i), "value_" + std::to_string(i));
+    }
+    scope.setExtra("extra_key", "extra_value");
+}
+
+json makeEvent()
+{
+    return
+    {
+        {"message", "Benchmark event"},
+        {"event_id", "fc6d8c0c43fc4630ad850ee518f1b9d0"},
+        {"timestamp", "2011-10-08T07:07:09Z"},
+        {"platform", "other"},
+    };
+}
+
+} // namespace
+
+void benchScope()
+{
+    Sentry::Scope scope;
+    fillScope(scope, 50);
+    const json event = makeEvent();
+
+    // both paths must produce the same event
+    json applied = event;
+    scope.applyToEvent(applied);
+    if (json::parse(scope.serializeEvent(event)) != applied)
+    {
+        std::cerr << "scope/serialize_event differs from scope/apply_to_event" << std::endl;
+    }
+
+    run("scope/apply_to_event+dump/50_tags", 100000, [&]()
+    {
+        json payload = event;
+        scope.applyToEvent(payload);
+        std::string contents = payload.dump();
+        doNotOptimize(contents);
+    });
+
+    run("scope/serialize_event/50_tags", 100000, [&]()
+    {
+        std::string contents = scope.serializeEvent(event);
+        doNotOptimize(contents);
+    });
+}
+
+} // namespace SentryBench
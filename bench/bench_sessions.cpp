@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#include "hub.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t REQUEST_ITERATIONS = 10000000;
+
+const std::chrono::milliseconds FLUSH_TIMEOUT(1000);
+
+} // namespace
+
+void benchSessions()
+{
+    Sentry::SentryOptions options;
+    options.transport = Sentry::TransportType::MEMORY;
+    options.release = "bench@1.0";
+    Sentry::Hub hub;
+    hub.init("", options);
+
+    // the hot path of a server: counted into the minute, nothing sent
+    run("sessions/request_session", REQUEST_ITERATIONS, [&]()
+    {
+        Sentry::RequestSession session = hub.startRequestSession();
+        doNotOptimize(session);
+    });
+
+    run("sessions/request_session/errored", REQUEST_ITERATIONS, [&]()
+    {
+        Sentry::RequestSession session = hub.startRequestSession();
+        session.setErrored();
+    });
+
+    // every request above, in a single envelope
+    hub.flush(FLUSH_TIMEOUT);
+    const std::vector<std::string> envelopes = hub.takeCapturedEvents();
+    reportResult({{"benchmark", "sessions/request_session/envelopes"},
+                  {"requests", 2 * (REQUEST_ITERATIONS + REQUEST_ITERATIONS / 10 + 1)},
+                  {"envelopes", envelopes.size()}});
+
+    run("sessions/flush_aggregates", 10000, [&]()
+    {
+        Sentry::RequestSession session = hub.startRequestSession();
+        session.end();
+        hub.flush(FLUSH_TIMEOUT);
+        std::vector<std::string> sent = hub.takeCapturedEvents();
+        doNotOptimize(sent);
+    });
+
+    // the session of the application: an update per start and end
+    run("sessions/start_end_session", 10000, [&]()
+    {
+        hub.startSession();
+        hub.endSession();
+        hub.flush(FLUSH_TIMEOUT);
+        std::vector<std::string> sent = hub.takeCapturedEvents();
+        doNotOptimize(sent);
+    });
+}
+
+} // namespace SentryBench
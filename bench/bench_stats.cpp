@@ -0,0 +1,25 @@
+#include "bench.h"
+
+#include "sdkstats.h"
+
+
+namespace SentryBench
+{
+
+void benchStats()
+{
+    Sentry::SdkStats& stats = Sentry::SdkStats::instance();
+
+    run("stats/add", 10000000, [&]()
+    {
+        stats.add(Sentry::StatCounter::EVENTS_CAPTURED);
+    });
+
+    run("stats/snapshot", 100000, [&]()
+    {
+        Sentry::SdkStatistics statistics = stats.snapshot();
+        doNotOptimize(statistics);
+    });
+}
+
+} // namespace SentryBench
@@ -0,0 +1,96 @@
+#include "bench.h"
+
+#include "hub.h"
+#include "spanrecorder.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+namespace SentryBench
+{
+
+namespace
+{
+
+constexpr size_t SPAN_BATCHES = 2000;
+constexpr size_t SPANS_PER_BATCH = Sentry::SpanBuffer::CAPACITY / 2;    // drained between the batches, never dropped
+constexpr size_t TRANSACTION_ITERATIONS = 10000;
+
+const std::chrono::milliseconds FLUSH_TIMEOUT(1000);
+
+} // namespace
+
+void benchTracing()
+{
+    Sentry::SentryOptions options;
+    options.transport = Sentry::TransportType::MEMORY;
+    options.tracesSampleRate = 100;
+    Sentry::Hub hub;
+    hub.init("", options);
+
+    // a span reads the clock twice, the rest is the bookkeeping
+    run("tracing/steady_clock_now", 10000000, [&]()
+    {
+        int64_t now = Sentry::SpanRecorder::steadyNanoseconds();
+        doNotOptimize(now);
+    });
+
+    // the hot path only: the ring of the thread is drained between the batches, outside of the measurement
+    {
+        Sentry::Span transaction = hub.startTransaction("benchmark", "bench");
+        double totalNs = 0.0;
+        for (size_t batch=0; batch<SPAN_BATCHES; batch++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i=0; i<SPANS_PER_BATCH; i++)
+            {
+                Sentry::Span span = transaction.startChild("db.query", "SELECT 1");
+                doNotOptimize(span);
+            }
+            const auto end = std::chrono::steady_clock::now();
+            totalNs += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+            hub.flush(FLUSH_TIMEOUT);
+        }
+        report("tracing/span_start_finish", SPAN_BATCHES * SPANS_PER_BATCH,
+               totalNs / static_cast<double>(SPAN_BATCHES * SPANS_PER_BATCH));
+    }
+    hub.flush(FLUSH_TIMEOUT);
+    hub.takeCapturedEvents();
+
+    Sentry::Span notRecording;
+    run("tracing/span_start_finish/not_recording", 10000000, [&]()
+    {
+        Sentry::Span span = notRecording.startChild("db.query", "SELECT 1");
+        doNotOptimize(span);
+    });
+
+    options.tracesSampleRate = 0;
+    Sentry::Hub sampledOutHub;
+    sampledOutHub.init("", options);
+    run("tracing/start_transaction/sampled_out", 1000000, [&]()
+    {
+        Sentry::Span transaction = sampledOutHub.startTransaction("benchmark", "bench");
+        doNotOptimize(transaction);
+    });
+
+    // the whole way: the records, the drain, building the transaction and its envelope
+    run("tracing/transaction_10_spans/sent", TRANSACTION_ITERATIONS, [&]()
+    {
+        {
+            Sentry::Span transaction = hub.startTransaction("benchmark", "bench");
+            for (size_t i=0; i<10; i++)
+            {
+                Sentry::Span span = transaction.startChild("db.query", "SELECT 1");
+                span.setStatus("ok");
+            }
+        }
+        hub.flush(FLUSH_TIMEOUT);
+        std::vector<std::string> envelopes = hub.takeCapturedEvents();
+        doNotOptimize(envelopes);
+    });
+}
+
+} // namespace SentryBench
@@ -0,0 +1,199 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+
+#include "httptransport.h"
+#include "memorytransport.h"
+
+#include <asio.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+
+namespace Sentry
+{
+
+class TransportBenchmark
+{
+public:
+
+    static const http::Header& prepareHeader(HttpTransport& transport, size_t contentLength)
+    {
+        return transport.prepareHeader(contentLength);
+    }
+};
+
+} // namespace Sentry
+
+namespace SentryBench
+{
+
+namespace
+{
+
+// how the header was built for every request before the template
+http::Header createHeaderBaseline(const Sentry::SentryDSN& dsn)
+{
+    http::Header header;
+    std::string client_version = "sentry_cpp/0.1";
+    const auto dur = std::chrono::system_clock::now().time_since_epoch();
+    std::string timestamp = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(dur).count());
+
+    std::stringstream ss;
+    ss << "Sentry " << "sentry_version=" << 7 << ", "
+       << "sentry_client=" << client_version << ", "
+       << "sentry_timestamp=" << timestamp << ", "
+       << "sentry_key=" << dsn.publicKey;
+    if (dsn.secretKey != "")
+        ss << ", " << "sentry_secret=" << dsn.secretKey;
+
+    header.emplace("X-Sentry-Auth", ss.str());
+    header.emplace("Content-Type", "application/json");
+    header.emplace("User-Agent", client_version);
+    return header;
+}
+
+// local relay for the UNIX socket transport, reads and discards
+class SocketRelay
+{
+public:
+
+    explicit SocketRelay(const std::string& path)
+    :
+    m_path(path),
+    m_listening(socket(AF_UNIX, SOCK_STREAM, 0)),
+    m_thread()
+    {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", m_path.c_str());
+        unlink(m_path.c_str());
+        bind(m_listening, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        listen(m_listening, 4);
+
+        m_thread = std::thread([this]()
+        {
+            int connection;
+            while ((connection = accept(m_listening, nullptr, nullptr)) >= 0)
+            {
+                char buffer[65536];
+                while (read(connection, buffer, sizeof(buffer)) > 0)
+                {
+                }
+                close(connection);
+            }
+        });
+    }
+
+    ~SocketRelay()
+    {
+        shutdown(m_listening, SHUT_RDWR);
+        close(m_listening);
+        m_thread.join();
+        unlink(m_path.c_str());
+    }
+
+private:
+
+    std::string m_path;
+    int m_listening;
+    std::thread m_thread;
+};
+
+long contextSwitches()
+{
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// cost of an event from the queue to the destination, the transport drained with flush;
+// with ioContext the worker runs on it instead of a thread of its own
+void runTransport(const std::string& name, size_t numberOfEvents, Sentry::TransportType type, const std::string& dsn,
+                  const std::string& path, asio::io_context* ioContext = nullptr)
+{
+    Sentry::SentryOptions options;
+    options.transport = type;
+    options.transportPath = path;
+    Sentry::SentryDSN parsedDsn;
+    Sentry::SentryDSN::parseDSN(dsn, &parsedDsn);
+
+    auto transport = Sentry::Transport::create(type);
+    transport->setup(parsedDsn, options);
+    transport->setIoContext(ioContext);
+    transport->start();
+    transport->flush(std::chrono::seconds(5));      // the connection is prewarmed
+
+    const std::string event = "{\"event_id\": \"0123456789abcdef0123456789abcdef\", \"message\": \"benchmark\", \"level\": \"error\"}";
+    const long switchesBefore = contextSwitches();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i=0; i<numberOfEvents; i++)
+    {
+        transport->sendEvent(event);
+    }
+    transport->flush(std::chrono::seconds(60));
+    const auto end = std::chrono::steady_clock::now();
+    const long switches = contextSwitches() - switchesBefore;
+    transport->stop();
+
+    const double totalNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    report(name, numberOfEvents, totalNs / static_cast<double>(numberOfEvents));
+    reportResult({{"benchmark", name + "/context_switches"},
+                  {"per_event", static_cast<double>(switches) / static_cast<double>(numberOfEvents)}});
+}
+
+} // namespace
+
+void benchTransport()
+{
+    Sentry::SentryDSN dsn;
+    Sentry::SentryDSN::parseDSN("http://0123456789abcdef0123456789abcdef@127.0.0.1:9000/1", &dsn);
+
+    run("transport/create_header/baseline", 1000000, [&]()
+    {
+        http::Header header = createHeaderBaseline(dsn);
+        doNotOptimize(header);
+    });
+
+    Sentry::HttpTransport transport;
+    transport.setup(dsn, Sentry::SentryOptions());
+    size_t contentLength = 0;
+    run("transport/prepare_header", 1000000, [&]()
+    {
+        const http::Header& header = Sentry::TransportBenchmark::prepareHeader(transport, 1000 + contentLength++ % 1000);
+        doNotOptimize(header);
+    });
+
+    runTransport("transport/send/memory", 100000, Sentry::TransportType::MEMORY, "", "");
+
+    const std::string filePath = "/tmp/sentry_bench_events_" + std::to_string(getpid()) + ".jsonl";
+    runTransport("transport/send/file", 100000, Sentry::TransportType::FILE, "", filePath);
+    std::remove(filePath.c_str());
+
+    const std::string socketPath = "/tmp/sentry_bench_relay_" + std::to_string(getpid()) + ".sock";
+    {
+        SocketRelay relay(socketPath);
+        runTransport("transport/send/unix_socket", 100000, Sentry::TransportType::UNIX_SOCKET, "", socketPath);
+    }
+
+    MockSentryServer server;
+    runTransport("transport/send/http", 5000, Sentry::TransportType::HTTP, server.dsn(), "");
+
+    // the event loop of an application, here with a thread of its own
+    asio::io_context ioContext;
+    auto work = asio::make_work_guard(ioContext);
+    std::thread loop([&ioContext]() { ioContext.run(); });
+    runTransport("transport/send/memory/io_context", 100000, Sentry::TransportType::MEMORY, "", "", &ioContext);
+    runTransport("transport/send/http/io_context", 5000, Sentry::TransportType::HTTP, server.dsn(), "", &ioContext);
+    work.reset();
+    loop.join();
+}
+
+} // namespace SentryBench
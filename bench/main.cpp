@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#ifndef SENTRY_BENCH_BUILD_TYPE
+#define SENTRY_BENCH_BUILD_TYPE ""
+#endif
+
+
+/*
+ * usage: sentry_bench [group_filter] [--output results.jsonl]
+ * group_filter runs only the groups containing the given substring
+ */
+int main(int argc, char** argv)
+{
+    const char* filter = "";
+    std::ofstream outputFile;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (std::strcmp(argv[i], "--output") == 0 && i+1 < argc)
+        {
+            outputFile.open(argv[++i]);
+            SentryBench::output() = &outputFile;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    // first line describes the run, so results from different builds can be compared
+    SentryBench::reportResult({{"context", {{"compiler", __VERSION__},
+                                            {"build_type", SENTRY_BENCH_BUILD_TYPE},
+                                            {"timestamp", static_cast<int64_t>(std::time(nullptr))}}}});
+
+    const std::vector<std::pair<const char*, std::function<void()>>> groups =
+    {
+        {"event_processors", SentryBench::benchEventProcessors},
+        {"scope", SentryBench::benchScope},
+        {"dsn", SentryBench::benchDsn},
+        {"memory", SentryBench::benchMemory},
+        {"stats", SentryBench::benchStats},
+        {"hub", SentryBench::benchHub},
+        {"log", SentryBench::benchLog},
+        {"backtrace", SentryBench::benchBacktrace},
+        {"throughput", SentryBench::benchThroughput},
+        {"tracing", SentryBench::benchTracing},
+        {"profiler", SentryBench::benchProfiler},
+        {"sessions", SentryBench::benchSessions},
+        {"metrics", SentryBench::benchMetrics},
+        {"attachments", SentryBench::benchAttachments},
+        {"event_size", SentryBench::benchEventSize},
+        {"transport", SentryBench::benchTransport},
+        {"https", SentryBench::benchHttps},
+    };
+
+    for (const auto& group : groups)
+    {
+        if (std::strstr(group.first, filter) != nullptr)
+        {
+            group.second();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,414 @@
+#ifndef SENTRY_MOCKSENTRYSERVER_H
+#define SENTRY_MOCKSENTRYSERVER_H
+
+#include "server_http.hpp"
+#include "server_https.hpp"
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <zlib.h>
+
+
+/*
+ * Local stand-in for the Sentry ingest, built on the vendored SimpleWeb server.
+ * Binds to a free port on 127.0.0.1 and serves on its own thread.
+ * MockSentryTlsServer serves https, with the certificate and key files given (see selfsignedcertificate.h).
+ *
+ * Accepts the store and envelope endpoints (optionally gzip encoded) and can inject faults:
+ * latency, 429 with Retry-After, 5xx errors and connections closed without a response.
+ * Events carrying "extra": {"soak_sent_ns": <steady_clock ns>} get their capture-to-ingest latency recorded.
+ */
+
+using json = nlohmann::json;
+
+namespace SentryBench
+{
+
+class FaultProfile
+{
+public:
+    std::string name = "none";
+    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+    double tooManyRequestsRate = 0.0;
+    int retryAfterSeconds = 1;
+    double serverErrorRate = 0.0;
+    double connectionResetRate = 0.0;
+    bool closeConnections = false;      // "Connection: close" on every response, each request needs a new connection
+};
+
+template<typename SocketType>
+class BasicMockSentryServer
+{
+public:
+
+    // serverArguments go to the SimpleWeb server, for https the certificate and private key files
+    template<typename... ServerArguments>
+    explicit BasicMockSentryServer(const FaultProfile& faults = FaultProfile(), ServerArguments&&... serverArguments)
+    :
+    m_faults(faults),
+    m_server(std::forward<ServerArguments>(serverArguments)...),
+    m_thread(),
+    m_requestsReceived(0),
+    m_eventsReceived(0),
+    m_bytesReceived(0),
+    m_mutex(),
+    m_conditionVariable(),
+    m_eventIds(),
+    m_itemTypes(),
+    m_itemPayloads(),
+    m_latenciesNs(),
+    m_random(42)
+    {
+        m_server.config.address = "127.0.0.1";
+        m_server.config.port = 0;
+        m_server.io_service = std::make_shared<asio::io_service>();
+
+        // the target of the request line is absolute or relative, depending on the client
+        m_server.resource["^.*/api/[0-9]+/store/$"]["POST"] =
+            [this](std::shared_ptr<typename Server::Response> response, std::shared_ptr<typename Server::Request> request)
+        {
+            handleRequest(response, request, false);
+        };
+        m_server.resource["^.*/api/[0-9]+/envelope/$"]["POST"] =
+            [this](std::shared_ptr<typename Server::Response> response, std::shared_ptr<typename Server::Request> request)
+        {
+            handleRequest(response, request, true);
+        };
+
+        m_server.start();   // with an external io_service only binds and starts accepting
+        m_thread = std::thread([this]() { m_server.io_service->run(); });
+    }
+
+    ~BasicMockSentryServer()
+    {
+        m_server.stop();
+        m_server.io_service->stop();
+        m_thread.join();
+    }
+
+    unsigned short port()
+    {
+        return m_server.boundPort();
+    }
+
+    std::string dsn()
+    {
+        return std::string(std::is_same<SocketType, SimpleWeb::HTTPS>::value ? "https" : "http")
+                + "://public@127.0.0.1:" + std::to_string(port()) + "/1";
+    }
+
+    size_t requestsReceived() const
+    {
+        return m_requestsReceived;
+    }
+
+    // accepted events, retried duplicates included
+    size_t eventsReceived() const
+    {
+        return m_eventsReceived;
+    }
+
+    size_t uniqueEventsReceived() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_eventIds.size();
+    }
+
+    size_t bytesReceived() const
+    {
+        return m_bytesReceived;
+    }
+
+    // accepted envelope items by type
+    std::map<std::string, size_t> envelopeItems() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_itemTypes;
+    }
+
+    std::vector<json> envelopeItemsOfType(const std::string& type) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_itemPayloads.find(type);
+        return (found != m_itemPayloads.end()) ? found->second : std::vector<json>();
+    }
+
+    // capture-to-ingest latency percentile (0.0 - 1.0) in nanoseconds, 0 if nothing recorded
+    uint64_t latencyPercentileNs(double percentile) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_latenciesNs.empty())
+            return 0;
+
+        std::vector<uint64_t> sorted(m_latenciesNs);
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(percentile * static_cast<double>(sorted.size())))];
+    }
+
+    bool waitForEvents(size_t count, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_conditionVariable.wait_for(lock, timeout, [this, count]() { return m_eventsReceived >= count; });
+    }
+
+    bool waitForUniqueEvents(size_t count, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_conditionVariable.wait_for(lock, timeout, [this, count]() { return m_eventIds.size() >= count; });
+    }
+
+    bool waitForEnvelopeItems(const std::string& type, size_t count, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_conditionVariable.wait_for(lock, timeout, [this, &type, count]() { return m_itemTypes[type] >= count; });
+    }
+
+    static std::string gunzip(const std::string& compressed)
+    {
+        z_stream stream = {};
+        if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+            return "";
+
+        std::string output;
+        char buffer[16384];
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        int result = Z_OK;
+        while (result == Z_OK)
+        {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer);
+            stream.avail_out = sizeof(buffer);
+            result = inflate(&stream, Z_NO_FLUSH);
+            output.append(buffer, sizeof(buffer) - stream.avail_out);
+        }
+        inflateEnd(&stream);
+        return (result == Z_STREAM_END) ? output : "";
+    }
+
+private:
+
+    class Server : public SimpleWeb::Server<SocketType>
+    {
+    public:
+        template<typename... Arguments>
+        explicit Server(Arguments&&... arguments)
+        :
+        SimpleWeb::Server<SocketType>(std::forward<Arguments>(arguments)...)
+        {
+            allowTls13(*this);
+        }
+
+        unsigned short boundPort()
+        {
+            return this->acceptor->local_endpoint().port();
+        }
+
+    private:
+        static void allowTls13(SimpleWeb::Server<SimpleWeb::HTTP>&)
+        {
+        }
+
+        // the tlsv12 context of SimpleWeb pins the maximum to TLS 1.2 as well
+        void allowTls13(SimpleWeb::Server<SimpleWeb::HTTPS>&)
+        {
+            SSL_CTX_set_max_proto_version(this->context.native_handle(), 0);
+        }
+    };
+
+    enum class Fault
+    {
+        NONE,
+        TOO_MANY_REQUESTS,
+        SERVER_ERROR,
+        CONNECTION_RESET
+    };
+
+    Fault drawFault()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const double draw = std::uniform_real_distribution<double>(0.0, 1.0)(m_random);
+        if (draw < m_faults.tooManyRequestsRate)
+            return Fault::TOO_MANY_REQUESTS;
+        if (draw < m_faults.tooManyRequestsRate + m_faults.serverErrorRate)
+            return Fault::SERVER_ERROR;
+        if (draw < m_faults.tooManyRequestsRate + m_faults.serverErrorRate + m_faults.connectionResetRate)
+            return Fault::CONNECTION_RESET;
+        return Fault::NONE;
+    }
+
+    void handleRequest(std::shared_ptr<typename Server::Response> response, std::shared_ptr<typename Server::Request> request, bool isEnvelope)
+    {
+        m_requestsReceived++;
+
+        std::string content = request->content.string();
+        auto encoding = request->header.find("Content-Encoding");
+        if (encoding != request->header.end() && encoding->second == "gzip")
+        {
+            content = gunzip(content);
+        }
+
+        const Fault fault = drawFault();
+        auto respond = [this, response, content, isEnvelope, fault]()
+        {
+            switch (fault)
+            {
+            case Fault::TOO_MANY_REQUESTS:
+            {
+                SimpleWeb::CaseInsensitiveMultimap header;
+                header.emplace("Retry-After", std::to_string(m_faults.retryAfterSeconds));
+                response->write(SimpleWeb::StatusCode::client_error_too_many_requests, header);
+                break;
+            }
+            case Fault::SERVER_ERROR:
+                response->write(SimpleWeb::StatusCode::server_error_service_unavailable);
+                break;
+            case Fault::CONNECTION_RESET:
+                // close the connection without any response
+                response->close_connection_after_response = true;
+                break;
+            case Fault::NONE:
+                if (m_faults.closeConnections)
+                {
+                    SimpleWeb::CaseInsensitiveMultimap header;
+                    header.emplace("Connection", "close");
+                    response->close_connection_after_response = true;
+                    response->write(SimpleWeb::StatusCode::success_ok, "{\"id\": \"\"}", header);
+                }
+                else
+                {
+                    response->write(SimpleWeb::StatusCode::success_ok, "{\"id\": \"\"}");
+                }
+                accept(content, isEnvelope);
+                break;
+            }
+        };
+
+        if (m_faults.latency.count() > 0)
+        {
+            auto timer = std::make_shared<asio::steady_timer>(*m_server.io_service, m_faults.latency);
+            timer->async_wait([timer, respond](const SimpleWeb::error_code&) { respond(); });
+        }
+        else
+        {
+            respond();
+        }
+    }
+
+    void accept(const std::string& content, bool isEnvelope)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bytesReceived += content.size();
+            if (isEnvelope)
+            {
+                acceptEnvelope(content);
+            }
+            else
+            {
+                acceptEvent(json::parse(content, nullptr, false));
+            }
+        }
+        m_conditionVariable.notify_all();
+    }
+
+    // called with m_mutex held
+    void acceptEvent(const json& event)
+    {
+        if (!event.is_object())
+            return;
+
+        m_eventsReceived++;
+        auto eventId = event.find("event_id");
+        if (eventId != event.end())
+        {
+            m_eventIds.insert(eventId->dump());
+        }
+
+        auto extra = event.find("extra");
+        if (extra != event.end() && extra->find("soak_sent_ns") != extra->end())
+        {
+            const int64_t sentNs = (*extra)["soak_sent_ns"].get<int64_t>();
+            const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+            m_latenciesNs.push_back(static_cast<uint64_t>(nowNs - sentNs));
+        }
+    }
+
+    // called with m_mutex held
+    void acceptEnvelope(const std::string& content)
+    {
+        // header line, then items: item header line and its payload (of the given length or up to the newline)
+        size_t position = content.find('\n');
+        while (position != std::string::npos && position + 1 < content.size())
+        {
+            const size_t headerStart = position + 1;
+            const size_t headerEnd = content.find('\n', headerStart);
+            if (headerEnd == std::string::npos)
+                break;
+
+            const json itemHeader = json::parse(content.substr(headerStart, headerEnd - headerStart), nullptr, false);
+            if (!itemHeader.is_object())
+                break;
+
+            const size_t payloadStart = headerEnd + 1;
+            size_t payloadLength;
+            if (itemHeader.find("length") != itemHeader.end())
+            {
+                payloadLength = itemHeader["length"].get<size_t>();
+            }
+            else
+            {
+                const size_t payloadEnd = content.find('\n', payloadStart);
+                payloadLength = ((payloadEnd == std::string::npos) ? content.size() : payloadEnd) - payloadStart;
+            }
+
+            const std::string type = itemHeader.value("type", "");
+            m_itemTypes[type]++;
+            if (type == "event")
+            {
+                acceptEvent(json::parse(content.substr(payloadStart, payloadLength), nullptr, false));
+            }
+            else if (type != "attachment")
+            {
+                m_itemPayloads[type].push_back(json::parse(content.substr(payloadStart, payloadLength), nullptr, false));
+            }
+
+            position = payloadStart + payloadLength;    // the newline after the payload
+        }
+    }
+
+    FaultProfile m_faults;
+    Server m_server;
+    std::thread m_thread;
+
+    std::atomic<size_t> m_requestsReceived;
+    std::atomic<size_t> m_eventsReceived;
+    std::atomic<size_t> m_bytesReceived;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_conditionVariable;
+    std::set<std::string> m_eventIds;
+    std::map<std::string, size_t> m_itemTypes;
+    std::map<std::string, std::vector<json>> m_itemPayloads;
+    std::vector<uint64_t> m_latenciesNs;
+    std::mt19937 m_random;
+};
+
+using MockSentryServer = BasicMockSentryServer<SimpleWeb::HTTP>;
+using MockSentryTlsServer = BasicMockSentryServer<SimpleWeb::HTTPS>;
+
+} // namespace SentryBench
+
+#endif // SENTRY_MOCKSENTRYSERVER_H
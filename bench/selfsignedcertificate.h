@@ -0,0 +1,117 @@
+#ifndef SENTRY_SELFSIGNEDCERTIFICATE_H
+#define SENTRY_SELFSIGNEDCERTIFICATE_H
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+
+/*
+ * Certificate for the local TLS stand-in, generated at runtime so no key material is kept in the repository.
+ * EC P-256 key, self-signed for 127.0.0.1 (subject alternative name) and usable as its own CA,
+ * so the client can verify it by passing certificatePath() as SentryOptions::caCerts.
+ * The PEM files are written to the temporary directory and removed with the object.
+ */
+
+namespace SentryBench
+{
+
+class SelfSignedCertificate
+{
+public:
+
+    SelfSignedCertificate()
+    :
+    m_certificatePath(),
+    m_privateKeyPath()
+    {
+        EVP_PKEY* key = EVP_EC_gen("P-256");
+        X509* certificate = X509_new();
+        if (key == nullptr || certificate == nullptr)
+            throw std::runtime_error("Could not create the key of the self-signed certificate");
+
+        X509_set_version(certificate, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate), -60);
+        X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 60 * 60);
+        X509_set_pubkey(certificate, key);
+
+        X509_NAME* name = X509_get_subject_name(certificate);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+        X509_set_issuer_name(certificate, name);
+
+        addExtension(certificate, NID_subject_alt_name, "IP:127.0.0.1");
+        addExtension(certificate, NID_basic_constraints, "critical,CA:TRUE");
+
+        if (X509_sign(certificate, key, EVP_sha256()) == 0)
+            throw std::runtime_error("Could not sign the self-signed certificate");
+
+        m_certificatePath = writePem("sentry_bench_certificate", [certificate](FILE* file) { return PEM_write_X509(file, certificate); });
+        m_privateKeyPath = writePem("sentry_bench_key", [key](FILE* file)
+        {
+            return PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+        });
+
+        X509_free(certificate);
+        EVP_PKEY_free(key);
+    }
+
+    ~SelfSignedCertificate()
+    {
+        std::remove(m_certificatePath.c_str());
+        std::remove(m_privateKeyPath.c_str());
+    }
+
+    const std::string& certificatePath() const
+    {
+        return m_certificatePath;
+    }
+
+    const std::string& privateKeyPath() const
+    {
+        return m_privateKeyPath;
+    }
+
+private:
+
+    SelfSignedCertificate(const SelfSignedCertificate&) = delete;
+    SelfSignedCertificate& operator=(const SelfSignedCertificate&) = delete;
+    SelfSignedCertificate(const SelfSignedCertificate&&) = delete;
+    SelfSignedCertificate&& operator=(const SelfSignedCertificate&&) = delete;
+
+    static void addExtension(X509* certificate, int nid, const char* value)
+    {
+        X509V3_CTX context;
+        X509V3_set_ctx(&context, certificate, certificate, nullptr, nullptr, 0);
+        X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &context, nid, value);
+        if (extension == nullptr)
+            throw std::runtime_error("Could not add an extension to the self-signed certificate");
+        X509_add_ext(certificate, extension, -1);
+        X509_EXTENSION_free(extension);
+    }
+
+    template<typename F>
+    static std::string writePem(const std::string& prefix, F write)
+    {
+        std::string path = "/tmp/" + prefix + "_XXXXXX";
+        const int descriptor = mkstemp(&path[0]);
+        FILE* file = (descriptor >= 0) ? fdopen(descriptor, "w") : nullptr;
+        if (file == nullptr || write(file) == 0)
+            throw std::runtime_error("Could not write " + path);
+        std::fclose(file);
+        return path;
+    }
+
+    std::string m_certificatePath;
+    std::string m_privateKeyPath;
+};
+
+} // namespace SentryBench
+
+#endif // SENTRY_SELFSIGNEDCERTIFICATE_H
@@ -0,0 +1,168 @@
+#include "bench.h"
+#include "mocksentryserver.h"
+
+#include "httptransport.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+#include <vector>
+
+
+/*
+ * usage: sentry_soak [events_per_profile] [profile_filter]
+ * Sends unique events through the Transport to the mock ingest under every fault profile.
+ * One JSON line per profile; the exit code is non zero if any event was lost or the resident memory grew by more
+ * than RSS_GROWTH_LIMIT_KB (plus what the mock server keeps per event) from after the warm-up to the end.
+ */
+
+namespace SentryBench
+{
+
+namespace
+{
+
+const std::chrono::seconds DRAIN_TIMEOUT(120);
+constexpr size_t WARMUP_EVENTS = 1000;
+constexpr size_t RSS_GROWTH_LIMIT_KB = 16 * 1024;
+constexpr size_t MOCK_SERVER_BYTES_PER_EVENT = 256;    // the id and the latency it keeps of every event
+
+size_t residentSetKilobytes()
+{
+    // what the allocator keeps free is not held by the SDK
+    malloc_trim(0);
+
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> totalPages >> residentPages;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+int64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<FaultProfile> faultProfiles()
+{
+    // 429s pause the transport for Retry-After seconds, keep them rare
+    FaultProfile none;
+
+    FaultProfile latency;
+    latency.name = "latency";
+    latency.latency = std::chrono::milliseconds(10);
+
+    FaultProfile tooManyRequests;
+    tooManyRequests.name = "429";
+    tooManyRequests.tooManyRequestsRate = 0.005;
+
+    FaultProfile serverErrors;
+    serverErrors.name = "5xx";
+    serverErrors.serverErrorRate = 0.1;
+
+    FaultProfile connectionResets;
+    connectionResets.name = "resets";
+    connectionResets.connectionResetRate = 0.05;
+
+    FaultProfile mixed;
+    mixed.name = "mixed";
+    mixed.latency = std::chrono::milliseconds(2);
+    mixed.tooManyRequestsRate = 0.002;
+    mixed.serverErrorRate = 0.05;
+    mixed.connectionResetRate = 0.02;
+
+    return {none, latency, tooManyRequests, serverErrors, connectionResets, mixed};
+}
+
+// returns true if every event reached the server and the memory did not grow over the limit
+bool soak(const FaultProfile& profile, size_t numberOfEvents)
+{
+    MockSentryServer server(profile);
+
+    Sentry::SentryDSN dsn;
+    Sentry::SentryDSN::parseDSN(server.dsn(), &dsn);
+
+    const size_t rssStart = residentSetKilobytes();
+    size_t rssBaseline = rssStart;
+    const size_t warmupEvents = std::min(numberOfEvents / 10, WARMUP_EVENTS);
+    const auto start = std::chrono::steady_clock::now();
+    bool allReceived = false;
+    {
+        Sentry::HttpTransport transport;
+        transport.setup(dsn, Sentry::SentryOptions());
+        transport.start();
+
+        json event =
+        {
+            {"level", "error"},
+            {"logger", "soak"},
+            {"message", "Soak event"},
+        };
+        for (size_t i=0; i<numberOfEvents; i++)
+        {
+            char eventId[33];
+            std::snprintf(eventId, sizeof(eventId), "%032zx", i);
+            event["event_id"] = eventId;
+            event["extra"]["soak_sent_ns"] = steadyNowNs();
+            transport.sendEvent(event.dump());
+
+            if (i + 1 == warmupEvents && server.waitForUniqueEvents(warmupEvents, DRAIN_TIMEOUT))
+            {
+                // the connections, buffers and caches are there by now
+                rssBaseline = residentSetKilobytes();
+            }
+        }
+
+        allReceived = server.waitForUniqueEvents(numberOfEvents, DRAIN_TIMEOUT);
+        transport.stop();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const size_t rssEnd = residentSetKilobytes();
+    const size_t rssGrowth = (rssEnd > rssBaseline) ? rssEnd - rssBaseline : 0;
+    const size_t rssGrowthLimit = RSS_GROWTH_LIMIT_KB + numberOfEvents * MOCK_SERVER_BYTES_PER_EVENT / 1024;
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    const size_t received = server.uniqueEventsReceived();
+    reportResult({{"soak", profile.name},
+                  {"events", numberOfEvents},
+                  {"events_received", received},
+                  {"events_lost", numberOfEvents - received},
+                  {"duplicates", server.eventsReceived() - received},
+                  {"requests", server.requestsReceived()},
+                  {"events_per_second", static_cast<double>(received) / seconds},
+                  {"latency_p50_ns", server.latencyPercentileNs(0.5)},
+                  {"latency_p99_ns", server.latencyPercentileNs(0.99)},
+                  {"latency_max_ns", server.latencyPercentileNs(1.0)},
+                  {"rss_start_kb", rssStart},
+                  {"rss_baseline_kb", rssBaseline},
+                  {"rss_end_kb", rssEnd},
+                  {"rss_growth_kb", rssGrowth},
+                  {"rss_growth_limit_kb", rssGrowthLimit}});
+
+    return allReceived && rssGrowth <= rssGrowthLimit;
+}
+
+} // namespace
+
+} // namespace SentryBench
+
+int main(int argc, char** argv)
+{
+    const size_t numberOfEvents = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    const char* filter = (argc > 2) ? argv[2] : "";
+
+    bool passed = true;
+    for (const auto& profile : SentryBench::faultProfiles())
+    {
+        if (std::strstr(profile.name.c_str(), filter) != nullptr)
+        {
+            passed = SentryBench::soak(profile, numberOfEvents) && passed;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
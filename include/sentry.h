@@ -2,16 +2,49 @@
 #define SENTRY_H
 
 #include "sentry_common.h"
+#include "sentry_log.h"
+#include "sentry_metrics.h"
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "json.h"
 
 using json = ::nlohmann::json;
 
+namespace asio
+{
+class io_context;
+}
+
 
 namespace Sentry
 {
+
+// Modifies the event in place, returns false if the event should be dropped.
+using EventProcessor = std::function<bool(json& event)>;
+
+// How the events leave the process, see SentryOptions::transport.
+enum class TransportType
+{
+    HTTP,           // to the DSN (the default)
+    MEMORY,         // kept in memory, see takeCapturedEvents - for tests and benchmarks
+    FILE,           // one JSON event per line, appended to the file or named pipe at transportPath
+    UNIX_SOCKET     // one JSON event per line, to the stream UNIX domain socket at transportPath
+};
+
+// How the stacks of exceptions, signals and thread snapshots are walked, see SentryOptions::stackUnwinder.
+enum class StackUnwinder
+{
+    BACKTRACE,      // glibc backtrace() (the default) - may take the loader lock and allocate on the first call
+    FRAME_POINTER,  // along the saved frame pointers, code built with -fno-omit-frame-pointer
+    EH_FRAME        // the DWARF unwind tables of the loaded objects, cached at init (x86_64)
+};
+
 class SentryOptions
 {
 public:
@@ -22,6 +55,155 @@ public:
     int maxBreadcrumbs = 100;
     bool debug = false;
     bool attachStackTrace = false;
+    EventProcessor beforeSend = nullptr;
+    bool processEventsOnTransportThread = false;  // run event processors on transport worker instead of the calling thread
+    int statsDumpIntervalSeconds = 0;             // periodically log SDK statistics, 0 - disabled
+    EventLevel logLevel = EventLevel::LEVEL_DEBUG;  // SENTRY_LOG_* below this level are skipped, see setLogLevel
+    EventLevel logEventLevel = EventLevel::LEVEL_ERROR;   // logs at or above this level are sent as events, the rest become breadcrumbs
+    std::string caCerts = "";                     // PEM file with the certificates trusted for https DSNs, empty - system defaults
+    bool verifyCertificate = true;
+    bool prewarmConnection = true;                // connect (and handshake) on the transport thread before the first event
+    TransportType transport = TransportType::HTTP;  // the DSN is required only by HTTP
+    std::string transportPath = "";               // for the FILE and UNIX_SOCKET transports
+    bool outOfProcessCrashHandler = false;        // crashes are captured and sent by a process forked at init, init fails if other threads run
+    StackUnwinder stackUnwinder = StackUnwinder::BACKTRACE;
+    size_t maxStackFrames = 128;                  // the deepest stack captured for exceptions and signals
+    bool captureThrowStack = false;               // exceptions report the stack of the throw, needs the library built with THROW_HOOK_SENTRY
+    int tracesSampleRate = 0;                     // percent of the transactions recorded, see startTransaction
+    int profilesSampleRate = 0;                   // percent of the recorded transactions profiled (sampling the CPU with SIGPROF)
+    int profilingFrequencyHz = 100;               // samples per second of CPU time, at most 250
+    bool autoSessionTracking = false;             // start the session of the application at init, see startSession
+    bool enableMetrics = false;                   // send the metrics of sentry_metrics.h (aggregated, every 10 s)
+    size_t maxEventBytes = 1024 * 1024;           // serialized, the event is cut down to fit (breadcrumbs, source lines, frames, strings)
+    size_t maxStringLength = 8192;                // longer strings in events are cut, with "..."
+    size_t maxContextLines = 4;                   // source lines kept before and after the line of a frame
+    size_t maxStacktraceFrames = 250;             // longer stack traces lose their middle frames
+    unsigned int coalesceWindowMilliseconds = 0;  // identical events within the window are sent once, with their count,
+                                                  // 0 - no coalescing, repeats over 3 an hour are dropped
+    asio::io_context* ioContext = nullptr;        // the transport runs on this event loop (a strand of it) instead of a
+                                                  // thread of its own, it must outlive the hub
+};
+
+// A timed operation within a transaction, finished (timestamped) by finish() or when destroyed.
+// The operation, description and status are copied, short ones (up to 15 bytes) without allocation.
+// Spans finished after their transaction are dropped, as are the ones over 1000 in a transaction.
+class Span
+{
+public:
+
+    Span();     // not recording, e.g. a transaction sampled out - its children are not recording either
+    ~Span();
+
+    Span(Span&& other) noexcept;
+    Span& operator=(Span&& other) noexcept;
+
+    Span startChild(const char* operation, const char* description=nullptr);
+    void setStatus(const char* status);     // e.g. "ok", "internal_error", "deadline_exceeded"
+    void finish();
+
+    bool isRecording() const;
+
+private:
+
+    friend class Hub;
+
+    Span(uint64_t transactionId, uint64_t spanId, uint64_t parentSpanId, const char* operation, const char* description);
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    uint64_t m_transactionId;   // 0 - not recording
+    uint64_t m_spanId;          // of the transaction itself, the transaction id
+    uint64_t m_parentSpanId;
+    std::string m_operation;
+    std::string m_description;  // empty - none
+    std::string m_status;       // empty - none
+    int64_t m_startNanoseconds; // steady clock
+};
+
+class Hub;
+
+// A request handled by a server, counted into the per minute session aggregates when ended or destroyed:
+// errored if setErrored() was called or an error event was captured on its thread meanwhile, crashed if
+// setCrashed() was called or the process crashed before it ended.
+class RequestSession
+{
+public:
+
+    RequestSession();   // not counted, e.g. before init
+    ~RequestSession();
+
+    RequestSession(RequestSession&& other) noexcept;
+    RequestSession& operator=(RequestSession&& other) noexcept;
+
+    void setErrored();  // e.g. the error was captured on another thread
+    void setCrashed();  // the request failed unrecoverably, e.g. its worker process died
+    void end();
+
+    bool isCounted() const;
+
+private:
+
+    friend class Hub;
+
+    explicit RequestSession(Hub* hub);
+
+    RequestSession(const RequestSession&) = delete;
+    RequestSession& operator=(const RequestSession&) = delete;
+
+    Hub* m_hub;                 // nullptr - not counted
+    uint64_t m_threadErrors;    // error events captured on the thread before the request started
+    bool m_errored;
+    bool m_crashed;
+};
+
+// Internal SDK statistics - totals since the process started.
+class SdkStatistics
+{
+public:
+    static constexpr size_t HTTP_LATENCY_BUCKETS = 24;
+
+    uint64_t queueDepth = 0;            // events waiting in the transport queue
+    uint64_t eventsCaptured = 0;
+    uint64_t eventsSampledOut = 0;
+    uint64_t eventsRateLimited = 0;     // by the client (too many identical events) or by the server (429)
+    uint64_t eventsDropped = 0;         // by event processors
+    uint64_t eventsSent = 0;
+    uint64_t eventsFailed = 0;
+    uint64_t bytesSent = 0;
+
+    // bucket i counts requests that took less than 2^i microseconds (and at least 2^(i-1))
+    std::array<uint64_t, HTTP_LATENCY_BUCKETS> httpLatencyHistogram = {};
+
+    uint64_t symbolizations = 0;
+    uint64_t symbolizationTimeNs = 0;
+    uint64_t serializations = 0;
+    uint64_t serializationTimeNs = 0;
+
+    uint64_t tlsHandshakes = 0;
+    uint64_t tlsSessionsResumed = 0;    // handshakes that resumed an earlier session
+
+    uint64_t stacktraceCacheHits = 0;   // captured exceptions whose stack was symbolized before
+    uint64_t stacktraceCacheMisses = 0;
+    uint64_t stacktraceCacheEntries = 0;
+    uint64_t stacktraceCacheBytes = 0;  // of the cached frames, serialized
+
+    uint64_t transactionsSent = 0;      // handed to the transport
+    uint64_t spansDropped = 0;          // full span buffers, spans finished after their transaction or over the limit
+
+    uint64_t profilesSent = 0;
+    uint64_t profileSamples = 0;        // stacks sampled by the profiler
+    uint64_t profileSamplesDropped = 0; // full sample buffer or the profiler limits
+
+    uint64_t sessionUpdatesSent = 0;    // of the session of the application
+    uint64_t requestSessionsSent = 0;   // counted in the session aggregates sent
+
+    uint64_t metricsSent = 0;           // aggregated metric lines (a key in a 10 s bucket)
+    uint64_t metricValuesDropped = 0;   // over the key limit or a full set
+
+    uint64_t attachmentsSent = 0;       // files sent with events, by the http and line transports
+    uint64_t eventsTruncated = 0;       // cut down to the event limits of SentryOptions
+    uint64_t eventsCoalesced = 0;       // repeats counted into an event held, see SentryOptions::coalesceWindowMilliseconds
 };
 
 EErrorCode init(const SentryOptions& initParameters);
@@ -30,12 +212,44 @@ void log(EventLevel level, const std::string& message);
 
 std::string captureEvent(const json& event);
 
+// an event with the stacks of all the threads, e.g. from a watchdog that detected a deadlock
+std::string captureHangSnapshot(const std::string& message);
+
 std::string lastEventId();
 
 void addBreadcrumb(const json& crumb);
 void setTag(const std::string& key, const std::string& value);
 void setExtra(const std::string& key, const std::string& value);
 
+// a file sent with every event captured afterwards (not with transactions), e.g. a log or a core artifact; only
+// the path is kept - the file is read when an event is sent, streamed from the disk (of a larger file its last
+// 100 MiB). filename is the last component of the path; contentType is left to Sentry when empty.
+void addAttachment(const std::string& path, const std::string& contentType = "");
+void clearAttachments();
+
+// the root span of a new transaction, sent with its child spans when finished; not recording before init
+// or when sampled out (SentryOptions::tracesSampleRate)
+Span startTransaction(const std::string& name, const char* operation);
+
+// the session of the application, for the crash free rate of the release (SentryOptions::release); ends the
+// previous one. Ended by endSession, as crashed by the signal and termination handlers, or at exit.
+void startSession();
+void endSession();
+
+// a request of a server, counted into per minute aggregates sent periodically - not a request to Sentry each
+RequestSession startRequestSession();
+
+void addEventProcessor(EventProcessor processor);
+void addErrorProcessor(EventProcessor processor);
+
+SdkStatistics getStats();
+
+// waits until the queued events are sent (or given up), false on timeout or before init
+bool flush(unsigned int timeoutMilliseconds);
+
+// events captured by the MEMORY transport (serialized, oldest first) since the last call, transactions as envelopes
+std::vector<std::string> takeCapturedEvents();
+
 const char* getErrorDescription(EErrorCode errorCode);
 
 } // namespace Sentry
@@ -22,6 +22,9 @@ namespace Sentry
     EECODE_MAP(NO_DSN, "Sentry diabled. No DSN key provided. DSN key must be passed to init function or SENTRY_DSN environment variable must be set.") \
     EECODE_MAP(WRONG_DSN, "Wrong DNS key provided!") \
     EECODE_MAP(CONNECTION_ERROR, "Failed to establish connection. Event will be stored and retried later.")\
+    EECODE_MAP(TLS_ERROR, "Failed to set up TLS. Check SentryOptions::caCerts.")\
+    EECODE_MAP(WRONG_TRANSPORT_PATH, "Missing or invalid SentryOptions::transportPath, required by the FILE and UNIX_SOCKET transports.")\
+    EECODE_MAP(CRASH_HANDLER_ERROR, "Failed to start the out-of-process crash handler.")\
 
 
 enum class EErrorCode
@@ -43,7 +46,7 @@ enum class EventLevel
     LEVEL_FATAL,
 };
 
-const std::string levelToString(EventLevel level);
+const std::string& levelToString(EventLevel level);
 
 
 } //namespace
@@ -0,0 +1,269 @@
+#ifndef SENTRY_LOG_H
+#define SENTRY_LOG_H
+
+#include "sentry_common.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+/*
+ * Level filtered logging into Sentry:
+ *
+ *     SENTRY_LOG_DEBUG("cache miss for {} after {} ms", key, elapsedMs);
+ *
+ * Levels below SENTRY_LOG_MIN_LEVEL (defined before including this header, or with -D) compile to nothing,
+ * their arguments are not even evaluated. Levels below the runtime level (SentryOptions::logLevel, setLogLevel)
+ * cost one relaxed atomic load; nothing is logged before init.
+ *
+ * Breadcrumb level messages keep the format string and a copy of the arguments, they are formatted only
+ * when the breadcrumb is sent with an event. Numbers and short strings are stored without allocation.
+ * The format of the macros must be a string literal (anything else does not compile), each {} is replaced by
+ * the next argument, {{ and }} are escaped braces.
+ */
+
+#define SENTRY_LOG_LEVEL_DEBUG -1
+#define SENTRY_LOG_LEVEL_INFO 0
+#define SENTRY_LOG_LEVEL_WARNING 1
+#define SENTRY_LOG_LEVEL_ERROR 2
+#define SENTRY_LOG_LEVEL_FATAL 3
+
+#ifndef SENTRY_LOG_MIN_LEVEL
+#define SENTRY_LOG_MIN_LEVEL SENTRY_LOG_LEVEL_DEBUG
+#endif
+
+#define SENTRY_LOG(level, ...) \
+    do { if (::Sentry::isLogLevelEnabled(level)) ::Sentry::detail::logLiteral(level, "" __VA_ARGS__); } while (false)
+
+#if SENTRY_LOG_MIN_LEVEL <= SENTRY_LOG_LEVEL_DEBUG
+#define SENTRY_LOG_DEBUG(...) SENTRY_LOG(::Sentry::EventLevel::LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define SENTRY_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if SENTRY_LOG_MIN_LEVEL <= SENTRY_LOG_LEVEL_INFO
+#define SENTRY_LOG_INFO(...) SENTRY_LOG(::Sentry::EventLevel::LEVEL_INFO, __VA_ARGS__)
+#else
+#define SENTRY_LOG_INFO(...) ((void)0)
+#endif
+
+#if SENTRY_LOG_MIN_LEVEL <= SENTRY_LOG_LEVEL_WARNING
+#define SENTRY_LOG_WARNING(...) SENTRY_LOG(::Sentry::EventLevel::LEVEL_WARNING, __VA_ARGS__)
+#else
+#define SENTRY_LOG_WARNING(...) ((void)0)
+#endif
+
+#if SENTRY_LOG_MIN_LEVEL <= SENTRY_LOG_LEVEL_ERROR
+#define SENTRY_LOG_ERROR(...) SENTRY_LOG(::Sentry::EventLevel::LEVEL_ERROR, __VA_ARGS__)
+#else
+#define SENTRY_LOG_ERROR(...) ((void)0)
+#endif
+
+#define SENTRY_LOG_FATAL(...) SENTRY_LOG(::Sentry::EventLevel::LEVEL_FATAL, __VA_ARGS__)
+
+
+namespace Sentry
+{
+
+constexpr int LOG_LEVEL_DISABLED = static_cast<int>(EventLevel::LEVEL_FATAL) + 1;
+constexpr size_t MAX_LOG_ARGUMENTS = 6;
+
+namespace detail
+{
+// LOG_LEVEL_DISABLED until init
+extern std::atomic<int> runtimeLogLevel;
+}
+
+inline bool isLogLevelEnabled(EventLevel level)
+{
+    // the first condition is a constant for the macros, so disabled levels are removed by the compiler
+    return static_cast<int>(level) >= SENTRY_LOG_MIN_LEVEL
+            && static_cast<int>(level) >= detail::runtimeLogLevel.load(std::memory_order_relaxed);
+}
+
+void setLogLevel(EventLevel level);
+
+// copy of a single log argument, strings are copied (short ones fit the small string buffer)
+class LogArgument
+{
+public:
+
+    LogArgument() = default;
+
+    template<typename T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+    LogArgument(T value)
+    {
+        if (std::is_same<T, bool>::value)
+        {
+            m_type = Type::BOOL;
+            m_value.unsignedValue = value ? 1 : 0;
+        }
+        else if (std::is_same<T, char>::value)
+        {
+            m_type = Type::CHAR;
+            m_value.unsignedValue = static_cast<unsigned char>(value);
+        }
+        else if (std::is_floating_point<T>::value)
+        {
+            m_type = Type::FLOATING;
+            m_value.floatingValue = static_cast<double>(value);
+        }
+        else if (std::is_signed<T>::value)
+        {
+            m_type = Type::SIGNED;
+            m_value.signedValue = static_cast<int64_t>(value);
+        }
+        else
+        {
+            m_type = Type::UNSIGNED;
+            m_value.unsignedValue = static_cast<uint64_t>(value);
+        }
+    }
+
+    LogArgument(const char* text)
+    :
+    m_type(Type::TEXT),
+    m_text(text != nullptr ? text : "(null)")
+    {
+    }
+
+    LogArgument(std::string_view text)
+    :
+    m_type(Type::TEXT),
+    m_text(text)
+    {
+    }
+
+    LogArgument(const std::string& text)
+    :
+    m_type(Type::TEXT),
+    m_text(text)
+    {
+    }
+
+    LogArgument(std::string&& text)
+    :
+    m_type(Type::TEXT),
+    m_text(std::move(text))
+    {
+    }
+
+    LogArgument(const void* pointer)
+    :
+    m_type(Type::POINTER)
+    {
+        m_value.unsignedValue = reinterpret_cast<uintptr_t>(pointer);
+    }
+
+    void appendTo(std::string& output) const;
+
+private:
+
+    enum class Type : uint8_t
+    {
+        NONE,
+        BOOL,
+        CHAR,
+        SIGNED,
+        UNSIGNED,
+        FLOATING,
+        POINTER,
+        TEXT
+    };
+
+    Type m_type = Type::NONE;
+    union
+    {
+        int64_t signedValue;
+        uint64_t unsignedValue;
+        double floatingValue;
+    } m_value = {};
+    std::string m_text;
+};
+
+// format string with its captured arguments, formatted on demand
+class LogMessage
+{
+public:
+
+    struct CopyFormat {};
+
+    LogMessage() = default;
+
+    // format must be a string literal, it is not copied
+    template<typename... Args>
+    explicit LogMessage(const char* format, Args&&... args)
+    :
+    m_format(format),
+    m_numberOfArguments(sizeof...(Args)),
+    m_arguments{{LogArgument(std::forward<Args>(args))...}}
+    {
+        static_assert(sizeof...(Args) <= MAX_LOG_ARGUMENTS, "Too many log arguments, see MAX_LOG_ARGUMENTS");
+    }
+
+    template<typename... Args>
+    LogMessage(CopyFormat, const char* format, Args&&... args)
+    :
+    LogMessage("", std::forward<Args>(args)...)
+    {
+        m_formatCopy = format != nullptr ? format : "(null)";
+    }
+
+    bool empty() const
+    {
+        return m_format == nullptr;
+    }
+
+    std::string format() const;
+
+private:
+
+    const char* m_format = nullptr;     // string literal, never copied
+    std::string m_formatCopy;           // instead of m_format when not empty
+    uint8_t m_numberOfArguments = 0;
+    std::array<LogArgument, MAX_LOG_ARGUMENTS> m_arguments;
+};
+
+// messages below SentryOptions::logEventLevel are added as breadcrumbs, formatted lazily; the rest are sent as events
+void log(EventLevel level, LogMessage&& message);
+
+/*
+ * Entry point of the log sinks (sentry_logsink.h), for already formatted lines.
+ * Lines below SentryOptions::logEventLevel become breadcrumbs: they are staged in a per-thread buffer without
+ * taking any lock and moved to the scope in batches, consecutive repeats collapsed into one breadcrumb
+ * with data.count. Lines at or above it are sent as events, together with the breadcrumbs staged so far.
+ */
+void logToSentry(EventLevel level, std::string_view message, std::string_view logger = std::string_view());
+
+namespace detail
+{
+// for the SENTRY_LOG_* macros only, they paste "" before the format so that it is a string literal
+template<typename... Args>
+void logLiteral(EventLevel level, const char* literal, Args&&... args)
+{
+    log(level, LogMessage(literal, std::forward<Args>(args)...));
+}
+}
+
+// Sentry::log<EventLevel::LEVEL_DEBUG>("...", args) - the template form of the macros, arguments are always evaluated.
+// It cannot tell a literal from a buffer, so the format is copied into the message.
+template<EventLevel level, typename... Args>
+void log(const char* format, Args&&... args)
+{
+    if constexpr (static_cast<int>(level) >= SENTRY_LOG_MIN_LEVEL)
+    {
+        if (isLogLevelEnabled(level))
+        {
+            log(level, LogMessage(LogMessage::CopyFormat(), format, std::forward<Args>(args)...));
+        }
+    }
+}
+
+} // namespace Sentry
+
+#endif // SENTRY_LOG_H
@@ -0,0 +1,103 @@
+#ifndef SENTRY_LOGSINK_H
+#define SENTRY_LOGSINK_H
+
+#include "sentry_log.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// define SENTRY_NO_SPDLOG to skip the spdlog sink when spdlog is installed but not used
+#if !defined(SENTRY_NO_SPDLOG) && __has_include(<spdlog/sinks/base_sink.h>)
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
+#define SENTRY_HAS_SPDLOG 1
+#endif
+
+
+/*
+ * Adapters mirroring application logging into Sentry, see logToSentry.
+ */
+
+namespace Sentry
+{
+
+// adapter for callback based loggers: logger.addSink(Sentry::LogSink("network").callback());
+class LogSink
+{
+public:
+
+    explicit LogSink(std::string logger = "")
+    :
+    m_logger(std::move(logger))
+    {
+    }
+
+    void operator()(EventLevel level, std::string_view message) const
+    {
+        logToSentry(level, message, m_logger);
+    }
+
+    std::function<void(EventLevel, std::string_view)> callback() const
+    {
+        return *this;
+    }
+
+private:
+
+    std::string m_logger;
+};
+
+#ifdef SENTRY_HAS_SPDLOG
+
+/*
+ * spdlog::default_logger()->sinks().push_back(std::make_shared<Sentry::SpdlogSink<>>());
+ *
+ * The default null_mutex is enough, the sink keeps no state and the staging is per thread.
+ */
+template<typename Mutex = spdlog::details::null_mutex>
+class SpdlogSink : public spdlog::sinks::base_sink<Mutex>
+{
+protected:
+
+    void sink_it_(const spdlog::details::log_msg& msg) override
+    {
+        EventLevel level;
+        switch (msg.level)
+        {
+        case spdlog::level::trace:
+        case spdlog::level::debug:
+            level = EventLevel::LEVEL_DEBUG;
+            break;
+        case spdlog::level::info:
+            level = EventLevel::LEVEL_INFO;
+            break;
+        case spdlog::level::warn:
+            level = EventLevel::LEVEL_WARNING;
+            break;
+        case spdlog::level::err:
+            level = EventLevel::LEVEL_ERROR;
+            break;
+        case spdlog::level::critical:
+            level = EventLevel::LEVEL_FATAL;
+            break;
+        default:
+            return;
+        }
+
+        logToSentry(level,
+                    std::string_view(msg.payload.data(), msg.payload.size()),
+                    std::string_view(msg.logger_name.data(), msg.logger_name.size()));
+    }
+
+    void flush_() override
+    {
+    }
+};
+
+#endif // SENTRY_HAS_SPDLOG
+
+} // namespace Sentry
+
+#endif // SENTRY_LOGSINK_H
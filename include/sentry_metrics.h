@@ -0,0 +1,79 @@
+#ifndef SENTRY_METRICS_H
+#define SENTRY_METRICS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/*
+ * Custom metrics, sent through the DSN when SentryOptions::enableMetrics is set:
+ *
+ *     Sentry::metrics::increment("cache.miss");
+ *     Sentry::metrics::distribution("db.query.duration", elapsedMs, "millisecond", {{"table", "users"}});
+ *
+ * Values are aggregated in the process into accumulators of the calling thread and sent every 10 seconds from
+ * the transport thread, so recording one never makes a network call or takes a lock. A metric object resolves
+ * its key once and records with a single atomic operation; the functions look the key up in a cache of the
+ * thread first (the first use of a key on a thread registers it, under a lock).
+ */
+
+namespace Sentry
+{
+namespace metrics
+{
+
+using Tags = std::vector<std::pair<std::string, std::string>>;
+
+// Sums the values.
+class Counter
+{
+public:
+    explicit Counter(const std::string& key, const char* unit="none", const Tags& tags={});
+    void increment(double value=1.0) const;
+private:
+    uint32_t m_id;
+};
+
+// Keeps the last, minimum, maximum, sum and count of the values.
+class Gauge
+{
+public:
+    explicit Gauge(const std::string& key, const char* unit="none", const Tags& tags={});
+    void set(double value) const;
+private:
+    uint32_t m_id;
+};
+
+// Keeps the distribution of the values (percentiles), in a sketch of about 3% relative error.
+class Distribution
+{
+public:
+    explicit Distribution(const std::string& key, const char* unit="none", const Tags& tags={});
+    void record(double value) const;
+private:
+    uint32_t m_id;
+};
+
+// Counts the unique values, e.g. users.
+class Set
+{
+public:
+    explicit Set(const std::string& key, const char* unit="none", const Tags& tags={});
+    void add(uint32_t value) const;
+    void add(const std::string& value) const;     // hashed
+private:
+    uint32_t m_id;
+};
+
+void increment(const std::string& key, double value=1.0, const char* unit="none", const Tags& tags={});
+void gauge(const std::string& key, double value, const char* unit="none", const Tags& tags={});
+void distribution(const std::string& key, double value, const char* unit="none", const Tags& tags={});
+void set(const std::string& key, uint32_t value, const char* unit="none", const Tags& tags={});
+void set(const std::string& key, const std::string& value, const char* unit="none", const Tags& tags={});
+
+} // namespace metrics
+} // namespace Sentry
+
+#endif // SENTRY_METRICS_H
@@ -1,6 +1,10 @@
 #include "backtracehandler.h"
+#include "sdkstats.h"
+#include "stacktracecache.h"
+#include "unwinder.h"
 
 
+#include <algorithm>
 #include <bfd.h>
 #include <cstring>
 #include <cxxabi.h>
@@ -9,15 +13,21 @@
 #include <fstream>
 #include <iostream>
 #include <link.h>
+#include <map>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
 #include <sstream>
+#include <climits>
+#include <unistd.h>
 
 
-backtraceHandler::backtraceHandler(bool withSourceData)
+backtraceHandler::backtraceHandler(bool withSourceData, Sentry::StackUnwinder unwinder, size_t maxFrames, bool useCache)
 :
-m_withSourceData(withSourceData)
+m_withSourceData(withSourceData),
+m_unwinder(unwinder),
+m_maxFrames(maxFrames),
+m_useCache(useCache)
 
 {
 
@@ -26,28 +36,171 @@ m_withSourceData(withSourceData)
 // based on https://oroboro.com/printing-stack-traces-file-line/
 json backtraceHandler::getStacktraceJSON(size_t skip_front, size_t skip_back)
 {
-    void* callstack[128];
-    const int nMaxFrames = sizeof(callstack) / sizeof(callstack[0]);
-    //char buf[1024];
-    int nFrames = backtrace(callstack, nMaxFrames);
-    //char** symbols = backtrace_symbols(callstack, nFrames);
-    size_t additionalLines = 4;
+    // the first frame is this function, as with backtrace()
+    std::vector<void*> callstack(m_maxFrames + skip_front + skip_back);
+    const size_t nFrames = Sentry::Unwinder::unwind(m_unwinder, callstack.data(), callstack.size());
+    return getStacktraceJSON(callstack.data(), nFrames, skip_front, skip_back);
+}
 
-    json outBacktrace = createBacktraceSymbols(callstack, nFrames, skip_front, skip_back);
+json backtraceHandler::getStacktraceJSON(void* const* callstack, size_t nFrames, size_t skip_front, size_t skip_back)
+{
+    // the frames are built from the addresses left after the skipped ones, which are the key of the cache
+    void* const* symbolized = callstack + std::min(skip_front, nFrames);
+    const size_t nSymbolized = nFrames > skip_front + skip_back ? nFrames - skip_front - skip_back : 0;
 
-    if (m_withSourceData)
+    if (m_useCache)
     {
-        for (auto& frame : outBacktrace)
+        // the only copy of the shared frames, into the event, made outside the lock of the cache
+        const std::shared_ptr<const json> cached =
+            Sentry::StacktraceCache::instance().find(symbolized, nSymbolized, m_withSourceData);
+        if (cached != nullptr)
         {
-            json contextLinesInfo = getContextLines(frame["abs_path"], frame["lineno"], additionalLines);
+            return *cached;
+        }
+    }
+
+    json outBacktrace;
+    {
+        Sentry::ScopedStatTimer timer(Sentry::StatCounter::SYMBOLIZATIONS, Sentry::StatCounter::SYMBOLIZATION_TIME_NS);
+        outBacktrace = createBacktraceSymbols(callstack, static_cast<int>(nFrames), skip_front, skip_back);
 
-            for (auto& line : contextLinesInfo.items())
+        if (m_withSourceData)
+        {
+            addContextLines(outBacktrace);
+        }
+    }
+
+    if (m_useCache)
+    {
+        Sentry::StacktraceCache::instance().insert(symbolized, nSymbolized, m_withSourceData,
+                                                   std::make_shared<const json>(outBacktrace));
+    }
+    return outBacktrace;
+}
+
+json backtraceHandler::getStacktraceJSON(const std::vector<ObjectFrame>& frames)
+{
+    Sentry::ScopedStatTimer timer(Sentry::StatCounter::SYMBOLIZATIONS, Sentry::StatCounter::SYMBOLIZATION_TIME_NS);
+    bfd_init();
+
+    // reading the symbol table is the expensive part, translate all the addresses of a file at once,
+    // each of them once (the threads of a pool share most of their frames)
+    std::map<std::string, std::map<uint64_t, std::string>> locationsOfFile;
+    for (const auto& frame : frames)
+    {
+        if (!frame.file.empty())
+        {
+            locationsOfFile[frame.file][frame.address];
+        }
+    }
+
+    for (auto& fileLocations : locationsOfFile)
+    {
+        std::vector<bfd_vma> addresses;
+        for (const auto& location : fileLocations.second)
+        {
+            addresses.push_back(location.first);
+        }
+
+        char** translated = processFile(fileLocations.first.c_str(), addresses.data(), static_cast<uint32_t>(addresses.size()));
+        if (translated != nullptr)
+        {
+            size_t i = 0;
+            for (auto& location : fileLocations.second)
             {
-                frame[line.key()]= line.value();
+                location.second = translated[i++];
             }
-         }
-     }
-    return outBacktrace;
+            free(translated);
+        }
+    }
+
+    static const std::string unknown;
+    json output = json::array();
+    for (const auto& frame : frames)
+    {
+        const std::string& location = frame.file.empty() ? unknown : locationsOfFile[frame.file][frame.address];
+        output.push_back(createObjectFrame(location, frame));
+    }
+
+    if (m_withSourceData)
+    {
+        addContextLines(output);
+    }
+    return output;
+}
+
+backtraceHandler::ObjectFrame backtraceHandler::locateFrame(void* address, bool returnAddress)
+{
+    ObjectFrame frame;
+    frame.instructionAddress = reinterpret_cast<uint64_t>(address);
+
+    // a return address may be the first one after the function that made the call
+    void* lookup = returnAddress ? static_cast<char*>(address) - 1 : address;
+    FileMatch match(lookup);
+    if (dl_iterate_phdr(findMatchingFile, &match) == 0)
+    {
+        return frame;   // not in a loaded object
+    }
+
+    if (match.mFile != nullptr && strlen(match.mFile) > 0)
+    {
+        frame.file = match.mFile;
+    }
+    else
+    {
+        // the executable has no name in the list
+        static const std::string executable = []()
+        {
+            char path[PATH_MAX];
+            const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+            return (length > 0) ? std::string(path, static_cast<size_t>(length)) : std::string("/proc/self/exe");
+        }();
+        frame.file = executable;
+    }
+    frame.address = reinterpret_cast<uint64_t>(lookup) - reinterpret_cast<uint64_t>(match.mBase);
+    return frame;
+}
+
+json backtraceHandler::createObjectFrame(const std::string& location, const ObjectFrame& frame)
+{
+    std::stringstream instructionAddress;
+    instructionAddress << "0x" << std::hex << frame.instructionAddress;
+
+    // an address without a symbol is translated to '[0x...] ?? ??:0'
+    if (location.empty() || location[0] == '[')
+    {
+        return {{"function", "??"},
+                {"in_app", false},
+                {"package", frame.file},
+                {"instruction_addr", instructionAddress.str()}};
+    }
+
+    std::string line = location;
+    FrameInfo frameInfo(&line[0]);
+    return {{"function", frameInfo.functionName},
+            {"lineno", frameInfo.lineNumber},
+            {"filename", frameInfo.fileName},
+            {"abs_path", frameInfo.absFilePath},
+            {"in_app", frameInfo.functionName[0]!='_'},
+            {"package", frame.file},
+            {"instruction_addr", instructionAddress.str()}};
+}
+
+void backtraceHandler::addContextLines(json& frames)
+{
+    size_t additionalLines = 4;
+    for (auto& frame : frames)
+    {
+        if (frame.find("abs_path") == frame.end())
+            continue;
+
+        json contextLinesInfo = getContextLines(frame["abs_path"], frame["lineno"], additionalLines);
+
+        for (auto& line : contextLinesInfo.items())
+        {
+            frame[line.key()]= line.value();
+        }
+    }
 }
 
 json backtraceHandler::getContextLines(const std::string& filePath, size_t lineNo, size_t deltaLines)
@@ -96,14 +249,20 @@ json backtraceHandler::getContextLines(const std::string& filePath, size_t lineN
 
 json backtraceHandler::createBacktraceSymbols(void* const* addrList, int nFrames, size_t skip_front, size_t skip_back)
 {
+    json output = json::array();
+    if (nFrames <= 0 || static_cast<size_t>(nFrames) <= skip_front + skip_back)
+    {
+        return output;
+    }
     size_t numberOfFramesInOutput = static_cast<size_t>(nFrames) - skip_back - skip_front;
-    json output;
     // initialize the bfd library
     bfd_init();
 
     int total = 0;
-    for (size_t i = numberOfFramesInOutput+skip_front-1; i >= skip_front;  --i )
+    // oldest frame first; counting down to skip_front would never end for skip_front == 0
+    for (size_t frameNo = numberOfFramesInOutput; frameNo > 0;  --frameNo )
     {
+        const size_t i = skip_front + frameNo - 1;
         char** location = reinterpret_cast<char **>(alloca(sizeof(char**)));
 
        // find which executable, or library the symbol is from
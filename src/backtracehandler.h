@@ -2,10 +2,13 @@
 #define SENTRY_BACKTRACEHANDLER_H
 
 #include "json.h"
+#include "sentry.h"
 
 #include <bfd.h>
 #include <link.h>
 #include <stdlib.h>
+#include <string>
+#include <vector>
 
 
 using json = nlohmann::json;
@@ -13,10 +16,30 @@ using json = nlohmann::json;
 class backtraceHandler
 {
 public:
-    backtraceHandler(bool withSourceData);
+    // a frame resolved to its object file, of another process (see RemoteProcess) or of this one (locateFrame)
+    class ObjectFrame
+    {
+    public:
+        std::string file;               // empty - unknown, reported by the instruction address only
+        uint64_t address = 0;           // relative to the load base of the file
+        uint64_t instructionAddress = 0;
+    };
+
+    // useCache - repeated stacks are symbolized once (stacktracecache.h), not from signal handlers
+    backtraceHandler(bool withSourceData, Sentry::StackUnwinder unwinder = Sentry::StackUnwinder::BACKTRACE,
+                     size_t maxFrames = 128, bool useCache = false);
     json getStacktraceJSON(size_t skip_front=0, size_t skip_back=0);
+    // of return addresses captured earlier, newest first
+    json getStacktraceJSON(void* const* callstack, size_t nFrames, size_t skip_front, size_t skip_back);
+    // frames oldest first, every file is read once
+    json getStacktraceJSON(const std::vector<ObjectFrame>& frames);
+
+    // for an address of this process, a return address is looked up at the call before it
+    static ObjectFrame locateFrame(void* address, bool returnAddress);
 
 private:
+    void addContextLines(json& frames);
+    static json createObjectFrame(const std::string& location, const ObjectFrame& frame);
     static int findMatchingFile(struct dl_phdr_info* info, size_t size, void* data);
     json createBacktraceSymbols(void* const* addrList, int nFrames, size_t skip_front=0, size_t skip_back=0);
     json getContextLines(const std::string& filePath, size_t lineNo, size_t deltaLines);
@@ -26,6 +49,9 @@ private:
     static void FindAddressInSection( bfd* abfd, asection* section, void* data );
 
     bool m_withSourceData;
+    Sentry::StackUnwinder m_unwinder;
+    size_t m_maxFrames;
+    bool m_useCache;
 
 struct FrameInfo
 {
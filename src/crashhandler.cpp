@@ -0,0 +1,454 @@
+#include "sentry_common.h"
+#include "crashhandler.h"
+
+#include "backtracehandler.h"
+#include "remoteprocess.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <new>
+#include <poll.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace Sentry
+{
+
+CrashHandler::CrashHandler()
+:
+m_handlerPid(-1),
+m_socket(-1),
+m_sharedState(nullptr),
+m_crashReported(false)
+{
+
+}
+
+CrashHandler::~CrashHandler()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);    // the handler process sees the end of the stream and exits
+    }
+
+    if (m_handlerPid > 0)
+    {
+        for (unsigned int waited = 0; waitpid(m_handlerPid, nullptr, WNOHANG) == 0; waited += 10)
+        {
+            if (waited >= CRASH_HANDLER_EXIT_TIMEOUT_MILLISECONDS)
+            {
+                kill(m_handlerPid, SIGKILL);
+                waitpid(m_handlerPid, nullptr, 0);
+                break;
+            }
+            usleep(10000);
+        }
+    }
+
+    if (m_sharedState != nullptr)
+    {
+        munmap(m_sharedState, sizeof(SharedState));
+    }
+}
+
+EErrorCode CrashHandler::start(bool withSourceData, ReportFunction report)
+{
+    if (isRunning())
+    {
+        return EErrorCode::NO_ERROR;
+    }
+
+    // the child gets only the forking thread, locks held by the others (malloc, stdio, OpenSSL) would stay locked
+    if (numberOfThreads() != 1)
+    {
+#ifdef DEBUG_SENTRYCPP
+        LOG_SENTRY_DEBUG("Crash handler process not started, init must be called before any thread is created");
+#endif
+        return EErrorCode::CRASH_HANDLER_ERROR;
+    }
+
+    void* sharedMemory = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sharedMemory == MAP_FAILED)
+    {
+        return EErrorCode::CRASH_HANDLER_ERROR;
+    }
+    m_sharedState = new (sharedMemory) SharedState;     // the mapping is zeroed
+
+    // a datagram keeps the record in one piece, MSG_NOSIGNAL (not possible for pipes) avoids SIGPIPE if the handler is gone
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+    {
+        return EErrorCode::CRASH_HANDLER_ERROR;
+    }
+
+    const pid_t applicationPid = getpid();
+    const pid_t handlerPid = fork();
+    if (handlerPid < 0)
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        return EErrorCode::CRASH_HANDLER_ERROR;
+    }
+    if (handlerPid == 0)
+    {
+        close(sockets[0]);
+        runHandler(applicationPid, sockets[1], m_sharedState, withSourceData, report);
+    }
+
+    close(sockets[1]);
+    m_socket = sockets[0];
+    m_handlerPid = handlerPid;
+
+    // with Yama (ptrace_scope 1) only ancestors may trace a process, unless it names the tracer
+    prctl(PR_SET_PTRACER, handlerPid, 0, 0, 0);
+
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG("Crash handler process started: " + std::to_string(handlerPid));
+#endif
+    return EErrorCode::NO_ERROR;
+}
+
+bool CrashHandler::isRunning() const
+{
+    return m_handlerPid > 0;
+}
+
+void CrashHandler::publishScope(const std::string& scope)
+{
+    if (m_sharedState == nullptr || scope.size() > CRASH_HANDLER_SCOPE_BYTES)
+    {
+        return;     // too large ones keep the previous scope
+    }
+
+    // a sequence lock, the handler never waits for the writer - it may be stopped in the middle
+    const uint32_t sequence = m_sharedState->scopeSequence.load(std::memory_order_relaxed);
+    m_sharedState->scopeSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_sharedState->scope, scope.data(), scope.size());
+    m_sharedState->scopeSize = static_cast<uint32_t>(scope.size());
+    m_sharedState->scopeSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void CrashHandler::publishSession(const SessionState& session)
+{
+    if (m_sharedState == nullptr)
+    {
+        return;
+    }
+
+    const uint32_t sequence = m_sharedState->sessionSequence.load(std::memory_order_relaxed);
+    m_sharedState->sessionSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&m_sharedState->session, &session, sizeof(session));
+    m_sharedState->sessionSequence.store(sequence + 2, std::memory_order_release);
+}
+
+SessionAggregator* CrashHandler::requestSessions()
+{
+    return (m_sharedState != nullptr) ? &m_sharedState->requestSessions : nullptr;
+}
+
+void CrashHandler::reportCrash(int signal, const siginfo_t* info, const void* context)
+{
+    if (m_socket < 0)
+    {
+        return;
+    }
+    if (m_crashReported.exchange(true))
+    {
+        // another thread crashed at the same time, it ends the process once its report is captured
+        poll(nullptr, 0, CRASH_HANDLER_ACK_TIMEOUT_MILLISECONDS);
+        return;
+    }
+
+    CrashRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.magic = CRASH_RECORD_MAGIC;
+    record.signal = signal;
+    record.threadId = static_cast<int32_t>(syscall(SYS_gettid));
+    if (info != nullptr)
+    {
+        record.code = info->si_code;
+        record.faultAddress = reinterpret_cast<uint64_t>(info->si_addr);
+    }
+
+    // the registers of the crashed thread are in the signal frame, ptrace would see the ones of this handler
+    const ucontext_t* signalContext = static_cast<const ucontext_t*>(context);
+    if (signalContext != nullptr)
+    {
+#if defined(__x86_64__)
+        record.instructionPointer = static_cast<uint64_t>(signalContext->uc_mcontext.gregs[REG_RIP]);
+        record.stackPointer = static_cast<uint64_t>(signalContext->uc_mcontext.gregs[REG_RSP]);
+        record.framePointer = static_cast<uint64_t>(signalContext->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+        record.instructionPointer = signalContext->uc_mcontext.pc;
+        record.stackPointer = signalContext->uc_mcontext.sp;
+        record.framePointer = signalContext->uc_mcontext.regs[29];
+#endif
+    }
+
+    if (send(m_socket, &record, sizeof(record), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(record)))
+    {
+        return;
+    }
+
+    // the process must stay alive until the handler read its memory
+    struct pollfd acknowledgement = {m_socket, POLLIN, 0};
+    if (poll(&acknowledgement, 1, CRASH_HANDLER_ACK_TIMEOUT_MILLISECONDS) > 0)
+    {
+        char ignored;
+        recv(m_socket, &ignored, sizeof(ignored), 0);
+    }
+}
+
+void CrashHandler::skipReport()
+{
+    m_crashReported = true;
+}
+
+void CrashHandler::runHandler(pid_t applicationPid, int socket, SharedState* sharedState,
+                              bool withSourceData, const ReportFunction& report)
+{
+    // signals for the whole process group (Ctrl-C) or the application (e.g. SIGTERM from a service manager,
+    // which the application reports itself) must not end the handler before it uploaded the crash
+    setpgid(0, 0);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    prctl(PR_SET_NAME, "sentry-crash", 0, 0, 0);
+    closeInheritedDescriptors(socket);
+
+    CrashRecord record;
+    ssize_t received;
+    do
+    {
+        received = recv(socket, &record, sizeof(record), 0);
+    }
+    while (received < 0 && errno == EINTR);
+
+    if (received != static_cast<ssize_t>(sizeof(record)) || record.magic != CRASH_RECORD_MAGIC)
+    {
+        _exit(0);   // the application exited normally
+    }
+
+    json event = captureCrash(applicationPid, record, withSourceData, socket);
+    close(socket);
+
+    const json scope = readScope(sharedState);
+    for (auto& item : scope.items())
+    {
+        if (event.find(item.key()) == event.end())
+        {
+            event[item.key()] = item.value();
+        }
+    }
+
+    if (report)
+    {
+        const bool crashed = (record.signal != SIGINT && record.signal != SIGTERM);
+        report(event, crashed, readSession(sharedState), sharedState->requestSessions);
+    }
+
+    // the destructors of the application's static objects must not run here
+    _exit(0);
+}
+
+json CrashHandler::captureCrash(pid_t applicationPid, const CrashRecord& record, bool withSourceData, int socket)
+{
+    class CapturedThread
+    {
+    public:
+        pid_t id;
+        std::string name;
+        std::vector<backtraceHandler::ObjectFrame> frames;  // oldest first
+    };
+    std::vector<CapturedThread> capturedThreads;
+
+    {
+        RemoteProcess process(applicationPid);
+        process.attach();   // without it (ptrace not permitted) the threads are listed without stacks
+
+        for (auto& thread : process.threads())
+        {
+            if (thread.id == record.threadId && record.instructionPointer != 0)
+            {
+                thread.registers.instructionPointer = record.instructionPointer;
+                thread.registers.stackPointer = record.stackPointer;
+                thread.registers.framePointer = record.framePointer;
+            }
+            process.unwind(thread);
+
+            CapturedThread captured;
+            captured.id = thread.id;
+            captured.name = thread.name;
+            for (size_t i = thread.frames.size(); i > 0; --i)
+            {
+                backtraceHandler::ObjectFrame frame;
+                frame.instructionAddress = thread.frames[i - 1];
+
+                // a return address is after the call, which may be the last instruction of a function
+                const uint64_t address = (i > 1) ? frame.instructionAddress - 1 : frame.instructionAddress;
+                RemoteProcess::ObjectAddress objectAddress;
+                if (process.resolve(address, &objectAddress))
+                {
+                    frame.file = objectAddress.file;
+                    frame.address = objectAddress.address;
+                }
+                captured.frames.push_back(std::move(frame));
+            }
+            capturedThreads.push_back(std::move(captured));
+        }
+    }   // detached
+
+    // let the application die, only the object files are read from now on
+    const char acknowledgement = 1;
+    send(socket, &acknowledgement, sizeof(acknowledgement), MSG_NOSIGNAL);
+
+    backtraceHandler symbolizer(withSourceData);
+    json threads = json::array();
+    json crashedFrames = json::array();
+    for (const auto& captured : capturedThreads)
+    {
+        const bool crashed = (captured.id == record.threadId);
+        json frames = symbolizer.getStacktraceJSON(captured.frames);
+
+        json thread = {{"id", captured.id}, {"name", captured.name}, {"crashed", crashed}, {"current", crashed}};
+        if (crashed)
+        {
+            crashedFrames = std::move(frames);  // in the exception already
+        }
+        else
+        {
+            thread["stacktrace"]["frames"] = std::move(frames);
+        }
+        threads.push_back(std::move(thread));
+    }
+
+    std::stringstream value;
+    value << "Signal " << record.signal;
+    if (record.signal == SIGSEGV || record.signal == SIGBUS || record.signal == SIGILL || record.signal == SIGFPE)
+    {
+        value << " at address 0x" << std::hex << record.faultAddress;
+    }
+
+    const char* signalName = strsignal(record.signal);
+    json exception;
+    exception["type"] = (signalName != nullptr) ? signalName : "Signal";
+    exception["value"] = value.str();
+    exception["thread_id"] = record.threadId;
+    exception["mechanism"] = {{"type", "signalhandler"},
+                              {"handled", false},
+                              {"meta", {{"signal", {{"number", record.signal}, {"code", record.code}}}}}};
+    exception["stacktrace"]["frames"] = std::move(crashedFrames);
+
+    json event;
+    event["exception"] = std::move(exception);
+    event["threads"]["values"] = std::move(threads);
+    event["level"] = "fatal";
+    event["logger"] = "crash_handler";
+    return event;
+}
+
+json CrashHandler::readScope(const SharedState* sharedState)
+{
+    const uint32_t sequence = sharedState->scopeSequence.load(std::memory_order_acquire);
+    if (sequence == 0 || (sequence & 1) != 0)
+    {
+        return json::object();  // never published, or the application crashed while writing it
+    }
+
+    std::string scope(sharedState->scope, std::min<size_t>(sharedState->scopeSize, CRASH_HANDLER_SCOPE_BYTES));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sharedState->scopeSequence.load(std::memory_order_relaxed) != sequence)
+    {
+        return json::object();
+    }
+
+    try
+    {
+        json parsed = json::parse(scope);
+        return parsed.is_object() ? parsed : json::object();
+    }
+    catch (const json::exception&)
+    {
+        return json::object();
+    }
+}
+
+size_t CrashHandler::numberOfThreads()
+{
+    size_t threads = 0;
+    if (DIR* directory = opendir("/proc/self/task"))
+    {
+        while (struct dirent* entry = readdir(directory))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                threads++;
+            }
+        }
+        closedir(directory);
+    }
+    return threads;
+}
+
+SessionState CrashHandler::readSession(const SharedState* sharedState)
+{
+    SessionState session;
+    std::memset(&session, 0, sizeof(session));
+
+    const uint32_t sequence = sharedState->sessionSequence.load(std::memory_order_acquire);
+    if ((sequence & 1) != 0)
+    {
+        return session;
+    }
+
+    SessionState copy;
+    std::memcpy(&copy, &sharedState->session, sizeof(copy));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sharedState->sessionSequence.load(std::memory_order_relaxed) != sequence)
+    {
+        return session;
+    }
+    copy.id[sizeof(copy.id) - 1] = '\0';
+    return copy;
+}
+
+void CrashHandler::closeInheritedDescriptors(int socket)
+{
+    // e.g. listening sockets of the application must not stay open after it died
+    std::vector<int> descriptors;
+    if (DIR* directory = opendir("/proc/self/fd"))
+    {
+        const int directoryDescriptor = dirfd(directory);
+        while (struct dirent* entry = readdir(directory))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            const int descriptor = static_cast<int>(std::strtol(entry->d_name, nullptr, 10));
+            if (descriptor > STDERR_FILENO && descriptor != socket && descriptor != directoryDescriptor)
+            {
+                descriptors.push_back(descriptor);
+            }
+        }
+        closedir(directory);
+    }
+
+    for (int descriptor : descriptors)
+    {
+        close(descriptor);
+    }
+}
+
+} // namespace Sentry
@@ -0,0 +1,126 @@
+#ifndef SENTRY_CRASHHANDLER_H
+#define SENTRY_CRASHHANDLER_H
+
+#include "sentry_common.h"
+
+#include "json.h"
+#include "session.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <signal.h>
+#include <string>
+#include <sys/types.h>
+
+
+/*
+ * Out-of-process crash handling (SentryOptions::outOfProcessCrashHandler).
+ *
+ * A handler process is forked at init and waits on a socket pair. It does not exec, it goes on with a copy of
+ * the application: json, malloc, libbfd and OpenSSL in it are only safe when no other thread could hold their
+ * locks at the fork - start refuses to fork when the process has more than one thread, init must come first.
+ * When the application crashes, its signal handler only sends a CrashRecord (the signal and the registers at
+ * the fault) and waits for the acknowledgement - nothing that could touch the possibly corrupt heap. The
+ * handler stops every thread with ptrace, walks their stacks with process_vm_readv (remoteprocess.h), lets
+ * the application die, then symbolizes and uploads the event with a transport of its own.
+ *
+ * The scope (tags, extras, breadcrumbs) cannot be read safely from the crashed process, the application
+ * publishes it to shared memory from the transport thread instead, so it can be up to a drain interval old.
+ * The session of the application is published whenever it changes, and the request sessions are counted
+ * in shared memory directly, so the handler sends the crashed session and the request sessions in progress.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr uint32_t CRASH_RECORD_MAGIC = 0x53435248;                 // 'SCRH'
+constexpr int CRASH_HANDLER_ACK_TIMEOUT_MILLISECONDS = 5000;         // the crashed process waits at most that long
+constexpr unsigned int CRASH_HANDLER_EXIT_TIMEOUT_MILLISECONDS = 1000;
+constexpr unsigned int CRASH_HANDLER_UPLOAD_TIMEOUT_MILLISECONDS = 30000;
+constexpr size_t CRASH_HANDLER_SCOPE_BYTES = 64 * 1024;             // larger scopes are not published
+}
+
+namespace Sentry
+{
+
+// the only data sent from the signal handler, in a single message
+struct CrashRecord
+{
+    uint32_t magic;
+    int32_t signal;
+    int32_t code;               // si_code
+    int32_t threadId;           // of the crashed thread
+    uint64_t faultAddress;      // si_addr
+    uint64_t instructionPointer;    // at the fault, all 0 if not known
+    uint64_t stackPointer;
+    uint64_t framePointer;
+};
+
+class CrashHandler
+{
+public:
+
+    // delivers the event in the handler process (and waits until it is sent) with the sessions of the application:
+    // ends the session and the request sessions in progress - as crashed, unless it was SIGINT or SIGTERM
+    using ReportFunction = std::function<void(const json& event, bool crashed, const SessionState& session,
+                                              SessionAggregator& requestSessions)>;
+
+    CrashHandler();
+    ~CrashHandler();    // the handler process exits once the application does
+
+    // forks the handler process, CRASH_HANDLER_ERROR when any other thread runs already
+    EErrorCode start(bool withSourceData, ReportFunction report);
+    bool isRunning() const;
+
+    // from the transport thread, the scope JSON object added to the crash event
+    void publishScope(const std::string& scope);
+    // whenever the session of the application changes, by one thread at a time
+    void publishSession(const SessionState& session);
+    // request sessions counted here are visible to the handler process, nullptr before start
+    SessionAggregator* requestSessions();
+
+    // async-signal-safe, returns when the handler captured the threads (or after a timeout),
+    // only the first crash is reported
+    void reportCrash(int signal, const siginfo_t* info, const void* context);
+    // the coming crash was reported already, e.g. the uncaught exception before the abort
+    void skipReport();
+
+private:
+
+    // mapped before the fork, shared with the handler process
+    struct SharedState
+    {
+        std::atomic<uint32_t> scopeSequence;    // odd while the scope is written
+        uint32_t scopeSize;
+        char scope[CRASH_HANDLER_SCOPE_BYTES];
+        std::atomic<uint32_t> sessionSequence;  // odd while the session is written
+        SessionState session;
+        SessionAggregator requestSessions;
+    };
+
+    CrashHandler(const CrashHandler&) = delete;
+    CrashHandler& operator=(const CrashHandler&) = delete;
+    CrashHandler(const CrashHandler&&) = delete;
+    CrashHandler&& operator=(const CrashHandler&&) = delete;
+
+    // the handler process, never returns
+    [[noreturn]] static void runHandler(pid_t applicationPid, int socket, SharedState* sharedState,
+                                        bool withSourceData, const ReportFunction& report);
+    static json captureCrash(pid_t applicationPid, const CrashRecord& record, bool withSourceData, int socket);
+    static json readScope(const SharedState* sharedState);
+    // an inactive session when it is not consistent (the application crashed while writing it)
+    static SessionState readSession(const SharedState* sharedState);
+    static void closeInheritedDescriptors(int socket);
+    static size_t numberOfThreads();
+
+    pid_t m_handlerPid;
+    int m_socket;
+    SharedState* m_sharedState;
+    std::atomic_bool m_crashReported;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_CRASHHANDLER_H
@@ -0,0 +1,190 @@
+#ifndef SENTRY_DSNPARSER_H
+#define SENTRY_DSNPARSER_H
+
+#include <cstdint>
+#include <string_view>
+
+
+/*
+ * Single pass DSN parser, no allocations - the parts are views into the DSN.
+ * constexpr, so DSN literals can be validated at compile time (see the corpus in dsnparser.cpp).
+ *
+ * '{PROTOCOL}://{PUBLIC_KEY}[:{SECRET_KEY}]@{HOST}[:{PORT}][{PATH}]/{PROJECT_ID}[/]'
+ * HOST can be an IPv6 literal in brackets, PATH is an optional prefix (e.g. /sentry) of the API endpoints.
+ */
+
+namespace Sentry
+{
+
+struct DSNParts
+{
+    bool valid = false;
+    std::string_view protocol;
+    std::string_view publicKey;
+    std::string_view secretKey;
+    std::string_view host;          // without the brackets of IPv6 literals
+    std::string_view hostPort;      // as written in the DSN, e.g. [::1]:9000
+    uint16_t port = 0;              // explicit or the protocol default
+    std::string_view path;          // without the trailing slash, empty if none
+    std::string_view projectID;
+};
+
+namespace dsn_parser
+{
+
+constexpr bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool isSchemeChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c) || c == '+' || c == '-' || c == '.';
+}
+
+constexpr bool isHostChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c) || c == '-' || c == '.' || c == '_';
+}
+
+// characters allowed in keys and path segments, anything that does not delimit a DSN part
+constexpr bool isPlainChar(char c)
+{
+    return c > ' ' && c != 0x7f && c != '/' && c != '@' && c != ':' && c != '?' && c != '#'
+            && c != '[' && c != ']';
+}
+
+constexpr bool allOf(std::string_view text, bool (*predicate)(char))
+{
+    for (char c : text)
+    {
+        if (!predicate(c))
+            return false;
+    }
+    return true;
+}
+
+constexpr bool parsePort(std::string_view text, uint16_t& port)
+{
+    if (text.empty() || text.size() > 5)
+        return false;
+
+    uint32_t value = 0;
+    for (char c : text)
+    {
+        if (!isDigit(c))
+            return false;
+        value = value * 10 + static_cast<uint32_t>(c - '0');
+    }
+    if (value == 0 || value > 65535)
+        return false;
+
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+constexpr uint16_t defaultPort(std::string_view protocol)
+{
+    return (protocol == "https") ? 443 : 80;
+}
+
+} // namespace dsn_parser
+
+constexpr DSNParts parseDSNParts(std::string_view dsn)
+{
+    using namespace dsn_parser;
+
+    DSNParts parts;
+
+    // {PROTOCOL}://
+    const size_t schemeEnd = dsn.find("://");
+    if (schemeEnd == std::string_view::npos || schemeEnd == 0)
+        return parts;
+    parts.protocol = dsn.substr(0, schemeEnd);
+    if (!allOf(parts.protocol, isSchemeChar))
+        return parts;
+    std::string_view rest = dsn.substr(schemeEnd + 3);
+
+    // {PUBLIC_KEY}[:{SECRET_KEY}]@ - the keys can not contain '/', so the first '@' before the path ends them
+    const size_t keysEnd = rest.find('@');
+    if (keysEnd == std::string_view::npos || rest.substr(0, keysEnd).find('/') != std::string_view::npos)
+        return parts;
+    std::string_view keys = rest.substr(0, keysEnd);
+    const size_t keysSeparator = keys.find(':');
+    parts.publicKey = keys.substr(0, keysSeparator);
+    if (keysSeparator != std::string_view::npos)
+    {
+        parts.secretKey = keys.substr(keysSeparator + 1);
+        if (parts.secretKey.empty() || !allOf(parts.secretKey, isPlainChar))
+            return parts;
+    }
+    if (parts.publicKey.empty() || !allOf(parts.publicKey, isPlainChar))
+        return parts;
+    rest = rest.substr(keysEnd + 1);
+
+    // {HOST}[:{PORT}]
+    size_t hostPortEnd = 0;
+    if (!rest.empty() && rest[0] == '[')
+    {
+        const size_t hostEnd = rest.find(']');
+        if (hostEnd == std::string_view::npos || hostEnd == 1)
+            return parts;
+        parts.host = rest.substr(1, hostEnd - 1);
+        for (char c : parts.host)
+        {
+            if (!(isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || c == ':' || c == '.'))
+                return parts;
+        }
+        hostPortEnd = hostEnd + 1;
+    }
+    else
+    {
+        while (hostPortEnd < rest.size() && rest[hostPortEnd] != ':' && rest[hostPortEnd] != '/')
+        {
+            hostPortEnd++;
+        }
+        parts.host = rest.substr(0, hostPortEnd);
+        if (parts.host.empty() || !allOf(parts.host, isHostChar))
+            return parts;
+    }
+
+    parts.port = defaultPort(parts.protocol);
+    if (hostPortEnd < rest.size() && rest[hostPortEnd] == ':')
+    {
+        const size_t portEnd = rest.find('/', hostPortEnd);
+        if (!parsePort(rest.substr(hostPortEnd + 1, portEnd - (hostPortEnd + 1)), parts.port))
+            return parts;
+        hostPortEnd = portEnd;
+    }
+    parts.hostPort = rest.substr(0, hostPortEnd);
+    if (hostPortEnd == std::string_view::npos || hostPortEnd == rest.size() || rest[hostPortEnd] != '/')
+        return parts;
+    rest = rest.substr(hostPortEnd);
+
+    // [{PATH}]/{PROJECT_ID}[/]
+    if (rest.size() > 1 && rest.back() == '/')
+    {
+        rest.remove_suffix(1);
+    }
+    const size_t projectStart = rest.rfind('/') + 1;
+    parts.projectID = rest.substr(projectStart);
+    parts.path = rest.substr(0, projectStart - 1);
+    if (parts.projectID.empty() || !allOf(parts.projectID, isPlainChar))
+        return parts;
+    for (size_t segmentStart = 0; segmentStart < parts.path.size(); )
+    {
+        // '/' followed by a non empty segment
+        const size_t segmentEnd = parts.path.find('/', segmentStart + 1);
+        const std::string_view segment = parts.path.substr(segmentStart + 1, segmentEnd - (segmentStart + 1));
+        if (segment.empty() || !allOf(segment, isPlainChar))
+            return parts;
+        segmentStart = (segmentEnd == std::string_view::npos) ? parts.path.size() : segmentEnd;
+    }
+
+    parts.valid = true;
+    return parts;
+}
+
+} // namespace Sentry
+
+#endif // SENTRY_DSNPARSER_H
@@ -0,0 +1,142 @@
+#include "envelope.h"
+#include "json.h"
+
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace Sentry
+{
+
+Envelope::Envelope(const std::string& eventId)
+:
+m_contents()
+{
+    time_t now = time(nullptr);
+    char sentAt[sizeof("2011-10-08T07:07:09Z")];
+    strftime(sentAt, sizeof(sentAt), "%FT%TZ", gmtime(&now));
+
+    m_contents.reserve(1024);
+    m_contents.push_back('{');
+    if (!eventId.empty())
+    {
+        m_contents.append("\"event_id\":\"").append(eventId).append("\",");
+    }
+    m_contents.append("\"sent_at\":\"").append(sentAt).append("\"}");
+}
+
+void Envelope::addItem(const char* type, const std::string& payload)
+{
+    m_contents.append("\n{\"type\":\"").append(type).append("\",\"length\":").append(std::to_string(payload.size()));
+    m_contents.append("}\n").append(payload);
+}
+
+const std::string& Envelope::serialized() const
+{
+    return m_contents;
+}
+
+std::string Envelope::take()
+{
+    return std::move(m_contents);
+}
+
+bool Envelope::isEnvelope(const std::string& contents)
+{
+    return contents.find('\n') != std::string::npos;
+}
+
+StreamedEnvelope::StreamedEnvelope(const std::string& eventId, const std::string& event, std::vector<Attachment> attachments)
+:
+m_head(),
+m_attachments(std::move(attachments))
+{
+    Envelope envelope(eventId);
+    envelope.addItem("event", event);
+    m_head = envelope.take();
+}
+
+const std::string& StreamedEnvelope::head() const
+{
+    return m_head;
+}
+
+const std::vector<Attachment>& StreamedEnvelope::attachments() const
+{
+    return m_attachments;
+}
+
+OpenedEnvelope::OpenedEnvelope(const StreamedEnvelope& envelope)
+:
+m_parts(),
+m_size(0)
+{
+    m_parts.reserve(envelope.attachments().size() + 1);
+    m_parts.push_back({envelope.head(), -1, 0, 0});
+    m_size = envelope.head().size();
+
+    for (const Attachment& attachment : envelope.attachments())
+    {
+        const int descriptor = open(attachment.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            continue;
+
+        // read at offsets (pread, sendfile), so only regular files
+        struct stat status;
+        if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+        {
+            close(descriptor);
+            continue;
+        }
+
+        EnvelopePart part;
+        part.descriptor = descriptor;
+        part.length = static_cast<uint64_t>(status.st_size);
+        if (part.length > ATTACHMENT_MAX_BYTES)
+        {
+            part.offset = static_cast<off_t>(part.length - ATTACHMENT_MAX_BYTES);
+            part.length = ATTACHMENT_MAX_BYTES;
+        }
+        posix_fadvise(descriptor, part.offset, static_cast<off_t>(part.length), POSIX_FADV_SEQUENTIAL);
+
+        nlohmann::json header = {{"type", "attachment"}, {"length", part.length}, {"filename", attachment.filename}};
+        if (!attachment.contentType.empty())
+        {
+            header["content_type"] = attachment.contentType;
+        }
+        part.data.append("\n").append(header.dump()).append("\n");
+
+        m_size += part.data.size() + part.length;
+        m_parts.push_back(std::move(part));
+    }
+}
+
+OpenedEnvelope::~OpenedEnvelope()
+{
+    for (const EnvelopePart& part : m_parts)
+    {
+        if (part.descriptor >= 0)
+        {
+            close(part.descriptor);
+        }
+    }
+}
+
+const std::vector<EnvelopePart>& OpenedEnvelope::parts() const
+{
+    return m_parts;
+}
+
+uint64_t OpenedEnvelope::size() const
+{
+    return m_size;
+}
+
+size_t OpenedEnvelope::attachments() const
+{
+    return m_parts.size() - 1;
+}
+
+} // namespace Sentry
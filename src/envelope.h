@@ -0,0 +1,111 @@
+#ifndef SENTRY_ENVELOPE_H
+#define SENTRY_ENVELOPE_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+
+/*
+ * Envelopes carry what the store endpoint does not take (transactions, ...) to the envelope endpoint:
+ * a header line, then for every item a header line with its type and length and the payload.
+ * https://develop.sentry.dev/sdk/envelopes/
+ *
+ * The transports tell envelopes from events by the newline, a serialized event never contains a raw one.
+ *
+ * Events with attachments (Sentry::addAttachment) are StreamedEnvelopes: queued with the paths of the files only,
+ * the files are opened and sized when the envelope is sent and copied by the transport straight from them,
+ * so the memory of an attachment does not depend on the size of its file.
+ */
+
+namespace
+{
+constexpr uint64_t ATTACHMENT_MAX_BYTES = 100 * 1024 * 1024;    // the end of a larger file, e.g. the newest lines of a log
+}
+
+namespace Sentry
+{
+
+class Envelope
+{
+public:
+
+    // eventId is left out of the header when empty
+    explicit Envelope(const std::string& eventId);
+
+    // payload is serialized JSON, or text (statsd) - the item header carries its length
+    void addItem(const char* type, const std::string& payload);
+
+    const std::string& serialized() const;
+    std::string take();
+
+    static bool isEnvelope(const std::string& contents);
+
+private:
+
+    std::string m_contents;
+};
+
+// a file sent as an attachment item of the events, read only when the envelope is sent
+class Attachment
+{
+public:
+    std::string path;
+    std::string filename;       // shown in Sentry
+    std::string contentType;    // empty - left to Sentry
+};
+
+// an event with attachments
+class StreamedEnvelope
+{
+public:
+
+    StreamedEnvelope(const std::string& eventId, const std::string& event, std::vector<Attachment> attachments);
+
+    // the envelope header and the event item, the attachment items follow
+    const std::string& head() const;
+    const std::vector<Attachment>& attachments() const;
+
+private:
+
+    std::string m_head;
+    std::vector<Attachment> m_attachments;
+};
+
+// a part of the serialized envelope: data, then length bytes of the file from offset
+struct EnvelopePart
+{
+    std::string data;
+    int descriptor = -1;
+    off_t offset = 0;
+    uint64_t length = 0;
+};
+
+// the files of a StreamedEnvelope opened for one send, closed with it; a file is sent with the size it had when
+// opened (a log written meanwhile is cut there), files that can not be read are left out
+class OpenedEnvelope
+{
+public:
+
+    explicit OpenedEnvelope(const StreamedEnvelope& envelope);
+    ~OpenedEnvelope();
+
+    const std::vector<EnvelopePart>& parts() const;
+    uint64_t size() const;
+    size_t attachments() const;
+
+private:
+
+    OpenedEnvelope(const OpenedEnvelope&) = delete;
+    OpenedEnvelope& operator=(const OpenedEnvelope&) = delete;
+    OpenedEnvelope(const OpenedEnvelope&&) = delete;
+    OpenedEnvelope&& operator=(const OpenedEnvelope&&) = delete;
+
+    std::vector<EnvelopePart> m_parts;
+    uint64_t m_size;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_ENVELOPE_H
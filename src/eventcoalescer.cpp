@@ -0,0 +1,223 @@
+#include "eventcoalescer.h"
+
+#include <algorithm>
+
+
+namespace
+{
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+class FingerprintHash
+{
+public:
+
+    void add(const std::string& value)
+    {
+        for (char c : value)
+        {
+            m_hash ^= static_cast<unsigned char>(c);
+            m_hash *= FNV_PRIME;
+        }
+        // a separator, "ab" + "c" differs from "a" + "bc"
+        m_hash ^= 0xff;
+        m_hash *= FNV_PRIME;
+    }
+
+    void add(const json& value)
+    {
+        add(value.is_string() ? value.get_ref<const std::string&>() : value.dump());
+    }
+
+    void addMember(const json& object, const char* key)
+    {
+        auto member = object.find(key);
+        add((member != object.end()) ? *member : json());
+    }
+
+    void addFrames(const json& stacktrace)
+    {
+        auto frames = stacktrace.find("frames");
+        if (!stacktrace.is_object() || frames == stacktrace.end() || !frames->is_array())
+            return;
+
+        // the innermost frames are the last ones
+        const size_t count = std::min(frames->size(), EVENT_FINGERPRINT_FRAMES);
+        for (size_t i = frames->size() - count; i < frames->size(); i++)
+        {
+            const json& frame = (*frames)[i];
+            if (!frame.is_object())
+                continue;
+            addMember(frame, "function");
+            addMember(frame, "filename");
+            addMember(frame, "lineno");
+            addMember(frame, "instruction_addr");
+        }
+    }
+
+    void addException(const json& exception)
+    {
+        if (!exception.is_object())
+            return;
+        addMember(exception, "type");
+        auto stacktrace = exception.find("stacktrace");
+        if (stacktrace != exception.end())
+        {
+            addFrames(*stacktrace);
+        }
+    }
+
+    uint64_t value() const
+    {
+        return m_hash;
+    }
+
+private:
+
+    uint64_t m_hash = FNV_OFFSET_BASIS;
+};
+
+} // namespace
+
+namespace Sentry
+{
+
+EventCoalescer::EventCoalescer()
+:
+m_window(0),
+m_mutex(),
+m_held()
+{
+
+}
+
+void EventCoalescer::setWindow(std::chrono::milliseconds window)
+{
+    m_window = window;
+}
+
+std::chrono::milliseconds EventCoalescer::window() const
+{
+    return m_window;
+}
+
+bool EventCoalescer::isEnabled() const
+{
+    return m_window.count() > 0;
+}
+
+uint64_t EventCoalescer::fingerprint(const json& event)
+{
+    FingerprintHash hash;
+
+    // the grouping chosen by the application
+    auto explicitFingerprint = event.find("fingerprint");
+    if (explicitFingerprint != event.end() && explicitFingerprint->is_array())
+    {
+        for (const json& part : *explicitFingerprint)
+        {
+            hash.add(part);
+        }
+        return hash.value();
+    }
+
+    hash.addMember(event, "message");
+    hash.addMember(event, "level");
+    hash.addMember(event, "logger");
+
+    auto exception = event.find("exception");
+    if (exception != event.end())
+    {
+        // {"values":[...]}, or a single exception as the signal handler sends it
+        auto values = exception->find("values");
+        if (exception->is_object() && values != exception->end() && values->is_array())
+        {
+            for (const json& value : *values)
+            {
+                hash.addException(value);
+            }
+        }
+        else
+        {
+            hash.addException(*exception);
+        }
+    }
+
+    auto stacktrace = event.find("stacktrace");
+    if (stacktrace != event.end())
+    {
+        hash.addFrames(*stacktrace);
+    }
+
+    return hash.value();
+}
+
+bool EventCoalescer::addOccurrence(uint64_t fingerprint, const std::string& timestamp, std::string& eventId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto held = m_held.find(fingerprint);
+    if (held == m_held.end())
+        return false;
+
+    held->second.count++;
+    held->second.lastSeen = timestamp;
+    eventId = held->second.eventId;
+    return true;
+}
+
+bool EventCoalescer::hold(uint64_t fingerprint, HeldEvent& event, std::string& eventId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto held = m_held.find(fingerprint);
+    if (held != m_held.end())
+    {
+        held->second.count += event.count;
+        held->second.lastSeen = event.lastSeen;
+        eventId = held->second.eventId;
+        return true;
+    }
+    if (m_held.size() >= EVENT_COALESCER_MAX_HELD)
+        return false;
+
+    eventId = event.eventId;
+    event.windowEnd = std::chrono::steady_clock::now() + m_window;
+    m_held.emplace(fingerprint, std::move(event));
+    return true;
+}
+
+std::vector<EventCoalescer::HeldEvent> EventCoalescer::take(bool includeOpen)
+{
+    std::vector<HeldEvent> ended;
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto held = m_held.begin(); held != m_held.end(); )
+        {
+            if (includeOpen || held->second.windowEnd <= now)
+            {
+                ended.push_back(std::move(held->second));
+                held = m_held.erase(held);
+            }
+            else
+            {
+                ++held;
+            }
+        }
+    }
+
+    for (HeldEvent& event : ended)
+    {
+        if (event.count < 2)
+            continue;
+        json& contexts = event.payload["contexts"];
+        if (contexts.is_null() || contexts.is_object())
+        {
+            contexts["coalesced"] = {{"count", event.count}, {"first_seen", event.firstSeen},
+                                     {"last_seen", event.lastSeen}};
+        }
+    }
+    return ended;
+}
+
+} // namespace Sentry
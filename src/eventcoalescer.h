@@ -0,0 +1,83 @@
+#ifndef SENTRY_EVENTCOALESCER_H
+#define SENTRY_EVENTCOALESCER_H
+
+#include "envelope.h"
+#include "json.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * Coalescing of identical events (SentryOptions::coalesceWindowMilliseconds). Events with the same fingerprint -
+ * the "fingerprint" of the event when it has one, else its message, level, logger, exception types and innermost
+ * frames - are held from the first of them until the window ends and sent once, as the first of them with
+ * contexts.coalesced {"count", "first_seen", "last_seen"} when it repeated. A repeat costs a hash of the event
+ * and a lookup, it is never processed or serialized.
+ *
+ * At most EVENT_COALESCER_MAX_HELD distinct events are held, further ones are not coalesced.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t EVENT_COALESCER_MAX_HELD = 256;
+constexpr size_t EVENT_FINGERPRINT_FRAMES = 5;      // innermost frames of each stack trace
+}
+
+namespace Sentry
+{
+
+class EventCoalescer
+{
+public:
+
+    struct HeldEvent
+    {
+        std::string eventId;
+        json payload;       // the scope applied
+        std::vector<Attachment> attachments;
+        uint64_t count = 1;
+        std::string firstSeen;
+        std::string lastSeen;
+        std::chrono::steady_clock::time_point windowEnd;
+    };
+
+    EventCoalescer();
+
+    // zero - disabled
+    void setWindow(std::chrono::milliseconds window);
+    std::chrono::milliseconds window() const;
+    bool isEnabled() const;
+
+    static uint64_t fingerprint(const json& event);
+
+    // counts a repeat of a held event and sets eventId to its id, false when no event with the fingerprint is held
+    bool addOccurrence(uint64_t fingerprint, const std::string& timestamp, std::string& eventId);
+    // event is moved from when held (or counted, when another thread held the same fingerprint meanwhile),
+    // eventId is set to the id of the held event; false when too many events are held
+    bool hold(uint64_t fingerprint, HeldEvent& event, std::string& eventId);
+
+    // the events whose window ended (all of them with includeOpen), the repeated ones with contexts.coalesced
+    std::vector<HeldEvent> take(bool includeOpen);
+
+private:
+
+    EventCoalescer(const EventCoalescer&) = delete;
+    EventCoalescer& operator=(const EventCoalescer&) = delete;
+    EventCoalescer(const EventCoalescer&&) = delete;
+    EventCoalescer&& operator=(const EventCoalescer&&) = delete;
+
+    std::chrono::milliseconds m_window;
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, HeldEvent> m_held;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_EVENTCOALESCER_H
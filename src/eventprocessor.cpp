@@ -0,0 +1,135 @@
+#include "eventprocessor.h"
+
+#include <algorithm>
+
+
+namespace Sentry
+{
+
+EventProcessorPipeline::EventProcessorPipeline()
+:
+m_processors(nullptr),
+m_readers(0),
+m_writeMutex(),
+m_lists()
+{
+
+}
+
+EventProcessorPipeline::~EventProcessorPipeline()
+{
+    m_processors = nullptr;
+}
+
+bool EventProcessorPipeline::ProcessorList::empty() const
+{
+    return eventProcessors.empty() && errorProcessors.empty() && !beforeSend;
+}
+
+void EventProcessorPipeline::addEventProcessor(EventProcessor processor)
+{
+    if (!processor)
+        return;
+
+    modify([&processor](ProcessorList& list) { list.eventProcessors.push_back(std::move(processor)); });
+}
+
+void EventProcessorPipeline::addErrorProcessor(EventProcessor processor)
+{
+    if (!processor)
+        return;
+
+    modify([&processor](ProcessorList& list) { list.errorProcessors.push_back(std::move(processor)); });
+}
+
+void EventProcessorPipeline::setBeforeSend(EventProcessor processor)
+{
+    modify([&processor](ProcessorList& list) { list.beforeSend = std::move(processor); });
+}
+
+void EventProcessorPipeline::clear()
+{
+    modify([](ProcessorList& list) { list = ProcessorList(); });
+}
+
+template<typename F>
+void EventProcessorPipeline::modify(F modifier)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+
+    const ProcessorList* current = m_processors.load(std::memory_order_relaxed);
+    auto newList = current ? std::make_unique<ProcessorList>(*current) : std::make_unique<ProcessorList>();
+    modifier(*newList);
+
+    // an empty list is published as nullptr, so the fast path stays a single load
+    const ProcessorList* published = newList->empty() ? nullptr : newList.get();
+    m_processors.store(published, std::memory_order_seq_cst);
+    m_lists.push_back(std::move(newList));
+
+    // a reader counted after this load sees the list just published (both sequentially consistent),
+    // so none of the replaced ones can be in use
+    if (m_readers.load(std::memory_order_seq_cst) == 0)
+    {
+        m_lists.erase(std::remove_if(m_lists.begin(), m_lists.end(),
+                                     [published](const std::unique_ptr<ProcessorList>& list)
+                                     { return list.get() != published; }),
+                      m_lists.end());
+    }
+}
+
+bool EventProcessorPipeline::applyCurrent(json& event) const
+{
+    // a processor may throw
+    class Reader
+    {
+    public:
+        explicit Reader(std::atomic<size_t>& readers)
+        :
+        m_readers(readers)
+        {
+            m_readers.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        ~Reader()
+        {
+            m_readers.fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<size_t>& m_readers;
+    };
+    const Reader reader(m_readers);
+
+    const ProcessorList* processors = m_processors.load(std::memory_order_seq_cst);
+    if (processors == nullptr)
+        return true;
+
+    return applyList(*processors, event);
+}
+
+bool EventProcessorPipeline::applyList(const ProcessorList& processors, json& event)
+{
+    for (const auto& processor : processors.eventProcessors)
+    {
+        if (!processor(event))
+            return false;
+    }
+
+    if (!processors.errorProcessors.empty() && event.find("exception") != event.end())
+    {
+        for (const auto& processor : processors.errorProcessors)
+        {
+            if (!processor(event))
+                return false;
+        }
+    }
+
+    if (processors.beforeSend)
+    {
+        return processors.beforeSend(event);
+    }
+
+    return true;
+}
+
+} // namespace Sentry
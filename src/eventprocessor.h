@@ -0,0 +1,87 @@
+#ifndef SENTRY_EVENTPROCESSOR_H
+#define SENTRY_EVENTPROCESSOR_H
+
+#include "sentry.h"
+#include "json.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/*
+ * Event processors are run on every event after the scope was applied to it and before it is serialized.
+ * They can modify the event in place (scrubbing, enrichment, fingerprinting) or drop it by returning false.
+ *
+ * Readers never take a lock - the list of processors is replaced as a whole (copy on write) on registration,
+ * so when no processor is registered applying the pipeline costs a single atomic load. The replaced lists
+ * are freed by a later registration that finds no reader in flight.
+ */
+
+using json = nlohmann::json;
+
+namespace Sentry
+{
+
+class EventProcessorPipeline
+{
+public:
+
+    EventProcessorPipeline();
+    ~EventProcessorPipeline();
+
+    void addEventProcessor(EventProcessor processor);
+    void addErrorProcessor(EventProcessor processor);   // called only for events with an exception
+    void setBeforeSend(EventProcessor processor);       // always called last
+    void clear();
+
+    bool empty() const
+    {
+        return m_processors.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // returns false if the event should be dropped
+    bool apply(json& event) const
+    {
+        if (m_processors.load(std::memory_order_acquire) == nullptr)
+            return true;
+
+        return applyCurrent(event);
+    }
+
+private:
+
+    EventProcessorPipeline(const EventProcessorPipeline&) = delete;
+    EventProcessorPipeline& operator=(const EventProcessorPipeline&) = delete;
+    EventProcessorPipeline(const EventProcessorPipeline&&) = delete;
+    EventProcessorPipeline&& operator=(const EventProcessorPipeline&&) = delete;
+
+    struct ProcessorList
+    {
+        std::vector<EventProcessor> eventProcessors;
+        std::vector<EventProcessor> errorProcessors;
+        EventProcessor beforeSend;
+
+        bool empty() const;
+    };
+
+    // counted in m_readers, so the list it applies is not freed meanwhile
+    bool applyCurrent(json& event) const;
+    static bool applyList(const ProcessorList& processors, json& event);
+
+    template<typename F>
+    void modify(F modifier);
+
+    std::atomic<const ProcessorList*> m_processors;
+    mutable std::atomic<size_t> m_readers;
+
+    // writers only - the published list and the replaced ones readers may still hold,
+    // freed when no reader is in flight
+    mutable std::mutex m_writeMutex;
+    std::vector<std::unique_ptr<ProcessorList>> m_lists;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_EVENTPROCESSOR_H
@@ -0,0 +1,463 @@
+#include "eventserializer.h"
+#include "sdkstats.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+
+namespace
+{
+
+// the members of an event in the order they are written, the others follow in their own order, the breadcrumbs last
+const char* const EVENT_MEMBERS_ORDER[] =
+{
+    "event_id", "timestamp", "platform", "level", "logger", "release", "environment", "transaction", "server_name",
+    "fingerprint", "message", "logentry", "exception", "stacktrace", "threads", "tags", "user", "contexts", "request"
+};
+
+bool isOrderedMember(const std::string& key)
+{
+    for (const char* member : EVENT_MEMBERS_ORDER)
+    {
+        if (key == member)
+            return true;
+    }
+    return false;
+}
+
+bool isContextLines(const std::string& key)
+{
+    return key == "pre_context" || key == "post_context";
+}
+
+size_t escapedLength(unsigned char c)
+{
+    if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t')
+        return 2;
+    return (c < 0x20) ? 6 : 1;    // \u00XX
+}
+
+// the longest prefix of data (of size bytes) that takes at most maxEscaped bytes escaped
+size_t escapedPrefix(const char* data, size_t size, size_t maxEscaped)
+{
+    if (size <= maxEscaped / 6)
+        return size;
+
+    size_t escaped = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        escaped += escapedLength(static_cast<unsigned char>(data[i]));
+        if (escaped > maxEscaped)
+            return i;
+    }
+    return size;
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+EventSerializer::EventSerializer(const EventLimits& limits)
+:
+EventSerializer(limits, limits.maxEventBytes)
+{
+    m_output.push_back('{');
+}
+
+EventSerializer::EventSerializer(const EventLimits& limits, size_t budget)
+:
+m_limits(limits),
+m_budget(budget),
+m_output(),
+m_firstMember(true),
+m_truncated(false),
+m_eventBreadcrumbs(nullptr),
+m_breadcrumbsFragment(nullptr),
+m_breadcrumbs()
+{
+    m_output.reserve(4096);
+}
+
+void EventSerializer::appendEvent(const nlohmann::json& event)
+{
+    for (const char* member : EVENT_MEMBERS_ORDER)
+    {
+        auto value = event.find(member);
+        if (value != event.end())
+        {
+            beginMember(member);
+            writeValue(*value, member);
+        }
+    }
+
+    for (auto it = event.begin(); it != event.end(); ++it)
+    {
+        if (it.key() == "breadcrumbs")
+        {
+            m_eventBreadcrumbs = &it.value();
+        }
+        else if (!isOrderedMember(it.key()))
+        {
+            if (budgetLeft() == 0)
+            {
+                m_truncated = true;
+                break;
+            }
+            beginMember(it.key());
+            writeValue(it.value(), it.key());
+        }
+    }
+}
+
+void EventSerializer::appendMember(const char* key, const std::string& serialized)
+{
+    // the reserve is there for these
+    if (m_output.size() + std::strlen(key) + serialized.size() + 4 > m_budget)
+    {
+        m_truncated = true;
+        return;
+    }
+    beginMember(key);
+    m_output.append(serialized);
+}
+
+void EventSerializer::setBreadcrumbs(const std::string& fragment, std::vector<const std::string*> breadcrumbs)
+{
+    m_breadcrumbsFragment = &fragment;
+    m_breadcrumbs = std::move(breadcrumbs);
+}
+
+std::string EventSerializer::finish()
+{
+    if (m_eventBreadcrumbs != nullptr)
+    {
+        const nlohmann::json* values = m_eventBreadcrumbs;
+        if (values->is_object() && values->find("values") != values->end())
+        {
+            values = &(*values)["values"];
+        }
+
+        if (!values->is_array())
+        {
+            beginMember("breadcrumbs");
+            writeValue(*m_eventBreadcrumbs, "breadcrumbs");
+        }
+        else
+        {
+            // serialized newest first, until the budget is spent - the older ones never are
+            const size_t left = budgetLeft();
+            size_t used = 0;
+            std::vector<std::string> serialized;
+            for (size_t i = values->size(); i-- > 0; )
+            {
+                std::string breadcrumb = serialize((*values)[i], m_limits);
+                used += breadcrumb.size() + 1;
+                if (used > left)
+                    break;
+                serialized.push_back(std::move(breadcrumb));
+            }
+
+            std::vector<const std::string*> newestFirst;
+            newestFirst.reserve(serialized.size());
+            for (const std::string& breadcrumb : serialized)
+            {
+                newestFirst.push_back(&breadcrumb);
+            }
+            writeBreadcrumbs(newestFirst, values->size());
+        }
+    }
+    else if (m_breadcrumbsFragment != nullptr)
+    {
+        if (m_breadcrumbsFragment->size() + sizeof("\"breadcrumbs\":,") <= budgetLeft())
+        {
+            beginMember("breadcrumbs");
+            m_output.append(*m_breadcrumbsFragment);
+        }
+        else
+        {
+            const size_t left = budgetLeft();
+            size_t used = 0;
+            std::vector<const std::string*> newestFirst;
+            for (size_t i = m_breadcrumbs.size(); i-- > 0; )
+            {
+                used += m_breadcrumbs[i]->size() + 1;
+                if (used > left)
+                    break;
+                newestFirst.push_back(m_breadcrumbs[i]);
+            }
+            writeBreadcrumbs(newestFirst, m_breadcrumbs.size());
+        }
+    }
+
+    m_output.push_back('}');
+    if (m_truncated)
+    {
+        SdkStats::instance().add(StatCounter::EVENTS_TRUNCATED);
+    }
+    return std::move(m_output);
+}
+
+bool EventSerializer::truncated() const
+{
+    return m_truncated;
+}
+
+std::string EventSerializer::serialize(const nlohmann::json& value, const EventLimits& limits)
+{
+    EventSerializer serializer(limits, std::numeric_limits<size_t>::max() / 2);
+    serializer.writeValue(value, std::string());
+    return std::move(serializer.m_output);
+}
+
+std::string EventSerializer::serializeEvent(const nlohmann::json& event, const EventLimits& limits)
+{
+    if (!event.is_object())
+    {
+        return serialize(event, limits);
+    }
+    EventSerializer serializer(limits);
+    serializer.appendEvent(event);
+    return serializer.finish();
+}
+
+size_t EventSerializer::budgetLeft() const
+{
+    const size_t used = m_output.size() + EVENT_SIZE_RESERVE;
+    return (used < m_budget) ? m_budget - used : 0;
+}
+
+void EventSerializer::beginMember(const std::string& key)
+{
+    if (!m_firstMember)
+    {
+        m_output.push_back(',');
+    }
+    m_firstMember = false;
+    m_output.push_back('"');
+    writeEscaped(key.data(), key.size());
+    m_output.append("\":");
+}
+
+void EventSerializer::writeValue(const nlohmann::json& value, const std::string& key)
+{
+    char buffer[24];
+    switch (value.type())
+    {
+    case nlohmann::json::value_t::object:
+        writeObject(value);
+        break;
+
+    case nlohmann::json::value_t::array:
+        if (key == "pre_context")
+        {
+            // the lines nearest to the line of the frame
+            const size_t kept = std::min(value.size(), m_limits.maxContextLines);
+            m_truncated |= kept < value.size();
+            writeArray(value, key, value.size() - kept, value.size());
+        }
+        else if (key == "post_context")
+        {
+            const size_t kept = std::min(value.size(), m_limits.maxContextLines);
+            m_truncated |= kept < value.size();
+            writeArray(value, key, 0, kept);
+        }
+        else
+        {
+            writeArray(value, key, 0, value.size());
+        }
+        break;
+
+    case nlohmann::json::value_t::string:
+        writeString(value.get_ref<const std::string&>(),
+                    (key == "context_line" || isContextLines(key)) ? std::min(m_limits.maxStringLength, EVENT_CONTEXT_LINE_MAX_LENGTH)
+                                                                   : m_limits.maxStringLength);
+        break;
+
+    case nlohmann::json::value_t::number_integer:
+        m_output.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value.get<int64_t>()).ptr);
+        break;
+
+    case nlohmann::json::value_t::number_unsigned:
+        m_output.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value.get<uint64_t>()).ptr);
+        break;
+
+    case nlohmann::json::value_t::number_float:
+        m_output.append(value.dump());
+        break;
+
+    case nlohmann::json::value_t::boolean:
+        m_output.append(value.get<bool>() ? "true" : "false");
+        break;
+
+    default:
+        m_output.append("null");
+        break;
+    }
+}
+
+void EventSerializer::writeObject(const nlohmann::json& object)
+{
+    m_output.push_back('{');
+    bool first = true;
+    for (auto it = object.begin(); it != object.end(); ++it)
+    {
+        const std::string& key = it.key();
+        const nlohmann::json& value = it.value();
+
+        if (budgetLeft() == 0)
+        {
+            m_truncated = true;
+            break;
+        }
+        // the source lines are the first to go once half of the budget is spent
+        if (isContextLines(key) && m_output.size() > m_budget / 2)
+        {
+            m_truncated = true;
+            continue;
+        }
+
+        if (!first)
+        {
+            m_output.push_back(',');
+        }
+        first = false;
+        m_output.push_back('"');
+        writeEscaped(key.data(), key.size());
+        m_output.append("\":");
+
+        if (key == "frames" && value.is_array() && value.size() > m_limits.maxStacktraceFrames)
+        {
+            // the outermost frames and the innermost ones, where it failed (only those with fewer than 2)
+            const size_t head = m_limits.maxStacktraceFrames / 2;
+            const size_t tail = m_limits.maxStacktraceFrames - head;
+            const size_t tailBegin = value.size() - tail;
+            m_output.push_back('[');
+            bool firstFrame = true;
+            for (size_t i = 0; i < value.size() && budgetLeft() > 0; i++)
+            {
+                if (i == head)
+                {
+                    i = tailBegin;
+                    if (i == value.size())
+                        break;
+                }
+                if (!firstFrame)
+                {
+                    m_output.push_back(',');
+                }
+                firstFrame = false;
+                writeValue(value[i], key);
+            }
+            m_output.push_back(']');
+            char buffer[24];
+            m_output.append(",\"frames_omitted\":[");
+            m_output.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), head).ptr);
+            m_output.push_back(',');
+            m_output.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), tailBegin).ptr);
+            m_output.push_back(']');
+            m_truncated = true;
+        }
+        else
+        {
+            writeValue(value, key);
+        }
+    }
+    m_output.push_back('}');
+}
+
+void EventSerializer::writeArray(const nlohmann::json& array, const std::string& key, size_t begin, size_t end)
+{
+    m_output.push_back('[');
+    for (size_t i = begin; i < end; i++)
+    {
+        if (budgetLeft() == 0)
+        {
+            m_truncated = true;
+            break;
+        }
+        if (i != begin)
+        {
+            m_output.push_back(',');
+        }
+        writeValue(array[i], key);
+    }
+    m_output.push_back(']');
+}
+
+void EventSerializer::writeString(const std::string& value, size_t maxLength)
+{
+    // maxLength limits the bytes of the value, the budget the bytes written - escaped, up to 6 for a byte
+    const size_t budget = budgetLeft();
+    m_output.push_back('"');
+    if (value.size() <= maxLength && escapedPrefix(value.data(), value.size(), budget) == value.size())
+    {
+        writeEscaped(value.data(), value.size());
+    }
+    else
+    {
+        size_t cut = escapedPrefix(value.data(), std::min(value.size(), (maxLength > 3) ? maxLength - 3 : 0),
+                                   (budget > 3) ? budget - 3 : 0);
+        while (cut > 0 && (static_cast<unsigned char>(value[cut]) & 0xC0) == 0x80)
+        {
+            cut--;      // not within a UTF-8 sequence
+        }
+        writeEscaped(value.data(), cut);
+        m_output.append("...");
+        m_truncated = true;
+    }
+    m_output.push_back('"');
+}
+
+void EventSerializer::writeEscaped(const char* data, size_t size)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    size_t runBegin = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        m_output.append(data + runBegin, i - runBegin);
+        runBegin = i + 1;
+        switch (c)
+        {
+        case '"': m_output.append("\\\""); break;
+        case '\\': m_output.append("\\\\"); break;
+        case '\b': m_output.append("\\b"); break;
+        case '\f': m_output.append("\\f"); break;
+        case '\n': m_output.append("\\n"); break;
+        case '\r': m_output.append("\\r"); break;
+        case '\t': m_output.append("\\t"); break;
+        default:
+            m_output.append("\\u00");
+            m_output.push_back(hexDigits[c >> 4]);
+            m_output.push_back(hexDigits[c & 0xF]);
+            break;
+        }
+    }
+    m_output.append(data + runBegin, size - runBegin);
+}
+
+void EventSerializer::writeBreadcrumbs(const std::vector<const std::string*>& newestFirst, size_t total)
+{
+    m_truncated |= newestFirst.size() < total;
+    if (newestFirst.empty())
+        return;
+
+    beginMember("breadcrumbs");
+    m_output.append("{\"values\":[");
+    for (size_t i = newestFirst.size(); i-- > 0; )
+    {
+        m_output.append(*newestFirst[i]);
+        m_output.push_back(',');
+    }
+    m_output.back() = ']';
+    m_output.push_back('}');
+}
+
+} // namespace Sentry
@@ -0,0 +1,102 @@
+#ifndef SENTRY_EVENTSERIALIZER_H
+#define SENTRY_EVENTSERIALIZER_H
+
+#include "json.h"
+
+#include <string>
+#include <vector>
+
+
+/*
+ * Serialization of events within the size Sentry accepts, in a single pass over the event (no measuring,
+ * no serializing again after a cut):
+ *  - strings longer than maxStringLength are cut at a UTF-8 boundary and end with "...", the source lines
+ *    of the frames at EVENT_CONTEXT_LINE_MAX_LENGTH,
+ *  - frames keep maxContextLines of source around their line on each side,
+ *  - stack traces longer than maxStacktraceFrames lose their middle frames (the outermost and the innermost
+ *    are kept, "frames_omitted" tells which),
+ *  - the members are written in the order of their importance and the breadcrumbs last: the newest that fit
+ *    into what is left of maxEventBytes are kept. When the budget runs low anyway, the source lines of further
+ *    frames are left out, then arrays and objects are cut and strings shortened.
+ *
+ * Scope fragments and breadcrumbs are serialized (with the same limits) once and only spliced in.
+ */
+
+namespace
+{
+constexpr size_t EVENT_SIZE_RESERVE = 1024;             // for the closing brackets and the small members written last
+constexpr size_t EVENT_CONTEXT_LINE_MAX_LENGTH = 256;   // minified or generated sources have very long lines
+}
+
+namespace Sentry
+{
+
+class EventLimits
+{
+public:
+    size_t maxEventBytes = 1024 * 1024;
+    size_t maxStringLength = 8192;
+    size_t maxContextLines = 4;
+    size_t maxStacktraceFrames = 250;
+};
+
+class EventSerializer
+{
+public:
+
+    explicit EventSerializer(const EventLimits& limits);
+
+    // every member of event (an object) but its breadcrumbs, which are written by finish
+    void appendEvent(const nlohmann::json& event);
+    // a member serialized before, e.g. a scope fragment; left out when it does not fit
+    void appendMember(const char* key, const std::string& serialized);
+    // serialized breadcrumbs, oldest first, for an event without its own: fragment is all of them,
+    // {"values":[...]}, spliced as it is when it fits
+    void setBreadcrumbs(const std::string& fragment, std::vector<const std::string*> breadcrumbs);
+
+    // writes the breadcrumbs and closes the event
+    std::string finish();
+
+    // anything was cut or left out
+    bool truncated() const;
+
+    // value with the limits of the strings, source lines and stack traces, but no budget
+    static std::string serialize(const nlohmann::json& value, const EventLimits& limits);
+    // appendEvent and finish
+    static std::string serializeEvent(const nlohmann::json& event, const EventLimits& limits);
+
+private:
+
+    EventSerializer(const EventLimits& limits, size_t budget);
+
+    EventSerializer(const EventSerializer&) = delete;
+    EventSerializer& operator=(const EventSerializer&) = delete;
+    EventSerializer(const EventSerializer&&) = delete;
+    EventSerializer&& operator=(const EventSerializer&&) = delete;
+
+    size_t budgetLeft() const;
+    void beginMember(const std::string& key);
+
+    // key is the name of the member holding value (of the array, for its elements), it selects the limits
+    void writeValue(const nlohmann::json& value, const std::string& key);
+    void writeObject(const nlohmann::json& object);
+    void writeArray(const nlohmann::json& array, const std::string& key, size_t begin, size_t end);
+    void writeString(const std::string& value, size_t maxLength);
+    void writeEscaped(const char* data, size_t size);
+    // newest first, the ones that fit
+    void writeBreadcrumbs(const std::vector<const std::string*>& newestFirst, size_t total);
+
+    const EventLimits& m_limits;
+    size_t m_budget;
+    std::string m_output;
+    bool m_firstMember;
+    bool m_truncated;
+
+    const nlohmann::json* m_eventBreadcrumbs;
+    const std::string* m_breadcrumbsFragment;
+    std::vector<const std::string*> m_breadcrumbs;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_EVENTSERIALIZER_H
@@ -0,0 +1,511 @@
+#include "sentry_common.h"
+#include "httpclient.h"
+#include "sdkstats.h"
+#include "sigpipeguard.h"
+
+#include "client_http.hpp"
+#include "client_https.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <mutex>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+
+namespace http
+{
+
+namespace
+{
+
+constexpr size_t FILE_CHUNK_SIZE = 64 * 1024;           // of the files read to be encrypted, constant memory
+constexpr size_t SENDFILE_MAX_BYTES = 1024 * 1024 * 1024;   // per call, the kernel takes less than 2 GiB
+
+template<typename SocketType>
+class SimpleWebClient : public Client, public ::SimpleWeb::Client<SocketType>
+{
+public:
+
+    // SimpleWeb splits "host:port" at the first colon, which breaks IPv6 literals - take them separately
+    template<typename... Args>
+    SimpleWebClient(const std::string& host, unsigned short port, long timeoutSeconds, Args&&... args)
+    :
+    ::SimpleWeb::Client<SocketType>("localhost", std::forward<Args>(args)...),    // placeholder, the parsing would fail for IPv6
+    m_fileBuffer()
+    {
+        this->host = host;
+        this->port = port;
+        this->config.timeout = timeoutSeconds;
+    }
+
+    std::shared_ptr<Response> post(const std::string& path, const std::string& content, const Header& header) override
+    {
+        auto response = this->request(POST, path, content, header);
+        return toResponse(*response);
+    }
+
+    std::shared_ptr<Response> postChunked(const std::string& path, const Header& header,
+                                          const std::function<bool(ChunkWriter&)>& body) override
+    {
+        ::SimpleWeb::error_code result;
+        // a kept alive connection closed by the server meanwhile fails only once the body is written (or when
+        // the response is read), the request is written again on a new connection then
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            auto connection = this->get_connection();   // creates the io_service and the resolver query on first use
+            const bool reused = connection->socket->lowest_layer().is_open();
+            bool bodyFailed = false;
+            auto response = writeChunked(connection, path, header, body, result, bodyFailed);
+
+            {
+                std::lock_guard<std::mutex> lock(this->connections_mutex);
+                connection->in_use = false;
+                if (result)
+                {
+                    // a body cut short leaves the connection in the middle of a request
+                    this->connections.erase(connection);
+                }
+            }
+
+            if (!result)
+            {
+                return toResponse(*response);
+            }
+            if (!reused || bodyFailed)
+            {
+                break;
+            }
+        }
+        throw ::SimpleWeb::system_error(result);
+    }
+
+    bool prewarm() override
+    {
+        auto connection = this->get_connection();   // creates the io_service and the resolver query on first use
+        ::SimpleWeb::error_code result = openConnection(connection);
+
+        std::lock_guard<std::mutex> lock(this->connections_mutex);
+        connection->in_use = false;
+        if (result)
+        {
+            this->connections.erase(connection);
+        }
+        return !result;
+    }
+
+protected:
+
+    using Connection = typename ::SimpleWeb::Client<SocketType>::Connection;
+    using Session = typename ::SimpleWeb::Client<SocketType>::Session;
+    using ClientResponse = typename ::SimpleWeb::Client<SocketType>::Response;
+
+    // runs on the io_service after the TCP connection is established, stores the error in result
+    virtual void handshake(const std::shared_ptr<Connection>&, ::SimpleWeb::error_code&)
+    {
+    }
+
+    // the same steps as SimpleWeb's connect, without a request to write at the end; nothing when already open
+    ::SimpleWeb::error_code openConnection(const std::shared_ptr<Connection>& connection)
+    {
+        ::SimpleWeb::error_code result;
+        if (!connection->socket->lowest_layer().is_open())
+        {
+            asio::ip::tcp::resolver resolver(*this->io_service);
+            connection->set_timeout(this->config.timeout_connect);
+            resolver.async_resolve(*this->query, [this, connection, &result](const ::SimpleWeb::error_code& ec, asio::ip::tcp::resolver::iterator it)
+            {
+                connection->cancel_timeout();
+                if (ec)
+                {
+                    result = ec;
+                    return;
+                }
+                connection->set_timeout(this->config.timeout_connect);
+                asio::async_connect(connection->socket->lowest_layer(), it, [this, connection, &result](const ::SimpleWeb::error_code& ec, asio::ip::tcp::resolver::iterator)
+                {
+                    connection->cancel_timeout();
+                    if (ec)
+                    {
+                        result = ec;
+                        return;
+                    }
+                    ::SimpleWeb::error_code ignored;
+                    connection->socket->lowest_layer().set_option(asio::ip::tcp::no_delay(true), ignored);
+                    handshake(connection, result);
+                });
+            });
+            this->io_service->run();
+            this->io_service->reset();
+        }
+        return result;
+    }
+
+    std::shared_ptr<Response> toResponse(ClientResponse& response)
+    {
+        auto result = std::make_shared<Response>();
+        result->status_code = response.status_code;
+        result->header = response.header;
+        result->content = response.content.string();
+
+        // SimpleWeb would find out only when writing the next request, and reconnect after that failed
+        auto connectionHeader = result->header.find("Connection");
+        if (connectionHeader != result->header.end() && ::SimpleWeb::case_insensitive_equal(connectionHeader->second, "close"))
+        {
+            closeIdleConnections();
+        }
+        return result;
+    }
+
+    // the request on connection, nullptr and result set on failure
+    std::shared_ptr<ClientResponse> writeChunked(const std::shared_ptr<Connection>& connection, const std::string& path,
+                                                 const Header& header, const std::function<bool(ChunkWriter&)>& body,
+                                                 ::SimpleWeb::error_code& result, bool& bodyFailed)
+    {
+        result = openConnection(connection);
+        if (result)
+            return nullptr;
+
+        std::unique_ptr<asio::streambuf> requestHeader = this->create_request_header("POST", path, header);
+        {
+            std::ostream stream(requestHeader.get());
+            stream << "Transfer-Encoding: chunked\r\n\r\n";
+        }
+        if (!writeBuffers(connection, requestHeader->data(), result))
+            return nullptr;
+
+        SocketChunkWriter writer(*this, connection);
+        if (!body(writer))
+        {
+            result = writer.error();
+            bodyFailed = !result;
+            if (bodyFailed)
+            {
+                result = ::SimpleWeb::make_error_code::make_error_code(::SimpleWeb::errc::io_error);
+            }
+            return nullptr;
+        }
+        static const char lastChunk[] = "0\r\n\r\n";
+        if (!writeBuffers(connection, asio::buffer(lastChunk, sizeof(lastChunk) - 1), result))
+            return nullptr;
+
+        // SimpleWeb's parsing of the response, it would reconnect on failure and write only the header again
+        auto session = std::make_shared<Session>(this->config.max_response_streambuf_size, connection,
+                                                 std::unique_ptr<asio::streambuf>(new asio::streambuf()));
+        connection->attempt_reconnect = false;
+        session->callback = [&result](const std::shared_ptr<Connection>&, const ::SimpleWeb::error_code& ec)
+        {
+            result = ec;
+        };
+        this->read(session);
+        this->io_service->run();
+        this->io_service->reset();
+        return result ? nullptr : session->response;
+    }
+
+    // synchronous, with the timeout of the requests
+    template<typename Buffers>
+    bool writeBuffers(const std::shared_ptr<Connection>& connection, const Buffers& buffers, ::SimpleWeb::error_code& result)
+    {
+        connection->set_timeout();
+        asio::async_write(*connection->socket, buffers, [connection, &result](const ::SimpleWeb::error_code& ec, size_t)
+        {
+            connection->cancel_timeout();
+            result = ec;
+        });
+        this->io_service->run();
+        this->io_service->reset();
+        return !result;
+    }
+
+    bool writeChunk(const std::shared_ptr<Connection>& connection, const char* data, size_t size,
+                    ::SimpleWeb::error_code& result)
+    {
+        if (size == 0)
+            return true;    // an empty chunk would end the body
+
+        char sizeLine[24];
+        char* end = std::to_chars(sizeLine, sizeLine + sizeof(sizeLine) - 2, size, 16).ptr;
+        *end++ = '\r';
+        *end++ = '\n';
+        const std::vector<asio::const_buffer> buffers = {asio::buffer(sizeLine, static_cast<size_t>(end - sizeLine)),
+                                                         asio::buffer(data, size), asio::buffer("\r\n", 2)};
+        return writeBuffers(connection, buffers, result);
+    }
+
+    // false with result set when the connection failed, false with no result when the file is shorter
+    bool writeFileChunks(const std::shared_ptr<Connection>& connection, int descriptor, off_t offset, uint64_t length,
+                         ::SimpleWeb::error_code& result)
+    {
+        if constexpr (std::is_same<SocketType, ::SimpleWeb::HTTP>::value)
+        {
+            // a single chunk, the file goes from the page cache to the socket without being copied in the process
+            char sizeLine[24];
+            char* end = std::to_chars(sizeLine, sizeLine + sizeof(sizeLine) - 2, length, 16).ptr;
+            *end++ = '\r';
+            *end++ = '\n';
+            if (length == 0 || !writeBuffers(connection, asio::buffer(sizeLine, static_cast<size_t>(end - sizeLine)), result))
+                return !result;
+
+            auto& socket = *connection->socket;
+            socket.native_non_blocking(true, result);
+            if (result)
+                return false;
+            const int timeoutMilliseconds = this->config.timeout > 0 ? static_cast<int>(this->config.timeout * 1000) : -1;
+            const Sentry::SigpipeGuard sigpipeGuard;    // sendfile has no MSG_NOSIGNAL, a reset connection fails with EPIPE
+            while (length > 0)
+            {
+                const ssize_t sent = sendfile(socket.native_handle(), descriptor, &offset,
+                                              static_cast<size_t>(std::min<uint64_t>(length, SENDFILE_MAX_BYTES)));
+                if (sent > 0)
+                {
+                    length -= static_cast<uint64_t>(sent);
+                    continue;
+                }
+                if (sent == 0)
+                    return false;
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                {
+                    result = ::SimpleWeb::error_code(errno, std::system_category());
+                    return false;
+                }
+
+                struct pollfd writable = {socket.native_handle(), POLLOUT, 0};
+                const int ready = poll(&writable, 1, timeoutMilliseconds);
+                if (ready == 0)
+                {
+                    result = ::SimpleWeb::make_error_code::make_error_code(::SimpleWeb::errc::timed_out);
+                    return false;
+                }
+                if (ready < 0 && errno != EINTR)
+                {
+                    result = ::SimpleWeb::error_code(errno, std::system_category());
+                    return false;
+                }
+            }
+            return writeBuffers(connection, asio::buffer("\r\n", 2), result);
+        }
+        else
+        {
+            // encrypted in the process, a buffer at a time
+            if (m_fileBuffer.empty())
+            {
+                m_fileBuffer.resize(FILE_CHUNK_SIZE);
+            }
+            while (length > 0)
+            {
+                const ssize_t bytesRead = pread(descriptor, m_fileBuffer.data(),
+                                                static_cast<size_t>(std::min<uint64_t>(length, m_fileBuffer.size())), offset);
+                if (bytesRead < 0 && errno == EINTR)
+                    continue;
+                if (bytesRead <= 0)
+                    return false;
+                if (!writeChunk(connection, m_fileBuffer.data(), static_cast<size_t>(bytesRead), result))
+                    return false;
+                offset += bytesRead;
+                length -= static_cast<uint64_t>(bytesRead);
+            }
+            return true;
+        }
+    }
+
+    void closeIdleConnections()
+    {
+        std::lock_guard<std::mutex> lock(this->connections_mutex);
+        for (auto it = this->connections.begin(); it != this->connections.end(); )
+        {
+            it = (*it)->in_use ? std::next(it) : this->connections.erase(it);
+        }
+    }
+
+private:
+
+    // chunks written straight to the socket of the connection
+    class SocketChunkWriter : public ChunkWriter
+    {
+    public:
+
+        SocketChunkWriter(SimpleWebClient& client, const std::shared_ptr<Connection>& connection)
+        :
+        m_client(client),
+        m_connection(connection),
+        m_error()
+        {
+        }
+
+        bool write(const char* data, size_t size) override
+        {
+            return m_client.writeChunk(m_connection, data, size, m_error);
+        }
+
+        bool writeFile(int descriptor, off_t offset, uint64_t length) override
+        {
+            return m_client.writeFileChunks(m_connection, descriptor, offset, length, m_error);
+        }
+
+        const ::SimpleWeb::error_code& error() const
+        {
+            return m_error;
+        }
+
+    private:
+
+        SimpleWebClient& m_client;
+        const std::shared_ptr<Connection>& m_connection;
+        ::SimpleWeb::error_code m_error;
+    };
+
+    std::vector<char> m_fileBuffer;     // allocated with the first file sent over TLS
+};
+
+class TlsClient : public SimpleWebClient<::SimpleWeb::HTTPS>
+{
+public:
+
+    TlsClient(const std::string& host, unsigned short port, long timeoutSeconds, const TlsOptions& tlsOptions)
+    :
+    SimpleWebClient<::SimpleWeb::HTTPS>(host, port, timeoutSeconds, tlsOptions.verifyCertificate, std::string(), std::string(),
+                                        tlsOptions.verifyCertificate ? tlsOptions.caCertsPath : std::string()),
+    m_sessionMutex(),
+    m_session(nullptr)
+    {
+        // SimpleWeb set it up for the placeholder host
+        if (tlsOptions.verifyCertificate)
+        {
+            context.set_verify_callback(asio::ssl::rfc2818_verification(host));
+        }
+
+        SSL_CTX* sslContext = context.native_handle();
+        SSL_CTX_set_max_proto_version(sslContext, 0);   // tlsv12 pins the maximum to TLS 1.2 as well
+        SSL_CTX_set_ex_data(sslContext, clientIndex(), this);   // the app data is taken by asio
+        SSL_CTX_set_info_callback(sslContext, &TlsClient::infoCallback);
+        if (tlsOptions.reuseSessions)
+        {
+            // OpenSSL does not look up client sessions on its own, create_connection sets the stored one
+            SSL_CTX_set_session_cache_mode(sslContext, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(sslContext, &TlsClient::newSessionCallback);
+        }
+    }
+
+    ~TlsClient() override
+    {
+        SSL_CTX* sslContext = context.native_handle();
+        SSL_CTX_set_info_callback(sslContext, nullptr);
+        SSL_CTX_sess_set_new_cb(sslContext, nullptr);
+        if (m_session != nullptr)
+        {
+            SSL_SESSION_free(m_session);
+        }
+    }
+
+protected:
+
+    // called for new connections and for the reconnections of SimpleWeb
+    std::shared_ptr<Connection> create_connection() noexcept override
+    {
+        auto connection = ::SimpleWeb::Client<::SimpleWeb::HTTPS>::create_connection();
+        std::lock_guard<std::mutex> lock(m_sessionMutex);
+        if (m_session != nullptr)
+        {
+            SSL_set_session(connection->socket->native_handle(), m_session);
+        }
+        return connection;
+    }
+
+    void handshake(const std::shared_ptr<Connection>& connection, ::SimpleWeb::error_code& result) override
+    {
+        SSL_set_tlsext_host_name(connection->socket->native_handle(), host.c_str());
+
+        connection->set_timeout(config.timeout_connect);
+        connection->socket->async_handshake(asio::ssl::stream_base::client, [connection, &result](const ::SimpleWeb::error_code& ec)
+        {
+            connection->cancel_timeout();
+            result = ec;
+        });
+    }
+
+private:
+
+    TlsClient(const TlsClient&) = delete;
+    TlsClient& operator=(const TlsClient&) = delete;
+    TlsClient(const TlsClient&&) = delete;
+    TlsClient&& operator=(const TlsClient&&) = delete;
+
+    static int clientIndex()
+    {
+        static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    static int handshakeCountedIndex()
+    {
+        static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    static void infoCallback(const SSL* ssl, int where, int)
+    {
+        if ((where & SSL_CB_HANDSHAKE_DONE) == 0)
+            return;
+
+        // TLS 1.3 reports the session tickets received after the handshake as handshakes too, count every connection once
+        SSL* connection = const_cast<SSL*>(ssl);
+        if (SSL_get_ex_data(connection, handshakeCountedIndex()) != nullptr)
+            return;
+        SSL_set_ex_data(connection, handshakeCountedIndex(), connection);
+
+        Sentry::SdkStats& stats = Sentry::SdkStats::instance();
+        stats.add(Sentry::StatCounter::TLS_HANDSHAKES);
+        if (SSL_session_reused(connection))
+        {
+            stats.add(Sentry::StatCounter::TLS_SESSIONS_RESUMED);
+        }
+    }
+
+    // keeps the newest session, TLS 1.3 servers may send several tickets per connection
+    static int newSessionCallback(SSL* ssl, SSL_SESSION* session)
+    {
+        // a copy - OpenSSL marks the session of a connection freed without a TLS shutdown as not resumable,
+        // and SimpleWeb drops idle connections (or ones closed by the server) just like that
+        SSL_SESSION* copy = SSL_SESSION_dup(session);
+        if (copy == nullptr)
+            return 0;
+
+        TlsClient* client = static_cast<TlsClient*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), clientIndex()));
+        std::lock_guard<std::mutex> lock(client->m_sessionMutex);
+        if (client->m_session != nullptr)
+        {
+            SSL_SESSION_free(client->m_session);
+        }
+        client->m_session = copy;
+        return 0;   // the original stays with the connection
+    }
+
+    std::mutex m_sessionMutex;
+    SSL_SESSION* m_session;
+};
+
+} // namespace
+
+std::shared_ptr<Client> Client::create(const std::string& protocol, const std::string& host, unsigned short port,
+                                       long timeoutSeconds, const TlsOptions& tlsOptions)
+{
+    if (protocol == "http")
+    {
+        return std::make_shared<SimpleWebClient<::SimpleWeb::HTTP>>(host, port, timeoutSeconds);
+    }
+    else if (protocol == "https")
+    {
+        return std::make_shared<TlsClient>(host, port, timeoutSeconds, tlsOptions);
+    }
+    return nullptr;
+}
+
+} // namespace http
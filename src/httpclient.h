@@ -0,0 +1,83 @@
+#ifndef SENTRY_HTTPCLIENT_H
+#define SENTRY_HTTPCLIENT_H
+
+#include "utility.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+
+/*
+ * HTTP(S) client of the transport, a thin layer over the vendored SimpleWeb clients (client_http.hpp / client_https.hpp).
+ *
+ * The connection is kept alive between requests and reopened when the server closes it.
+ * Over https the TLS session of the last handshake is kept, so a reconnection resumes it (abbreviated handshake)
+ * instead of running the full key exchange again. TLS 1.2 and 1.3 are allowed.
+ *
+ * Bodies of unknown or large size (envelopes with attachments) are posted with chunked transfer encoding, written
+ * by a callback as they are produced. Over http the files go from the page cache to the socket with sendfile,
+ * over https (encrypted in the process) through a buffer of a fixed size.
+ *
+ * Not thread safe, used only by the transport worker.
+ */
+
+namespace http
+{
+using Header = ::SimpleWeb::CaseInsensitiveMultimap;
+
+class Response
+{
+public:
+    std::string status_code;    // e.g. "200 OK"
+    Header header;
+    std::string content;
+};
+
+class TlsOptions
+{
+public:
+    std::string caCertsPath;    // PEM file with the trusted certificates, empty - system defaults
+    bool verifyCertificate = true;
+    bool reuseSessions = true;
+};
+
+// writes the body of Client::postChunked, every call is a chunk
+class ChunkWriter
+{
+public:
+    virtual ~ChunkWriter() = default;
+
+    // false when the connection failed
+    virtual bool write(const char* data, size_t size) = 0;
+    // length bytes of the file from offset, false when the connection failed or the file is shorter
+    virtual bool writeFile(int descriptor, off_t offset, uint64_t length) = 0;
+};
+
+class Client
+{
+public:
+
+    // protocol of the DSN: "http" or "https", nullptr for anything else
+    // throws std::system_error when the TLS context can not be set up (e.g. unreadable caCertsPath)
+    static std::shared_ptr<Client> create(const std::string& protocol, const std::string& host, unsigned short port,
+                                          long timeoutSeconds, const TlsOptions& tlsOptions = TlsOptions());
+
+    virtual ~Client() = default;
+
+    // synchronous, throws std::system_error when the request could not be sent or the response not read
+    virtual std::shared_ptr<Response> post(const std::string& path, const std::string& content, const Header& header) = 0;
+
+    // the same for a body written by body (with chunked transfer encoding, header must not have a Content-Length),
+    // body may be called again when a kept alive connection turned out to be closed - it returns false to give up
+    virtual std::shared_ptr<Response> postChunked(const std::string& path, const Header& header,
+                                                  const std::function<bool(ChunkWriter&)>& body) = 0;
+
+    // opens the connection (and does the TLS handshake) ahead of the first request, false on failure
+    virtual bool prewarm() = 0;
+};
+
+} // namespace http
+
+#endif // SENTRY_HTTPCLIENT_H
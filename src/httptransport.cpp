@@ -0,0 +1,297 @@
+#include "sentry_common.h"
+#include "envelope.h"
+#include "httptransport.h"
+#include "sdkstats.h"
+
+#include <charconv>
+#include <sstream>
+
+
+#define SENTRY_VERSION 7
+
+
+namespace Sentry
+{
+
+HttpTransport::HttpTransport()
+:
+Transport(),
+m_dsnStruct(),
+m_pHttpClient(nullptr),
+m_headerTemplate(),
+m_authHeader(),
+m_contentTypeHeader(),
+m_contentLengthHeader(),
+m_authTimestampOffset(0),
+m_authTimestampLength(0),
+m_authTimestamp(-1)
+{
+
+}
+
+HttpTransport::~HttpTransport()
+{
+    // the worker uses the client
+    stop();
+}
+
+EErrorCode HttpTransport::setup(const SentryDSN& dsn, const SentryOptions& options)
+{
+    m_dsnStruct = dsn;
+
+#ifdef DEBUG_SENTRYCPP
+        std::stringstream ss;
+        ss << "Protocol: " << m_dsnStruct.protocol
+           << " public key: " << m_dsnStruct.publicKey
+           << " host path: " << m_dsnStruct.hostPath;
+        if (m_dsnStruct.secretKey != "")
+            ss << ", " << "sentry_secret key: " << m_dsnStruct.secretKey;
+        ss << std::endl << "Endpoint path: " << m_dsnStruct.sentry_endpoint_path;
+        LOG_SENTRY_DEBUG(ss.str());
+#endif // DEBUG_SENTRYCPP
+
+    createHeaderTemplate();
+
+    http::TlsOptions tlsOptions;
+    tlsOptions.caCertsPath = options.caCerts;
+    tlsOptions.verifyCertificate = options.verifyCertificate;
+    try
+    {
+        m_pHttpClient = http::Client::create(m_dsnStruct.protocol, m_dsnStruct.host, m_dsnStruct.port, HTTP_CLIENT_TIMOUT_IN_SECONDS, tlsOptions);
+    }
+    catch (std::system_error& e)
+    {
+#ifdef DEBUG_SENTRYCPP
+        LOG_SENTRY_DEBUG(e.what());
+#endif
+        return EErrorCode::TLS_ERROR;
+    }
+    if (m_pHttpClient == nullptr)
+    {
+        // also when no DSN was given
+        return EErrorCode::WRONG_DSN;
+    }
+
+    if (options.prewarmConnection)
+    {
+        // the first event does not wait for the connection and the TLS handshake
+        // on failure the first send tries again and handles the error
+        auto actionToEnqueue = [this]()
+        {
+            if (!m_pHttpClient->prewarm())
+            {
+#ifdef DEBUG_SENTRYCPP
+                LOG_SENTRY_DEBUG("Could not prewarm the connection");
+#endif
+            }
+        };
+        addActionToQueue(actionToEnqueue);
+    }
+
+    return EErrorCode::NO_ERROR;
+}
+
+void HttpTransport::send(const std::string& content, unsigned int attempt)
+{
+    if (m_pHttpClient == nullptr)
+    {
+        //raise - client not set!
+        return;
+    }
+    const bool isEnvelope = Envelope::isEnvelope(content);
+    const std::string& endpoint = isEnvelope ? m_dsnStruct.envelope_endpoint : m_dsnStruct.sentry_endpoint;
+    const http::Header& header = prepareHeader(content.size(), isEnvelope);
+
+#ifdef DEBUG_SENTRYCPP
+    std::stringstream ss;
+    ss << "Path: " << (isEnvelope ? m_dsnStruct.envelope_endpoint_path : m_dsnStruct.sentry_endpoint_path)
+       << "Request headers: " << std::endl;
+    for (auto h : header) {
+        ss << h.first << ": " << h.second << std::endl;
+    }
+    ss << "Request contents: " << content << std::endl;
+    ss << "Http client url: " << endpoint << std::endl;
+    LOG_SENTRY_DEBUG(ss.str());
+#endif // DEBUG_SENTRYCPP
+
+    sendPost(endpoint, content, header, attempt);
+}
+
+void HttpTransport::sendPost(const std::string& endpoint, const std::string& content, const http::Header& header,
+                             unsigned int attempt)
+{
+    try
+    {
+        const auto requestStart = std::chrono::steady_clock::now();
+        auto response = m_pHttpClient->post(endpoint, content, header);
+        SdkStats::instance().recordHttpLatency(std::chrono::steady_clock::now() - requestStart);
+
+        //check response
+        bool ok = checkResponse(response);
+        if (ok)
+        {
+            handleSendSuccess(content.size());
+        }
+        else
+        {
+            handleSendFailure(content, attempt);
+        }
+
+    }
+    catch(std::system_error& e)
+    {
+#ifdef DEBUG_SENTRYCPP
+        LOG_SENTRY_DEBUG("Could not send event! ");
+        LOG_SENTRY_DEBUG(e.code().message());
+        LOG_SENTRY_DEBUG(e.what());
+#endif
+        handleConnectionError(); // ? does every error mean that?
+        handleSendFailure(content, attempt);
+    }
+}
+
+void HttpTransport::sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt)
+{
+    if (m_pHttpClient == nullptr)
+    {
+        return;
+    }
+
+    // the length is known, but the body is not in memory - SimpleWeb writes only bodies it holds
+    http::Header header = prepareHeader(0, true);
+    header.erase("Content-Length");
+
+    const OpenedEnvelope opened(*envelope);
+    auto body = [&opened](http::ChunkWriter& writer)
+    {
+        for (const EnvelopePart& part : opened.parts())
+        {
+            if (!writer.write(part.data.data(), part.data.size()) || !writer.writeFile(part.descriptor, part.offset, part.length))
+                return false;
+        }
+        return true;
+    };
+
+    try
+    {
+        const auto requestStart = std::chrono::steady_clock::now();
+        auto response = m_pHttpClient->postChunked(m_dsnStruct.envelope_endpoint, header, body);
+        SdkStats::instance().recordHttpLatency(std::chrono::steady_clock::now() - requestStart);
+
+        if (checkResponse(response))
+        {
+            handleSendSuccess(opened);
+        }
+        else
+        {
+            handleSendFailure(envelope, attempt);
+        }
+    }
+    catch(std::system_error& e)
+    {
+#ifdef DEBUG_SENTRYCPP
+        LOG_SENTRY_DEBUG("Could not send envelope with attachments! ");
+        LOG_SENTRY_DEBUG(e.what());
+#endif
+        handleConnectionError();
+        handleSendFailure(envelope, attempt);
+    }
+}
+
+void HttpTransport::createHeaderTemplate()
+{
+    /*
+     * Authentication header:
+     * X-Sentry-Auth: Sentry sentry_version=5,
+      sentry_client=<client version, arbitrary>,
+      sentry_timestamp=<current timestamp>,
+      sentry_key=<public api key>,
+      sentry_secret=<secret api key>
+    */
+
+    // built once, prepareHeader patches only the timestamp and Content-Length
+    std::string client_version = "sentry_cpp/0.1";
+    std::string header_info = "Sentry sentry_version=" + std::to_string(SENTRY_VERSION) + ", "
+                            + "sentry_client=" + client_version + ", "
+                            + "sentry_timestamp=";
+    m_authTimestampOffset = header_info.size();
+    m_authTimestampLength = 0;
+    m_authTimestamp = -1;
+    header_info += ", sentry_key=" + m_dsnStruct.publicKey;
+    if (m_dsnStruct.secretKey != "")
+        header_info += ", sentry_secret=" + m_dsnStruct.secretKey;
+
+    m_headerTemplate.clear();
+    m_authHeader = m_headerTemplate.emplace("X-Sentry-Auth", header_info);
+    m_contentTypeHeader = m_headerTemplate.emplace("Content-Type", "application/json");
+    m_headerTemplate.emplace("User-Agent", client_version);
+    // when present, SimpleWeb does not add its own
+    m_contentLengthHeader = m_headerTemplate.emplace("Content-Length", "0");
+}
+
+const http::Header& HttpTransport::prepareHeader(size_t contentLength, bool isEnvelope)
+{
+    char buffer[24];
+
+    const auto dur = std::chrono::system_clock::now().time_since_epoch();
+    const int64_t timestamp = std::chrono::duration_cast<std::chrono::seconds>(dur).count();
+    if (timestamp != m_authTimestamp)
+    {
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), timestamp);
+        const size_t length = static_cast<size_t>(result.ptr - buffer);
+        m_authHeader->second.replace(m_authTimestampOffset, m_authTimestampLength, buffer, length);
+        m_authTimestampLength = length;
+        m_authTimestamp = timestamp;
+    }
+
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), contentLength);
+    m_contentLengthHeader->second.assign(buffer, result.ptr);
+
+    m_contentTypeHeader->second = isEnvelope ? "application/x-sentry-envelope" : "application/json";
+
+    return m_headerTemplate;
+}
+
+bool HttpTransport::checkResponse(std::shared_ptr<http::Response> response)
+{
+    if (SimpleWeb::status_code(response->status_code) == SimpleWeb::StatusCode::success_ok)
+    {
+        return true;
+    }
+    else if (SimpleWeb::status_code(response->status_code) == SimpleWeb::StatusCode::client_error_too_many_requests)
+    {
+        // not sent yet, retried after Retry-After
+        SdkStats::instance().add(StatCounter::EVENTS_RATE_LIMITED);
+        handleTooManyRequests(response);
+        return false;
+    }
+    else
+    {
+#ifdef DEBUG_SENTRYCPP
+            std::stringstream ss;
+            ss << "Response "
+               << "status code: " << response->status_code << std::endl;
+            ss << "Response headers" << std::endl;
+            for (auto h : response->header) {
+                ss << h.first << ": " << h.second << std::endl;
+            }
+            ss << "Response content: " << response->content << std::endl;
+            LOG_SENTRY_DEBUG(ss.str());
+#endif //DEBUG_SENTRYCPP
+        return false;
+    }
+}
+
+void HttpTransport::handleTooManyRequests(std::shared_ptr<http::Response> errorResponse)
+{
+    uint64_t retryAfterMilliseconds = RECONNECTION_TIMEOUT_MILLISECONDS; // default
+    for (auto& h : errorResponse->header) {
+        if (h.first == "Retry-After")
+        {
+            retryAfterMilliseconds = std::stoul(h.second.c_str()) * MILLISECONDS_IN_SECOND;
+        }
+    }
+    pauseSending(retryAfterMilliseconds);
+}
+
+} // namespace Sentry
@@ -0,0 +1,60 @@
+#ifndef SENTRY_HTTPTRANSPORT_H
+#define SENTRY_HTTPTRANSPORT_H
+
+#include "httpclient.h"
+#include "transport.h"
+
+#include <memory>
+
+
+namespace Sentry
+{
+
+class TransportBenchmark;    // benchmarks measure private hot paths
+
+// the default transport, posts the events to the store endpoint of the DSN (http or https), envelopes to the envelope one
+class HttpTransport : public Transport
+{
+public:
+
+    HttpTransport();
+    ~HttpTransport() override;
+
+    // https DSNs use the TLS settings of the options
+    EErrorCode setup(const SentryDSN& dsn, const SentryOptions& options) override;
+
+protected:
+
+    void send(const std::string& contents, unsigned int attempt) override;
+    // posted with chunked transfer encoding, the files are read while the request is written
+    void sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt) override;
+
+private:
+
+    friend class TransportBenchmark;
+
+    void sendPost(const std::string& endpoint, const std::string& contents, const http::Header& header, unsigned int attempt);
+    bool checkResponse(std::shared_ptr<http::Response> response);
+
+    void handleTooManyRequests(std::shared_ptr<http::Response> errorResponse);
+
+    // the header is built once in setup, only the timestamp, Content-Type and Content-Length change per request
+    void createHeaderTemplate();
+    const http::Header& prepareHeader(size_t contentLength, bool isEnvelope=false);
+
+    SentryDSN m_dsnStruct;
+
+    std::shared_ptr<http::Client> m_pHttpClient;
+
+    http::Header m_headerTemplate;
+    http::Header::iterator m_authHeader;
+    http::Header::iterator m_contentTypeHeader;
+    http::Header::iterator m_contentLengthHeader;
+    size_t m_authTimestampOffset;       // of the timestamp in the X-Sentry-Auth value
+    size_t m_authTimestampLength;
+    int64_t m_authTimestamp;            // currently written, -1 - none
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_HTTPTRANSPORT_H
@@ -1,9 +1,21 @@
 #include "hub.h"
 
 #include "backtracehandler.h"
-
-
+#include "envelope.h"
+#include "logstaging.h"
+#include "memorytransport.h"
+#include "metricsaggregator.h"
+#include "profiler.h"
+#include "sdkstats.h"
+#include "spanrecorder.h"
+#include "threadsampler.h"
+#include "throwhook.h"
+#include "unwinder.h"
+
+
+#include <algorithm>
 #include <assert.h>
+#include <cstring>
 #include <cxxabi.h>
 //#include <dlfcn.h> // for dladdr
 #include <iomanip>
@@ -13,7 +25,10 @@
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
 #include <time.h>
+#include <unistd.h>
 #include <uuid/uuid.h>
 
 #define WAIT_FOR_REQUEST_COMPLETED_TIMEOUT_MS 1000
@@ -28,47 +43,193 @@ Hub::Hub()
 :
 m_initialised(false),
 m_sampleRate(100),
+m_tracesSampleRate(0),
+m_profilesSampleRate(0),
+m_profilingFrequencyHz(100),
 m_lastEventId(),
 m_listOfLastUniqueEventsWithTimestamps(),
-m_pHttpClient(nullptr),
+m_pTransport(nullptr),
 m_scope(),
-m_isSourceAvailable(false)
+m_crashHandler(),
+m_session(),
+m_sessionMutex(),
+m_sessionAggregator(),
+m_requestSessions(&m_sessionAggregator),
+m_sessionAttributes(json::object()),
+m_metricsEnabled(false),
+m_metricsTags(),
+m_isSourceAvailable(false),
+m_processEventsOnTransportThread(false),
+m_stackUnwinder(StackUnwinder::BACKTRACE),
+m_maxStackFrames(128),
+m_eventLimits(),
+m_eventCoalescer()
 {
 
 }
 
 Hub::~Hub()
 {
-    closeHttpConnection();
+    if (m_initialised)
+    {
+        endSession();
+        flushSessionAggregates(true);
+        flushMetrics();
+    }
+    drainSpans();
+    SpanRecorder::instance().removeHub(this);
+    closeTransport();
 }
 
-EErrorCode Hub::init(std::string dsn, int maxBreadcrumbs, bool sourceAvailable,  int sampleRate)
+EErrorCode Hub::init(std::string dsn, const SentryOptions& options)
 {
     // config
-    if (maxBreadcrumbs != -1)
-        m_scope.setMaxBreadcrumbs(static_cast<uint16_t>(maxBreadcrumbs));
-    m_isSourceAvailable = sourceAvailable;
+    if (options.maxBreadcrumbs != -1)
+        m_scope.setMaxBreadcrumbs(static_cast<uint16_t>(options.maxBreadcrumbs));
+    m_isSourceAvailable = options.attachStackTrace;
+    m_stackUnwinder = options.stackUnwinder;
+    m_maxStackFrames = options.maxStackFrames;
+    m_eventLimits.maxEventBytes = options.maxEventBytes;
+    m_eventLimits.maxStringLength = options.maxStringLength;
+    m_eventLimits.maxContextLines = options.maxContextLines;
+    m_eventLimits.maxStacktraceFrames = options.maxStacktraceFrames;
+    m_scope.setEventLimits(m_eventLimits);
+    if (m_stackUnwinder == StackUnwinder::EH_FRAME)
+    {
+        Unwinder::refreshModules();     // the signal handlers cannot
+    }
+    if (options.captureThrowStack)
+    {
+        if (ThrowHook::isAvailable())
+        {
+            ThrowHook::enable(m_stackUnwinder);
+        }
+#ifdef DEBUG_SENTRYCPP
+        else
+        {
+            LOG_SENTRY_DEBUG("captureThrowStack needs the library built with THROW_HOOK_SENTRY");
+        }
+#endif // DEBUG_SENTRYCPP
+    }
+
+    m_sampleRate = options.sampleRate;
+    m_tracesSampleRate = options.tracesSampleRate;
+    m_profilesSampleRate = options.profilesSampleRate;
+    m_profilingFrequencyHz = options.profilingFrequencyHz;
 
-    m_sampleRate = sampleRate;
+    if (options.release != "")
+    {
+        m_sessionAttributes["release"] = options.release;
+        m_metricsTags.emplace_back("release", options.release);
+    }
+    if (options.environment != "")
+    {
+        m_sessionAttributes["environment"] = options.environment;
+        m_metricsTags.emplace_back("environment", options.environment);
+    }
+    m_metricsEnabled = options.enableMetrics;
 
-    EErrorCode errorCode;
+    m_processEventsOnTransportThread = options.processEventsOnTransportThread;
+    m_eventCoalescer.setWindow(std::chrono::milliseconds(options.coalesceWindowMilliseconds));
+    if (options.beforeSend)
+    {
+        m_scope.getEventProcessors().setBeforeSend(options.beforeSend);
+    }
+
+    EErrorCode errorCode = EErrorCode::NO_ERROR;
     SentryDSN newDSNStruct;
 
-    errorCode = SentryDSN::parseDSN(dsn, &newDSNStruct);
+    // optional for the transports to a local relay
+    if (dsn != "")
+    {
+        errorCode = SentryDSN::parseDSN(dsn, &newDSNStruct);
+    }
 
     if (errorCode != EErrorCode::NO_ERROR)
     {
         return errorCode;
     }
 
-    m_pHttpClient = std::make_shared<Transport>();
-    m_pHttpClient->start();
+    // forked before the transport thread starts, the handler process sends the crash with a hub of its own
+    if (options.outOfProcessCrashHandler && !m_crashHandler.isRunning())
+    {
+        SentryOptions handlerOptions = options;
+        handlerOptions.outOfProcessCrashHandler = false;
+        handlerOptions.prewarmConnection = false;
+        handlerOptions.ioContext = nullptr;     // not run in the forked process
+        handlerOptions.autoSessionTracking = false;     // the session of the application is ended instead
+        handlerOptions.enableMetrics = false;           // the aggregates are a copy from the fork
+        errorCode = m_crashHandler.start(options.attachStackTrace,
+                                         [dsn, handlerOptions](const json& event, bool crashed, const SessionState& session,
+                                                               SessionAggregator& requestSessions)
+        {
+            Hub handlerHub;
+            if (handlerHub.init(dsn, handlerOptions) == EErrorCode::NO_ERROR)
+            {
+                handlerHub.m_session.restore(session);
+                handlerHub.m_requestSessions = &requestSessions;
+                handlerHub.captureEvent(event);     // counted as an error of the session
+                handlerHub.endSessionsOnExit(crashed);
+                handlerHub.flush(std::chrono::milliseconds(CRASH_HANDLER_UPLOAD_TIMEOUT_MILLISECONDS));
+            }
+        });
+        if (errorCode != EErrorCode::NO_ERROR)
+        {
+            return errorCode;
+        }
+        m_requestSessions = m_crashHandler.requestSessions();
+    }
 
-    errorCode = m_pHttpClient->setupClient(newDSNStruct);
+    // set up before the worker starts, so the worker never sees a half configured transport
+    m_pTransport = Transport::create(options.transport);
+    m_pTransport->setEventLimits(m_eventLimits);
+    m_pTransport->setIoContext(options.ioContext);
+    errorCode = m_pTransport->setup(newDSNStruct, options);
     if (errorCode == EErrorCode::NO_ERROR)
     {
+        m_pTransport->start();
+        m_pTransport->addPeriodicTask(std::chrono::milliseconds(LOG_STAGING_DRAIN_INTERVAL_MILLISECONDS), [this]()
+        {
+            drainStagedLogs();
+            drainSpans();
+            publishScope();
+        });
+        m_pTransport->addPeriodicTask(std::chrono::seconds(SESSION_AGGREGATES_FLUSH_INTERVAL_SECONDS), [this]()
+        {
+            flushSessionAggregates(false);
+        });
+        if (m_metricsEnabled)
+        {
+            MetricsAggregator::instance().enable();
+            m_pTransport->addPeriodicTask(std::chrono::seconds(METRICS_FLUSH_INTERVAL_SECONDS), [this]()
+            {
+                flushMetrics();
+            });
+        }
+        if (m_eventCoalescer.isEnabled())
+        {
+            // a held event waits at most a quarter of the window longer
+            const auto interval = std::max(m_eventCoalescer.window() / 4, std::chrono::milliseconds(10));
+            m_pTransport->addPeriodicTask(interval, [this]()
+            {
+                flushCoalescedEvents(false);
+            });
+        }
+        if (options.statsDumpIntervalSeconds > 0)
+        {
+            m_pTransport->addPeriodicTask(std::chrono::seconds(options.statsDumpIntervalSeconds), []()
+            {
+                logSentryInternal("SdkStats", SdkStats::toJSON(SdkStats::instance().snapshot()).dump());
+            });
+        }
+
         m_initialised = true;
         installHandler();
+
+        if (options.autoSessionTracking)
+        {
+            startSession();
+        }
     }
 
     return errorCode;
@@ -79,14 +240,51 @@ bool Hub::isInitialised()
     return m_initialised;
 }
 
-void Hub::closeHttpConnection()
+void Hub::closeTransport()
+{
+    if (m_pTransport != nullptr)
+    {
+        flushCoalescedEvents(true);     // e.g. the event of a crash, held a moment ago
+        m_pTransport->stop();
+    }
+}
+
+bool Hub::flush(std::chrono::milliseconds timeout)
+{
+    flushCoalescedEvents(true);
+    flushSessionAggregates(true);
+    flushMetrics();
+    drainSpans();
+    return m_pTransport != nullptr && m_pTransport->flush(timeout);
+}
+
+void Hub::publishScope()
+{
+    if (!m_crashHandler.isRunning())
+        return;
+
+    std::string scope;
+    {
+        std::lock_guard<std::mutex> lock(m_scopeMutex);
+        scope = m_scope.serializeEvent(json::object());
+    }
+    m_crashHandler.publishScope(scope);
+}
+
+void Hub::publishSession()
 {
-    if (m_pHttpClient != nullptr)
+    if (m_crashHandler.isRunning())
     {
-        m_pHttpClient->stop();
+        m_crashHandler.publishSession(m_session.state());
     }
 }
 
+std::vector<std::string> Hub::takeCapturedEvents()
+{
+    MemoryTransport* memoryTransport = dynamic_cast<MemoryTransport*>(m_pTransport.get());
+    return (memoryTransport != nullptr) ? memoryTransport->takeEvents() : std::vector<std::string>();
+}
+
 void Hub::setTag(const std::string& key, const std::string& value)
 {
     std::lock_guard<std::mutex> lock(m_scopeMutex);
@@ -106,6 +304,48 @@ void Hub::setExtra(const std::string& key, const std::string& value)
     m_scope.setExtra(key, value);
 }
 
+void Hub::addAttachment(const std::string& path, const std::string& contentType)
+{
+    Attachment attachment;
+    attachment.path = path;
+    const size_t slash = path.find_last_of('/');
+    attachment.filename = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    attachment.contentType = contentType;
+
+    std::lock_guard<std::mutex> lock(m_scopeMutex);
+    m_scope.addAttachment(std::move(attachment));
+}
+
+void Hub::clearAttachments()
+{
+    std::lock_guard<std::mutex> lock(m_scopeMutex);
+    m_scope.clearAttachments();
+}
+
+void Hub::sendEvent(const std::string& eventId, const std::string& contents, std::vector<Attachment> attachments)
+{
+    if (attachments.empty())
+    {
+        m_pTransport->sendEvent(contents);
+    }
+    else
+    {
+        // only the paths are queued, the files are read when the envelope is sent
+        m_pTransport->sendEnvelope(std::make_shared<StreamedEnvelope>(eventId, contents, std::move(attachments)));
+    }
+}
+
+void Hub::addEventProcessor(EventProcessor processor)
+{
+    // the pipeline synchronises itself, scope lock not needed
+    m_scope.addEventProcessor(std::move(processor));
+}
+
+void Hub::addErrorProcessor(EventProcessor processor)
+{
+    m_scope.addErrorProcessor(std::move(processor));
+}
+
 void Hub::installHandler()
 {
     if (default_termination_handler == nullptr)
@@ -119,20 +359,34 @@ void Hub::installHandler()
     }
 
     // TODO - make it controllable in settings which signals to catch?
-    signal(SIGINT, signalsHandler);
-    signal(SIGTERM, signalsHandler);
-    signal(SIGSEGV, signalsHandler);
-    signal(SIGABRT, signalsHandler);
-    signal(SIGBUS, signalsHandler);
-    signal(SIGFPE, signalsHandler);
-    signal(SIGILL, signalsHandler);
+    const int signals[] = {SIGINT, SIGTERM, SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+    if (m_crashHandler.isRunning())
+    {
+        // the context of the signal carries the registers at the fault
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = crashSignalsHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        for (int sig : signals)
+        {
+            sigaction(sig, &action, nullptr);
+        }
+    }
+    else
+    {
+        for (int sig : signals)
+        {
+            signal(sig, signalsHandler);
+        }
+    }
 
 }
 
 // based on https://github.com/nlohmann/crow
 void Hub::terminationHandler()
 {
-    assert(m_hub_that_installed_termination_handler->m_pHttpClient != nullptr);
+    assert(m_hub_that_installed_termination_handler->m_pTransport != nullptr);
 
 #ifdef DEBUG_SENTRYCPP
     LOG_SENTRY_DEBUG("TerminationHandler called!");
@@ -153,11 +407,14 @@ void Hub::terminationHandler()
             json context;
             context["logger"] = "termination_handler";
             m_hub_that_installed_termination_handler->captureException(e, context, false);
+            m_hub_that_installed_termination_handler->m_crashHandler.skipReport();     // of the following abort
         }
     }
 
+    m_hub_that_installed_termination_handler->endSessionsOnExit(true);
+
     //wait for transport to send or sefor some timeout
-    m_hub_that_installed_termination_handler->closeHttpConnection();
+    m_hub_that_installed_termination_handler->closeTransport();
 
     if (m_hub_that_installed_termination_handler->default_termination_handler != nullptr)
         m_hub_that_installed_termination_handler->default_termination_handler();
@@ -165,7 +422,7 @@ void Hub::terminationHandler()
 
 void Hub::signalsHandler(int sig)
 {
-    assert(m_hub_that_installed_termination_handler->m_pHttpClient != nullptr);
+    assert(m_hub_that_installed_termination_handler->m_pTransport != nullptr);
 #ifdef DEBUG_SENTRYCPP
     LOG_SENTRY_DEBUG("Returning to default handler");
 #endif
@@ -180,22 +437,35 @@ void Hub::signalsHandler(int sig)
     LOG_SENTRY_DEBUG(ss.str());
 #endif // DEBUG_SENTRYCPP
 
+    const pid_t crashedThreadId = static_cast<pid_t>(syscall(SYS_gettid));
     json currentAttributes;
     currentAttributes["type"] = sig_name;
+    currentAttributes["thread_id"] = crashedThreadId;
 
     size_t functionsToSkip = 2+1;
-    backtraceHandler bckHandler(m_hub_that_installed_termination_handler->m_isSourceAvailable);
+    const Hub* hub = m_hub_that_installed_termination_handler;
+    backtraceHandler bckHandler(hub->m_isSourceAvailable, hub->m_stackUnwinder, hub->m_maxStackFrames);
     currentAttributes["stacktrace"]["frames"] = bckHandler.getStacktraceJSON(functionsToSkip, 2);
 
     json exceptionInterface;
     exceptionInterface["exception"] = currentAttributes;
+    exceptionInterface["threads"] = ThreadSampler::captureThreads(hub->m_isSourceAvailable, hub->m_stackUnwinder, crashedThreadId);
     exceptionInterface["logger"] = "signals_handler";
     m_hub_that_installed_termination_handler->captureEvent(exceptionInterface);
-    m_hub_that_installed_termination_handler->closeHttpConnection();
+    m_hub_that_installed_termination_handler->endSessionsOnExit(sig != SIGINT && sig != SIGTERM);
+    m_hub_that_installed_termination_handler->closeTransport();
 
     raise(sig);
 }
 
+void Hub::crashSignalsHandler(int sig, siginfo_t* info, void* context)
+{
+    // async-signal-safe only, the heap may be corrupt - the handler process does the rest
+    m_hub_that_installed_termination_handler->m_crashHandler.reportCrash(sig, info, context);
+
+    raise(sig); // delivered with the default action (SA_RESETHAND) once this handler returns
+}
+
 std::string Hub::captureException(const std::exception& exception, const json& context, const bool handled)
 {
 
@@ -214,18 +484,351 @@ std::string Hub::captureException(const std::exception& exception, const json& c
     // module thread_id mechanism stacktrace
 
     size_t functionsToSkip = 6;
-    backtraceHandler bckHandler(m_isSourceAvailable);
-    currentAttributes["stacktrace"]["frames"] = bckHandler.getStacktraceJSON(functionsToSkip, 2);
+    if (m_stackUnwinder == StackUnwinder::EH_FRAME)
+    {
+        Unwinder::refreshModules();     // objects loaded since init
+    }
+    backtraceHandler bckHandler(m_isSourceAvailable, m_stackUnwinder, m_maxStackFrames, true);
+    void* throwStack[THROW_STACK_MAX_FRAMES];
+    const size_t throwStackFrames = ThrowHook::findThrowStack(dynamic_cast<const void*>(&exception), throwStack,
+                                                              std::min(m_maxStackFrames, THROW_STACK_MAX_FRAMES));
+    if (throwStackFrames > 0)
+    {
+        currentAttributes["stacktrace"]["frames"] = bckHandler.getStacktraceJSON(throwStack, throwStackFrames, 0, 2);
+    }
+    else
+    {
+        currentAttributes["stacktrace"]["frames"] = bckHandler.getStacktraceJSON(functionsToSkip, 2);
+    }
 
     json exceptionInterface;
     if (context != nullptr)
     {
         exceptionInterface = context;
     }
-    exceptionInterface["exception"] = currentAttributes;
+    exceptionInterface["exception"] = std::move(currentAttributes);
     return captureEvent(exceptionInterface);
 }
 
+std::string Hub::captureHangSnapshot(const std::string& message)
+{
+    json event;
+    event["message"] = message;     // repeated snapshots are limited like other repeated messages
+    event["level"] = "warning";
+    event["logger"] = "hang_snapshot";
+    if (m_stackUnwinder == StackUnwinder::EH_FRAME)
+    {
+        Unwinder::refreshModules();
+    }
+    event["threads"] = ThreadSampler::captureThreads(m_isSourceAvailable, m_stackUnwinder);
+    return captureEvent(event);
+}
+
+Span Hub::startTransaction(const std::string& name, const char* operation)
+{
+    if (!m_initialised || static_cast<int>(SpanRecorder::nextId() % 100) >= m_tracesSampleRate)
+        return Span();
+
+    const uint64_t transactionId = SpanRecorder::nextId();
+    Span transaction(transactionId, transactionId, 0, operation, nullptr);
+    const bool profiled = static_cast<int>(SpanRecorder::nextId() % 100) < m_profilesSampleRate
+                          && Profiler::instance().start(transaction.m_startNanoseconds, m_profilingFrequencyHz,
+                                                        m_stackUnwinder);
+
+    SpanRecord record = {};
+    record.start = new TransactionStart{this, name, SpanRecorder::nextId(), SpanRecorder::nextId(),
+                                        transaction.m_startNanoseconds, SpanRecorder::wallNanoseconds(),
+                                        static_cast<pid_t>(syscall(SYS_gettid)), profiled};
+    record.transactionId = transactionId;
+    SpanRecorder::instance().record(std::move(record));
+
+    return transaction;
+}
+
+void Hub::startSession()
+{
+    if (!m_initialised)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    if (m_session.isActive())
+    {
+        sendSessionUpdate(m_session.update("exited", m_sessionAttributes));
+    }
+    m_session.start(generateUuid());
+    sendSessionUpdate(m_session.update("ok", m_sessionAttributes));
+    publishSession();
+}
+
+void Hub::endSession()
+{
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    if (m_session.isActive())
+    {
+        sendSessionUpdate(m_session.update("exited", m_sessionAttributes));
+        publishSession();
+    }
+}
+
+RequestSession Hub::startRequestSession()
+{
+    if (!m_initialised)
+        return RequestSession();
+
+    m_requestSessions->startRequest();
+    return RequestSession(this);
+}
+
+void Hub::endRequestSession(RequestOutcome outcome)
+{
+    m_requestSessions->endRequest(outcome);
+}
+
+void Hub::countSessionError(const json& event)
+{
+    auto level = event.find("level");
+    const bool error = event.find("exception") != event.end()
+                       || (level != event.end() && (*level == "error" || *level == "fatal"));
+    if (!error)
+        return;
+
+    SessionAggregator::threadErrors()++;
+
+    std::lock_guard<std::mutex> lock(m_sessionMutex);
+    if (m_session.addError())
+    {
+        sendSessionUpdate(m_session.update("ok", m_sessionAttributes));
+    }
+    if (m_session.isActive())
+    {
+        publishSession();
+    }
+}
+
+void Hub::endSessionsOnExit(bool crashed)
+{
+    {
+        // the crashing thread may hold the lock - the update is skipped rather than deadlock
+        std::unique_lock<std::mutex> lock(m_sessionMutex, std::try_to_lock);
+        if (lock.owns_lock() && m_session.isActive())
+        {
+            sendSessionUpdate(m_session.update(crashed ? "crashed" : "exited", m_sessionAttributes));
+        }
+    }
+
+    if (crashed)
+    {
+        m_requestSessions->crashOpenRequests();
+    }
+    flushSessionAggregates(true);
+}
+
+void Hub::sendSessionUpdate(const json& payload)
+{
+    if (m_pTransport == nullptr)
+        return;
+
+    Envelope envelope("");
+    envelope.addItem("session", payload.dump());
+
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG(envelope.serialized());
+#endif // DEBUG_SENTRYCPP
+
+    SdkStats::instance().add(StatCounter::SESSION_UPDATES_SENT);
+    m_pTransport->sendEvent(envelope.take());
+}
+
+void Hub::flushSessionAggregates(bool includeCurrent)
+{
+    uint64_t requests = 0;
+    json aggregates = m_requestSessions->take(includeCurrent, requests);
+    if (aggregates.empty() || m_pTransport == nullptr)
+        return;
+
+    json payload;
+    payload["aggregates"] = std::move(aggregates);
+    payload["attrs"] = m_sessionAttributes;
+
+    Envelope envelope("");
+    envelope.addItem("sessions", payload.dump());
+
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG(envelope.serialized());
+#endif // DEBUG_SENTRYCPP
+
+    SdkStats::instance().add(StatCounter::REQUEST_SESSIONS_SENT, requests);
+    m_pTransport->sendEvent(envelope.take());
+}
+
+void Hub::flushMetrics()
+{
+    if (!m_metricsEnabled || m_pTransport == nullptr)
+        return;
+
+    // one bucket per flush, timestamped with the start of its interval
+    const int64_t now = static_cast<int64_t>(time(nullptr));
+    const int64_t timestamp = now - now % METRICS_FLUSH_INTERVAL_SECONDS;
+
+    size_t lines = 0;
+    std::string payload = MetricsAggregator::instance().collect(timestamp, m_metricsTags, lines);
+    if (lines == 0)
+        return;
+
+    Envelope envelope("");
+    envelope.addItem("statsd", payload);
+
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG(envelope.serialized());
+#endif // DEBUG_SENTRYCPP
+
+    SdkStats::instance().add(StatCounter::METRICS_SENT, lines);
+    m_pTransport->sendEvent(envelope.take());
+}
+
+bool Hub::holdEvent(uint64_t fingerprint, std::string& eventId, const std::string& timestamp, json payload)
+{
+    EventCoalescer::HeldEvent held;
+    {
+        std::lock_guard<std::mutex> lock(m_scopeMutex);
+        m_scope.applyToEvent(payload);
+        held.attachments = m_scope.getAttachments();
+    }
+
+    const EventProcessorPipeline& processors = m_scope.getEventProcessors();
+    if (!processors.empty() && !m_processEventsOnTransportThread && !processors.apply(payload))
+    {
+#ifdef DEBUG_SENTRYCPP
+        LOG_SENTRY_DEBUG("Event dropped by event processor.");
+#endif // DEBUG_SENTRYCPP
+        SdkStats::instance().add(StatCounter::EVENTS_DROPPED);
+        return false;
+    }
+
+    held.eventId = eventId;
+    held.payload = std::move(payload);
+    held.firstSeen = timestamp;
+    held.lastSeen = timestamp;
+    if (!m_eventCoalescer.hold(fingerprint, held, eventId))
+    {
+        sendCoalescedEvent(held);
+    }
+    return true;
+}
+
+void Hub::flushCoalescedEvents(bool includeOpen)
+{
+    if (m_pTransport == nullptr)
+        return;
+
+    std::vector<EventCoalescer::HeldEvent> events = m_eventCoalescer.take(includeOpen);
+    for (EventCoalescer::HeldEvent& event : events)
+    {
+        sendCoalescedEvent(event);
+    }
+}
+
+void Hub::sendCoalescedEvent(EventCoalescer::HeldEvent& event)
+{
+    // serialized on the transport thread, as are the events processed there
+    EventProcessor processor = nullptr;
+    const EventProcessorPipeline& processors = m_scope.getEventProcessors();
+    if (m_processEventsOnTransportThread && !processors.empty())
+    {
+        processor = [&processors](json& eventToProcess) { return processors.apply(eventToProcess); };
+    }
+    m_pTransport->sendEvent(std::move(event.payload), processor, std::move(event.attachments));
+}
+
+void Hub::drainSpans()
+{
+    // keeps the ring of the profiler from filling up during long transactions
+    Profiler::instance().collectSamples();
+
+    SpanRecorder::instance().drain([](FinishedTransaction& finished)
+    {
+        finished.hub->sendTransaction(finished);
+    });
+}
+
+void Hub::sendTransaction(FinishedTransaction& finished)
+{
+    json profile;
+    if (finished.start->profiled)
+    {
+        profile = Profiler::instance().finish(finished.start->steadyNanoseconds, finished.endNanoseconds);
+    }
+    if (m_pTransport == nullptr)
+        return;
+
+    json& transaction = finished.transaction;
+    const std::string eventId = generateUuid();
+    transaction["event_id"] = eventId;
+    transaction["platform"] = "other";
+
+    json profileItem;
+    if (!profile.is_null())
+    {
+        profileItem = createProfileItem(finished, eventId, std::move(profile));
+        transaction["contexts"]["profile"] = {{"profile_id", profileItem["event_id"]}};
+    }
+
+    std::string payload;
+    {
+        ScopedStatTimer timer(StatCounter::SERIALIZATIONS, StatCounter::SERIALIZATION_TIME_NS);
+        std::lock_guard<std::mutex> lock(m_scopeMutex);
+        payload = m_scope.serializeEvent(transaction);
+    }
+
+    Envelope envelope(eventId);
+    envelope.addItem("transaction", payload);
+    if (!profileItem.is_null())
+    {
+        envelope.addItem("profile", profileItem.dump());
+        SdkStats::instance().add(StatCounter::PROFILES_SENT);
+    }
+
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG(envelope.serialized());
+#endif // DEBUG_SENTRYCPP
+
+    SdkStats::instance().add(StatCounter::TRANSACTIONS_SENT);
+    m_pTransport->sendEvent(envelope.take());
+}
+
+json Hub::createProfileItem(const FinishedTransaction& finished, const std::string& transactionId, json profile)
+{
+    const TransactionStart& start = *finished.start;
+
+    time_t startSeconds = static_cast<time_t>(start.wallNanoseconds / 1000000000);
+    char timestamp[sizeof("2011-10-08T07:07:09Z")];
+    strftime(timestamp, sizeof(timestamp), "%FT%TZ", gmtime(&startSeconds));
+
+    struct utsname system;
+    uname(&system);
+
+    json item;
+    item["event_id"] = generateUuid();
+    item["version"] = "1";
+    item["platform"] = "other";
+    item["timestamp"] = timestamp;
+    item["os"] = {{"name", system.sysname}, {"version", system.release}};
+    item["device"] = {{"architecture", system.machine}};
+    {
+        std::lock_guard<std::mutex> lock(m_scopeMutex);
+        if (m_scope.getRelease() != "")
+        {
+            item["release"] = m_scope.getRelease();
+        }
+    }
+    item["transaction"] = {{"id", transactionId},
+                           {"name", start.name},
+                           {"trace_id", finished.transaction["contexts"]["trace"]["trace_id"]},
+                           {"active_thread_id", std::to_string(start.threadId)}};
+    item["profile"] = std::move(profile);
+    return item;
+}
+
 //std::string Hub::captureMessage()
 //{
 //    // TODO
@@ -234,11 +837,32 @@ std::string Hub::captureException(const std::exception& exception, const json& c
 
 std::string Hub::captureEvent(const json& event)
 {
-    std::string eventId = generateUuid();
-    m_lastEventId = eventId;
+    SdkStats& stats = SdkStats::instance();
+    stats.add(StatCounter::EVENTS_CAPTURED);
+
+    // before sampling and rate limiting, the session saw the error either way
+    countSessionError(event);
+
+    // the event should carry the log lines preceding it
+    drainStagedLogs();
+
     std::string timestamp = ISO8601_timestamp();
 
-    if (event.find("message") != event.end())
+    uint64_t fingerprint = 0;
+    if (m_eventCoalescer.isEnabled())
+    {
+        // a repeat only counts into the event held since its first occurrence, which is the one sent
+        fingerprint = EventCoalescer::fingerprint(event);
+        std::string heldEventId;
+        if (m_eventCoalescer.addOccurrence(fingerprint, timestamp, heldEventId))
+        {
+            stats.add(StatCounter::EVENTS_COALESCED);
+            addBreadcrumb(event);
+            m_lastEventId = heldEventId;
+            return heldEventId;
+        }
+    }
+    else if (event.find("message") != event.end())
     {
         if (checkIfEventTooOften(event, timestamp))
         {
@@ -246,28 +870,94 @@ std::string Hub::captureEvent(const json& event)
         LOG_SENTRY_DEBUG("Dropping the event because happens too often.");
     #endif // DEBUG_SENTRYCPP
 
+            stats.add(StatCounter::EVENTS_RATE_LIMITED);
             return "";
         }
     }
 
-    json payload = event;
-    payload["event_id"] = eventId;
-    payload["timestamp"] = timestamp;
-    payload["platform"] = "other";   // or undefined?
+    std::string eventId = generateUuid();
+    m_lastEventId = eventId;
 
-    m_scope.applyToEvent(payload);  // includes breadcrumbs etc.
+    // apply event sampling before paying for processing and serialization
+    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    const bool sampled = (std::rand()%100 < m_sampleRate);
 
-    const std::string contentsToSend = payload.dump();
+    if (!sampled)
+    {
+        stats.add(StatCounter::EVENTS_SAMPLED_OUT);
+    }
+    else
+    {
+        json payload = event;
+        payload["event_id"] = eventId;
+        payload["timestamp"] = timestamp;
+        payload["platform"] = "other";   // or undefined?
+
+        const EventProcessorPipeline& processors = m_scope.getEventProcessors();
+        std::vector<Attachment> attachments;
+        if (m_eventCoalescer.isEnabled())
+        {
+            if (!holdEvent(fingerprint, eventId, timestamp, std::move(payload)))
+                return "";
+            m_lastEventId = eventId;
+        }
+        else if (processors.empty())
+        {
+            // nothing needs the typed event - splice the cached scope fragments straight into the output
+            std::string contentsToSend;
+            {
+                ScopedStatTimer timer(StatCounter::SERIALIZATIONS, StatCounter::SERIALIZATION_TIME_NS);
+                std::lock_guard<std::mutex> lock(m_scopeMutex);
+                contentsToSend = m_scope.serializeEvent(payload);
+                attachments = m_scope.getAttachments();
+            }
 
 #ifdef DEBUG_SENTRYCPP
-    LOG_SENTRY_DEBUG(contentsToSend);
+            LOG_SENTRY_DEBUG(contentsToSend);
 #endif // DEBUG_SENTRYCPP
 
-    // apply event sampling
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
-    if (std::rand()%100 < m_sampleRate)
-    {
-        m_pHttpClient->sendEvent(contentsToSend);
+            sendEvent(eventId, contentsToSend, std::move(attachments));
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_scopeMutex);
+                m_scope.applyToEvent(payload);  // includes breadcrumbs etc.
+                attachments = m_scope.getAttachments();
+            }
+
+            if (m_processEventsOnTransportThread)
+            {
+                // processors and serialization run on the transport worker,
+                // an event dropped by a processor still gets its id returned here
+                m_pTransport->sendEvent(std::move(payload),
+                                         [&processors](json& eventToProcess) { return processors.apply(eventToProcess); },
+                                         std::move(attachments));
+            }
+            else
+            {
+                if (!processors.apply(payload))
+                {
+#ifdef DEBUG_SENTRYCPP
+                    LOG_SENTRY_DEBUG("Event dropped by event processor.");
+#endif // DEBUG_SENTRYCPP
+                    stats.add(StatCounter::EVENTS_DROPPED);
+                    return "";
+                }
+
+                std::string contentsToSend;
+                {
+                    ScopedStatTimer timer(StatCounter::SERIALIZATIONS, StatCounter::SERIALIZATION_TIME_NS);
+                    contentsToSend = EventSerializer::serializeEvent(payload, m_eventLimits);
+                }
+
+#ifdef DEBUG_SENTRYCPP
+                LOG_SENTRY_DEBUG(contentsToSend);
+#endif // DEBUG_SENTRYCPP
+
+                sendEvent(eventId, contentsToSend, std::move(attachments));
+            }
+        }
     }
 
     addBreadcrumb(event);
@@ -277,52 +967,97 @@ std::string Hub::captureEvent(const json& event)
 
 void Hub::addBreadcrumb(const json& attributes)
 {
-    std::string timestamp = ISO8601_timestamp();
     // default bredcrumb:
-    json breadcrumb =
-    {{"timestamp", timestamp},
-     {"type", "default"},
-     {"level", "info"}
-    };
+    static const InternedString defaultType("default");
+    static const InternedString defaultLevel(levelToString(EventLevel::LEVEL_INFO));
+
+    Breadcrumb breadcrumb;
+    breadcrumb.type = defaultType;
+    breadcrumb.level = defaultLevel;
 
     if (attributes.is_object())
     {
         // type
         auto type = attributes.find("type");
-        if (type != attributes.end())
+        if (type != attributes.end() && type->is_string())
         {
-            breadcrumb["type"] = *type;
+            breadcrumb.type = InternedString(type->get<std::string>());
         }
         // level
         auto level = attributes.find("level");
-        if (level != attributes.end())
+        if (level != attributes.end() && level->is_string())
         {
-            breadcrumb["level"] = *level;
-        }
-        // category
-        auto category = attributes.find("category");
-        if (category != attributes.end())
-        {
-            breadcrumb["category"] = *category;
+            breadcrumb.level = InternedString(level->get<std::string>());
         }
+        // category - always overwritten with level below
         // data
         auto data = attributes.find("data");
         if (data != attributes.end())
         {
-            breadcrumb["data"] = *data;
+            breadcrumb.data = *data;
         }
         auto message = attributes.find("message");
         if (message != attributes.end())
         {
-            breadcrumb["message"] = *message;
+            breadcrumb.message = message->is_string() ? message->get<std::string>() : message->dump();
         }
     }// else nothing (adds default)
 
-    // always the same as level
-    breadcrumb["category"] = breadcrumb["level"];
+    addBreadcrumb(std::move(breadcrumb));
+}
+
+void Hub::addBreadcrumb(Breadcrumb breadcrumb)
+{
+    if (breadcrumb.timestamp == 0)
+    {
+        breadcrumb.timestamp = time(nullptr);    // formatted when serialized
+    }
+    // the same as level, unless set (to the logger name) by the log sinks
+    if (breadcrumb.category.empty())
+    {
+        breadcrumb.category = breadcrumb.level;
+    }
+
+    std::lock_guard<std::mutex> lock(m_scopeMutex);
+    m_scope.addBreadcrumb(std::move(breadcrumb));
+}
+
+void Hub::drainStagedLogs()
+{
+    static const InternedString logType("default");
+    static const InternedString logLevels[] =
+    {
+        InternedString(levelToString(EventLevel::LEVEL_DEBUG)),
+        InternedString(levelToString(EventLevel::LEVEL_INFO)),
+        InternedString(levelToString(EventLevel::LEVEL_WARNING)),
+        InternedString(levelToString(EventLevel::LEVEL_ERROR)),
+        InternedString(levelToString(EventLevel::LEVEL_FATAL)),
+    };
+
+    std::vector<Breadcrumb> breadcrumbs;
+    LogStaging::instance().drain([&breadcrumbs](const StagedLog& log, size_t repetitions)
+    {
+        Breadcrumb breadcrumb;
+        breadcrumb.timestamp = log.timestamp;
+        breadcrumb.type = logType;
+        breadcrumb.level = logLevels[static_cast<int>(log.level) - static_cast<int>(EventLevel::LEVEL_DEBUG)];
+        breadcrumb.category = log.logger.empty() ? breadcrumb.level : log.logger;
+        breadcrumb.message = log.message;
+        if (repetitions > 1)
+        {
+            breadcrumb.data = {{"count", repetitions}};
+        }
+        breadcrumbs.push_back(std::move(breadcrumb));
+    });
+
+    if (breadcrumbs.empty())
+        return;
 
     std::lock_guard<std::mutex> lock(m_scopeMutex);
-    m_scope.addBreadcrumb(breadcrumb);
+    for (auto& breadcrumb : breadcrumbs)
+    {
+        m_scope.addBreadcrumb(std::move(breadcrumb));
+    }
 }
 
 const std::string& Hub::lastEventId()
@@ -364,8 +1099,8 @@ void Hub::timeFromISO6801String(const std::string& timestamp, struct tm &timesta
 
 bool Hub::isTimeDiffGreaterThan(const std::string& timestamp1, const std::string& timestamp2, double diffInSeconds)
 {
-    struct tm timeS1;
-    struct tm timeS2;
+    struct tm timeS1 = {};
+    struct tm timeS2 = {};
     timeFromISO6801String(timestamp1, timeS1);
     timeFromISO6801String(timestamp2, timeS2);
     time_t time1 = mktime(&timeS1);
@@ -396,16 +1131,19 @@ void Hub::removeOldEventsFromList()
 {
     std::string currTime = ISO8601_timestamp();
     std::lock_guard<std::mutex> lock(m_lastEventsListMutex);
-    for (auto const& entry : m_listOfLastUniqueEventsWithTimestamps)
+    for (auto entry = m_listOfLastUniqueEventsWithTimestamps.begin(); entry != m_listOfLastUniqueEventsWithTimestamps.end();)
     {
-        bool oldEnoughToRemove = isTimeDiffGreaterThan(entry.second,
+        bool oldEnoughToRemove = isTimeDiffGreaterThan(entry->second,
                                                        currTime,
                                                        m_maxEventsRepetitionIntervalInSeconds);
         if (oldEnoughToRemove)
         {
-            m_listOfLastUniqueEventsWithTimestamps.erase(entry.first);
+            entry = m_listOfLastUniqueEventsWithTimestamps.erase(entry);
+        }
+        else
+        {
+            ++entry;
         }
-        // else nothing
     }
 }
 
@@ -2,18 +2,33 @@
 #define SENTRY_HUB_H
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <string>
+#include <vector>
 
+#include "crashhandler.h"
+#include "eventcoalescer.h"
 #include "json.h"
 #include "scope.h"
+#include "sentry.h"
 #include "sentry_common.h"
+#include "session.h"
+#include "spanrecorder.h"
 #include "transport.h"
 
 using json = ::nlohmann::json;
 
+namespace
+{
+constexpr unsigned int LOG_STAGING_DRAIN_INTERVAL_MILLISECONDS = 1000;
+}
+
 namespace Sentry
 {
 
+class HubBenchmark;     // benchmarks measure private hot paths
+
 class Hub
 {
 public:
@@ -21,7 +36,7 @@ public:
     Hub();
     ~Hub();
 
-    EErrorCode init(const std::string dsn, int maxBreadcrumbs=-1, bool sourceAvailable=false, int sampleRate=100);
+    EErrorCode init(const std::string dsn, const SentryOptions& options);
 
     bool isInitialised();
 
@@ -30,27 +45,83 @@ public:
     //std::string captureMessage();
 
     std::string captureEvent(const json& event);
+    std::string captureHangSnapshot(const std::string& message);
+
+    // not recording when sampled out, see SentryOptions::tracesSampleRate
+    Span startTransaction(const std::string& name, const char* operation);
+
+    // the session of the application, see Sentry::startSession
+    void startSession();
+    void endSession();
+
+    RequestSession startRequestSession();
+    void endRequestSession(RequestOutcome outcome);
 
     void setTag(const std::string& key, const std::string& value);
     void setExtra(const std::string& key, const std::string& value);
 
+    // see Sentry::addAttachment
+    void addAttachment(const std::string& path, const std::string& contentType);
+    void clearAttachments();
+
     void addBreadcrumb(const json& attributes); // hint)? Adds a breadcrumb to the current scope.
+    void addBreadcrumb(Breadcrumb breadcrumb);
+    // moves the log lines staged by the log sinks to the scope, in a single lock acquisition
+    void drainStagedLogs();
+
+    void addEventProcessor(EventProcessor processor);
+    void addErrorProcessor(EventProcessor processor);
 
     const std::string& lastEventId();
 
+    bool flush(std::chrono::milliseconds timeout);
+    // empty unless the MEMORY transport is used
+    std::vector<std::string> takeCapturedEvents();
+
     static void signalsHandler(int sig);
+    static void crashSignalsHandler(int sig, siginfo_t* info, void* context);   // with the out-of-process handler
     static void terminationHandler();
 
     void installHandler();
 
 private:
 
+    friend class HubBenchmark;
+
     Hub(const Hub&) = delete;
     Hub& operator=(const Hub&) = delete;
     Hub(const Hub&&) = delete;
     Hub&& operator=(const Hub&&) = delete;
 
-    void closeHttpConnection();
+    void closeTransport();
+    // a serialized event, in a StreamedEnvelope when it has attachments
+    void sendEvent(const std::string& eventId, const std::string& contents, std::vector<Attachment> attachments);
+    // for the out-of-process crash handler
+    void publishScope();
+    // called with m_sessionMutex held
+    void publishSession();
+
+    // sends the transactions finished since the last drain, of any hub
+    void drainSpans();
+    void sendTransaction(FinishedTransaction& finished);
+    json createProfileItem(const FinishedTransaction& finished, const std::string& transactionId, json profile);
+
+    void sendSessionUpdate(const json& payload);
+    // counts an error event into the session of the application and the request session of the thread
+    void countSessionError(const json& event);
+    // from the signal and termination handlers
+    void endSessionsOnExit(bool crashed);
+    // sends the completed minutes of the request session aggregates, all of them with includeCurrent
+    void flushSessionAggregates(bool includeCurrent);
+    // sends the metrics recorded since the last flush, see SentryOptions::enableMetrics
+    void flushMetrics();
+    // applies the scope (and the processors, unless they run on the transport thread) and holds the event,
+    // sent right away when too many are held; false when a processor dropped it. eventId is set to the id
+    // of the held event, another thread may have held one with the same fingerprint meanwhile
+    bool holdEvent(uint64_t fingerprint, std::string& eventId, const std::string& timestamp, json payload);
+    // sends the held events whose window ended, all of them with includeOpen
+    void flushCoalescedEvents(bool includeOpen);
+    void sendCoalescedEvent(EventCoalescer::HeldEvent& event);
 
     std::string generateUuid();
     std::string ISO8601_timestamp();
@@ -63,6 +134,9 @@ private:
     std::atomic_bool m_initialised;
 
     int m_sampleRate;
+    int m_tracesSampleRate;
+    int m_profilesSampleRate;
+    int m_profilingFrequencyHz;
     std::terminate_handler default_termination_handler = nullptr;
     static Hub* m_hub_that_installed_termination_handler;
 
@@ -72,11 +146,27 @@ private:
     // <message, timestamp>
     std::multimap<std::string, std::string> m_listOfLastUniqueEventsWithTimestamps;
 
-    std::shared_ptr<Transport> m_pHttpClient;
+    std::shared_ptr<Transport> m_pTransport;
     Scope m_scope;
     mutable std::mutex m_scopeMutex;
 
+    CrashHandler m_crashHandler;
+
+    Session m_session;
+    std::mutex m_sessionMutex;
+    SessionAggregator m_sessionAggregator;
+    SessionAggregator* m_requestSessions;   // m_sessionAggregator, or the one shared with the crash handler process
+    json m_sessionAttributes;   // release and environment
+
+    bool m_metricsEnabled;
+    metrics::Tags m_metricsTags;    // added to every metric: release and environment
+
     bool m_isSourceAvailable;
+    bool m_processEventsOnTransportThread;
+    StackUnwinder m_stackUnwinder;
+    size_t m_maxStackFrames;
+    EventLimits m_eventLimits;
+    EventCoalescer m_eventCoalescer;    // see SentryOptions::coalesceWindowMilliseconds
 
     size_t m_maxEventsPerInterval = 3;                      // send max identical 3 events
     size_t m_maxEventsRepetitionIntervalInSeconds = 3600;   // per 1 hour
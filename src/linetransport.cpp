@@ -0,0 +1,291 @@
+#include "sentry_common.h"
+#include "linetransport.h"
+#include "sigpipeguard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace
+{
+constexpr size_t LINE_FILE_BUFFER_SIZE = 64 * 1024;
+constexpr size_t SENDFILE_MAX_BYTES = 1024 * 1024 * 1024;   // per call, the kernel takes less than 2 GiB
+}
+
+namespace Sentry
+{
+
+LineTransport::LineTransport()
+:
+Transport(),
+m_path(),
+m_descriptor(-1),
+m_descriptorIsSocket(false),
+m_fileBuffer()
+{
+
+}
+
+LineTransport::~LineTransport()
+{
+    stop();
+    closeDescriptor();
+}
+
+EErrorCode LineTransport::setup(const SentryDSN&, const SentryOptions& options)
+{
+    if (!isValidPath(options.transportPath))
+    {
+        return EErrorCode::WRONG_TRANSPORT_PATH;
+    }
+    m_path = options.transportPath;
+    return EErrorCode::NO_ERROR;
+}
+
+bool LineTransport::isValidPath(const std::string& path) const
+{
+    return !path.empty();
+}
+
+void LineTransport::send(const std::string& contents, unsigned int attempt)
+{
+    bool written = prepareDescriptor();
+    if (written)
+    {
+        // a socket is written with MSG_NOSIGNAL
+        std::optional<SigpipeGuard> sigpipeGuard;
+        if (!m_descriptorIsSocket)
+        {
+            sigpipeGuard.emplace();
+        }
+        written = writeLine(contents);
+    }
+    if (!written)
+    {
+        handleWriteError();
+        handleSendFailure(contents, attempt);
+        return;
+    }
+
+    handleSendSuccess(contents.size());
+}
+
+void LineTransport::sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt)
+{
+    const OpenedEnvelope opened(*envelope);
+    const SigpipeGuard sigpipeGuard;    // sendfile, to a socket too
+    if (!prepareDescriptor() || !writeEnvelope(opened))
+    {
+        handleWriteError();
+        handleSendFailure(envelope, attempt);
+        return;
+    }
+
+    handleSendSuccess(opened);
+}
+
+bool LineTransport::prepareDescriptor()
+{
+    if (m_descriptor < 0)
+    {
+        m_descriptor = openDescriptor(m_path);
+        struct stat status;
+        m_descriptorIsSocket = m_descriptor >= 0 && fstat(m_descriptor, &status) == 0 && S_ISSOCK(status.st_mode);
+    }
+    return m_descriptor >= 0;
+}
+
+void LineTransport::handleWriteError()
+{
+#ifdef DEBUG_SENTRYCPP
+    LOG_SENTRY_DEBUG("Could not write event to " + m_path + ": " + std::strerror(errno));
+#endif
+    closeDescriptor();
+    handleConnectionError();
+}
+
+bool LineTransport::writeLine(const std::string& contents)
+{
+    char newline = '\n';
+    struct iovec parts[2] = {{const_cast<char*>(contents.data()), contents.size()}, {&newline, 1}};
+    int part = 0;
+
+    // one writev for both, a partial write continues where it stopped
+    while (part < 2)
+    {
+        const ssize_t written = writeParts(parts + part, 2 - part);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        while (part < 2 && remaining >= parts[part].iov_len)
+        {
+            remaining -= parts[part].iov_len;
+            part++;
+        }
+        if (part < 2)
+        {
+            parts[part].iov_base = static_cast<char*>(parts[part].iov_base) + remaining;
+            parts[part].iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+ssize_t LineTransport::writeParts(const iovec* parts, int count)
+{
+    if (m_descriptorIsSocket)
+    {
+        struct msghdr message = {};
+        message.msg_iov = const_cast<iovec*>(parts);
+        message.msg_iovlen = static_cast<size_t>(count);
+        return sendmsg(m_descriptor, &message, MSG_NOSIGNAL);
+    }
+    return writev(m_descriptor, parts, count);
+}
+
+bool LineTransport::writeEnvelope(const OpenedEnvelope& envelope)
+{
+    for (const EnvelopePart& part : envelope.parts())
+    {
+        if (!writeAll(part.data.data(), part.data.size()) || !writeFile(part.descriptor, part.offset, part.length))
+            return false;
+    }
+    return writeAll("\n", 1);
+}
+
+bool LineTransport::writeAll(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t written = m_descriptorIsSocket ? ::send(m_descriptor, data, size, MSG_NOSIGNAL)
+                                                     : write(m_descriptor, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool LineTransport::writeFile(int descriptor, off_t offset, uint64_t length)
+{
+    // from the page cache to the descriptor, not copied in the process
+    while (length > 0)
+    {
+        const ssize_t sent = sendfile(m_descriptor, descriptor, &offset,
+                                      static_cast<size_t>(std::min<uint64_t>(length, SENDFILE_MAX_BYTES)));
+        if (sent > 0)
+        {
+            length -= static_cast<uint64_t>(sent);
+            continue;
+        }
+        if (sent == 0)
+        {
+            errno = ENODATA;    // the file is shorter than when it was opened
+            return false;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno != EINVAL && errno != ENOSYS)
+            return false;
+
+        // not supported by the descriptor (e.g. O_APPEND), through a buffer
+        if (m_fileBuffer.empty())
+        {
+            m_fileBuffer.resize(LINE_FILE_BUFFER_SIZE);
+        }
+        while (length > 0)
+        {
+            const ssize_t bytesRead = pread(descriptor, m_fileBuffer.data(),
+                                            static_cast<size_t>(std::min<uint64_t>(length, m_fileBuffer.size())), offset);
+            if (bytesRead < 0 && errno == EINTR)
+                continue;
+            if (bytesRead <= 0)
+            {
+                errno = (bytesRead == 0) ? ENODATA : errno;
+                return false;
+            }
+            if (!writeAll(m_fileBuffer.data(), static_cast<size_t>(bytesRead)))
+                return false;
+            offset += bytesRead;
+            length -= static_cast<uint64_t>(bytesRead);
+        }
+    }
+    return true;
+}
+
+void LineTransport::closeDescriptor()
+{
+    if (m_descriptor >= 0)
+    {
+        close(m_descriptor);
+        m_descriptor = -1;
+    }
+}
+
+FileTransport::~FileTransport()
+{
+    // the worker calls openDescriptor
+    stop();
+}
+
+int FileTransport::openDescriptor(const std::string& path)
+{
+    // O_NONBLOCK only for opening: a named pipe without a reader fails (ENXIO) instead of blocking the worker
+    const int descriptor = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC | O_NONBLOCK, 0644);
+    if (descriptor >= 0)
+    {
+        fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) & ~O_NONBLOCK);
+    }
+    return descriptor;
+}
+
+UnixSocketTransport::~UnixSocketTransport()
+{
+    // the worker calls openDescriptor
+    stop();
+}
+
+int UnixSocketTransport::openDescriptor(const std::string& path)
+{
+    const int descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (descriptor < 0)
+        return -1;
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    if (connect(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        const int error = errno;
+        close(descriptor);
+        errno = error;
+        return -1;
+    }
+    return descriptor;
+}
+
+bool UnixSocketTransport::isValidPath(const std::string& path) const
+{
+    return !path.empty() && path.size() < sizeof(sockaddr_un::sun_path);
+}
+
+} // namespace Sentry
@@ -0,0 +1,102 @@
+#ifndef SENTRY_LINETRANSPORT_H
+#define SENTRY_LINETRANSPORT_H
+
+#include "transport.h"
+
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+
+/*
+ * Transports for a local relay or sidecar: every event is written as one line, the JSON body of the store endpoint
+ * followed by '\n' (the JSON itself never contains a raw newline). The relay adds the DSN and ships the events.
+ * Envelopes (transactions) are written as they are, followed by '\n': the envelope header (with "sent_at",
+ * an event never has it), then an item header and a payload line per item - every line is JSON, except
+ * the payloads of attachments: the bytes of their files, as many as the length in the item header.
+ * Attachments are copied from the files with sendfile (or through a buffer of a fixed size where it can not
+ * write, e.g. to a file opened for appending).
+ *
+ * A relay that went away must not kill the process with SIGPIPE: sockets are written with MSG_NOSIGNAL, writes to
+ * a pipe and sendfile (which have no such flag) run under a SigpipeGuard - the signal mask of the thread running
+ * the worker (a thread of the application, with SentryOptions::ioContext) is restored after each event.
+ *
+ * The descriptor is opened with the first event and reopened after a write error, with the backoff of
+ * connection errors. An event interrupted by an error is written again whole, so the relay may see
+ * a truncated line before it.
+ */
+
+namespace Sentry
+{
+
+class LineTransport : public Transport
+{
+public:
+
+    ~LineTransport() override;
+
+    // SentryOptions::transportPath is required
+    EErrorCode setup(const SentryDSN& dsn, const SentryOptions& options) override;
+
+protected:
+
+    LineTransport();
+
+    void send(const std::string& contents, unsigned int attempt) override;
+    void sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt) override;
+
+    // the descriptor to write the events to, -1 on failure
+    virtual int openDescriptor(const std::string& path) = 0;
+    virtual bool isValidPath(const std::string& path) const;
+
+private:
+
+    // opens the descriptor when closed, false on failure
+    bool prepareDescriptor();
+    // closes the descriptor after a failed write, it is opened again after the backoff
+    void handleWriteError();
+
+    bool writeLine(const std::string& contents);
+    // writev, or sendmsg with MSG_NOSIGNAL to a socket
+    ssize_t writeParts(const iovec* parts, int count);
+    bool writeEnvelope(const OpenedEnvelope& envelope);
+    bool writeAll(const char* data, size_t size);
+    bool writeFile(int descriptor, off_t offset, uint64_t length);
+    void closeDescriptor();
+
+    std::string m_path;
+    int m_descriptor;
+    bool m_descriptorIsSocket;
+    std::vector<char> m_fileBuffer;     // for the files sendfile can not write, allocated on first use
+};
+
+// appends to a file or a named pipe; writes to a pipe block the worker when the reader falls behind
+class FileTransport : public LineTransport
+{
+public:
+
+    FileTransport() = default;
+    ~FileTransport() override;
+
+protected:
+
+    int openDescriptor(const std::string& path) override;
+};
+
+// connects to a stream UNIX domain socket
+class UnixSocketTransport : public LineTransport
+{
+public:
+
+    UnixSocketTransport() = default;
+    ~UnixSocketTransport() override;
+
+protected:
+
+    int openDescriptor(const std::string& path) override;
+    bool isValidPath(const std::string& path) const override;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_LINETRANSPORT_H
@@ -0,0 +1,148 @@
+#include "logstaging.h"
+
+#include <algorithm>
+
+
+namespace Sentry
+{
+
+LogStagingBuffer::LogStagingBuffer()
+:
+m_entries(),
+m_head(0),
+m_tail(0),
+m_consuming(),
+m_orphaned(false)
+{
+    m_consuming.clear();
+}
+
+void LogStagingBuffer::push(EventLevel level, InternedString logger, std::string_view message)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+    {
+        // full - make room by dropping the oldest half, unless the hub is draining right now
+        if (!tryDiscard(CAPACITY / 2))
+            return;
+    }
+
+    // the slots are reused, so messages fitting the previous capacity do not allocate
+    StagedLog& entry = m_entries[tail % CAPACITY];
+    entry.level = level;
+    entry.logger = logger;
+    entry.message.assign(message.data(), message.size());
+    entry.timestamp = time(nullptr);
+
+    m_tail.store(tail + 1, std::memory_order_release);
+}
+
+bool LogStagingBuffer::tryDiscard(size_t count)
+{
+    if (m_consuming.test_and_set(std::memory_order_acquire))
+        return false;
+
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    m_head.store(head + std::min(count, m_tail.load(std::memory_order_relaxed) - head), std::memory_order_release);
+
+    m_consuming.clear(std::memory_order_release);
+    return true;
+}
+
+bool LogStagingBuffer::isRepetition(const StagedLog& log, const StagedLog& next)
+{
+    return log.level == next.level && log.logger == next.logger && log.message == next.message;
+}
+
+void LogStagingBuffer::setOrphaned()
+{
+    m_orphaned = true;
+}
+
+bool LogStagingBuffer::isOrphaned() const
+{
+    return m_orphaned;
+}
+
+bool LogStagingBuffer::empty() const
+{
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+LogStaging& LogStaging::instance()
+{
+    // never destroyed, threads may log while static objects are destroyed
+    static LogStaging* staging = new LogStaging();
+    return *staging;
+}
+
+LogStaging::LogStaging()
+:
+m_buffers(),
+m_buffersMutex()
+{
+
+}
+
+void LogStaging::stage(EventLevel level, InternedString logger, std::string_view message)
+{
+    threadBuffer().push(level, logger, message);
+}
+
+void LogStaging::stage(EventLevel level, std::string_view logger, std::string_view message)
+{
+    // a thread usually logs through the same logger, remember its handle
+    thread_local std::string lastLogger;
+    thread_local InternedString lastLoggerHandle;
+    if (logger != lastLogger)
+    {
+        lastLogger.assign(logger.data(), logger.size());
+        lastLoggerHandle = InternedString(lastLogger);
+    }
+    threadBuffer().push(level, lastLoggerHandle, message);
+}
+
+LogStagingBuffer& LogStaging::threadBuffer()
+{
+    // registered on the first log of the thread, handed over to the drain when the thread exits
+    struct ThreadBuffer
+    {
+        std::shared_ptr<LogStagingBuffer> buffer;
+
+        ~ThreadBuffer()
+        {
+            if (buffer)
+            {
+                buffer->setOrphaned();
+            }
+        }
+    };
+    thread_local ThreadBuffer threadBuffer;
+
+    if (!threadBuffer.buffer)
+    {
+        threadBuffer.buffer = std::make_shared<LogStagingBuffer>();
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(threadBuffer.buffer);
+    }
+    return *threadBuffer.buffer;
+}
+
+std::vector<std::shared_ptr<LogStagingBuffer>> LogStaging::buffers()
+{
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    return m_buffers;
+}
+
+void LogStaging::removeOrphanedBuffers()
+{
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                   [](const std::shared_ptr<LogStagingBuffer>& buffer)
+                                   {
+                                       return buffer->isOrphaned() && buffer->empty();
+                                   }),
+                    m_buffers.end());
+}
+
+} // namespace Sentry
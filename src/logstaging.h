@@ -0,0 +1,136 @@
+#ifndef SENTRY_LOGSTAGING_H
+#define SENTRY_LOGSTAGING_H
+
+#include "sentry_common.h"
+#include "stringinterner.h"
+
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/*
+ * Per-thread staging of log lines that become breadcrumbs.
+ *
+ * Every logging thread owns a single producer / single consumer ring, so staging a line takes no lock and
+ * touches no cache line shared with other threads. The hub drains all rings into the scope in one batch
+ * (before capturing an event and periodically on the transport thread), collapsing consecutive repeats.
+ * A full ring drops its oldest half - only the newest maxBreadcrumbs would be kept by the scope anyway.
+ */
+
+namespace Sentry
+{
+
+struct StagedLog
+{
+    EventLevel level;
+    InternedString logger;
+    std::string message;
+    time_t timestamp;
+};
+
+class LogStagingBuffer
+{
+public:
+
+    static constexpr size_t CAPACITY = 256;
+
+    LogStagingBuffer();
+
+    // owning thread only
+    void push(EventLevel level, InternedString logger, std::string_view message);
+
+    // any thread, consumer(const StagedLog& log, size_t repetitions) is called oldest first for each run of
+    // identical lines; returns false if another consumer is running
+    template<typename F>
+    bool tryConsume(F&& consumer)
+    {
+        if (m_consuming.test_and_set(std::memory_order_acquire))
+            return false;
+
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        while (head != tail)
+        {
+            const StagedLog& log = m_entries[head % CAPACITY];
+            size_t repetitions = 1;
+            for (head++; head != tail && isRepetition(log, m_entries[head % CAPACITY]); head++)
+            {
+                repetitions++;
+            }
+            consumer(log, repetitions);
+        }
+        // the producer can reuse the entries from now on
+        m_head.store(head, std::memory_order_release);
+
+        m_consuming.clear(std::memory_order_release);
+        return true;
+    }
+
+    void setOrphaned();     // owning thread exited
+    bool isOrphaned() const;
+    bool empty() const;
+
+private:
+
+    bool tryDiscard(size_t count);     // owning thread only
+    static bool isRepetition(const StagedLog& log, const StagedLog& next);
+
+    LogStagingBuffer(const LogStagingBuffer&) = delete;
+    LogStagingBuffer& operator=(const LogStagingBuffer&) = delete;
+    LogStagingBuffer(const LogStagingBuffer&&) = delete;
+    LogStagingBuffer&& operator=(const LogStagingBuffer&&) = delete;
+
+    std::array<StagedLog, CAPACITY> m_entries;
+    alignas(64) std::atomic<size_t> m_head;     // next entry to consume
+    alignas(64) std::atomic<size_t> m_tail;     // next entry to write
+    std::atomic_flag m_consuming;
+    std::atomic_bool m_orphaned;
+};
+
+class LogStaging
+{
+public:
+
+    static LogStaging& instance();
+
+    // lock-free apart from the first call on each thread
+    void stage(EventLevel level, InternedString logger, std::string_view message);
+    void stage(EventLevel level, std::string_view logger, std::string_view message);
+
+    // consumer(const StagedLog& log, size_t repetitions) for each run of identical lines, thread by thread
+    template<typename F>
+    void drain(F&& consumer)
+    {
+        for (auto& buffer : buffers())
+        {
+            buffer->tryConsume(consumer);
+        }
+        removeOrphanedBuffers();
+    }
+
+private:
+
+    LogStaging();
+
+    LogStaging(const LogStaging&) = delete;
+    LogStaging& operator=(const LogStaging&) = delete;
+    LogStaging(const LogStaging&&) = delete;
+    LogStaging&& operator=(const LogStaging&&) = delete;
+
+    LogStagingBuffer& threadBuffer();
+    std::vector<std::shared_ptr<LogStagingBuffer>> buffers();
+    void removeOrphanedBuffers();
+
+    std::vector<std::shared_ptr<LogStagingBuffer>> m_buffers;
+    mutable std::mutex m_buffersMutex;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_LOGSTAGING_H
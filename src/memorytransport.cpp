@@ -0,0 +1,49 @@
+#include "memorytransport.h"
+
+#include <iterator>
+
+
+namespace Sentry
+{
+
+MemoryTransport::MemoryTransport()
+:
+Transport(),
+m_events(),
+m_eventsMutex()
+{
+
+}
+
+MemoryTransport::~MemoryTransport()
+{
+    stop();
+}
+
+EErrorCode MemoryTransport::setup(const SentryDSN&, const SentryOptions&)
+{
+    return EErrorCode::NO_ERROR;
+}
+
+std::vector<std::string> MemoryTransport::takeEvents()
+{
+    std::lock_guard<std::mutex> lock(m_eventsMutex);
+    std::vector<std::string> events(std::make_move_iterator(m_events.begin()), std::make_move_iterator(m_events.end()));
+    m_events.clear();
+    return events;
+}
+
+void MemoryTransport::send(const std::string& contents, unsigned int)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        if (m_events.size() == MEMORY_TRANSPORT_MAX_EVENTS)
+        {
+            m_events.pop_front();
+        }
+        m_events.push_back(contents);
+    }
+    handleSendSuccess(contents.size());
+}
+
+} // namespace Sentry
@@ -0,0 +1,45 @@
+#ifndef SENTRY_MEMORYTRANSPORT_H
+#define SENTRY_MEMORYTRANSPORT_H
+
+#include "transport.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+constexpr size_t MEMORY_TRANSPORT_MAX_EVENTS = 10000;   // the oldest are dropped, take them regularly
+}
+
+namespace Sentry
+{
+
+// keeps the serialized events in memory, for tests and benchmarks (see Sentry::takeCapturedEvents)
+class MemoryTransport : public Transport
+{
+public:
+
+    MemoryTransport();
+    ~MemoryTransport() override;
+
+    EErrorCode setup(const SentryDSN& dsn, const SentryOptions& options) override;
+
+    // the captured events, oldest first, and forgets them
+    std::vector<std::string> takeEvents();
+
+protected:
+
+    void send(const std::string& contents, unsigned int attempt) override;
+
+private:
+
+    std::deque<std::string> m_events;
+    mutable std::mutex m_eventsMutex;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_MEMORYTRANSPORT_H
@@ -0,0 +1,714 @@
+#include "metricsaggregator.h"
+
+#include "sdkstats.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+namespace
+{
+
+uint64_t toBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void addDouble(std::atomic<uint64_t>& target, double value)
+{
+    uint64_t expected = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(expected, toBits(fromBits(expected) + value), std::memory_order_relaxed))
+    {
+    }
+}
+
+template<typename Compare>
+void replaceDoubleIf(std::atomic<uint64_t>& target, double value, Compare compare)
+{
+    uint64_t expected = target.load(std::memory_order_relaxed);
+    while (compare(value, fromBits(expected))
+           && !target.compare_exchange_weak(expected, toBits(value), std::memory_order_relaxed))
+    {
+    }
+}
+
+void hashBytes(uint64_t& hash, const char* data, size_t size)
+{
+    for (size_t i=0; i<size; i++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+    }
+    hash = (hash ^ 0xff) * 0x100000001b3ull;    // separates the fields
+}
+
+uint64_t hashKey(Sentry::MetricType type, const std::string& key, const char* unit, const Sentry::metrics::Tags& tags)
+{
+    uint64_t hash = 0xcbf29ce484222325ull ^ static_cast<uint64_t>(type);
+    hashBytes(hash, key.data(), key.size());
+    hashBytes(hash, unit, std::strlen(unit));
+    for (const auto& tag : tags)
+    {
+        hashBytes(hash, tag.first.data(), tag.first.size());
+        hashBytes(hash, tag.second.data(), tag.second.size());
+    }
+    return hash;
+}
+
+std::string sanitize(const std::string& text, const char* allowed, bool replace)
+{
+    std::string sanitized;
+    sanitized.reserve(text.size());
+    for (char c : text)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || std::strchr(allowed, c) != nullptr)
+        {
+            sanitized.push_back(c);
+        }
+        else if (replace)
+        {
+            sanitized.push_back('_');
+        }
+    }
+    return sanitized;
+}
+
+std::string escapeTagValue(const std::string& value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value)
+    {
+        switch (c)
+        {
+            case '\n': escaped.append("\\n"); break;
+            case '\r': escaped.append("\\r"); break;
+            case '\t': escaped.append("\\t"); break;
+            case '\\': escaped.append("\\\\"); break;
+            case '|': escaped.append("\\u{7c}"); break;
+            case ',': escaped.append("\\u{2c}"); break;
+            default: escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+std::string serializeTags(const Sentry::metrics::Tags& tags)
+{
+    std::string serialized;
+    for (const auto& tag : tags)
+    {
+        const std::string key = sanitize(tag.first, "_-./", false);
+        if (key.empty())
+            continue;
+
+        if (!serialized.empty())
+        {
+            serialized.push_back(',');
+        }
+        serialized.append(key).append(":").append(escapeTagValue(tag.second));
+    }
+    return serialized;
+}
+
+void appendNumber(std::string& output, double value)
+{
+    // the shortest text that reads back as the same double, several times faster than printf
+    char buffer[32];
+    const std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    output.append(buffer, static_cast<size_t>(result.ptr - buffer));
+}
+
+uint32_t hashValue(const std::string& value)
+{
+    uint32_t hash = 0x811c9dc5u;
+    for (char c : value)
+    {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x01000193u;
+    }
+    return hash;
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+MetricsAggregator& MetricsAggregator::instance()
+{
+    // never destroyed, metrics may be recorded while static objects are destroyed
+    static MetricsAggregator* aggregator = new MetricsAggregator();
+    return *aggregator;
+}
+
+MetricsAggregator::MetricsAggregator()
+:
+m_enabled(false),
+m_keysMutex(),
+m_keyIds(),
+m_keys(new MetricKey[METRICS_MAX_KEYS]),
+m_keyCount(0),
+m_threadsMutex(),
+m_threads(),
+m_collectMutex()
+{
+
+}
+
+MetricsAggregator::ThreadMetrics::ThreadMetrics()
+:
+accumulators(),
+keyCache(),
+orphaned(false)
+{
+    for (auto& accumulator : accumulators)
+    {
+        accumulator.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+MetricsAggregator::ThreadMetrics::~ThreadMetrics()
+{
+    for (auto& accumulator : accumulators)
+    {
+        delete accumulator.load(std::memory_order_relaxed);
+    }
+}
+
+void MetricsAggregator::enable()
+{
+    m_enabled.store(true, std::memory_order_relaxed);
+}
+
+uint32_t MetricsAggregator::registerKey(MetricType type, const std::string& key, const char* unit,
+                                        const metrics::Tags& tags)
+{
+    const std::string name = sanitize(key, "_-.", true) + "@" + sanitize(unit, "_", false);
+    const std::string statsdTags = serializeTags(tags);
+    std::string id = name + "|" + statsdTags;
+    id.push_back(static_cast<char>('0' + static_cast<int>(type)));
+
+    std::lock_guard<std::mutex> lock(m_keysMutex);
+    auto found = m_keyIds.find(id);
+    if (found != m_keyIds.end())
+        return found->second;
+
+    const uint32_t count = m_keyCount.load(std::memory_order_relaxed);
+    if (count == METRICS_MAX_KEYS)
+        return METRICS_INVALID_ID;
+
+    m_keys[count] = {type, key, unit, tags, name, statsdTags};
+    m_keyIds.emplace(std::move(id), count);
+    m_keyCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+uint32_t MetricsAggregator::findKey(MetricType type, const std::string& key, const char* unit,
+                                    const metrics::Tags& tags)
+{
+    ThreadMetrics& metrics = threadMetrics();
+    const uint64_t hash = hashKey(type, key, unit, tags);
+
+    // the registered keys never change, they can be compared without the lock
+    auto cached = metrics.keyCache.find(hash);
+    if (cached != metrics.keyCache.end())
+    {
+        if (cached->second == METRICS_INVALID_ID)
+            return METRICS_INVALID_ID;     // over the limit, not looked up again
+
+        const MetricKey& found = m_keys[cached->second];
+        if (found.type == type && found.key == key && found.unit == unit && found.tags == tags)
+            return cached->second;
+    }
+
+    const uint32_t id = registerKey(type, key, unit, tags);
+    metrics.keyCache[hash] = id;
+    return id;
+}
+
+MetricsAggregator::ThreadMetrics& MetricsAggregator::threadMetrics()
+{
+    // registered on the first metric of the thread, handed over to the flush when the thread exits
+    struct ThreadMetricsHolder
+    {
+        std::shared_ptr<ThreadMetrics> metrics;
+
+        ~ThreadMetricsHolder()
+        {
+            if (metrics)
+            {
+                metrics->orphaned.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local ThreadMetricsHolder holder;
+
+    if (!holder.metrics)
+    {
+        holder.metrics = std::make_shared<ThreadMetrics>();
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        m_threads.push_back(holder.metrics);
+    }
+    return *holder.metrics;
+}
+
+std::vector<std::shared_ptr<MetricsAggregator::ThreadMetrics>> MetricsAggregator::threads()
+{
+    std::lock_guard<std::mutex> lock(m_threadsMutex);
+    return m_threads;
+}
+
+MetricsAggregator::Accumulator* MetricsAggregator::accumulator(uint32_t id)
+{
+    if (id == METRICS_INVALID_ID)
+    {
+        SdkStats::instance().add(StatCounter::METRIC_VALUES_DROPPED);
+        return nullptr;
+    }
+
+    std::atomic<Accumulator*>& slot = threadMetrics().accumulators[id];
+    Accumulator* accumulator = slot.load(std::memory_order_relaxed);
+    if (accumulator == nullptr)
+    {
+        accumulator = new Accumulator();
+        accumulator->sum.store(toBits(0.0), std::memory_order_relaxed);
+        accumulator->count.store(0, std::memory_order_relaxed);
+        accumulator->last.store(toBits(0.0), std::memory_order_relaxed);
+        accumulator->min.store(toBits(std::numeric_limits<double>::infinity()), std::memory_order_relaxed);
+        accumulator->max.store(toBits(-std::numeric_limits<double>::infinity()), std::memory_order_relaxed);
+        accumulator->zeroAdded.store(false, std::memory_order_relaxed);
+
+        const MetricType type = m_keys[id].type;
+        const size_t cells = (type == MetricType::DISTRIBUTION) ? 2 * METRICS_SKETCH_BUCKETS + 1
+                           : (type == MetricType::SET) ? METRICS_SET_CAPACITY : 0;
+        if (cells > 0)
+        {
+            accumulator->cells.reset(new std::atomic<uint32_t>[cells]);
+            for (size_t i=0; i<cells; i++)
+            {
+                accumulator->cells[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        slot.store(accumulator, std::memory_order_release);
+    }
+    return accumulator;
+}
+
+void MetricsAggregator::addCounter(uint32_t id, double value)
+{
+    Accumulator* target = accumulator(id);
+    if (target != nullptr)
+    {
+        addDouble(target->sum, value);
+    }
+}
+
+void MetricsAggregator::setGauge(uint32_t id, double value)
+{
+    Accumulator* target = accumulator(id);
+    if (target == nullptr)
+        return;
+
+    target->last.store(toBits(value), std::memory_order_relaxed);
+    replaceDoubleIf(target->min, value, [](double a, double b) { return a < b; });
+    replaceDoubleIf(target->max, value, [](double a, double b) { return a > b; });
+    addDouble(target->sum, value);
+    target->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricsAggregator::addDistribution(uint32_t id, double value)
+{
+    if (std::isnan(value))
+        return;
+
+    Accumulator* target = accumulator(id);
+    if (target != nullptr)
+    {
+        target->cells[sketchIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MetricsAggregator::addSet(uint32_t id, uint32_t value)
+{
+    Accumulator* target = accumulator(id);
+    if (target == nullptr)
+        return;
+
+    if (value == 0)
+    {
+        target->zeroAdded.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    // the flush empties cells concurrently, a value may then be kept twice - the flush merges them
+    size_t cell = (value * 0x9e3779b1u) % METRICS_SET_CAPACITY;
+    for (size_t probe=0; probe<METRICS_SET_PROBES; probe++)
+    {
+        uint32_t current = target->cells[cell].load(std::memory_order_relaxed);
+        if (current == value)
+            return;
+        if (current == 0 && (target->cells[cell].compare_exchange_strong(current, value, std::memory_order_relaxed)
+                             || current == value))
+            return;
+        cell = (cell + 1) % METRICS_SET_CAPACITY;
+    }
+    SdkStats::instance().add(StatCounter::METRIC_VALUES_DROPPED);
+}
+
+size_t MetricsAggregator::sketchIndex(double value)
+{
+    if (value == 0.0)
+        return 2 * METRICS_SKETCH_BUCKETS;
+
+    // the exponent and the top bits of the mantissa of the double: logarithmic buckets without a logarithm
+    const uint64_t bits = toBits(value);
+    const int exponent = std::min(std::max(static_cast<int>((bits >> 52) & 0x7ff) - 1023, METRICS_SKETCH_MIN_EXPONENT),
+                                  METRICS_SKETCH_MAX_EXPONENT);
+    const size_t subBucket = static_cast<size_t>(bits >> 48) & (METRICS_SKETCH_SUB_BUCKETS - 1);
+    const size_t index = static_cast<size_t>(exponent - METRICS_SKETCH_MIN_EXPONENT) * METRICS_SKETCH_SUB_BUCKETS
+                         + subBucket;
+    return (value < 0.0) ? METRICS_SKETCH_BUCKETS + index : index;
+}
+
+double MetricsAggregator::sketchValue(size_t index)
+{
+    if (index >= 2 * METRICS_SKETCH_BUCKETS)
+        return 0.0;
+
+    const bool negative = index >= METRICS_SKETCH_BUCKETS;
+    const size_t bucket = index % METRICS_SKETCH_BUCKETS;
+    const int exponent = static_cast<int>(bucket / METRICS_SKETCH_SUB_BUCKETS) + METRICS_SKETCH_MIN_EXPONENT;
+    const double subBucket = static_cast<double>(bucket % METRICS_SKETCH_SUB_BUCKETS);
+
+    // the middle of the bucket
+    const double value = std::ldexp(1.0 + (subBucket + 0.5) / METRICS_SKETCH_SUB_BUCKETS, exponent);
+    return negative ? -value : value;
+}
+
+void MetricsAggregator::take(Accumulator& accumulator, MetricType type, Aggregate& aggregate)
+{
+    switch (type)
+    {
+        case MetricType::COUNTER:
+        {
+            const double sum = fromBits(accumulator.sum.exchange(toBits(0.0), std::memory_order_relaxed));
+            if (sum != 0.0)
+            {
+                aggregate.sum += sum;
+                aggregate.recorded = true;
+            }
+            break;
+        }
+        case MetricType::GAUGE:
+        {
+            const uint64_t count = accumulator.count.exchange(0, std::memory_order_relaxed);
+            if (count == 0)
+                break;
+
+            const double sum = fromBits(accumulator.sum.exchange(toBits(0.0), std::memory_order_relaxed));
+            const double min = fromBits(accumulator.min.exchange(toBits(std::numeric_limits<double>::infinity()),
+                                                                 std::memory_order_relaxed));
+            const double max = fromBits(accumulator.max.exchange(toBits(-std::numeric_limits<double>::infinity()),
+                                                                 std::memory_order_relaxed));
+            aggregate.min = aggregate.recorded ? std::min(aggregate.min, min) : min;
+            aggregate.max = aggregate.recorded ? std::max(aggregate.max, max) : max;
+            aggregate.last = fromBits(accumulator.last.load(std::memory_order_relaxed));
+            aggregate.sum += sum;
+            aggregate.count += count;
+            aggregate.recorded = true;
+            break;
+        }
+        case MetricType::DISTRIBUTION:
+        {
+            for (size_t i=0; i<2*METRICS_SKETCH_BUCKETS+1; i++)
+            {
+                if (accumulator.cells[i].load(std::memory_order_relaxed) == 0)
+                    continue;
+
+                if (aggregate.sketch.empty())
+                {
+                    aggregate.sketch.resize(2 * METRICS_SKETCH_BUCKETS + 1, 0);
+                }
+                aggregate.sketch[i] += accumulator.cells[i].exchange(0, std::memory_order_relaxed);
+                aggregate.recorded = true;
+            }
+            break;
+        }
+        case MetricType::SET:
+        {
+            if (accumulator.zeroAdded.exchange(false, std::memory_order_relaxed))
+            {
+                aggregate.set.push_back(0);
+            }
+            for (size_t i=0; i<METRICS_SET_CAPACITY; i++)
+            {
+                if (accumulator.cells[i].load(std::memory_order_relaxed) == 0)
+                    continue;
+
+                aggregate.set.push_back(accumulator.cells[i].exchange(0, std::memory_order_relaxed));
+            }
+            aggregate.recorded = aggregate.recorded || !aggregate.set.empty();
+            break;
+        }
+    }
+}
+
+std::string MetricsAggregator::collect(int64_t timestamp, const metrics::Tags& defaultTags, size_t& lines)
+{
+    std::lock_guard<std::mutex> lock(m_collectMutex);
+
+    const uint32_t keyCount = m_keyCount.load(std::memory_order_acquire);
+    std::vector<Aggregate> aggregates(keyCount);
+
+    std::vector<std::shared_ptr<ThreadMetrics>> orphans;
+    for (const auto& thread : threads())
+    {
+        // an orphan seen before taking its accumulators gets no more values, it can go afterwards
+        if (thread->orphaned.load(std::memory_order_acquire))
+        {
+            orphans.push_back(thread);
+        }
+        for (uint32_t id=0; id<keyCount; id++)
+        {
+            Accumulator* accumulator = thread->accumulators[id].load(std::memory_order_acquire);
+            if (accumulator != nullptr)
+            {
+                take(*accumulator, m_keys[id].type, aggregates[id]);
+            }
+        }
+    }
+    if (!orphans.empty())
+    {
+        std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+        for (const auto& orphan : orphans)
+        {
+            m_threads.erase(std::find(m_threads.begin(), m_threads.end(), orphan));
+        }
+    }
+
+    const std::string statsdDefaultTags = serializeTags(defaultTags);
+    std::string output;
+    lines = 0;
+    for (uint32_t id=0; id<keyCount; id++)
+    {
+        if (aggregates[id].recorded)
+        {
+            writeLine(output, m_keys[id], aggregates[id], statsdDefaultTags, timestamp);
+            lines++;
+        }
+    }
+    return output;
+}
+
+void MetricsAggregator::writeLine(std::string& output, const MetricKey& key, Aggregate& aggregate,
+                                  const std::string& defaultTags, int64_t timestamp)
+{
+    if (!output.empty())
+    {
+        output.push_back('\n');
+    }
+    output.append(key.name);
+
+    const char* type = "c";
+    switch (key.type)
+    {
+        case MetricType::COUNTER:
+        {
+            output.push_back(':');
+            appendNumber(output, aggregate.sum);
+            break;
+        }
+        case MetricType::GAUGE:
+        {
+            type = "g";
+            for (double value : {aggregate.last, aggregate.min, aggregate.max, aggregate.sum})
+            {
+                output.push_back(':');
+                appendNumber(output, value);
+            }
+            output.push_back(':');
+            output.append(std::to_string(aggregate.count));
+            break;
+        }
+        case MetricType::DISTRIBUTION:
+        {
+            type = "d";
+            uint64_t total = 0;
+            for (uint64_t count : aggregate.sketch)
+            {
+                total += count;
+            }
+            for (size_t i=0; i<aggregate.sketch.size(); i++)
+            {
+                uint64_t count = aggregate.sketch[i];
+                if (count == 0)
+                    continue;
+
+                // downsampled in proportion, keeping every bucket
+                if (total > METRICS_DISTRIBUTION_VALUES_LIMIT)
+                {
+                    count = std::max<uint64_t>(1, count * METRICS_DISTRIBUTION_VALUES_LIMIT / total);
+                }
+                std::string value(":");
+                appendNumber(value, sketchValue(i));
+                for (uint64_t n=0; n<count; n++)
+                {
+                    output.append(value);
+                }
+            }
+            break;
+        }
+        case MetricType::SET:
+        {
+            type = "s";
+            std::sort(aggregate.set.begin(), aggregate.set.end());
+            aggregate.set.erase(std::unique(aggregate.set.begin(), aggregate.set.end()), aggregate.set.end());
+            for (uint32_t value : aggregate.set)
+            {
+                output.push_back(':');
+                output.append(std::to_string(value));
+            }
+            break;
+        }
+    }
+
+    output.append("|").append(type);
+    if (!key.statsdTags.empty() || !defaultTags.empty())
+    {
+        output.append("|#").append(key.statsdTags);
+        if (!key.statsdTags.empty() && !defaultTags.empty())
+        {
+            output.push_back(',');
+        }
+        output.append(defaultTags);
+    }
+    output.append("|T").append(std::to_string(timestamp));
+}
+
+namespace metrics
+{
+
+Counter::Counter(const std::string& key, const char* unit, const Tags& tags)
+:
+m_id(MetricsAggregator::instance().registerKey(MetricType::COUNTER, key, unit, tags))
+{
+
+}
+
+void Counter::increment(double value) const
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addCounter(m_id, value);
+    }
+}
+
+Gauge::Gauge(const std::string& key, const char* unit, const Tags& tags)
+:
+m_id(MetricsAggregator::instance().registerKey(MetricType::GAUGE, key, unit, tags))
+{
+
+}
+
+void Gauge::set(double value) const
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.setGauge(m_id, value);
+    }
+}
+
+Distribution::Distribution(const std::string& key, const char* unit, const Tags& tags)
+:
+m_id(MetricsAggregator::instance().registerKey(MetricType::DISTRIBUTION, key, unit, tags))
+{
+
+}
+
+void Distribution::record(double value) const
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addDistribution(m_id, value);
+    }
+}
+
+Set::Set(const std::string& key, const char* unit, const Tags& tags)
+:
+m_id(MetricsAggregator::instance().registerKey(MetricType::SET, key, unit, tags))
+{
+
+}
+
+void Set::add(uint32_t value) const
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addSet(m_id, value);
+    }
+}
+
+void Set::add(const std::string& value) const
+{
+    add(hashValue(value));
+}
+
+void increment(const std::string& key, double value, const char* unit, const Tags& tags)
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addCounter(aggregator.findKey(MetricType::COUNTER, key, unit, tags), value);
+    }
+}
+
+void gauge(const std::string& key, double value, const char* unit, const Tags& tags)
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.setGauge(aggregator.findKey(MetricType::GAUGE, key, unit, tags), value);
+    }
+}
+
+void distribution(const std::string& key, double value, const char* unit, const Tags& tags)
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addDistribution(aggregator.findKey(MetricType::DISTRIBUTION, key, unit, tags), value);
+    }
+}
+
+void set(const std::string& key, uint32_t value, const char* unit, const Tags& tags)
+{
+    MetricsAggregator& aggregator = MetricsAggregator::instance();
+    if (aggregator.isEnabled())
+    {
+        aggregator.addSet(aggregator.findKey(MetricType::SET, key, unit, tags), value);
+    }
+}
+
+void set(const std::string& key, const std::string& value, const char* unit, const Tags& tags)
+{
+    set(key, hashValue(value), unit, tags);
+}
+
+} // namespace metrics
+
+} // namespace Sentry
@@ -0,0 +1,165 @@
+#ifndef SENTRY_METRICSAGGREGATOR_H
+#define SENTRY_METRICSAGGREGATOR_H
+
+#include "sentry_metrics.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * Aggregation of the custom metrics (sentry_metrics.h) for the statsd envelope items of the hubs with
+ * SentryOptions::enableMetrics. https://develop.sentry.dev/sdk/metrics/
+ *
+ * Every metric key (type, name, unit, tags) is registered once and gets an id. Every thread that records has an
+ * accumulator per id it used, allocated on first use: only that thread adds to it, with a relaxed atomic add
+ * (a compare and swap for the sums of doubles) on a cache line no other thread writes - no lock, no allocation.
+ * The hub flushes on the transport thread every METRICS_FLUSH_INTERVAL_SECONDS: the accumulators of all the
+ * threads are taken with atomic exchanges and merged into one bucket of that interval, a line per key.
+ *
+ * Distributions are sketches with logarithmic buckets: 16 per power of two (about 3% relative error),
+ * mergeable across threads by adding the counts. A bucket with more values than
+ * METRICS_DISTRIBUTION_VALUES_LIMIT is sent downsampled - the percentiles are kept, the count and sum are not.
+ * Sets keep 32-bit hashes of the values in an open addressing table per thread, full tables drop new values.
+ * Gauges report the last value of one of the threads that set them.
+ */
+
+namespace
+{
+constexpr size_t METRICS_MAX_KEYS = 1024;
+constexpr unsigned int METRICS_FLUSH_INTERVAL_SECONDS = 10;
+constexpr int METRICS_SKETCH_MIN_EXPONENT = -24;    // about 6e-8, smaller values share the lowest buckets
+constexpr int METRICS_SKETCH_MAX_EXPONENT = 47;     // about 2.8e14, larger values share the highest buckets
+constexpr size_t METRICS_SKETCH_SUB_BUCKETS = 16;   // per power of two, the top 4 bits of the mantissa
+constexpr size_t METRICS_SKETCH_BUCKETS =
+        (METRICS_SKETCH_MAX_EXPONENT - METRICS_SKETCH_MIN_EXPONENT + 1) * METRICS_SKETCH_SUB_BUCKETS;
+constexpr size_t METRICS_SET_CAPACITY = 1024;       // unique values of a set per thread between the flushes
+constexpr size_t METRICS_SET_PROBES = 32;
+constexpr size_t METRICS_DISTRIBUTION_VALUES_LIMIT = 1000;  // per key and bucket
+constexpr uint32_t METRICS_INVALID_ID = UINT32_MAX;
+}
+
+namespace Sentry
+{
+
+enum class MetricType
+{
+    COUNTER,
+    GAUGE,
+    DISTRIBUTION,
+    SET
+};
+
+class MetricsAggregator
+{
+public:
+
+    static MetricsAggregator& instance();
+
+    // recording costs nothing until a hub with SentryOptions::enableMetrics is initialised
+    void enable();
+    bool isEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    // METRICS_INVALID_ID when METRICS_MAX_KEYS are registered, recording it is a no-op
+    uint32_t registerKey(MetricType type, const std::string& key, const char* unit, const metrics::Tags& tags);
+    // registerKey through a cache of the calling thread
+    uint32_t findKey(MetricType type, const std::string& key, const char* unit, const metrics::Tags& tags);
+
+    void addCounter(uint32_t id, double value);
+    void setGauge(uint32_t id, double value);
+    void addDistribution(uint32_t id, double value);
+    void addSet(uint32_t id, uint32_t value);
+
+    // the statsd lines of the values recorded since the last call, timestamped; defaultTags (e.g. release)
+    // are appended to the tags of every line
+    std::string collect(int64_t timestamp, const metrics::Tags& defaultTags, size_t& lines);
+
+    static size_t sketchIndex(double value);
+    static double sketchValue(size_t index);
+
+private:
+
+    MetricsAggregator();
+
+    MetricsAggregator(const MetricsAggregator&) = delete;
+    MetricsAggregator& operator=(const MetricsAggregator&) = delete;
+    MetricsAggregator(const MetricsAggregator&&) = delete;
+    MetricsAggregator&& operator=(const MetricsAggregator&&) = delete;
+
+    struct MetricKey
+    {
+        MetricType type;
+        std::string key;
+        std::string unit;
+        metrics::Tags tags;
+        std::string name;           // statsd, sanitized: key@unit
+        std::string statsdTags;     // sanitized and escaped: k:v,k:v
+    };
+
+    struct alignas(64) Accumulator
+    {
+        std::atomic<uint64_t> sum;      // of a double: counters and gauges
+        std::atomic<uint64_t> count;    // gauges
+        std::atomic<uint64_t> last;     // of a double: gauges
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+        std::atomic<bool> zeroAdded;    // sets, 0 marks the empty cells
+        std::unique_ptr<std::atomic<uint32_t>[]> cells;  // sketch buckets, negative values after the positive
+                                                          // and zero last; hashes of a set
+    };
+
+    // the accumulators of a thread, handed over to the flush when the thread exits
+    struct ThreadMetrics
+    {
+        ThreadMetrics();
+        ~ThreadMetrics();
+
+        std::atomic<Accumulator*> accumulators[METRICS_MAX_KEYS];
+        std::unordered_map<uint64_t, uint32_t> keyCache;     // hash of the key to its id, owner thread only
+        std::atomic<bool> orphaned;
+    };
+
+    // merged accumulators of a key
+    struct Aggregate
+    {
+        bool recorded = false;
+        double sum = 0.0;
+        uint64_t count = 0;
+        double last = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        std::vector<uint64_t> sketch;
+        std::vector<uint32_t> set;
+    };
+
+    Accumulator* accumulator(uint32_t id);
+    ThreadMetrics& threadMetrics();
+    std::vector<std::shared_ptr<ThreadMetrics>> threads();
+    void take(Accumulator& accumulator, MetricType type, Aggregate& aggregate);
+    void writeLine(std::string& output, const MetricKey& key, Aggregate& aggregate, const std::string& defaultTags,
+                   int64_t timestamp);
+
+    std::atomic<bool> m_enabled;
+
+    std::mutex m_keysMutex;
+    std::unordered_map<std::string, uint32_t> m_keyIds;
+    std::unique_ptr<MetricKey[]> m_keys;     // immutable once counted in m_keyCount
+    std::atomic<uint32_t> m_keyCount;
+
+    std::mutex m_threadsMutex;
+    std::vector<std::shared_ptr<ThreadMetrics>> m_threads;
+
+    std::mutex m_collectMutex;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_METRICSAGGREGATOR_H
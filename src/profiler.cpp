@@ -0,0 +1,379 @@
+#include "profiler.h"
+
+#include "backtracehandler.h"
+#include "sdkstats.h"
+#include "unwinder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <execinfo.h>
+#include <fstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+constexpr uint32_t NO_STACK_NODE = UINT32_MAX;
+
+struct RingSample
+{
+    std::atomic<size_t> sequence;   // == position - free to claim, position + 1 - written, ready to collect
+    int64_t nanoseconds;
+    pid_t threadId;
+    size_t frameCount;
+    void* frames[PROFILER_MAX_FRAMES];
+};
+
+// static, a late handler must never write into freed memory
+RingSample ringSamples[PROFILER_RING_SAMPLES];
+std::atomic<size_t> ringTail(0);
+std::atomic<uint64_t> ringDropped(0);
+std::atomic<Sentry::StackUnwinder> profilerUnwinder(Sentry::StackUnwinder::BACKTRACE);
+
+std::string threadName(pid_t threadId)
+{
+    std::string name;
+    std::ifstream comm("/proc/self/task/" + std::to_string(threadId) + "/comm");
+    std::getline(comm, name);
+    return name;
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+Profiler& Profiler::instance()
+{
+    // never destroyed, like the ring the handler writes to
+    static Profiler* profiler = new Profiler();
+    return *profiler;
+}
+
+Profiler::Profiler()
+:
+m_mutex(),
+m_handlerInstalled(false),
+m_timerCreated(false),
+m_timer(),
+m_openTransactions(),
+m_ringHead(0),
+m_samples(),
+m_stackNodes(),
+m_stackNodeIndex(),
+m_frameAddresses(),
+m_frameIndex()
+{
+
+}
+
+bool Profiler::start(int64_t startNanoseconds, int frequencyHz, StackUnwinder unwinder)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    profilerUnwinder.store(unwinder, std::memory_order_relaxed);
+    if (m_openTransactions.empty())
+    {
+        if (unwinder == StackUnwinder::EH_FRAME)
+        {
+            Unwinder::refreshModules();     // the handler cannot
+        }
+        if (!arm(frequencyHz))
+        {
+#ifdef DEBUG_SENTRYCPP
+            LOG_SENTRY_DEBUG("Profiler not started, SIGPROF is used by the application or the timer failed");
+#endif
+            return false;
+        }
+    }
+    m_openTransactions.insert(startNanoseconds);
+    return true;
+}
+
+json Profiler::finish(int64_t startNanoseconds, int64_t endNanoseconds)
+{
+    json profile;
+    std::vector<void*> addresses;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        collect();
+
+        // the stacks and frames used by the samples within the transaction, every one once
+        json samples = json::array();
+        json stacks = json::array();
+        json threads = json::object();
+        std::unordered_map<uint32_t, size_t> stackIds;
+        std::unordered_map<uint32_t, size_t> frameIds;
+        for (const Sample& sample : m_samples)
+        {
+            if (sample.nanoseconds < startNanoseconds || sample.nanoseconds > endNanoseconds)
+                continue;
+
+            auto stackId = stackIds.find(sample.stack);
+            if (stackId == stackIds.end())
+            {
+                json stack = json::array();     // innermost frame first
+                for (uint32_t node = sample.stack; node != NO_STACK_NODE; node = m_stackNodes[node].parent)
+                {
+                    auto frameId = frameIds.emplace(m_stackNodes[node].frame, addresses.size());
+                    if (frameId.second)
+                    {
+                        addresses.push_back(m_frameAddresses[m_stackNodes[node].frame]);
+                    }
+                    stack.push_back(frameId.first->second);
+                }
+                stackId = stackIds.emplace(sample.stack, stacks.size()).first;
+                stacks.push_back(std::move(stack));
+            }
+
+            const std::string threadId = std::to_string(sample.threadId);
+            samples.push_back({{"elapsed_since_start_ns", std::to_string(sample.nanoseconds - startNanoseconds)},
+                               {"thread_id", threadId},
+                               {"stack_id", stackId->second}});
+            if (threads.find(threadId) == threads.end())
+            {
+                // unknown once the thread exited
+                const std::string name = threadName(sample.threadId);
+                threads[threadId] = name.empty() ? json::object() : json({{"name", name}});
+            }
+        }
+
+        if (!samples.empty())
+        {
+            profile["samples"] = std::move(samples);
+            profile["stacks"] = std::move(stacks);
+            profile["thread_metadata"] = std::move(threads);
+        }
+        release(startNanoseconds);
+    }
+
+    if (profile.is_null())
+        return profile;
+
+    // outside of the lock, profiled transactions may start meanwhile
+    backtraceHandler symbolizer(false);
+    const json symbolized = symbolizer.getStacktraceJSON(addresses.data(), addresses.size(), 0, 0);    // oldest first
+    json frames = json::array();
+    for (size_t i=0; i<addresses.size(); i++)
+    {
+        json frame = (symbolized.size() == addresses.size()) ? symbolized[addresses.size() - 1 - i] : json::object();
+        char address[2 + 16 + 1];
+        std::snprintf(address, sizeof(address), "0x%llx",
+                      static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(addresses[i])));
+        frame["instruction_addr"] = address;
+        frames.push_back(std::move(frame));
+    }
+    profile["frames"] = std::move(frames);
+    return profile;
+}
+
+void Profiler::cancel(int64_t startNanoseconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    release(startNanoseconds);
+}
+
+void Profiler::collectSamples()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collect();
+}
+
+void Profiler::collect()
+{
+    SdkStats& stats = SdkStats::instance();
+    stats.add(StatCounter::PROFILE_SAMPLES_DROPPED, ringDropped.exchange(0, std::memory_order_relaxed));
+
+    for (;;)
+    {
+        RingSample& ringSample = ringSamples[m_ringHead % PROFILER_RING_SAMPLES];
+        if (ringSample.sequence.load(std::memory_order_acquire) != m_ringHead + 1)
+            break;  // empty, or a handler is still writing
+
+        // late samples, after the last profiled transaction finished, are not needed
+        if (!m_openTransactions.empty() && ringSample.frameCount > 0)
+        {
+            const uint32_t stack = (m_samples.size() < PROFILER_MAX_SAMPLES)
+                                   ? insertStack(ringSample.frames, ringSample.frameCount) : NO_STACK_NODE;
+            if (stack != NO_STACK_NODE)
+            {
+                m_samples.push_back({ringSample.nanoseconds, ringSample.threadId, stack});
+                stats.add(StatCounter::PROFILE_SAMPLES);
+            }
+            else
+            {
+                stats.add(StatCounter::PROFILE_SAMPLES_DROPPED);
+            }
+        }
+
+        ringSample.sequence.store(m_ringHead + PROFILER_RING_SAMPLES, std::memory_order_release);
+        m_ringHead++;
+    }
+}
+
+uint32_t Profiler::insertStack(void* const* frames, size_t frameCount)
+{
+    // from the outermost frame, stacks sharing their callers share the nodes
+    uint32_t parent = NO_STACK_NODE;
+    for (size_t i = frameCount; i > 0; --i)
+    {
+        void* address = frames[i - 1];
+        auto frame = m_frameIndex.emplace(address, static_cast<uint32_t>(m_frameAddresses.size()));
+        if (frame.second)
+        {
+            m_frameAddresses.push_back(address);
+        }
+
+        const uint64_t key = (static_cast<uint64_t>(parent) << 32) | frame.first->second;
+        auto node = m_stackNodeIndex.find(key);
+        if (node == m_stackNodeIndex.end())
+        {
+            if (m_stackNodes.size() >= PROFILER_MAX_STACK_NODES)
+                return NO_STACK_NODE;
+
+            node = m_stackNodeIndex.emplace(key, static_cast<uint32_t>(m_stackNodes.size())).first;
+            m_stackNodes.push_back({parent, frame.first->second});
+        }
+        parent = node->second;
+    }
+    return parent;
+}
+
+void Profiler::release(int64_t startNanoseconds)
+{
+    auto transaction = m_openTransactions.find(startNanoseconds);
+    if (transaction != m_openTransactions.end())
+    {
+        m_openTransactions.erase(transaction);
+    }
+
+    if (m_openTransactions.empty())
+    {
+        disarm();
+        m_samples.clear();
+        m_stackNodes.clear();
+        m_stackNodeIndex.clear();
+        m_frameAddresses.clear();
+        m_frameIndex.clear();
+    }
+    else
+    {
+        const int64_t oldestStart = *m_openTransactions.begin();
+        while (!m_samples.empty() && m_samples.front().nanoseconds < oldestStart)
+        {
+            m_samples.pop_front();
+        }
+    }
+}
+
+bool Profiler::arm(int frequencyHz)
+{
+    if (!m_handlerInstalled)
+    {
+        // the signal may be used by the application already
+        struct sigaction previous;
+        if (sigaction(SIGPROF, nullptr, &previous) != 0
+            || (previous.sa_flags & SA_SIGINFO) != 0 || previous.sa_handler != SIG_DFL)
+        {
+            return false;
+        }
+
+        for (size_t i=0; i<PROFILER_RING_SAMPLES; i++)
+        {
+            ringSamples[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // loads libgcc now, the first backtrace() is not safe in a signal handler
+        void* warmUp[1];
+        backtrace(warmUp, 1);
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = sampleHandler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) != 0)
+        {
+            return false;
+        }
+        m_handlerInstalled = true;
+    }
+
+    if (!m_timerCreated)
+    {
+        struct sigevent event;
+        std::memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_SIGNAL;
+        event.sigev_signo = SIGPROF;
+        if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &m_timer) != 0)
+        {
+            return false;
+        }
+        m_timerCreated = true;
+    }
+
+    const uint64_t interval = NANOSECONDS_IN_SECOND
+                              / static_cast<uint64_t>(std::clamp(frequencyHz, PROFILER_MIN_FREQUENCY_HZ, PROFILER_MAX_FREQUENCY_HZ));
+    struct itimerspec timerSpec;
+    timerSpec.it_interval.tv_sec = static_cast<time_t>(interval / NANOSECONDS_IN_SECOND);
+    timerSpec.it_interval.tv_nsec = static_cast<long>(interval % NANOSECONDS_IN_SECOND);
+    timerSpec.it_value = timerSpec.it_interval;
+    return timer_settime(m_timer, 0, &timerSpec, nullptr) == 0;
+}
+
+void Profiler::disarm()
+{
+    if (m_timerCreated)
+    {
+        struct itimerspec timerSpec;
+        std::memset(&timerSpec, 0, sizeof(timerSpec));
+        timer_settime(m_timer, 0, &timerSpec, nullptr);
+    }
+}
+
+void Profiler::sampleHandler(int, siginfo_t*, void* context)
+{
+    const int savedErrno = errno;
+
+    size_t position = ringTail.load(std::memory_order_relaxed);
+    RingSample* sample = nullptr;
+    for (;;)
+    {
+        sample = &ringSamples[position % PROFILER_RING_SAMPLES];
+        const size_t sequence = sample->sequence.load(std::memory_order_acquire);
+        const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0)
+        {
+            if (ringTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // full, the slot was not collected since the previous round
+            ringDropped.fetch_add(1, std::memory_order_relaxed);
+            errno = savedErrno;
+            return;
+        }
+        else
+        {
+            position = ringTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    sample->nanoseconds = static_cast<int64_t>(now.tv_sec) * static_cast<int64_t>(NANOSECONDS_IN_SECOND) + now.tv_nsec;
+    sample->threadId = static_cast<pid_t>(syscall(SYS_gettid));
+    sample->frameCount = Unwinder::unwindContext(profilerUnwinder.load(std::memory_order_relaxed), context,
+                                                 sample->frames, PROFILER_MAX_FRAMES);
+    sample->sequence.store(position + 1, std::memory_order_release);
+
+    errno = savedErrno;
+}
+
+} // namespace Sentry
@@ -0,0 +1,117 @@
+#ifndef SENTRY_PROFILER_H
+#define SENTRY_PROFILER_H
+
+#include "json.h"
+#include "sentry.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <signal.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * Statistical CPU profiler for the profiled transactions (SentryOptions::profilesSampleRate).
+ *
+ * While a profiled transaction is open, a timer on the CPU time of the process sends SIGPROF every
+ * 1/frequency seconds of CPU time; the kernel delivers it to a thread that is running, so busy threads are
+ * sampled at the frequency and idle ones are not. The handler walks the interrupted stack with the configured
+ * unwinder (unwinder.h) and claims a slot of a static multi-producer ring with a compare and swap - no lock,
+ * no allocation. A full ring drops the sample.
+ *
+ * The hub moves the samples to a prefix trie of the stacks on the transport thread, so a stack seen before
+ * costs no memory but its sample. When a profiled transaction is sent, the samples within it become its profile
+ * (the sample format of Sentry profiles): every stack and frame once, symbolized only then with backtraceHandler.
+ * The samples older than every open profiled transaction are discarded, the trie once none is open.
+ *
+ * The handler costs a few microseconds per sample, at most PROFILER_MAX_FREQUENCY_HZ keeps it well below 1%
+ * of a core. The application must not use SIGPROF (e.g. gprof), the profiler stays off then. A blocking call
+ * of a sampled thread may return early with EINTR.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t PROFILER_MAX_FRAMES = 64;
+constexpr size_t PROFILER_RING_SAMPLES = 2048;      // a drain a second keeps up with 20 busy threads at 100 Hz
+constexpr size_t PROFILER_MAX_SAMPLES = 60000;      // kept for the open profiled transactions
+constexpr size_t PROFILER_MAX_STACK_NODES = 65536;
+constexpr int PROFILER_MIN_FREQUENCY_HZ = 1;
+constexpr int PROFILER_MAX_FREQUENCY_HZ = 250;
+}
+
+namespace Sentry
+{
+
+class Profiler
+{
+public:
+
+    static Profiler& instance();
+
+    // a profiled transaction started, the first arms the timer; false if the profiler cannot run
+    bool start(int64_t startNanoseconds, int frequencyHz, StackUnwinder unwinder);
+    // a profiled transaction finished: the "profile" of an envelope item with the samples between start and end,
+    // null if there are none; the last one disarms the timer
+    json finish(int64_t startNanoseconds, int64_t endNanoseconds);
+    // a profiled transaction dropped without a profile
+    void cancel(int64_t startNanoseconds);
+
+    // moves the samples of the ring to the trie, not from a signal handler
+    void collectSamples();
+
+private:
+
+    Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    Profiler(const Profiler&&) = delete;
+    Profiler&& operator=(const Profiler&&) = delete;
+
+    struct StackNode
+    {
+        uint32_t parent;    // NO_STACK_NODE for the outermost frame
+        uint32_t frame;     // index to m_frameAddresses
+    };
+
+    struct Sample
+    {
+        int64_t nanoseconds;    // steady clock
+        pid_t threadId;
+        uint32_t stack;         // the innermost node
+    };
+
+    static void sampleHandler(int sig, siginfo_t* info, void* context);
+
+    bool arm(int frequencyHz);
+    void disarm();
+    // removes start from the open transactions, the samples and stacks no longer needed
+    void release(int64_t startNanoseconds);
+
+    uint32_t insertStack(void* const* frames, size_t frameCount);   // innermost first
+    void collect();
+
+    std::mutex m_mutex;
+    bool m_handlerInstalled;
+    bool m_timerCreated;
+    timer_t m_timer;
+    std::multiset<int64_t> m_openTransactions;  // start times
+
+    size_t m_ringHead;  // next sample of the ring to collect
+    std::deque<Sample> m_samples;
+    std::vector<StackNode> m_stackNodes;
+    std::unordered_map<uint64_t, uint32_t> m_stackNodeIndex;        // (parent, frame) to node
+    std::vector<void*> m_frameAddresses;
+    std::unordered_map<void*, uint32_t> m_frameIndex;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_PROFILER_H
@@ -0,0 +1,275 @@
+#include "remoteprocess.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <sys/user.h>
+#elif defined(__aarch64__)
+#include <asm/ptrace.h>
+#endif
+
+
+namespace Sentry
+{
+
+RemoteProcess::RemoteProcess(pid_t pid)
+:
+m_pid(pid),
+m_threads(),
+m_mappings()
+{
+
+}
+
+RemoteProcess::~RemoteProcess()
+{
+    detach();
+}
+
+bool RemoteProcess::attach()
+{
+    const std::string tasksPath = "/proc/" + std::to_string(m_pid) + "/task";
+    DIR* tasks = opendir(tasksPath.c_str());
+    if (tasks == nullptr)
+    {
+        return false;
+    }
+
+    while (struct dirent* entry = readdir(tasks))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        Thread thread;
+        thread.id = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+
+        std::ifstream comm(tasksPath + "/" + entry->d_name + "/comm");
+        std::getline(comm, thread.name);
+
+        m_threads.push_back(std::move(thread));
+    }
+    closedir(tasks);
+
+    bool anyStopped = false;
+    for (auto& thread : m_threads)
+    {
+        anyStopped = stopThread(thread) || anyStopped;
+    }
+
+    readMappings();
+    return anyStopped;
+}
+
+bool RemoteProcess::stopThread(Thread& thread)
+{
+    // PTRACE_SEIZE does not send a SIGSTOP the process could see, PTRACE_INTERRUPT stops the thread
+    if (ptrace(PTRACE_SEIZE, thread.id, nullptr, nullptr) != 0)
+    {
+        return false;
+    }
+    if (ptrace(PTRACE_INTERRUPT, thread.id, nullptr, nullptr) != 0)
+    {
+        ptrace(PTRACE_DETACH, thread.id, nullptr, nullptr);
+        return false;
+    }
+
+    int status = 0;
+    if (waitpid(thread.id, &status, __WALL) != thread.id || !WIFSTOPPED(status))
+    {
+        return false;   // exited in the meantime
+    }
+    if ((status >> 16) == 0)
+    {
+        // a signal-delivery-stop came before the interrupt, the signal is swallowed unless passed on detach
+        thread.pendingSignal = WSTOPSIG(status);
+    }
+    thread.stopped = true;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#if defined(__x86_64__)
+    struct user_regs_struct registers;
+#else
+    struct user_pt_regs registers;
+#endif
+    struct iovec registersVector = {&registers, sizeof(registers)};
+    if (ptrace(PTRACE_GETREGSET, thread.id, reinterpret_cast<void*>(NT_PRSTATUS), &registersVector) == 0)
+    {
+#if defined(__x86_64__)
+        thread.registers.instructionPointer = registers.rip;
+        thread.registers.stackPointer = registers.rsp;
+        thread.registers.framePointer = registers.rbp;
+#else
+        thread.registers.instructionPointer = registers.pc;
+        thread.registers.stackPointer = registers.sp;
+        thread.registers.framePointer = registers.regs[29];
+#endif
+    }
+#endif // other architectures are listed without stacks
+    return true;
+}
+
+void RemoteProcess::detach()
+{
+    for (auto& thread : m_threads)
+    {
+        if (thread.stopped)
+        {
+            ptrace(PTRACE_DETACH, thread.id, nullptr, reinterpret_cast<void*>(static_cast<intptr_t>(thread.pendingSignal)));
+            thread.stopped = false;
+        }
+    }
+}
+
+std::vector<RemoteProcess::Thread>& RemoteProcess::threads()
+{
+    return m_threads;
+}
+
+void RemoteProcess::unwind(Thread& thread, size_t maxFrames)
+{
+    thread.frames.clear();
+    if (thread.registers.instructionPointer == 0 && thread.registers.stackPointer == 0)
+    {
+        return;     // no registers
+    }
+    thread.frames.push_back(thread.registers.instructionPointer);
+
+    // x86_64 and aarch64 alike: the frame pointer points at the saved frame pointer of the caller,
+    // followed by the return address
+    uint64_t stackPointer = thread.registers.stackPointer;
+    uint64_t framePointer = thread.registers.framePointer;
+    ObjectAddress ignored;
+    while (thread.frames.size() < maxFrames)
+    {
+        if (framePointer < stackPointer || framePointer - stackPointer > REMOTE_MAX_STACK_BYTES || (framePointer & 7) != 0)
+            break;
+
+        uint64_t frameRecord[2];
+        if (!readMemory(framePointer, frameRecord, sizeof(frameRecord)))
+            break;
+
+        const uint64_t returnAddress = frameRecord[1];
+        if (!resolve(returnAddress, &ignored))
+            break;      // not code, the frame pointer was used as a general register
+        thread.frames.push_back(returnAddress);
+
+        if (frameRecord[0] <= framePointer)
+            break;      // the stack grows down, the callers' frames are above
+        stackPointer = framePointer;
+        framePointer = frameRecord[0];
+    }
+}
+
+bool RemoteProcess::resolve(uint64_t address, ObjectAddress* objectAddress) const
+{
+    auto mapping = std::upper_bound(m_mappings.begin(), m_mappings.end(), address,
+                                    [](uint64_t value, const Mapping& m) { return value < m.start; });
+    if (mapping == m_mappings.begin())
+    {
+        return false;
+    }
+    --mapping;
+    if (address >= mapping->end)
+    {
+        return false;
+    }
+
+    objectAddress->file = mapping->file;
+    objectAddress->address = address - mapping->base;
+    return true;
+}
+
+bool RemoteProcess::readMemory(uint64_t address, void* buffer, size_t size) const
+{
+    struct iovec local = {buffer, size};
+    struct iovec remote = {reinterpret_cast<void*>(address), size};
+    return process_vm_readv(m_pid, &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+}
+
+void RemoteProcess::readMappings()
+{
+    m_mappings.clear();
+
+    // 'start-end perms offset dev inode path'
+    std::ifstream maps("/proc/" + std::to_string(m_pid) + "/maps");
+    std::map<std::string, uint64_t> loadAddresses;     // of the lowest mapping of every file
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        unsigned long start = 0;
+        unsigned long end = 0;
+        unsigned long offset = 0;
+        char permissions[5] = {};
+        int pathStart = 0;
+        if (std::sscanf(line.c_str(), "%lx-%lx %4s %lx %*s %*u %n", &start, &end, permissions, &offset, &pathStart) < 4
+            || pathStart == 0)
+            continue;
+
+        const std::string file = line.substr(static_cast<size_t>(pathStart));
+        if (file.empty() || file[0] != '/' || file.find(" (deleted)") != std::string::npos)
+            continue;   // anonymous, [vdso] etc.
+
+        auto loadAddress = loadAddresses.find(file);
+        if (loadAddress == loadAddresses.end() || start - offset < loadAddress->second)
+        {
+            loadAddresses[file] = start - offset;
+        }
+
+        if (permissions[2] == 'x')
+        {
+            Mapping mapping;
+            mapping.start = start;
+            mapping.end = end;
+            mapping.file = file;
+            m_mappings.push_back(std::move(mapping));
+        }
+    }
+
+    // addresses in executables (not position independent) are the ones of the file
+    std::map<std::string, bool> sharedObjects;
+    for (auto& mapping : m_mappings)
+    {
+        auto sharedObject = sharedObjects.find(mapping.file);
+        if (sharedObject == sharedObjects.end())
+        {
+            sharedObject = sharedObjects.emplace(mapping.file, isSharedObject(mapping.file)).first;
+        }
+        mapping.base = sharedObject->second ? loadAddresses[mapping.file] : 0;
+    }
+    std::sort(m_mappings.begin(), m_mappings.end(), [](const Mapping& a, const Mapping& b) { return a.start < b.start; });
+}
+
+bool RemoteProcess::isSharedObject(const std::string& file)
+{
+    // e_type follows e_ident in the 32 and 64 bit headers alike
+    unsigned char header[EI_NIDENT + sizeof(Elf64_Half)];
+    const int descriptor = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        return true;
+    }
+    const bool complete = read(descriptor, header, sizeof(header)) == static_cast<ssize_t>(sizeof(header));
+    close(descriptor);
+    if (!complete || std::memcmp(header, ELFMAG, SELFMAG) != 0)
+    {
+        return true;
+    }
+
+    Elf64_Half type;
+    std::memcpy(&type, header + EI_NIDENT, sizeof(type));
+    return type == ET_DYN;
+}
+
+} // namespace Sentry
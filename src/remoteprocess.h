@@ -0,0 +1,104 @@
+#ifndef SENTRY_REMOTEPROCESS_H
+#define SENTRY_REMOTEPROCESS_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+
+/*
+ * Inspects another (stopped) process: its threads, their registers and stacks, and the object files
+ * mapped into it. Used by the crash handler process (crashhandler.h), which must not trust the memory
+ * of the crashed process - everything is read with process_vm_readv and every pointer is checked.
+ *
+ * The stacks are walked along the frame pointers, which needs the code to keep them
+ * (-fno-omit-frame-pointer); a frame without one ends the walk or skips its caller.
+ */
+
+namespace
+{
+constexpr size_t REMOTE_MAX_FRAMES = 128;
+constexpr uint64_t REMOTE_MAX_STACK_BYTES = 64 * 1024 * 1024;  // a frame pointer further from the stack pointer is garbage
+}
+
+namespace Sentry
+{
+
+class RemoteProcess
+{
+public:
+
+    class Registers
+    {
+    public:
+        uint64_t instructionPointer = 0;
+        uint64_t stackPointer = 0;
+        uint64_t framePointer = 0;
+    };
+
+    class Thread
+    {
+    public:
+        pid_t id = 0;
+        std::string name;
+        bool stopped = false;           // attached and its registers read
+        int pendingSignal = 0;          // reported while stopping it, delivered again on detach
+        Registers registers;
+        std::vector<uint64_t> frames;   // instruction pointer, then the return addresses, newest first
+    };
+
+    // a frame resolved to the object file it is in
+    class ObjectAddress
+    {
+    public:
+        std::string file;
+        uint64_t address = 0;           // relative to the load base of the file, as in its symbol table
+    };
+
+    explicit RemoteProcess(pid_t pid);
+    ~RemoteProcess();   // detaches
+
+    // stops every thread (the process must allow it, see PR_SET_PTRACER) and reads the mapped files,
+    // false if no thread could be stopped
+    bool attach();
+    void detach();
+
+    std::vector<Thread>& threads();
+
+    // from the registers of the thread, which may be overwritten before (e.g. with the context of a signal)
+    void unwind(Thread& thread, size_t maxFrames = REMOTE_MAX_FRAMES);
+
+    // false for addresses outside of the executable mappings
+    bool resolve(uint64_t address, ObjectAddress* objectAddress) const;
+
+    bool readMemory(uint64_t address, void* buffer, size_t size) const;
+
+private:
+
+    class Mapping
+    {
+    public:
+        uint64_t start = 0;
+        uint64_t end = 0;
+        uint64_t base = 0;      // subtracted from the addresses to get the ones of the file
+        std::string file;
+    };
+
+    RemoteProcess(const RemoteProcess&) = delete;
+    RemoteProcess& operator=(const RemoteProcess&) = delete;
+    RemoteProcess(const RemoteProcess&&) = delete;
+    RemoteProcess&& operator=(const RemoteProcess&&) = delete;
+
+    bool stopThread(Thread& thread);
+    void readMappings();
+    static bool isSharedObject(const std::string& file);
+
+    pid_t m_pid;
+    std::vector<Thread> m_threads;
+    std::vector<Mapping> m_mappings;    // executable ones, sorted by start
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_REMOTEPROCESS_H
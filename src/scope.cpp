@@ -2,6 +2,7 @@
 
 #include "sentry_common.h"
 
+#include <algorithm>
 #include <unistd.h> //gethostname
 
 
@@ -10,6 +11,35 @@ using json = nlohmann::json;
 namespace Sentry
 {
 
+json Breadcrumb::toJSON() const
+{
+    char formattedTimestamp[sizeof("2011-10-08T07:07:09Z")];
+    struct tm timestampStruct = {};
+    gmtime_r(&timestamp, &timestampStruct);
+    strftime(formattedTimestamp, sizeof(formattedTimestamp), "%FT%TZ", &timestampStruct);
+
+    json crumb =
+    {
+        {"timestamp", formattedTimestamp},
+        {"type", type.str()},
+        {"level", level.str()},
+        {"category", category.str()},
+    };
+    if (!data.is_null())
+    {
+        crumb["data"] = data;
+    }
+    if (!message.empty())
+    {
+        crumb["message"] = message;
+    }
+    else if (!logMessage.empty())
+    {
+        crumb["message"] = logMessage.format();
+    }
+    return crumb;
+}
+
 Scope::Scope()
 :
 m_userName(),
@@ -18,8 +48,16 @@ m_release(),
 m_level(EventLevel::LEVEL_INFO),
 m_maxBreadcrumbs(100),
 m_breadcrumbs(),
+m_breadcrumbsBegin(0),
+m_breadcrumbsCount(0),
 m_extras(),
-m_tags()
+m_tags(),
+m_tagsFragment(),
+m_extrasFragment(),
+m_breadcrumbsFragment(),
+m_eventLimits(),
+m_eventProcessors(),
+m_attachments()
 {
     clear();
     setDefaultTags();
@@ -57,21 +95,39 @@ void Scope::setTransaction(const std::string& transaction_name)
 void Scope::setExtra(const std::string& key, const std::string& value="")
 {
     setValueMap(key, value, &m_extras);
+    m_extrasFragment.valid = false;
 }
 
 void Scope::setExtras(json extras)
 {
     m_extras.insert(extras.begin(), extras.end());
+    m_extrasFragment.valid = false;
 }
 
 void Scope::setTag(const std::string& key, const std::string& value)
 {
-    setValueMap(key, value, &m_tags);
+    const InternedString internedKey(key);
+    if (value == "")
+    {
+        m_tags.erase(internedKey);
+    }
+    else
+    {
+        m_tags.emplace(internedKey, value);
+    }
+    m_tagsFragment.valid = false;
 }
 
 void Scope::setTags(json tags)
 {
-    m_tags.insert(tags.begin(), tags.end());
+    for (const auto& tag : tags.items())
+    {
+        if (tag.value().is_string())
+        {
+            m_tags.emplace(InternedString(tag.key()), tag.value().get<std::string>());
+        }
+    }
+    m_tagsFragment.valid = false;
 }
 
 void Scope::setLevel(EventLevel level)
@@ -84,34 +140,111 @@ void Scope::setRelease(const std::string& release)
     m_release = release;
 }
 
-void Scope::addBreadcrumb(json crumb)
+Scope::StoredBreadcrumb& Scope::breadcrumbAt(size_t i)
+{
+    return m_breadcrumbs[(m_breadcrumbsBegin + i) % m_breadcrumbs.size()];
+}
+
+void Scope::addBreadcrumb(Breadcrumb crumb)
 {
-    m_breadcrumbs.push_back(crumb);
-    if (m_breadcrumbs.size() > m_maxBreadcrumbs)
+    if (m_maxBreadcrumbs == 0)
+        return;
+
+    if (m_breadcrumbs.size() < m_maxBreadcrumbs)
     {
-        m_breadcrumbs.pop_front();
+        m_breadcrumbs.resize(m_maxBreadcrumbs);
     }
+
+    StoredBreadcrumb* slot;
+    if (m_breadcrumbsCount < m_maxBreadcrumbs)
+    {
+        slot = &breadcrumbAt(m_breadcrumbsCount++);
+    }
+    else
+    {
+        // overwrite the oldest one
+        slot = &breadcrumbAt(0);
+        m_breadcrumbsBegin = (m_breadcrumbsBegin + 1) % m_breadcrumbs.size();
+    }
+    slot->crumb = std::move(crumb);
+    slot->isSerialized = false;     // keeps the capacity of the serialized string for reuse
+
+    m_breadcrumbsFragment.valid = false;
+}
+
+void Scope::addEventProcessor(EventProcessor processor)
+{
+    m_eventProcessors.addEventProcessor(std::move(processor));
+}
+
+void Scope::addErrorProcessor(EventProcessor processor)
+{
+    m_eventProcessors.addErrorProcessor(std::move(processor));
 }
 
 void Scope::clearBreadcrumbs()
 {
     m_breadcrumbs.clear();
+    m_breadcrumbsBegin = 0;
+    m_breadcrumbsCount = 0;
+    m_breadcrumbsFragment.valid = false;
+}
+
+void Scope::addAttachment(Attachment attachment)
+{
+    m_attachments.push_back(std::move(attachment));
+}
+
+void Scope::clearAttachments()
+{
+    m_attachments.clear();
+}
+
+const std::vector<Attachment>& Scope::getAttachments() const
+{
+    return m_attachments;
 }
 
 void Scope::clear()
 {
     //TODO set default values!!!
     clearBreadcrumbs();
+    clearAttachments();
 }
 
 void Scope::setMaxBreadcrumbs(uint16_t maxBreadcrumbs)
 {
+    // keep the newest breadcrumbs, in order
+    std::vector<StoredBreadcrumb> breadcrumbs;
+    const size_t kept = std::min<size_t>(m_breadcrumbsCount, maxBreadcrumbs);
+    breadcrumbs.reserve(maxBreadcrumbs);
+    for (size_t i = m_breadcrumbsCount - kept; i < m_breadcrumbsCount; i++)
+    {
+        breadcrumbs.push_back(std::move(breadcrumbAt(i)));
+    }
+
     m_maxBreadcrumbs = maxBreadcrumbs;
+    m_breadcrumbs = std::move(breadcrumbs);
+    m_breadcrumbsBegin = 0;
+    m_breadcrumbsCount = kept;
+    m_breadcrumbsFragment.valid = false;
+}
+
+void Scope::setEventLimits(const EventLimits& limits)
+{
+    m_eventLimits = limits;
+    m_tagsFragment.valid = false;
+    m_extrasFragment.valid = false;
+    m_breadcrumbsFragment.valid = false;
+    for (size_t i=0; i<m_breadcrumbsCount; i++)
+    {
+        breadcrumbAt(i).isSerialized = false;
+    }
 }
 
 void Scope::applyToEvent(json &event)
 {
-    if (!m_breadcrumbs.empty())
+    if (m_breadcrumbsCount > 0)
         event.push_back({"breadcrumbs", getBreadcrumbs()});
     if (!m_tags.empty())
         event.push_back({"tags", getTags()});
@@ -127,6 +260,92 @@ void Scope::applyToEvent(json &event)
     //event.push_back({"fingerprint", }) //TODO
 }
 
+std::string Scope::serializeEvent(const json& event)
+{
+    // event keys take precedence over the scope, as in applyToEvent
+    auto missing = [&event](const char* key) { return event.find(key) == event.end(); };
+
+    if (!event.is_object())
+    {
+        return EventSerializer::serialize(event, m_eventLimits);  // nothing to splice into
+    }
+
+    EventSerializer serializer(m_eventLimits);
+    serializer.appendEvent(event);
+
+    if (missing("level"))
+        serializer.appendMember("level", json(getLevelStr()).dump());
+    if (m_release != "" && missing("release"))
+        serializer.appendMember("release", json(m_release).dump());
+    if (m_transactionName != "" && missing("transaction"))
+        serializer.appendMember("transaction", json(m_transactionName).dump());
+    if (!m_tags.empty() && missing("tags"))
+        serializer.appendMember("tags", getTagsFragment());
+    if (!m_extras.empty() && missing("extra"))
+        serializer.appendMember("extra", getExtrasFragment());
+    if (m_breadcrumbsCount > 0 && missing("breadcrumbs"))
+    {
+        const std::string& fragment = getBreadcrumbsFragment();
+        std::vector<const std::string*> breadcrumbs;
+        breadcrumbs.reserve(m_breadcrumbsCount);
+        for (size_t i=0; i<m_breadcrumbsCount; i++)
+        {
+            breadcrumbs.push_back(&breadcrumbAt(i).serialized);
+        }
+        serializer.setBreadcrumbs(fragment, std::move(breadcrumbs));
+    }
+
+    return serializer.finish();
+}
+
+const std::string& Scope::getTagsFragment()
+{
+    if (!m_tagsFragment.valid)
+    {
+        m_tagsFragment.contents = EventSerializer::serialize(getTags(), m_eventLimits);
+        m_tagsFragment.valid = true;
+    }
+    return m_tagsFragment.contents;
+}
+
+const std::string& Scope::getExtrasFragment()
+{
+    if (!m_extrasFragment.valid)
+    {
+        m_extrasFragment.contents = EventSerializer::serialize(m_extras, m_eventLimits);
+        m_extrasFragment.valid = true;
+    }
+    return m_extrasFragment.contents;
+}
+
+const std::string& Scope::getBreadcrumbsFragment()
+{
+    if (!m_breadcrumbsFragment.valid)
+    {
+        // only breadcrumbs added since the last event are serialized, the rest is concatenated
+        std::string& contents = m_breadcrumbsFragment.contents;
+        contents.assign("{\"values\":[");
+        for (size_t i=0; i<m_breadcrumbsCount; i++)
+        {
+            StoredBreadcrumb& stored = breadcrumbAt(i);
+            if (!stored.isSerialized)
+            {
+                stored.serialized.assign(EventSerializer::serialize(stored.crumb.toJSON(), m_eventLimits));
+                stored.isSerialized = true;
+            }
+            contents.append(stored.serialized);
+            contents.push_back(',');
+        }
+        if (contents.back() == ',')
+        {
+            contents.pop_back();
+        }
+        contents.append("]}");
+        m_breadcrumbsFragment.valid = true;
+    }
+    return m_breadcrumbsFragment.contents;
+}
+
 void Scope::setValueMap(std::string key, std::string value, json* map_object)
 {
     if (value == "")
@@ -159,7 +378,12 @@ json Scope::getExtras()
 
 json Scope::getTags()
 {
-    return m_tags;
+    json tags = json::object();
+    for (const auto& tag : m_tags)
+    {
+        tags[tag.first.str()] = tag.second;
+    }
+    return tags;
 }
 
 json Scope::getContexts()
@@ -184,11 +408,27 @@ std::string Scope::getLevelStr()
 
 json Scope::getBreadcrumbs()
 {
+    json values = json::array();
+    for (size_t i=0; i<m_breadcrumbsCount; i++)
+    {
+        values.push_back(breadcrumbAt(i).crumb.toJSON());
+    }
+
     json breadcrumbs;
-    breadcrumbs["values"] = m_breadcrumbs;
+    breadcrumbs["values"] = values;
     return breadcrumbs;
 }
 
+const EventProcessorPipeline& Scope::getEventProcessors() const
+{
+    return m_eventProcessors;
+}
+
+EventProcessorPipeline& Scope::getEventProcessors()
+{
+    return m_eventProcessors;
+}
+
 } // namespace Sentry'
 
 
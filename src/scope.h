@@ -1,12 +1,18 @@
 #ifndef SENTRY_SCOPE_H
 #define SENTRY_SCOPE_H
 
+#include "envelope.h"
+#include "eventprocessor.h"
+#include "eventserializer.h"
 #include "sentry_common.h"
+#include "sentry_log.h"
+#include "stringinterner.h"
 #include "json.h"
 
 #include <iostream>
-#include <list>
+#include <ctime>
 #include <map>
+#include <vector>
 
 
 /*
@@ -22,9 +28,24 @@ namespace Sentry
 namespace sentry_types
 {
 using Extras = std::map<std::string, std::string>;
-using Tags = std::map<std::string, std::string>;
+using Tags = std::map<InternedString, std::string>;     // keys repeat across scopes and events
 }
 
+// repeating fields are interned, each breadcrumb stores only handles for them
+// timestamp and logMessage are formatted only when the breadcrumb is serialized
+struct Breadcrumb
+{
+    time_t timestamp = 0;
+    InternedString type;
+    InternedString level;
+    InternedString category;
+    std::string message;
+    LogMessage logMessage;  // used if message is empty
+    json data;
+
+    json toJSON() const;
+};
+
 class Scope
 {
 
@@ -33,6 +54,8 @@ public:
     Scope();
 
     void setMaxBreadcrumbs(uint16_t maxBreadcrumbs);
+    // the fragments and breadcrumbs are serialized within these
+    void setEventLimits(const EventLimits& limits);
     void setUser(const std::string& user);
     void setExtra(const std::string& key, const std::string& value);
     void setExtras(json extras);
@@ -43,12 +66,19 @@ public:
     void setTransaction(const std::string& transaction_name);
     void setRelease(const std::string& release);
     //void set_fingerprint(xxx);
-    //void add_event_processor(processor);
-    //void add_error_processor(processor);
+    void addEventProcessor(EventProcessor processor);
+    void addErrorProcessor(EventProcessor processor);
     void clear();
-    void addBreadcrumb(json crumb);
+    void addBreadcrumb(Breadcrumb crumb);
     void clearBreadcrumbs();
+    // sent with the error events, not applied to the event itself
+    void addAttachment(Attachment attachment);
+    void clearAttachments();
+    const std::vector<Attachment>& getAttachments() const;
     void applyToEvent(json &event);
+    // same as applyToEvent followed by dump, but splices cached fragments instead of copying the scope,
+    // within the event limits
+    std::string serializeEvent(const json& event);
 
     // change to json all !
     const std::string& getUser();
@@ -62,6 +92,10 @@ public:
     json getContexts();
     json getBreadcrumbs();
 
+    // lock-free, can be used without holding the scope lock
+    const EventProcessorPipeline& getEventProcessors() const;
+    EventProcessorPipeline& getEventProcessors();
+
 private:
 
     Scope(const Scope&) = delete;
@@ -72,19 +106,51 @@ private:
     void setDefaultTags();
     void setValueMap(std::string key, std::string value, json* map_object);
 
+    // pre-serialized JSON of a scope member, rebuilt only after a setter changed the member
+    struct SerializedFragment
+    {
+        std::string contents;
+        bool valid = false;
+    };
+
+    const std::string& getTagsFragment();
+    const std::string& getExtrasFragment();
+    const std::string& getBreadcrumbsFragment();
+
     std::string m_userName;
     std::string m_transactionName;
     std::string m_release;
     EventLevel m_level;
     std::vector<std::string> m_fingerprint;
 
+    // ring buffer slot, the serialized form is built once, when the breadcrumbs are first sent
+    struct StoredBreadcrumb
+    {
+        Breadcrumb crumb;
+        std::string serialized;
+        bool isSerialized = false;
+    };
+
+    // oldest to newest, i-th breadcrumb
+    StoredBreadcrumb& breadcrumbAt(size_t i);
+
     uint16_t m_maxBreadcrumbs;
-    std::list<json> m_breadcrumbs;
+    std::vector<StoredBreadcrumb> m_breadcrumbs;    // slots are reused, no allocation per breadcrumb
+    size_t m_breadcrumbsBegin;                      // slot of the oldest breadcrumb
+    size_t m_breadcrumbsCount;
 
     json m_extras;
-    json m_tags;
+    sentry_types::Tags m_tags;
     json m_contexts;
 
+    SerializedFragment m_tagsFragment;
+    SerializedFragment m_extrasFragment;
+    SerializedFragment m_breadcrumbsFragment;
+    EventLimits m_eventLimits;
+
+    EventProcessorPipeline m_eventProcessors;
+
+    std::vector<Attachment> m_attachments;
 };
 
 } // namespace Sentry
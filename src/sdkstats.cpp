@@ -0,0 +1,144 @@
+#include "sdkstats.h"
+
+#include <sched.h>
+
+
+namespace Sentry
+{
+
+SdkStats& SdkStats::instance()
+{
+    // never destroyed - counters can still be updated by the transport worker during exit
+    static SdkStats* stats = new SdkStats();
+    return *stats;
+}
+
+SdkStats::SdkStats()
+:
+m_shards()
+{
+    for (auto& shard : m_shards)
+    {
+        for (auto& counter : shard.counters)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& bucket : shard.httpLatencyHistogram)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+SdkStats::Shard& SdkStats::shard()
+{
+    const int cpu = sched_getcpu();
+    return m_shards[(cpu < 0) ? 0 : static_cast<size_t>(cpu) % NUMBER_OF_SHARDS];
+}
+
+void SdkStats::recordHttpLatency(std::chrono::nanoseconds latency)
+{
+    uint64_t microseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket < SdkStatistics::HTTP_LATENCY_BUCKETS - 1)
+    {
+        microseconds >>= 1;
+        bucket++;
+    }
+    shard().httpLatencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+SdkStatistics SdkStats::snapshot() const
+{
+    uint64_t totals[static_cast<size_t>(StatCounter::SIZE)] = {};
+    SdkStatistics statistics;
+
+    for (const auto& shard : m_shards)
+    {
+        for (size_t i=0; i<static_cast<size_t>(StatCounter::SIZE); i++)
+        {
+            totals[i] += shard.counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i=0; i<SdkStatistics::HTTP_LATENCY_BUCKETS; i++)
+        {
+            statistics.httpLatencyHistogram[i] += shard.httpLatencyHistogram[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    auto total = [&totals](StatCounter counter) { return totals[static_cast<size_t>(counter)]; };
+
+    // queue depth is incremented and decremented on different shards - only the sum is meaningful
+    statistics.queueDepth = total(StatCounter::QUEUE_DEPTH);
+    statistics.eventsCaptured = total(StatCounter::EVENTS_CAPTURED);
+    statistics.eventsSampledOut = total(StatCounter::EVENTS_SAMPLED_OUT);
+    statistics.eventsRateLimited = total(StatCounter::EVENTS_RATE_LIMITED);
+    statistics.eventsDropped = total(StatCounter::EVENTS_DROPPED);
+    statistics.eventsSent = total(StatCounter::EVENTS_SENT);
+    statistics.eventsFailed = total(StatCounter::EVENTS_FAILED);
+    statistics.bytesSent = total(StatCounter::BYTES_SENT);
+    statistics.symbolizations = total(StatCounter::SYMBOLIZATIONS);
+    statistics.symbolizationTimeNs = total(StatCounter::SYMBOLIZATION_TIME_NS);
+    statistics.serializations = total(StatCounter::SERIALIZATIONS);
+    statistics.serializationTimeNs = total(StatCounter::SERIALIZATION_TIME_NS);
+    statistics.tlsHandshakes = total(StatCounter::TLS_HANDSHAKES);
+    statistics.tlsSessionsResumed = total(StatCounter::TLS_SESSIONS_RESUMED);
+    statistics.stacktraceCacheHits = total(StatCounter::STACKTRACE_CACHE_HITS);
+    statistics.stacktraceCacheMisses = total(StatCounter::STACKTRACE_CACHE_MISSES);
+    statistics.stacktraceCacheEntries = total(StatCounter::STACKTRACE_CACHE_ENTRIES);
+    statistics.stacktraceCacheBytes = total(StatCounter::STACKTRACE_CACHE_BYTES);
+    statistics.transactionsSent = total(StatCounter::TRANSACTIONS_SENT);
+    statistics.spansDropped = total(StatCounter::SPANS_DROPPED);
+    statistics.profilesSent = total(StatCounter::PROFILES_SENT);
+    statistics.profileSamples = total(StatCounter::PROFILE_SAMPLES);
+    statistics.profileSamplesDropped = total(StatCounter::PROFILE_SAMPLES_DROPPED);
+    statistics.sessionUpdatesSent = total(StatCounter::SESSION_UPDATES_SENT);
+    statistics.requestSessionsSent = total(StatCounter::REQUEST_SESSIONS_SENT);
+    statistics.metricsSent = total(StatCounter::METRICS_SENT);
+    statistics.metricValuesDropped = total(StatCounter::METRIC_VALUES_DROPPED);
+    statistics.attachmentsSent = total(StatCounter::ATTACHMENTS_SENT);
+    statistics.eventsTruncated = total(StatCounter::EVENTS_TRUNCATED);
+    statistics.eventsCoalesced = total(StatCounter::EVENTS_COALESCED);
+
+    return statistics;
+}
+
+json SdkStats::toJSON(const SdkStatistics& statistics)
+{
+    return
+    {
+        {"queue_depth", statistics.queueDepth},
+        {"events_captured", statistics.eventsCaptured},
+        {"events_sampled_out", statistics.eventsSampledOut},
+        {"events_rate_limited", statistics.eventsRateLimited},
+        {"events_dropped", statistics.eventsDropped},
+        {"events_sent", statistics.eventsSent},
+        {"events_failed", statistics.eventsFailed},
+        {"bytes_sent", statistics.bytesSent},
+        {"http_latency_histogram_us", statistics.httpLatencyHistogram},
+        {"symbolizations", statistics.symbolizations},
+        {"symbolization_time_ns", statistics.symbolizationTimeNs},
+        {"serializations", statistics.serializations},
+        {"serialization_time_ns", statistics.serializationTimeNs},
+        {"tls_handshakes", statistics.tlsHandshakes},
+        {"tls_sessions_resumed", statistics.tlsSessionsResumed},
+        {"stacktrace_cache_hits", statistics.stacktraceCacheHits},
+        {"stacktrace_cache_misses", statistics.stacktraceCacheMisses},
+        {"stacktrace_cache_entries", statistics.stacktraceCacheEntries},
+        {"stacktrace_cache_bytes", statistics.stacktraceCacheBytes},
+        {"transactions_sent", statistics.transactionsSent},
+        {"spans_dropped", statistics.spansDropped},
+        {"profiles_sent", statistics.profilesSent},
+        {"profile_samples", statistics.profileSamples},
+        {"profile_samples_dropped", statistics.profileSamplesDropped},
+        {"session_updates_sent", statistics.sessionUpdatesSent},
+        {"request_sessions_sent", statistics.requestSessionsSent},
+        {"metrics_sent", statistics.metricsSent},
+        {"metric_values_dropped", statistics.metricValuesDropped},
+        {"attachments_sent", statistics.attachmentsSent},
+        {"events_truncated", statistics.eventsTruncated},
+        {"events_coalesced", statistics.eventsCoalesced},
+    };
+}
+
+} // namespace Sentry
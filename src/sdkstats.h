@@ -0,0 +1,131 @@
+#ifndef SENTRY_SDKSTATS_H
+#define SENTRY_SDKSTATS_H
+
+#include "sentry.h"
+#include "json.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+/*
+ * Counters describing how the SDK itself performs (queue depth, sent/dropped events, latencies).
+ *
+ * Every counter is sharded per CPU, so updating one is a relaxed atomic add on a cache line
+ * that is rarely shared with other cores. Reading sums all the shards.
+ */
+
+using json = nlohmann::json;
+
+namespace Sentry
+{
+
+enum class StatCounter
+{
+    QUEUE_DEPTH,
+    EVENTS_CAPTURED,
+    EVENTS_SAMPLED_OUT,
+    EVENTS_RATE_LIMITED,
+    EVENTS_DROPPED,
+    EVENTS_SENT,
+    EVENTS_FAILED,
+    BYTES_SENT,
+    SYMBOLIZATIONS,
+    SYMBOLIZATION_TIME_NS,
+    SERIALIZATIONS,
+    SERIALIZATION_TIME_NS,
+    TLS_HANDSHAKES,
+    TLS_SESSIONS_RESUMED,
+    STACKTRACE_CACHE_HITS,
+    STACKTRACE_CACHE_MISSES,
+    STACKTRACE_CACHE_ENTRIES,
+    STACKTRACE_CACHE_BYTES,
+    TRANSACTIONS_SENT,
+    SPANS_DROPPED,
+    PROFILES_SENT,
+    PROFILE_SAMPLES,
+    PROFILE_SAMPLES_DROPPED,
+    SESSION_UPDATES_SENT,
+    REQUEST_SESSIONS_SENT,
+    METRICS_SENT,
+    METRIC_VALUES_DROPPED,
+    ATTACHMENTS_SENT,
+    EVENTS_TRUNCATED,
+    EVENTS_COALESCED,
+    SIZE
+};
+
+class SdkStats
+{
+public:
+
+    static SdkStats& instance();
+
+    void add(StatCounter counter, uint64_t value=1)
+    {
+        shard().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void subtract(StatCounter counter, uint64_t value=1)
+    {
+        shard().counters[static_cast<size_t>(counter)].fetch_sub(value, std::memory_order_relaxed);
+    }
+
+    void recordHttpLatency(std::chrono::nanoseconds latency);
+
+    SdkStatistics snapshot() const;
+    static json toJSON(const SdkStatistics& statistics);
+
+private:
+
+    SdkStats();
+
+    SdkStats(const SdkStats&) = delete;
+    SdkStats& operator=(const SdkStats&) = delete;
+    SdkStats(const SdkStats&&) = delete;
+    SdkStats&& operator=(const SdkStats&&) = delete;
+
+    static constexpr size_t NUMBER_OF_SHARDS = 64;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> counters[static_cast<size_t>(StatCounter::SIZE)];
+        std::atomic<uint64_t> httpLatencyHistogram[SdkStatistics::HTTP_LATENCY_BUCKETS];
+    };
+
+    Shard& shard();
+
+    Shard m_shards[NUMBER_OF_SHARDS];
+};
+
+// adds the lifetime of the object to a time counter and increments the matching count
+class ScopedStatTimer
+{
+public:
+
+    ScopedStatTimer(StatCounter countCounter, StatCounter timeCounter)
+    :
+    m_countCounter(countCounter),
+    m_timeCounter(timeCounter),
+    m_start(std::chrono::steady_clock::now())
+    {}
+
+    ~ScopedStatTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - m_start;
+        SdkStats& stats = SdkStats::instance();
+        stats.add(m_countCounter);
+        stats.add(m_timeCounter, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+private:
+
+    StatCounter m_countCounter;
+    StatCounter m_timeCounter;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_SDKSTATS_H
@@ -2,6 +2,9 @@
 
 #include "transport.h"
 #include "hub.h"
+#include "logstaging.h"
+#include "sdkstats.h"
+#include "stringinterner.h"
 
 #include "json.h"
 
@@ -12,6 +15,13 @@ namespace Sentry
 
 static Hub mainHub;
 
+namespace detail
+{
+std::atomic<int> runtimeLogLevel(LOG_LEVEL_DISABLED);
+}
+
+static std::atomic<int> logEventLevel(static_cast<int>(EventLevel::LEVEL_ERROR));
+
 EErrorCode init(const SentryOptions& initParameters)
 {
     // take options, confugure client
@@ -27,15 +37,12 @@ EErrorCode init(const SentryOptions& initParameters)
         }
     }
 
-    if (finalDsn == "")
+    if (finalDsn == "" && initParameters.transport == TransportType::HTTP)
     {
         return EErrorCode::NO_DSN;
     }
 
-   auto errorCode = mainHub.init(finalDsn,
-                                 initParameters.maxBreadcrumbs,
-                                 initParameters.attachStackTrace,
-                                 initParameters.sampleRate);
+   auto errorCode = mainHub.init(finalDsn, initParameters);
    if (errorCode != EErrorCode::NO_ERROR)
    {
        return errorCode;
@@ -50,6 +57,9 @@ EErrorCode init(const SentryOptions& initParameters)
        mainHub.setTag("environment", initParameters.environment);
    }
 
+   logEventLevel = static_cast<int>(initParameters.logEventLevel);
+   setLogLevel(initParameters.logLevel);
+
    return errorCode;
 }
 
@@ -66,6 +76,46 @@ std::string captureEvent(const json& event)
     return mainHub.captureEvent(event);
 }
 
+Span startTransaction(const std::string& name, const char* operation)
+{
+    if (!mainHub.isInitialised())
+        return Span();
+
+    return mainHub.startTransaction(name, operation);
+}
+
+void startSession()
+{
+    if (!mainHub.isInitialised())
+        return;
+
+    mainHub.startSession();
+}
+
+void endSession()
+{
+    if (!mainHub.isInitialised())
+        return;
+
+    mainHub.endSession();
+}
+
+RequestSession startRequestSession()
+{
+    if (!mainHub.isInitialised())
+        return RequestSession();
+
+    return mainHub.startRequestSession();
+}
+
+std::string captureHangSnapshot(const std::string& message)
+{
+    if (!mainHub.isInitialised())
+        return "";
+
+    return mainHub.captureHangSnapshot(message);
+}
+
 //std::string captureException(error)
 //{
 //    /*
@@ -114,6 +164,36 @@ void setExtra(const std::string& key, const std::string& value)
     mainHub.setExtra(key, value);
 }
 
+void addAttachment(const std::string& path, const std::string& contentType)
+{
+    if (!mainHub.isInitialised())
+        return;
+
+    mainHub.addAttachment(path, contentType);
+}
+
+void clearAttachments()
+{
+    if (!mainHub.isInitialised())
+        return;
+
+    mainHub.clearAttachments();
+}
+
+void addEventProcessor(EventProcessor processor)
+{
+    /*
+     * Processors run for every event, in the order they were added, after the scope was applied.
+     * They can be registered before init.
+     */
+    mainHub.addEventProcessor(std::move(processor));
+}
+
+void addErrorProcessor(EventProcessor processor)
+{
+    mainHub.addErrorProcessor(std::move(processor));
+}
+
 std::string lastEventId()
 {
  /*
@@ -135,8 +215,7 @@ void log(EventLevel level, const std::string& message)
     if (!mainHub.isInitialised())
         return;
 
-    EventLevel someLevel = EventLevel::LEVEL_ERROR;
-    if (level >= someLevel)
+    if (static_cast<int>(level) >= logEventLevel.load(std::memory_order_relaxed))
     {
         // prepare event json
         const json event
@@ -148,14 +227,91 @@ void log(EventLevel level, const std::string& message)
     }
     else
     {
-        const json breadcrumb =
+        // skip building a json object, the breadcrumb only references interned strings
+        static const InternedString logType("default");
+
+        Breadcrumb breadcrumb;
+        breadcrumb.type = logType;
+        breadcrumb.level = InternedString(levelToString(level));
+        breadcrumb.message = message;
+        mainHub.addBreadcrumb(std::move(breadcrumb));
+    }
+}
+
+void setLogLevel(EventLevel level)
+{
+    detail::runtimeLogLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void log(EventLevel level, LogMessage&& message)
+{
+    if (!mainHub.isInitialised())
+        return;
+
+    if (static_cast<int>(level) >= logEventLevel.load(std::memory_order_relaxed))
+    {
+        log(level, message.format());
+    }
+    else
+    {
+        // the arguments are moved into the breadcrumb, formatted only if an event is sent
+        static const InternedString logType("default");
+        static const InternedString logLevels[] =
+        {
+            InternedString(levelToString(EventLevel::LEVEL_DEBUG)),
+            InternedString(levelToString(EventLevel::LEVEL_INFO)),
+            InternedString(levelToString(EventLevel::LEVEL_WARNING)),
+            InternedString(levelToString(EventLevel::LEVEL_ERROR)),
+            InternedString(levelToString(EventLevel::LEVEL_FATAL)),
+        };
+
+        Breadcrumb breadcrumb;
+        breadcrumb.type = logType;
+        breadcrumb.level = logLevels[static_cast<int>(level) - static_cast<int>(EventLevel::LEVEL_DEBUG)];
+        breadcrumb.logMessage = std::move(message);
+        mainHub.addBreadcrumb(std::move(breadcrumb));
+    }
+}
+
+void logToSentry(EventLevel level, std::string_view message, std::string_view logger)
+{
+    // also false before init
+    if (!isLogLevelEnabled(level))
+        return;
+
+    if (static_cast<int>(level) >= logEventLevel.load(std::memory_order_relaxed))
+    {
+        json event
         {
-         {"category", "log"},
-         {"level", levelToString(level)},
-         {"message", message}
+            {"message", std::string(message)},
+            {"level", levelToString(level)},
         };
-        addBreadcrumb(breadcrumb);
+        if (!logger.empty())
+        {
+            event["logger"] = std::string(logger);
+        }
+        captureEvent(event);
     }
+    else
+    {
+        LogStaging::instance().stage(level, logger, message);
+    }
+}
+
+SdkStatistics getStats()
+{
+    // available also before init - all counters are zero then
+    return SdkStats::instance().snapshot();
+}
+
+bool flush(unsigned int timeoutMilliseconds)
+{
+    return mainHub.flush(std::chrono::milliseconds(timeoutMilliseconds));
+}
+
+std::vector<std::string> takeCapturedEvents()
+{
+    return mainHub.takeCapturedEvents();
 }
 
 const char* getErrorDescription(EErrorCode errorCode)
@@ -11,22 +11,30 @@ void logSentryInternal(const std::string& methodName, const std::string& msg)
     std::cout << "[SentryCpp]" << "[" << methodName << "] " << msg << std::endl;
 }
 
-const std::string levelToString(EventLevel level)
+const std::string& levelToString(EventLevel level)
 {
+    // levels repeat in every event and breadcrumb - do not build a new string each time
+    static const std::string fatal = "fatal";
+    static const std::string error = "error";
+    static const std::string warning = "warning";
+    static const std::string debug = "debug";
+    static const std::string info = "info";
+    static const std::string unknown = "unknown";
+
     switch (level)
     {
     case EventLevel::LEVEL_FATAL:
-        return "fatal";
+        return fatal;
     case EventLevel::LEVEL_ERROR:
-        return "error";
+        return error;
     case EventLevel::LEVEL_WARNING:
-        return "warning";
+        return warning;
     case EventLevel::LEVEL_DEBUG:
-        return "debug";
+        return debug;
     case EventLevel::LEVEL_INFO:
-        return "info";
+        return info;
     default:
-        return "unknown";
+        return unknown;
     }
 }
 
@@ -0,0 +1,74 @@
+#include "sentry_log.h"
+
+#include <charconv>
+
+
+namespace Sentry
+{
+
+void LogArgument::appendTo(std::string& output) const
+{
+    char buffer[32];
+    std::to_chars_result result = {buffer, std::errc()};
+
+    switch (m_type)
+    {
+    case Type::BOOL:
+        output.append(m_value.unsignedValue != 0 ? "true" : "false");
+        return;
+    case Type::CHAR:
+        output.push_back(static_cast<char>(m_value.unsignedValue));
+        return;
+    case Type::SIGNED:
+        result = std::to_chars(buffer, buffer + sizeof(buffer), m_value.signedValue);
+        break;
+    case Type::UNSIGNED:
+        result = std::to_chars(buffer, buffer + sizeof(buffer), m_value.unsignedValue);
+        break;
+    case Type::FLOATING:
+        // shortest representation that reads back the same value, like fmt
+        result = std::to_chars(buffer, buffer + sizeof(buffer), m_value.floatingValue);
+        break;
+    case Type::POINTER:
+        output.append("0x");
+        result = std::to_chars(buffer, buffer + sizeof(buffer), m_value.unsignedValue, 16);
+        break;
+    case Type::TEXT:
+        output.append(m_text);
+        return;
+    case Type::NONE:
+        return;
+    }
+
+    output.append(buffer, result.ptr);
+}
+
+std::string LogMessage::format() const
+{
+    std::string output;
+    if (m_format == nullptr)
+        return output;
+
+    size_t argumentNo = 0;
+    const char* format = m_formatCopy.empty() ? m_format : m_formatCopy.c_str();
+    for (const char* position = format; *position != '\0'; position++)
+    {
+        if (position[0] == '{' && position[1] == '}' && argumentNo < m_numberOfArguments)
+        {
+            m_arguments[argumentNo++].appendTo(output);
+            position++;
+        }
+        else if ((position[0] == '{' && position[1] == '{') || (position[0] == '}' && position[1] == '}'))
+        {
+            output.push_back(position[0]);
+            position++;
+        }
+        else
+        {
+            output.push_back(position[0]);
+        }
+    }
+    return output;
+}
+
+} // namespace Sentry
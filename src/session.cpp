@@ -0,0 +1,288 @@
+#include "session.h"
+
+#include "hub.h"
+#include "spanrecorder.h"
+
+#include <cstring>
+#include <sched.h>
+
+
+namespace
+{
+
+std::string toISO8601(time_t seconds)
+{
+    char buffer[sizeof("2011-10-08T07:07:09Z")];
+    strftime(buffer, sizeof(buffer), "%FT%TZ", gmtime(&seconds));
+    return std::string(buffer);
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+Session::Session()
+:
+m_id(),
+m_started(0),
+m_startNanoseconds(0),
+m_errors(0),
+m_initSent(false)
+{
+
+}
+
+SessionState Session::state() const
+{
+    SessionState state;
+    std::memset(&state, 0, sizeof(state));
+    m_id.copy(state.id, sizeof(state.id) - 1);
+    state.started = static_cast<int64_t>(m_started);
+    state.startNanoseconds = m_startNanoseconds;
+    state.errors = m_errors;
+    state.initSent = m_initSent;
+    return state;
+}
+
+void Session::restore(const SessionState& state)
+{
+    m_id.assign(state.id, strnlen(state.id, sizeof(state.id)));
+    m_started = static_cast<time_t>(state.started);
+    m_startNanoseconds = state.startNanoseconds;
+    m_errors = state.errors;
+    m_initSent = state.initSent;
+}
+
+void Session::start(const std::string& id)
+{
+    m_id = id;
+    m_started = time(nullptr);
+    m_startNanoseconds = SpanRecorder::steadyNanoseconds();
+    m_errors = 0;
+    m_initSent = false;
+}
+
+bool Session::isActive() const
+{
+    return !m_id.empty();
+}
+
+bool Session::addError()
+{
+    return isActive() && m_errors++ == 0;
+}
+
+json Session::update(const char* status, const json& attributes)
+{
+    json payload;
+    payload["sid"] = m_id;
+    payload["init"] = !m_initSent;
+    payload["started"] = toISO8601(m_started);
+    payload["timestamp"] = toISO8601(time(nullptr));
+    payload["status"] = status;
+    payload["errors"] = m_errors;
+    payload["duration"] = static_cast<double>(SpanRecorder::steadyNanoseconds() - m_startNanoseconds) / 1e9;
+    payload["attrs"] = attributes;
+
+    m_initSent = true;
+    if (std::strcmp(status, "ok") != 0)
+    {
+        m_id.clear();
+    }
+    return payload;
+}
+
+SessionAggregator::SessionAggregator()
+:
+m_minutes(),
+m_shards()
+{
+    for (auto& minute : m_minutes)
+    {
+        minute.store(0, std::memory_order_relaxed);
+    }
+    for (auto& shard : m_shards)
+    {
+        shard.openRequests.store(0, std::memory_order_relaxed);
+        for (auto& slot : shard.counts)
+        {
+            for (auto& counter : slot)
+            {
+                counter.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+uint64_t& SessionAggregator::threadErrors()
+{
+    thread_local uint64_t errors = 0;
+    return errors;
+}
+
+SessionAggregator::Shard& SessionAggregator::shard()
+{
+    const int cpu = sched_getcpu();
+    return m_shards[(cpu < 0) ? 0 : static_cast<size_t>(cpu) % NUMBER_OF_SHARDS];
+}
+
+void SessionAggregator::startRequest()
+{
+    shard().openRequests.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SessionAggregator::endRequest(RequestOutcome outcome)
+{
+    shard().openRequests.fetch_sub(1, std::memory_order_relaxed);
+    count(outcome, 1);
+}
+
+void SessionAggregator::count(RequestOutcome outcome, uint32_t requests)
+{
+    const int64_t minute = static_cast<int64_t>(time(nullptr)) / 60;
+    const size_t slot = static_cast<size_t>(minute) % SESSION_AGGREGATE_MINUTES;
+
+    // the first request of a minute claims its slot, the counts of the minute it held were sent by now
+    int64_t slotMinute = m_minutes[slot].load(std::memory_order_relaxed);
+    while (slotMinute < minute && !m_minutes[slot].compare_exchange_weak(slotMinute, minute, std::memory_order_relaxed))
+    {
+    }
+
+    shard().counts[slot][static_cast<size_t>(outcome)].fetch_add(requests, std::memory_order_relaxed);
+}
+
+void SessionAggregator::crashOpenRequests()
+{
+    uint64_t open = 0;
+    for (auto& shard : m_shards)
+    {
+        open += shard.openRequests.exchange(0, std::memory_order_relaxed);
+    }
+    if (static_cast<int64_t>(open) > 0)
+    {
+        count(RequestOutcome::CRASHED, static_cast<uint32_t>(open));
+    }
+}
+
+json SessionAggregator::take(bool includeCurrent, uint64_t& requests)
+{
+    static const char* const OUTCOME_NAMES[OUTCOMES] = {"exited", "errored", "crashed"};
+
+    const int64_t currentMinute = static_cast<int64_t>(time(nullptr)) / 60;
+    json aggregates = json::array();
+    requests = 0;
+
+    for (size_t slot=0; slot<SESSION_AGGREGATE_MINUTES; slot++)
+    {
+        const int64_t minute = m_minutes[slot].load(std::memory_order_relaxed);
+        if (minute > currentMinute || (minute == currentMinute && !includeCurrent))
+            continue;
+
+        json aggregate;
+        for (size_t outcome=0; outcome<OUTCOMES; outcome++)
+        {
+            uint64_t total = 0;
+            for (auto& shard : m_shards)
+            {
+                total += shard.counts[slot][outcome].exchange(0, std::memory_order_relaxed);
+            }
+            if (total > 0)
+            {
+                aggregate[OUTCOME_NAMES[outcome]] = total;
+                requests += total;
+            }
+        }
+        if (!aggregate.is_null())
+        {
+            aggregate["started"] = toISO8601(static_cast<time_t>(minute * 60));
+            aggregates.push_back(std::move(aggregate));
+        }
+    }
+    return aggregates;
+}
+
+RequestSession::RequestSession()
+:
+m_hub(nullptr),
+m_threadErrors(0),
+m_errored(false),
+m_crashed(false)
+{
+
+}
+
+RequestSession::RequestSession(Hub* hub)
+:
+m_hub(hub),
+m_threadErrors(SessionAggregator::threadErrors()),
+m_errored(false),
+m_crashed(false)
+{
+
+}
+
+RequestSession::~RequestSession()
+{
+    end();
+}
+
+RequestSession::RequestSession(RequestSession&& other) noexcept
+:
+m_hub(other.m_hub),
+m_threadErrors(other.m_threadErrors),
+m_errored(other.m_errored),
+m_crashed(other.m_crashed)
+{
+    other.m_hub = nullptr;
+}
+
+RequestSession& RequestSession::operator=(RequestSession&& other) noexcept
+{
+    if (this != &other)
+    {
+        end();
+        m_hub = other.m_hub;
+        m_threadErrors = other.m_threadErrors;
+        m_errored = other.m_errored;
+        m_crashed = other.m_crashed;
+        other.m_hub = nullptr;
+    }
+    return *this;
+}
+
+void RequestSession::setErrored()
+{
+    m_errored = true;
+}
+
+void RequestSession::setCrashed()
+{
+    m_crashed = true;
+}
+
+void RequestSession::end()
+{
+    if (m_hub == nullptr)
+        return;
+
+    RequestOutcome outcome = RequestOutcome::EXITED;
+    if (m_crashed)
+    {
+        outcome = RequestOutcome::CRASHED;
+    }
+    else if (m_errored || SessionAggregator::threadErrors() != m_threadErrors)
+    {
+        outcome = RequestOutcome::ERRORED;
+    }
+    m_hub->endRequestSession(outcome);
+
+    m_hub = nullptr;
+}
+
+bool RequestSession::isCounted() const
+{
+    return m_hub != nullptr;
+}
+
+} // namespace Sentry
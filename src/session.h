@@ -0,0 +1,129 @@
+#ifndef SENTRY_SESSION_H
+#define SENTRY_SESSION_H
+
+#include "json.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <time.h>
+
+
+/*
+ * Release health: sessions tell how many runs of a release (or requests of a server) ended cleanly, with
+ * errors or in a crash. https://develop.sentry.dev/sdk/sessions/
+ *
+ * The session of the application (Session) is sent as an update when it starts, on its first error and when it
+ * ends - exited, or crashed from the signal and termination handlers. With the out-of-process crash handler
+ * its SessionState and the SessionAggregator live in shared memory, and the handler process ends them.
+ *
+ * Request sessions of a server are not sent one by one: SessionAggregator counts them per outcome into the
+ * minute they ended, and the hub sends the completed minutes as a single "sessions" item periodically. The
+ * counters are sharded per CPU (as in SdkStats), counting a request is a relaxed atomic add. A count racing
+ * the minute boundary, or left in a slot the flush did not reach for SESSION_AGGREGATE_MINUTES minutes, is
+ * sent with a neighbouring minute - never lost.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t SESSION_AGGREGATE_MINUTES = 4;     // slots of the minutes not sent yet, reused round robin
+constexpr unsigned int SESSION_AGGREGATES_FLUSH_INTERVAL_SECONDS = 60;
+}
+
+namespace Sentry
+{
+
+enum class RequestOutcome
+{
+    EXITED,     // no error
+    ERRORED,
+    CRASHED,
+    SIZE
+};
+
+// a Session as plain data, e.g. in the memory shared with the crash handler process
+struct SessionState
+{
+    char id[40];                // empty - no session
+    int64_t started;            // seconds since the epoch
+    int64_t startNanoseconds;   // steady clock, the same in every process
+    uint32_t errors;
+    bool initSent;
+};
+
+class Session
+{
+public:
+
+    Session();
+
+    SessionState state() const;
+    void restore(const SessionState& state);
+
+    void start(const std::string& id);
+    bool isActive() const;
+
+    // true on the first error of the session, which is worth an update of its own
+    bool addError();
+
+    // the payload of a "session" item with the attributes (release, environment); a status other than "ok"
+    // ends the session
+    json update(const char* status, const json& attributes);
+
+private:
+
+    std::string m_id;       // empty - no session
+    time_t m_started;
+    int64_t m_startNanoseconds;     // steady clock
+    uint32_t m_errors;
+    bool m_initSent;
+};
+
+class SessionAggregator
+{
+public:
+
+    SessionAggregator();
+
+    void startRequest();
+    void endRequest(RequestOutcome outcome);
+
+    // the "aggregates" of the minutes before the current one, with the current one too if includeCurrent;
+    // requests is set to the number of request sessions in them
+    json take(bool includeCurrent, uint64_t& requests);
+
+    // the requests in progress at a crash end with it
+    void crashOpenRequests();
+
+    // error events captured on the calling thread, a request session compares it at its start and end
+    static uint64_t& threadErrors();
+
+private:
+
+    SessionAggregator(const SessionAggregator&) = delete;
+    SessionAggregator& operator=(const SessionAggregator&) = delete;
+    SessionAggregator(const SessionAggregator&&) = delete;
+    SessionAggregator&& operator=(const SessionAggregator&&) = delete;
+
+    static constexpr size_t NUMBER_OF_SHARDS = 64;
+    static constexpr size_t OUTCOMES = static_cast<size_t>(RequestOutcome::SIZE);
+
+    struct alignas(64) Shard
+    {
+        // started minus ended, incremented and decremented on different shards - only the sum is meaningful
+        std::atomic<uint64_t> openRequests;
+        std::atomic<uint32_t> counts[SESSION_AGGREGATE_MINUTES][OUTCOMES];
+    };
+
+    Shard& shard();
+    void count(RequestOutcome outcome, uint32_t requests);
+
+    std::atomic<int64_t> m_minutes[SESSION_AGGREGATE_MINUTES];     // of the slots, since the epoch
+    Shard m_shards[NUMBER_OF_SHARDS];
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_SESSION_H
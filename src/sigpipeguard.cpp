@@ -0,0 +1,45 @@
+#include "sigpipeguard.h"
+
+#include <cerrno>
+#include <pthread.h>
+
+
+namespace Sentry
+{
+
+SigpipeGuard::SigpipeGuard()
+:
+m_previousMask(),
+m_wasPending(false)
+{
+    sigset_t pending;
+    sigemptyset(&pending);
+    sigpending(&pending);
+    m_wasPending = sigismember(&pending, SIGPIPE) == 1;
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, &m_previousMask);
+}
+
+SigpipeGuard::~SigpipeGuard()
+{
+    const int error = errno;    // of the guarded write
+
+    if (!m_wasPending)
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGPIPE);
+        const struct timespec noWait = {0, 0};
+        while (sigtimedwait(&signals, nullptr, &noWait) < 0 && errno == EINTR)
+        {
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &m_previousMask, nullptr);
+
+    errno = error;
+}
+
+} // namespace Sentry
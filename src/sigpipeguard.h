@@ -0,0 +1,37 @@
+#ifndef SENTRY_SIGPIPEGUARD_H
+#define SENTRY_SIGPIPEGUARD_H
+
+#include <signal.h>
+
+
+/*
+ * Writes that can not pass MSG_NOSIGNAL (sendfile, write to a pipe) raise SIGPIPE when the reader is gone,
+ * which kills the process unless the application handles it. SigpipeGuard blocks SIGPIPE on the calling thread
+ * for its lifetime, so the write fails with EPIPE instead, then takes the SIGPIPE raised meanwhile (if it was not
+ * pending already) and restores the signal mask of the thread - the threads of the application are left as they are.
+ */
+
+namespace Sentry
+{
+
+class SigpipeGuard
+{
+public:
+
+    SigpipeGuard();
+    ~SigpipeGuard();
+
+private:
+
+    SigpipeGuard(const SigpipeGuard&) = delete;
+    SigpipeGuard& operator=(const SigpipeGuard&) = delete;
+    SigpipeGuard(const SigpipeGuard&&) = delete;
+    SigpipeGuard&& operator=(const SigpipeGuard&&) = delete;
+
+    sigset_t m_previousMask;
+    bool m_wasPending;      // a SIGPIPE of someone else, left pending
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_SIGPIPEGUARD_H
@@ -0,0 +1,109 @@
+#include "sentry.h"
+
+#include "spanrecorder.h"
+
+
+namespace Sentry
+{
+
+Span::Span()
+:
+m_transactionId(0),
+m_spanId(0),
+m_parentSpanId(0),
+m_operation(),
+m_description(),
+m_status(),
+m_startNanoseconds(0)
+{
+
+}
+
+Span::Span(uint64_t transactionId, uint64_t spanId, uint64_t parentSpanId, const char* operation, const char* description)
+:
+m_transactionId(transactionId),
+m_spanId(spanId),
+m_parentSpanId(parentSpanId),
+m_operation(operation != nullptr ? operation : "default"),
+m_description(description != nullptr ? description : ""),
+m_status(),
+m_startNanoseconds(SpanRecorder::steadyNanoseconds())
+{
+
+}
+
+Span::~Span()
+{
+    finish();
+}
+
+Span::Span(Span&& other) noexcept
+:
+m_transactionId(other.m_transactionId),
+m_spanId(other.m_spanId),
+m_parentSpanId(other.m_parentSpanId),
+m_operation(std::move(other.m_operation)),
+m_description(std::move(other.m_description)),
+m_status(std::move(other.m_status)),
+m_startNanoseconds(other.m_startNanoseconds)
+{
+    other.m_transactionId = 0;
+}
+
+Span& Span::operator=(Span&& other) noexcept
+{
+    if (this != &other)
+    {
+        finish();
+        m_transactionId = other.m_transactionId;
+        m_spanId = other.m_spanId;
+        m_parentSpanId = other.m_parentSpanId;
+        m_operation = std::move(other.m_operation);
+        m_description = std::move(other.m_description);
+        m_status = std::move(other.m_status);
+        m_startNanoseconds = other.m_startNanoseconds;
+        other.m_transactionId = 0;
+    }
+    return *this;
+}
+
+Span Span::startChild(const char* operation, const char* description)
+{
+    if (m_transactionId == 0)
+        return Span();
+
+    return Span(m_transactionId, SpanRecorder::nextId(), m_spanId, operation, description);
+}
+
+void Span::setStatus(const char* status)
+{
+    m_status = (status != nullptr) ? status : "";
+}
+
+void Span::finish()
+{
+    if (m_transactionId == 0)
+        return;
+
+    SpanRecord record;
+    record.start = nullptr;
+    record.transactionId = m_transactionId;
+    record.spanId = m_spanId;
+    record.parentSpanId = m_parentSpanId;
+    record.startNanoseconds = m_startNanoseconds;
+    record.endNanoseconds = SpanRecorder::steadyNanoseconds();
+    // the vocabulary of operations and statuses is small, descriptions (queries, urls) are not interned
+    record.operation = InternedString(m_operation);
+    record.description = std::move(m_description);
+    record.status = InternedString(m_status);
+    SpanRecorder::instance().record(std::move(record));
+
+    m_transactionId = 0;
+}
+
+bool Span::isRecording() const
+{
+    return m_transactionId != 0;
+}
+
+} // namespace Sentry
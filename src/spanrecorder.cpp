@@ -0,0 +1,329 @@
+#include "spanrecorder.h"
+
+#include "profiler.h"
+#include "sdkstats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+namespace
+{
+
+std::string toHex(uint64_t value)
+{
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return std::string(buffer, 16);
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+SpanBuffer::SpanBuffer()
+:
+m_records(),
+m_head(0),
+m_tail(0),
+m_orphaned(false)
+{
+
+}
+
+bool SpanBuffer::push(SpanRecord&& record)
+{
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+    {
+        return false;
+    }
+
+    m_records[tail % CAPACITY] = std::move(record);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+void SpanBuffer::setOrphaned()
+{
+    m_orphaned = true;
+}
+
+bool SpanBuffer::isOrphaned() const
+{
+    return m_orphaned;
+}
+
+bool SpanBuffer::empty() const
+{
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+SpanRecorder& SpanRecorder::instance()
+{
+    // never destroyed, spans may be finished while static objects are destroyed
+    static SpanRecorder* recorder = new SpanRecorder();
+    return *recorder;
+}
+
+SpanRecorder::SpanRecorder()
+:
+m_buffers(),
+m_buffersMutex(),
+m_drainMutex(),
+m_openTransactions(),
+m_records(),
+m_waitingChildren(),
+m_finished()
+{
+
+}
+
+uint64_t SpanRecorder::nextId()
+{
+    // splitmix64 per thread, the ids need to be unique rather than unpredictable
+    thread_local uint64_t state = static_cast<uint64_t>(steadyNanoseconds()) ^ reinterpret_cast<uintptr_t>(&state);
+    uint64_t id;
+    do
+    {
+        id = (state += 0x9e3779b97f4a7c15ull);
+        id = (id ^ (id >> 30)) * 0xbf58476d1ce4e5b9ull;
+        id = (id ^ (id >> 27)) * 0x94d049bb133111ebull;
+        id = id ^ (id >> 31);
+    } while (id == 0);  // 0 marks a span not recording
+    return id;
+}
+
+int64_t SpanRecorder::steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t SpanRecorder::wallNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void SpanRecorder::record(SpanRecord&& record)
+{
+    if (!threadBuffer().push(std::move(record)))
+    {
+        if (record.start != nullptr)
+        {
+            dropTransaction(*record.start);
+            delete record.start;
+        }
+        SdkStats::instance().add(StatCounter::SPANS_DROPPED);
+    }
+}
+
+SpanBuffer& SpanRecorder::threadBuffer()
+{
+    // registered on the first span of the thread, handed over to the drain when the thread exits
+    struct ThreadBuffer
+    {
+        std::shared_ptr<SpanBuffer> buffer;
+
+        ~ThreadBuffer()
+        {
+            if (buffer)
+            {
+                buffer->setOrphaned();
+            }
+        }
+    };
+    thread_local ThreadBuffer threadBuffer;
+
+    if (!threadBuffer.buffer)
+    {
+        threadBuffer.buffer = std::make_shared<SpanBuffer>();
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(threadBuffer.buffer);
+    }
+    return *threadBuffer.buffer;
+}
+
+std::vector<std::shared_ptr<SpanBuffer>> SpanRecorder::buffers()
+{
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    return m_buffers;
+}
+
+void SpanRecorder::removeOrphanedBuffers()
+{
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                   [](const std::shared_ptr<SpanBuffer>& buffer)
+                                   {
+                                       return buffer->isOrphaned() && buffer->empty();
+                                   }),
+                    m_buffers.end());
+}
+
+void SpanRecorder::removeHub(const Hub* hub)
+{
+    std::lock_guard<std::mutex> lock(m_drainMutex);
+    collect();
+    for (auto it = m_finished.begin(); it != m_finished.end();)
+    {
+        if (it->hub == hub)
+        {
+            dropTransaction(*it->start);
+            it = m_finished.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (auto it = m_openTransactions.begin(); it != m_openTransactions.end();)
+    {
+        if (it->second.start->hub == hub)
+        {
+            dropTransaction(*it->second.start);
+            SdkStats::instance().add(StatCounter::SPANS_DROPPED, it->second.spans.size());
+            it = m_openTransactions.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void SpanRecorder::collect()
+{
+    for (auto& buffer : buffers())
+    {
+        buffer->consume([this](SpanRecord& record) { m_records.push_back(std::move(record)); });
+    }
+    removeOrphanedBuffers();
+
+    // the starts first, the child spans of a transaction may come from the ring of another thread
+    for (const SpanRecord& record : m_records)
+    {
+        if (record.start != nullptr)
+        {
+            m_openTransactions[record.transactionId].start.reset(record.start);
+        }
+    }
+
+    std::vector<SpanRecord> waitingChildren;
+    waitingChildren.swap(m_waitingChildren);
+    for (SpanRecord& child : waitingChildren)
+    {
+        if (m_openTransactions.count(child.transactionId) > 0)
+        {
+            addChild(std::move(child));
+        }
+        else
+        {
+            SdkStats::instance().add(StatCounter::SPANS_DROPPED);
+        }
+    }
+
+    for (SpanRecord& record : m_records)
+    {
+        if (record.start == nullptr && record.spanId != record.transactionId)
+        {
+            if (m_openTransactions.count(record.transactionId) > 0)
+            {
+                addChild(std::move(record));
+            }
+            else
+            {
+                m_waitingChildren.push_back(std::move(record));
+            }
+        }
+    }
+
+    // a transaction finished in this drain has all its children collected above
+    for (const SpanRecord& record : m_records)
+    {
+        if (record.start == nullptr && record.spanId == record.transactionId)
+        {
+            auto transaction = m_openTransactions.find(record.transactionId);
+            if (transaction != m_openTransactions.end())
+            {
+                Hub* hub = transaction->second.start->hub;
+                json built = buildTransaction(transaction->second, record);
+                m_finished.push_back({hub, std::move(built), std::move(transaction->second.start), record.endNanoseconds});
+                m_openTransactions.erase(transaction);
+            }
+        }
+    }
+    m_records.clear();
+}
+
+void SpanRecorder::addChild(SpanRecord&& record)
+{
+    std::vector<SpanRecord>& spans = m_openTransactions[record.transactionId].spans;
+    if (spans.size() < SPANS_PER_TRANSACTION_LIMIT)
+    {
+        spans.push_back(std::move(record));
+    }
+    else
+    {
+        SdkStats::instance().add(StatCounter::SPANS_DROPPED);
+    }
+}
+
+void SpanRecorder::dropTransaction(const TransactionStart& start)
+{
+    if (start.profiled)
+    {
+        Profiler::instance().cancel(start.steadyNanoseconds);
+    }
+}
+
+json SpanRecorder::buildTransaction(const OpenTransaction& transaction, const SpanRecord& root) const
+{
+    const TransactionStart& start = *transaction.start;
+    auto toTimestamp = [&start](int64_t steadyNanoseconds)
+    {
+        // seconds since the epoch, with the precision of the steady clock relative to the start
+        return static_cast<double>(start.wallNanoseconds + (steadyNanoseconds - start.steadyNanoseconds)) / 1e9;
+    };
+    const std::string traceId = toHex(start.traceIdHigh) + toHex(start.traceIdLow);
+
+    json trace = {{"trace_id", traceId}, {"span_id", toHex(root.spanId)}, {"op", root.operation.str()}};
+    if (!root.status.empty())
+    {
+        trace["status"] = root.status.str();
+    }
+
+    json spans = json::array();
+    for (const SpanRecord& record : transaction.spans)
+    {
+        json span = {{"trace_id", traceId},
+                     {"span_id", toHex(record.spanId)},
+                     {"parent_span_id", toHex(record.parentSpanId)},
+                     {"op", record.operation.str()},
+                     {"start_timestamp", toTimestamp(record.startNanoseconds)},
+                     {"timestamp", toTimestamp(record.endNanoseconds)}};
+        if (!record.description.empty())
+        {
+            span["description"] = record.description;
+        }
+        if (!record.status.empty())
+        {
+            span["status"] = record.status.str();
+        }
+        spans.push_back(std::move(span));
+    }
+
+    json event;
+    event["type"] = "transaction";
+    event["transaction"] = start.name;
+    event["start_timestamp"] = toTimestamp(root.startNanoseconds);
+    event["timestamp"] = toTimestamp(root.endNanoseconds);
+    event["contexts"]["trace"] = std::move(trace);
+    event["spans"] = std::move(spans);
+    return event;
+}
+
+} // namespace Sentry
@@ -0,0 +1,188 @@
+#ifndef SENTRY_SPANRECORDER_H
+#define SENTRY_SPANRECORDER_H
+
+#include "json.h"
+#include "stringinterner.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * Finished spans on their way to the transport.
+ *
+ * Span::finish moves a record (the operation and status interned, the description moved from the span, the times
+ * steady clock nanoseconds) into a single producer / single consumer ring of the finishing thread - no lock,
+ * no allocation.
+ * startTransaction adds a record carrying the name and the trace id of the transaction.
+ * The hub drains all rings periodically on the transport thread and when flushing: child spans are collected
+ * per transaction, and once the transaction itself is finished it is built and handed to its hub.
+ *
+ * A full ring drops the span. A child span consumed before the start of its transaction (finished on another
+ * thread, racing the drain) waits for one more drain, then it is dropped like the spans finished after
+ * their transaction or over SPANS_PER_TRANSACTION_LIMIT.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t SPANS_PER_TRANSACTION_LIMIT = 1000;
+}
+
+namespace Sentry
+{
+
+class Hub;
+
+struct TransactionStart
+{
+    Hub* hub;                   // sends the transaction
+    std::string name;
+    uint64_t traceIdHigh;
+    uint64_t traceIdLow;
+    int64_t steadyNanoseconds;  // of the start, span times are converted to wall time relative to it
+    int64_t wallNanoseconds;
+    pid_t threadId;             // started the transaction
+    bool profiled;              // the profiler runs for it, see profiler.h
+};
+
+struct SpanRecord
+{
+    TransactionStart* start;    // only in the record of startTransaction, owned by the recorder afterwards
+    uint64_t transactionId;
+    uint64_t spanId;            // the transaction id for the transaction itself
+    uint64_t parentSpanId;
+    int64_t startNanoseconds;
+    int64_t endNanoseconds;
+    InternedString operation;
+    std::string description;    // empty - none
+    InternedString status;      // empty - none
+};
+
+struct FinishedTransaction
+{
+    Hub* hub;
+    json transaction;           // the payload of the envelope item
+    std::unique_ptr<TransactionStart> start;
+    int64_t endNanoseconds;     // steady clock
+};
+
+class SpanBuffer
+{
+public:
+
+    static constexpr size_t CAPACITY = 1024;
+
+    SpanBuffer();
+
+    // owning thread only, false if full - then record is not moved from
+    bool push(SpanRecord&& record);
+
+    // the drainer only, consumer(SpanRecord& record) oldest first, it may move from the record
+    template<typename F>
+    void consume(F&& consumer)
+    {
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        for (; head != tail; head++)
+        {
+            consumer(m_records[head % CAPACITY]);
+        }
+        // the producer can reuse the records from now on
+        m_head.store(head, std::memory_order_release);
+    }
+
+    void setOrphaned();     // owning thread exited
+    bool isOrphaned() const;
+    bool empty() const;
+
+private:
+
+    SpanBuffer(const SpanBuffer&) = delete;
+    SpanBuffer& operator=(const SpanBuffer&) = delete;
+    SpanBuffer(const SpanBuffer&&) = delete;
+    SpanBuffer&& operator=(const SpanBuffer&&) = delete;
+
+    std::array<SpanRecord, CAPACITY> m_records;
+    alignas(64) std::atomic<size_t> m_head;     // next record to consume
+    alignas(64) std::atomic<size_t> m_tail;     // next record to write
+    std::atomic_bool m_orphaned;
+};
+
+class SpanRecorder
+{
+public:
+
+    static SpanRecorder& instance();
+
+    // lock-free apart from the first call on each thread
+    void record(SpanRecord&& record);
+
+    // sink(FinishedTransaction& finished) for every finished transaction, called with the drain lock held
+    template<typename F>
+    void drain(F&& sink)
+    {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        collect();
+        for (auto& finished : m_finished)
+        {
+            sink(finished);
+        }
+        m_finished.clear();
+    }
+
+    // the open transactions of the hub are dropped, it is being destroyed
+    void removeHub(const Hub* hub);
+
+    // span and trace ids, never 0
+    static uint64_t nextId();
+    static int64_t steadyNanoseconds();
+    static int64_t wallNanoseconds();
+
+private:
+
+    SpanRecorder();
+
+    SpanRecorder(const SpanRecorder&) = delete;
+    SpanRecorder& operator=(const SpanRecorder&) = delete;
+    SpanRecorder(const SpanRecorder&&) = delete;
+    SpanRecorder&& operator=(const SpanRecorder&&) = delete;
+
+    struct OpenTransaction
+    {
+        std::unique_ptr<TransactionStart> start;
+        std::vector<SpanRecord> spans;
+    };
+
+    SpanBuffer& threadBuffer();
+    std::vector<std::shared_ptr<SpanBuffer>> buffers();
+    void removeOrphanedBuffers();
+
+    // moves the records of all rings to the open transactions, builds the finished ones into m_finished
+    void collect();
+    void addChild(SpanRecord&& record);
+    json buildTransaction(const OpenTransaction& transaction, const SpanRecord& root) const;
+    static void dropTransaction(const TransactionStart& start);
+
+    std::vector<std::shared_ptr<SpanBuffer>> m_buffers;
+    mutable std::mutex m_buffersMutex;
+
+    // below guarded by m_drainMutex
+    std::mutex m_drainMutex;
+    std::unordered_map<uint64_t, OpenTransaction> m_openTransactions;
+    std::vector<SpanRecord> m_records;          // of the current drain
+    std::vector<SpanRecord> m_waitingChildren;  // from the previous drain, their transaction was not started yet
+    std::vector<FinishedTransaction> m_finished;
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_SPANRECORDER_H
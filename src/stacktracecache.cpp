@@ -0,0 +1,109 @@
+#include "stacktracecache.h"
+
+#include "sdkstats.h"
+
+#include <algorithm>
+
+
+namespace Sentry
+{
+
+StacktraceCache& StacktraceCache::instance()
+{
+    // never destroyed - exceptions can still be captured during exit, e.g. on the terminate path
+    static StacktraceCache* cache = new StacktraceCache();
+    return *cache;
+}
+
+StacktraceCache::StacktraceCache()
+:
+m_shards()
+{
+
+}
+
+uint64_t StacktraceCache::hashAddresses(void* const* addresses, size_t count, bool withSourceData)
+{
+    // FNV-1a over the addresses, the low bits of a return address alone are poorly distributed
+    uint64_t hash = 0xcbf29ce484222325ull ^ (withSourceData ? 1 : 0);
+    for (size_t i=0; i<count; i++)
+    {
+        hash ^= reinterpret_cast<uintptr_t>(addresses[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+std::list<StacktraceCache::Entry>::iterator StacktraceCache::lookup(Shard& shard, uint64_t hash, void* const* addresses,
+                                                                    size_t count, bool withSourceData)
+{
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Entry& entry = *it->second;
+        if (entry.withSourceData == withSourceData && entry.addresses.size() == count
+            && std::equal(addresses, addresses + count, entry.addresses.begin()))
+        {
+            return it->second;
+        }
+    }
+    return shard.entries.end();
+}
+
+std::shared_ptr<const json> StacktraceCache::find(void* const* addresses, size_t count, bool withSourceData)
+{
+    const uint64_t hash = hashAddresses(addresses, count, withSourceData);
+    Shard& shard = m_shards[hash % STACKTRACE_CACHE_SHARDS];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto entry = lookup(shard, hash, addresses, count, withSourceData);
+    if (entry == shard.entries.end())
+    {
+        SdkStats::instance().add(StatCounter::STACKTRACE_CACHE_MISSES);
+        return nullptr;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    SdkStats::instance().add(StatCounter::STACKTRACE_CACHE_HITS);
+    return entry->frames;
+}
+
+void StacktraceCache::insert(void* const* addresses, size_t count, bool withSourceData,
+                             std::shared_ptr<const json> frames)
+{
+    const uint64_t hash = hashAddresses(addresses, count, withSourceData);
+    Shard& shard = m_shards[hash % STACKTRACE_CACHE_SHARDS];
+    const size_t bytes = frames->dump().size();
+    SdkStats& stats = SdkStats::instance();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (lookup(shard, hash, addresses, count, withSourceData) != shard.entries.end())
+    {
+        return;     // symbolized by another thread in the meantime
+    }
+
+    if (shard.entries.size() >= STACKTRACE_CACHE_MAX_ENTRIES / STACKTRACE_CACHE_SHARDS)
+    {
+        const Entry& oldest = shard.entries.back();
+        auto range = shard.index.equal_range(oldest.hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (&*it->second == &oldest)
+            {
+                shard.index.erase(it);
+                break;
+            }
+        }
+        stats.subtract(StatCounter::STACKTRACE_CACHE_ENTRIES);
+        stats.subtract(StatCounter::STACKTRACE_CACHE_BYTES, oldest.bytes);
+        shard.entries.pop_back();
+    }
+
+    shard.entries.push_front({hash, withSourceData, std::vector<void*>(addresses, addresses + count), std::move(frames),
+                              bytes});
+    shard.index.emplace(hash, shard.entries.begin());
+    stats.add(StatCounter::STACKTRACE_CACHE_ENTRIES);
+    stats.add(StatCounter::STACKTRACE_CACHE_BYTES, bytes);
+}
+
+} // namespace Sentry
@@ -0,0 +1,81 @@
+#ifndef SENTRY_STACKTRACECACHE_H
+#define SENTRY_STACKTRACECACHE_H
+
+#include "json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * Symbolized stack traces by the raw addresses they were built from, so an error repeating in a loop is
+ * symbolized once. The frames are kept as finished (with context lines if requested) and immutable, a hit only
+ * shares them.
+ *
+ * The cache is split into shards by the hash of the addresses, each with its own lock and least recently
+ * used order; at most STACKTRACE_CACHE_MAX_ENTRIES stacks are kept. Hits, misses, entries and the bytes
+ * of the cached frames are in the SDK statistics. Entries are not invalidated when a library is unloaded,
+ * an address reused by another library would keep its old frames until evicted.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t STACKTRACE_CACHE_SHARDS = 16;
+constexpr size_t STACKTRACE_CACHE_MAX_ENTRIES = 1024;
+}
+
+namespace Sentry
+{
+
+class StacktraceCache
+{
+public:
+
+    static StacktraceCache& instance();
+
+    // the frames symbolized from the addresses earlier, nullptr if not cached
+    std::shared_ptr<const json> find(void* const* addresses, size_t count, bool withSourceData);
+    void insert(void* const* addresses, size_t count, bool withSourceData, std::shared_ptr<const json> frames);
+
+private:
+
+    StacktraceCache();
+
+    StacktraceCache(const StacktraceCache&) = delete;
+    StacktraceCache& operator=(const StacktraceCache&) = delete;
+    StacktraceCache(const StacktraceCache&&) = delete;
+    StacktraceCache&& operator=(const StacktraceCache&&) = delete;
+
+    struct Entry
+    {
+        uint64_t hash;
+        bool withSourceData;
+        std::vector<void*> addresses;
+        std::shared_ptr<const json> frames;
+        size_t bytes;   // of the serialized frames, for the statistics
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;   // the most recently used first
+        std::unordered_multimap<uint64_t, std::list<Entry>::iterator> index;
+    };
+
+    static uint64_t hashAddresses(void* const* addresses, size_t count, bool withSourceData);
+    static std::list<Entry>::iterator lookup(Shard& shard, uint64_t hash, void* const* addresses, size_t count,
+                                             bool withSourceData);
+
+    Shard m_shards[STACKTRACE_CACHE_SHARDS];
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_STACKTRACECACHE_H
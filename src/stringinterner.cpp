@@ -0,0 +1,148 @@
+#include "stringinterner.h"
+
+#include <functional>
+
+
+namespace
+{
+constexpr size_t INITIAL_INDEX_CAPACITY = 1024;
+}
+
+namespace Sentry
+{
+
+StringInterner& StringInterner::instance()
+{
+    // never destroyed - handles may still be used by static objects during exit
+    static StringInterner* interner = new StringInterner();
+    return *interner;
+}
+
+StringInterner::StringInterner()
+:
+m_chunks(),
+m_size(0),
+m_index(nullptr),
+m_insertMutex(),
+m_indexes()
+{
+    for (auto& chunk : m_chunks)
+    {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    m_indexes.push_back(std::make_unique<Index>(INITIAL_INDEX_CAPACITY));
+    m_index.store(m_indexes.back().get(), std::memory_order_release);
+
+    Handle empty;
+    intern("", &empty);     // handle 0
+}
+
+StringInterner::Index::Index(size_t indexCapacity)
+:
+capacity(indexCapacity),
+slots(new std::atomic<uint32_t>[indexCapacity])
+{
+    for (size_t i=0; i<capacity; i++)
+    {
+        slots[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool StringInterner::intern(const std::string& value, Handle* result)
+{
+    if (value.size() > MAX_LENGTH)
+    {
+        return false;
+    }
+
+    const size_t hash = std::hash<std::string>()(value);
+
+    Handle handle;
+    if (find(*m_index.load(std::memory_order_acquire), value, hash, &handle))
+    {
+        *result = handle;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_insertMutex);
+
+    // someone could have inserted it in the meantime
+    Index* index = m_index.load(std::memory_order_relaxed);
+    if (find(*index, value, hash, &handle))
+    {
+        *result = handle;
+        return true;
+    }
+
+    handle = m_size.load(std::memory_order_relaxed);
+    const size_t chunkNo = handle / CHUNK_SIZE;
+    if (chunkNo >= MAX_CHUNKS)
+    {
+        return false;   // full, the caller keeps a copy
+    }
+    if (m_chunks[chunkNo].load(std::memory_order_relaxed) == nullptr)
+    {
+        m_chunks[chunkNo].store(new std::string[CHUNK_SIZE], std::memory_order_release);
+    }
+    m_chunks[chunkNo].load(std::memory_order_relaxed)[handle % CHUNK_SIZE] = value;
+    m_size.store(handle + 1, std::memory_order_release);
+
+    // keep the load factor below 1/2
+    if ((handle + 1) * 2 > index->capacity)
+    {
+        auto newIndex = std::make_unique<Index>(index->capacity * 2);
+        for (Handle existing=0; existing<handle; existing++)
+        {
+            insertIntoIndex(*newIndex, std::hash<std::string>()(get(existing)), existing);
+        }
+        index = newIndex.get();
+        m_indexes.push_back(std::move(newIndex));
+    }
+    insertIntoIndex(*index, hash, handle);
+    m_index.store(index, std::memory_order_release);
+
+    *result = handle;
+    return true;
+}
+
+const std::string& StringInterner::get(Handle handle) const
+{
+    return m_chunks[handle / CHUNK_SIZE].load(std::memory_order_acquire)[handle % CHUNK_SIZE];
+}
+
+size_t StringInterner::size() const
+{
+    return m_size.load(std::memory_order_acquire);
+}
+
+bool StringInterner::find(const Index& index, const std::string& value, size_t hash, Handle* handle) const
+{
+    const size_t mask = index.capacity - 1;
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        const uint32_t entry = index.slots[slot].load(std::memory_order_acquire);
+        if (entry == 0)
+        {
+            return false;
+        }
+        if (get(entry - 1) == value)
+        {
+            *handle = entry - 1;
+            return true;
+        }
+    }
+}
+
+void StringInterner::insertIntoIndex(Index& index, size_t hash, Handle handle)
+{
+    const size_t mask = index.capacity - 1;
+    size_t slot = hash & mask;
+    while (index.slots[slot].load(std::memory_order_relaxed) != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index.slots[slot].store(handle + 1, std::memory_order_release);
+}
+
+} // namespace Sentry
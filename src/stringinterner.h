@@ -0,0 +1,143 @@
+#ifndef SENTRY_STRINGINTERNER_H
+#define SENTRY_STRINGINTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/*
+ * Process-wide table of strings that repeat across events (tag keys, breadcrumb types, categories, levels).
+ * Every distinct string is stored once and referenced by a small integer handle.
+ *
+ * Lookups of already interned strings and handle -> string reads are lock-free,
+ * only inserting a new string takes a lock. Strings are never removed, so the table is bounded: it keeps
+ * the first MAX_STRINGS distinct strings up to MAX_LENGTH bytes - the vocabulary. Other strings (user
+ * controlled values of high cardinality) are not interned, an InternedString then owns a copy.
+ */
+
+namespace Sentry
+{
+
+class StringInterner
+{
+public:
+
+    using Handle = uint32_t;
+
+    static StringInterner& instance();
+
+    static constexpr size_t MAX_STRINGS = 4096;
+    static constexpr size_t MAX_LENGTH = 128;
+
+    // false when the value is too long or the table is full
+    bool intern(const std::string& value, Handle* handle);
+    const std::string& get(Handle handle) const;
+    size_t size() const;
+
+private:
+
+    StringInterner();
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    StringInterner(const StringInterner&&) = delete;
+    StringInterner&& operator=(const StringInterner&&) = delete;
+
+    // open addressing hash index, slot holds handle+1 (0 = empty)
+    struct Index
+    {
+        explicit Index(size_t indexCapacity);
+
+        size_t capacity;
+        std::unique_ptr<std::atomic<uint32_t>[]> slots;
+    };
+
+    bool find(const Index& index, const std::string& value, size_t hash, Handle* handle) const;
+    static void insertIntoIndex(Index& index, size_t hash, Handle handle);
+
+    static constexpr size_t CHUNK_SIZE = 1024;
+    static constexpr size_t MAX_CHUNKS = MAX_STRINGS / CHUNK_SIZE;
+
+    // strings live in fixed chunks, so a published string never moves
+    std::atomic<std::string*> m_chunks[MAX_CHUNKS];
+    std::atomic<uint32_t> m_size;
+    std::atomic<Index*> m_index;
+
+    // writers only - replaced indexes may still be read, they are kept for the lifetime of the process
+    std::mutex m_insertMutex;
+    std::vector<std::unique_ptr<Index>> m_indexes;
+};
+
+class InternedString
+{
+public:
+
+    InternedString()
+    :
+    m_handle(0),    // handle 0 is always the empty string
+    m_owned()
+    {}
+
+    explicit InternedString(const std::string& value)
+    :
+    m_handle(0),
+    m_owned()
+    {
+        if (!StringInterner::instance().intern(value, &m_handle))
+        {
+            m_handle = NOT_INTERNED;
+            m_owned = value;
+        }
+    }
+
+    const std::string& str() const
+    {
+        return (m_handle == NOT_INTERNED) ? m_owned : StringInterner::instance().get(m_handle);
+    }
+
+    // NOT_INTERNED for an owned copy
+    StringInterner::Handle handle() const
+    {
+        return m_handle;
+    }
+
+    bool empty() const
+    {
+        return m_handle == 0;
+    }
+
+    // a value is either always interned or never (the table only grows until full), so an interned string
+    // never equals an owned one
+    bool operator==(const InternedString& other) const
+    {
+        return m_handle == other.m_handle && (m_handle != NOT_INTERNED || m_owned == other.m_owned);
+    }
+
+    bool operator!=(const InternedString& other) const
+    {
+        return !(*this == other);
+    }
+
+    // interned strings by handle, then the owned ones by value
+    bool operator<(const InternedString& other) const
+    {
+        if (m_handle != other.m_handle)
+            return m_handle < other.m_handle;
+        return m_handle == NOT_INTERNED && m_owned < other.m_owned;
+    }
+
+    static constexpr StringInterner::Handle NOT_INTERNED = UINT32_MAX;
+
+private:
+
+    StringInterner::Handle m_handle;
+    std::string m_owned;    // only when not interned
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_STRINGINTERNER_H
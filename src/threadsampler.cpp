@@ -0,0 +1,246 @@
+#include "threadsampler.h"
+
+#include "backtracehandler.h"
+#include "unwinder.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <execinfo.h>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+namespace
+{
+
+constexpr uint32_t SLOT_FREE = 0;
+constexpr uint32_t SLOT_WRITING = 1;
+constexpr uint32_t SLOT_DONE = 2;
+// a slot waiting for a stack holds the tag sent with the signal - the generation of the snapshot and the index
+// of the slot - so a signal arriving after its snapshot timed out cannot write into a later one
+constexpr uint32_t SLOT_TAG_GENERATION_SHIFT = 16;
+constexpr uint32_t SLOT_TAG_INDEX_MASK = (1u << SLOT_TAG_GENERATION_SHIFT) - 1;
+constexpr uint32_t SLOT_TAG_MAX_GENERATION = 0x7fff;     // the tag is sent as an int
+
+static_assert(THREAD_SNAPSHOT_MAX_THREADS <= SLOT_TAG_INDEX_MASK, "slot index does not fit the tag");
+
+struct SampleSlot
+{
+    std::atomic<uint32_t> state;
+    int frameCount;
+    void* frames[THREAD_SNAPSHOT_MAX_FRAMES];
+};
+
+// static, a late handler must never write into freed memory
+SampleSlot sampleSlots[THREAD_SNAPSHOT_MAX_THREADS];
+std::mutex snapshotMutex;   // one snapshot at a time
+uint32_t snapshotGeneration = 0;
+bool handlerInstalled = false;
+std::atomic<Sentry::StackUnwinder> sampleUnwinder(Sentry::StackUnwinder::BACKTRACE);
+
+int sampleSignal()
+{
+    return SIGRTMIN + 5;
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+bool ThreadSampler::installHandler()
+{
+    if (handlerInstalled)
+    {
+        return true;
+    }
+
+    // the signal may be used by the application already
+    struct sigaction previous;
+    if (sigaction(sampleSignal(), nullptr, &previous) != 0
+        || (previous.sa_flags & SA_SIGINFO) != 0 || previous.sa_handler != SIG_DFL)
+    {
+        return false;
+    }
+
+    // loads libgcc now, the first backtrace() is not safe in a signal handler
+    void* warmUp[1];
+    backtrace(warmUp, 1);
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sampleHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    handlerInstalled = (sigaction(sampleSignal(), &action, nullptr) == 0);
+    return handlerInstalled;
+}
+
+void ThreadSampler::sampleHandler(int, siginfo_t* info, void* context)
+{
+    const int savedErrno = errno;
+
+    const uint32_t tag = static_cast<uint32_t>(info->si_value.sival_int);
+    const size_t index = tag & SLOT_TAG_INDEX_MASK;
+    if (info->si_code == SI_QUEUE && index < THREAD_SNAPSHOT_MAX_THREADS)
+    {
+        SampleSlot& slot = sampleSlots[index];
+        uint32_t expected = tag;
+        if (slot.state.compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acquire))
+        {
+            slot.frameCount = static_cast<int>(Unwinder::unwindContext(sampleUnwinder.load(std::memory_order_relaxed), context,
+                                                                       slot.frames, THREAD_SNAPSHOT_MAX_FRAMES));
+            slot.state.store(SLOT_DONE, std::memory_order_release);
+        }
+    }
+
+    errno = savedErrno;
+}
+
+json ThreadSampler::captureThreads(bool withSourceData, StackUnwinder unwinder, pid_t crashedThreadId)
+{
+    class SampledThread
+    {
+    public:
+        pid_t id = 0;
+        std::string name;
+        size_t slot = THREAD_SNAPSHOT_MAX_THREADS;  // none
+        size_t firstFrame = 0;      // in the frames of all threads
+        size_t frameCount = 0;
+    };
+
+    std::vector<SampledThread> threads;
+    if (DIR* tasks = opendir("/proc/self/task"))
+    {
+        while (struct dirent* entry = readdir(tasks))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            SampledThread thread;
+            thread.id = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+            std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+            std::getline(comm, thread.name);
+            threads.push_back(std::move(thread));
+        }
+        closedir(tasks);
+    }
+
+    const pid_t currentThreadId = static_cast<pid_t>(syscall(SYS_gettid));
+    std::vector<backtraceHandler::ObjectFrame> frames;
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        const bool sampling = installHandler();
+        sampleUnwinder.store(unwinder, std::memory_order_relaxed);     // sent with the signals below
+
+        snapshotGeneration = snapshotGeneration % SLOT_TAG_MAX_GENERATION + 1;
+        const uint32_t generationTag = snapshotGeneration << SLOT_TAG_GENERATION_SHIFT;  // above the slot states
+
+        // all at once, the threads record their stacks in parallel
+        size_t usedSlots = 0;
+        for (auto& thread : threads)
+        {
+            if (!sampling || thread.id == crashedThreadId || usedSlots == THREAD_SNAPSHOT_MAX_THREADS)
+                continue;
+
+            SampleSlot& slot = sampleSlots[usedSlots];
+            const uint32_t tag = generationTag | static_cast<uint32_t>(usedSlots);
+            slot.state.store(tag, std::memory_order_release);
+
+            siginfo_t info;
+            std::memset(&info, 0, sizeof(info));
+            info.si_signo = sampleSignal();
+            info.si_code = SI_QUEUE;
+            info.si_pid = getpid();
+            info.si_uid = getuid();
+            info.si_value.sival_int = static_cast<int>(tag);
+            if (syscall(SYS_rt_tgsigqueueinfo, getpid(), thread.id, sampleSignal(), &info) == 0)
+            {
+                thread.slot = usedSlots++;
+            }
+            else
+            {
+                slot.state.store(SLOT_FREE, std::memory_order_relaxed);   // exited in the meantime
+            }
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(THREAD_SNAPSHOT_TIMEOUT_MILLISECONDS);
+        for (size_t waiting = usedSlots; waiting > 0 && std::chrono::steady_clock::now() < deadline; )
+        {
+            std::this_thread::yield();
+            waiting = 0;
+            for (size_t i = 0; i < usedSlots; ++i)
+            {
+                waiting += (sampleSlots[i].state.load(std::memory_order_acquire) > SLOT_DONE) ? 1 : 0;
+            }
+        }
+
+        for (size_t i = 0; i < usedSlots; ++i)
+        {
+            // takes the tag back from the threads that did not answer, waits for the ones writing just now
+            uint32_t expected = generationTag | static_cast<uint32_t>(i);
+            if (!sampleSlots[i].state.compare_exchange_strong(expected, SLOT_FREE, std::memory_order_acquire))
+            {
+                while (sampleSlots[i].state.load(std::memory_order_acquire) == SLOT_WRITING)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        for (auto& thread : threads)
+        {
+            if (thread.slot == THREAD_SNAPSHOT_MAX_THREADS)
+                continue;
+
+            SampleSlot& slot = sampleSlots[thread.slot];
+            thread.firstFrame = frames.size();
+            if (slot.state.load(std::memory_order_acquire) == SLOT_DONE)
+            {
+                // oldest first, the newest one was interrupted by the signal - not a return address
+                for (int i = slot.frameCount - 1; i >= 0; --i)
+                {
+                    frames.push_back(backtraceHandler::locateFrame(slot.frames[i], i != 0));
+                }
+            }
+            thread.frameCount = frames.size() - thread.firstFrame;
+            slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+        }
+    }
+
+    // outside of the lock, the symbol tables are read once for all the threads
+    backtraceHandler symbolizer(withSourceData);
+    const json symbolizedFrames = symbolizer.getStacktraceJSON(frames);
+
+    json values = json::array();
+    for (const auto& thread : threads)
+    {
+        const bool crashed = (thread.id == crashedThreadId);
+        json value = {{"id", thread.id},
+                      {"name", thread.name},
+                      {"crashed", crashed},
+                      {"current", crashed || (crashedThreadId == 0 && thread.id == currentThreadId)}};
+        if (thread.frameCount > 0)
+        {
+            json threadFrames = json::array();
+            for (size_t i = thread.firstFrame; i < thread.firstFrame + thread.frameCount; ++i)
+            {
+                threadFrames.push_back(symbolizedFrames[i]);
+            }
+            value["stacktrace"]["frames"] = std::move(threadFrames);
+        }
+        values.push_back(std::move(value));
+    }
+
+    return {{"values", values}};
+}
+
+} // namespace Sentry
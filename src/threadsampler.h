@@ -0,0 +1,51 @@
+#ifndef SENTRY_THREADSAMPLER_H
+#define SENTRY_THREADSAMPLER_H
+
+#include "json.h"
+#include "sentry.h"
+
+#include <signal.h>
+#include <sys/types.h>
+
+
+/*
+ * Stacks of all the threads of this process, for crashes and hang snapshots.
+ *
+ * The threads are listed from /proc/self/task and each is sent a real-time signal (with rt_tgsigqueueinfo,
+ * the value says where to store the stack), its handler walks the stack from the interrupted context with the
+ * chosen unwinder (unwinder.h). The caller waits for all of them at most THREAD_SNAPSHOT_TIMEOUT_MILLISECONDS -
+ * a thread blocking the signal or stuck in the kernel is listed without a stack - and the addresses of all
+ * threads are symbolized together.
+ *
+ * A sleep or a blocking call of a sampled thread may return early with EINTR.
+ */
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr size_t THREAD_SNAPSHOT_MAX_THREADS = 512;             // the others are listed without a stack
+constexpr int THREAD_SNAPSHOT_MAX_FRAMES = 64;
+constexpr unsigned int THREAD_SNAPSHOT_TIMEOUT_MILLISECONDS = 100;
+}
+
+namespace Sentry
+{
+
+class ThreadSampler
+{
+public:
+
+    // the threads interface of an event: every thread with its id, name and stack
+    // crashedThreadId - marked as crashed, without a stack (it is in the exception)
+    static json captureThreads(bool withSourceData, StackUnwinder unwinder, pid_t crashedThreadId = 0);
+
+private:
+
+    static bool installHandler();
+    static void sampleHandler(int sig, siginfo_t* info, void* context);
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_THREADSAMPLER_H
@@ -0,0 +1,107 @@
+#include "throwhook.h"
+
+#include "unwinder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+
+
+namespace
+{
+
+constexpr size_t THROW_HOOK_FRAMES = 2;     // recordThrow and __cxa_throw
+
+struct ThrowStack
+{
+    const void* exception;
+    size_t frameCount;
+    void* frames[THROW_STACK_MAX_FRAMES + THROW_HOOK_FRAMES];
+};
+
+thread_local ThrowStack throwStacks[THROW_STACK_SLOTS];
+thread_local size_t nextThrowStack = 0;
+
+std::atomic_bool throwHookEnabled(false);
+std::atomic<Sentry::StackUnwinder> throwHookUnwinder(Sentry::StackUnwinder::BACKTRACE);
+
+} // namespace
+
+#ifdef THROW_HOOK_SENTRYCPP
+
+// replaces the one of the C++ runtime (libstdc++ or libc++abi, linked after this library), which does the throw;
+// the type is a std::type_info*, declared as void* the way the compiler declares it implicitly for throw expressions
+extern "C" [[noreturn]] void __cxa_throw(void* thrownException, void* type, void (*destructor)(void*))
+{
+    using CxaThrow = void (*)(void*, void*, void (*)(void*));
+    static const CxaThrow runtimeThrow = reinterpret_cast<CxaThrow>(dlsym(RTLD_NEXT, "__cxa_throw"));
+
+    if (throwHookEnabled.load(std::memory_order_relaxed))
+    {
+        Sentry::ThrowHook::recordThrow(thrownException);
+    }
+
+    if (runtimeThrow == nullptr)
+    {
+        // the C++ runtime is linked statically into the same object, there is nothing to forward to
+        std::fputs("SentryCpp: __cxa_throw of the C++ runtime not found, build without THROW_HOOK_SENTRY\n", stderr);
+        std::abort();
+    }
+    runtimeThrow(thrownException, type, destructor);
+    __builtin_unreachable();
+}
+
+#endif // THROW_HOOK_SENTRYCPP
+
+namespace Sentry
+{
+
+bool ThrowHook::isAvailable()
+{
+#ifdef THROW_HOOK_SENTRYCPP
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ThrowHook::enable(StackUnwinder unwinder)
+{
+    throwHookUnwinder.store(unwinder, std::memory_order_relaxed);
+    throwHookEnabled.store(true, std::memory_order_relaxed);
+}
+
+void ThrowHook::disable()
+{
+    throwHookEnabled.store(false, std::memory_order_relaxed);
+}
+
+size_t ThrowHook::findThrowStack(const void* exception, void** frames, size_t maxFrames)
+{
+    // newest first, a freed exception object may have been reused by a later throw
+    for (size_t i = 1; i <= THROW_STACK_SLOTS; ++i)
+    {
+        const ThrowStack& stack = throwStacks[(nextThrowStack + THROW_STACK_SLOTS - i) % THROW_STACK_SLOTS];
+        if (stack.exception == exception && stack.frameCount > THROW_HOOK_FRAMES)
+        {
+            const size_t count = std::min(stack.frameCount - THROW_HOOK_FRAMES, maxFrames);
+            std::copy(stack.frames + THROW_HOOK_FRAMES, stack.frames + THROW_HOOK_FRAMES + count, frames);
+            return count;
+        }
+    }
+    return 0;
+}
+
+__attribute__((noinline)) void ThrowHook::recordThrow(const void* exception)
+{
+    ThrowStack& stack = throwStacks[nextThrowStack];
+    nextThrowStack = (nextThrowStack + 1) % THROW_STACK_SLOTS;
+
+    stack.exception = exception;
+    stack.frameCount = Unwinder::unwind(throwHookUnwinder.load(std::memory_order_relaxed), stack.frames,
+                                        THROW_STACK_MAX_FRAMES + THROW_HOOK_FRAMES);
+}
+
+} // namespace Sentry
@@ -0,0 +1,51 @@
+#ifndef SENTRY_THROWHOOK_H
+#define SENTRY_THROWHOOK_H
+
+#include "sentry.h"
+
+#include <cstddef>
+
+
+/*
+ * The stack where an exception was thrown, for SentryOptions::captureThrowStack.
+ *
+ * Built with THROW_HOOK_SENTRY, the library defines __cxa_throw: it records the return addresses (nothing is
+ * symbolized) into one of THROW_STACK_SLOTS thread-local slots, keyed by the exception object, then calls
+ * the __cxa_throw of the C++ runtime. captureException looks the caught exception up and reports the stack
+ * of the throw instead of the one of the catch. An exception caught on another thread than it was thrown,
+ * or after THROW_STACK_SLOTS later throws of the same thread, falls back to the stack of the catch.
+ *
+ * The hook costs a relaxed load while disabled; enabled, one stack walk with the configured unwinder per
+ * throw (FRAME_POINTER or EH_FRAME keep it to a few hundred nanoseconds).
+ */
+
+namespace
+{
+constexpr size_t THROW_STACK_MAX_FRAMES = 64;
+constexpr size_t THROW_STACK_SLOTS = 4;     // per thread, a throw from a catch block does not lose the first
+}
+
+namespace Sentry
+{
+
+class ThrowHook
+{
+public:
+
+    // the library was built with the hook
+    static bool isAvailable();
+
+    static void enable(StackUnwinder unwinder);
+    static void disable();
+
+    // the return addresses recorded when the exception was thrown on this thread, newest (the throw) first;
+    // exception is the most derived object, e.g. dynamic_cast<const void*>(&caught)
+    static size_t findThrowStack(const void* exception, void** frames, size_t maxFrames);
+
+    // from the hook
+    static void recordThrow(const void* exception);
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_THROWHOOK_H
@@ -1,56 +1,166 @@
 #include "sentry_common.h"
+#include "dsnparser.h"
+#include "httptransport.h"
+#include "linetransport.h"
+#include "memorytransport.h"
+#include "sdkstats.h"
 #include "transport.h"
 
-#include <regex>
-#include <sstream>
+#include <asio.hpp>
+#include <asio/steady_timer.hpp>
 
-
-#define SENTRY_VERSION 7
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <unistd.h>
 
 
 namespace Sentry
 {
 
-EErrorCode SentryDSN::parseDSN(const std::string& dsn, SentryDSN* newDSNStruct)
+// a single chain of steps: each step either posts the next one or waits on the timer for it
+struct Transport::AsyncWorker : public std::enable_shared_from_this<Transport::AsyncWorker>
 {
-    // '{PROTOCOL}://{PUBLIC_KEY}:{SECRET_KEY}@{HOST_PATH}/{PROJECT_ID}'
-    std::regex re("(.*)://(.*)(:.*)*@(.*)/(.*)");
+    AsyncWorker(asio::io_context& ioContext, Transport* owner)
+    :
+    strand(ioContext),
+    timer(ioContext),
+    mutex(),
+    transport(owner),
+    sleeping(false),
+    waiting(false)
+    {
 
-    std::smatch match;
-    if (std::regex_search(dsn, match, re))
+    }
+
+    void post()
     {
-        newDSNStruct->protocol = match.str(1);
-        newDSNStruct->publicKey = match.str(2);
-        newDSNStruct->secretKey = match.str(3);
-        newDSNStruct->hostPath = match.str(4);
-        newDSNStruct->projectID = match.str(5);
+        auto self = shared_from_this();
+        asio::post(strand, [self]() { self->step(); });
+    }
 
-        newDSNStruct->baseURI = newDSNStruct->protocol + "://" + newDSNStruct->hostPath;
+    void waitUntil(std::chrono::steady_clock::time_point wakeUp)
+    {
+        auto self = shared_from_this();
+        waiting = true;
+        timer.expires_at(wakeUp);
+        timer.async_wait(asio::bind_executor(strand, [self](const asio::error_code&)
+        {
+            self->waiting = false;
+            self->step();
+        }));
+    }
 
-        newDSNStruct->sentry_endpoint_path = "/api/" + newDSNStruct->projectID + "/store/";
-        newDSNStruct->sentry_endpoint = newDSNStruct->baseURI + newDSNStruct->sentry_endpoint_path;
+    // a task was queued or the transport stopped: the waiting step runs now, or a step when idle
+    void wake()
+    {
+        if (!sleeping.exchange(false))
+            return;
+        auto self = shared_from_this();
+        asio::post(strand, [self]()
+        {
+            std::lock_guard<std::recursive_mutex> lock(self->mutex);
+            if (self->transport == nullptr)
+                return;
+            if (self->waiting)
+            {
+                self->timer.cancel();
+            }
+            else
+            {
+                self->step();
+            }
+        });
+    }
 
-        return EErrorCode::NO_ERROR;
+    // stopped from outside the strand, a waiting timer must not hold the event loop until it expires
+    void release()
+    {
+        auto self = shared_from_this();
+        asio::post(strand, [self]() { self->timer.cancel(); });
     }
 
-    else
+    void step()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        sleeping = false;
+        if (transport != nullptr)
+        {
+            transport->runAsyncStep();
+        }
+    }
+
+    asio::io_context::strand strand;
+    asio::steady_timer timer;
+    std::recursive_mutex mutex;     // held by a step, and while the worker is run on another thread (performInline)
+    Transport* transport;           // cleared when stopped, for the handlers still scheduled
+    std::atomic_bool sleeping;      // set before the queue is checked the last time, see runAsyncStep
+    bool waiting;                   // on the timer, within the strand
+};
+
+EErrorCode SentryDSN::parseDSN(const std::string& dsn, SentryDSN* newDSNStruct)
+{
+    // '{PROTOCOL}://{PUBLIC_KEY}:{SECRET_KEY}@{HOST}{PATH}/{PROJECT_ID}'
+    const DSNParts parts = parseDSNParts(dsn);
+    if (!parts.valid)
     {
         return EErrorCode::WRONG_DSN;
     }
 
+    newDSNStruct->protocol = parts.protocol;
+    newDSNStruct->publicKey = parts.publicKey;
+    newDSNStruct->secretKey = parts.secretKey;
+    newDSNStruct->hostPath = parts.hostPort;
+    newDSNStruct->host = parts.host;
+    newDSNStruct->port = parts.port;
+    newDSNStruct->path = parts.path;
+    newDSNStruct->projectID = parts.projectID;
+
+    newDSNStruct->baseURI = newDSNStruct->protocol + "://" + newDSNStruct->hostPath;
+
+    newDSNStruct->sentry_endpoint_path = newDSNStruct->path + "/api/" + newDSNStruct->projectID + "/store/";
+    newDSNStruct->sentry_endpoint = newDSNStruct->baseURI + newDSNStruct->sentry_endpoint_path;
+    newDSNStruct->envelope_endpoint_path = newDSNStruct->path + "/api/" + newDSNStruct->projectID + "/envelope/";
+    newDSNStruct->envelope_endpoint = newDSNStruct->baseURI + newDSNStruct->envelope_endpoint_path;
+
+    return EErrorCode::NO_ERROR;
+}
+
+std::shared_ptr<Transport> Transport::create(TransportType type)
+{
+    switch (type)
+    {
+    case TransportType::MEMORY:
+        return std::make_shared<MemoryTransport>();
+    case TransportType::FILE:
+        return std::make_shared<FileTransport>();
+    case TransportType::UNIX_SOCKET:
+        return std::make_shared<UnixSocketTransport>();
+    case TransportType::HTTP:
+    default:
+        return std::make_shared<HttpTransport>();
+    }
 }
 
 Transport::Transport()
 :
 m_lastConnectionRequestTime(),
+m_reconnectTimeoutMilliseconds(INITIAL_RECONNECTION_TIMEOUT_MILLISECONDS),
+m_retryAfterMilliseconds(0),
+m_lastRequestBeforeDroppingTime(),
 m_thread(),
+m_ioContext(nullptr),
+m_asyncWorker(),
 m_tasks(),
+m_periodicTasks(),
+m_taskInProgress(false),
 m_tasksQueueMutex(),
+m_taskDoneConditionVariable(),
 m_running(false),
 m_shouldStop(false),
-m_pHttpClient(nullptr),
 m_actionInProgressMutex(),
 m_conditionVariable(),
+m_eventLimits(),
 m_state(State::NO_CONNECTION),
 m_stateMutex()
 {
@@ -59,43 +169,63 @@ m_stateMutex()
 
 Transport::~Transport()
 {
-
+    // the implementations stop in their destructors already, send must not be called on a destroyed one
+    stop();
 }
 
-void Transport::start()
+void Transport::setIoContext(asio::io_context* ioContext)
 {
-    //start thread
-    m_thread = std::thread(&Transport::run, this);
-
-    m_running = true;
+    m_ioContext = ioContext;
 }
 
-EErrorCode Transport::setupClient(SentryDSN dsn)
+void Transport::start()
 {
-    m_dsnStruct = dsn;
-
-#ifdef DEBUG_SENTRYCPP
-        std::stringstream ss;
-        ss << "Protocol: " << m_dsnStruct.protocol
-           << " public key: " << m_dsnStruct.publicKey
-           << " host path: " << m_dsnStruct.hostPath;
-        if (m_dsnStruct.secretKey != "")
-            ss << ", " << "sentry_secret key: " << m_dsnStruct.secretKey;
-        ss << std::endl << "Endpoint path: " << m_dsnStruct.sentry_endpoint_path;
-        LOG_SENTRY_DEBUG(ss.str());
-#endif // DEBUG_SENTRYCPP
-
-    m_pHttpClient = std::make_shared<http::Client>(m_dsnStruct.hostPath);
-    m_pHttpClient->config.timeout = HTTP_CLIENT_TIMOUT_IN_SECONDS;  /// ? no set func???
+    m_running = true;
+    if (m_ioContext != nullptr)
+    {
+        m_asyncWorker = std::make_shared<AsyncWorker>(*m_ioContext, this);
+        m_asyncWorker->post();
+        return;
+    }
 
-    return EErrorCode::NO_ERROR;
+    //start thread
+    m_thread = std::thread(&Transport::run, this);
 }
 
 void Transport::stop()
 {
     // TODO: save events not sent?
     m_shouldStop = true;
-    m_thread.join();
+    m_conditionVariable.notify_all();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    if (m_asyncWorker != nullptr && m_running)
+    {
+        if (!asyncWorkerBlocked())
+        {
+            // the last step sends what is queued, unless the loop does not get to it (e.g. stopped meanwhile)
+            m_asyncWorker->wake();
+            std::unique_lock<std::mutex> lock(m_tasksQueueMutex);
+            if (m_taskDoneConditionVariable.wait_for(lock, std::chrono::milliseconds(ASYNC_WORKER_STOP_WAIT_MILLISECONDS),
+                                                     [this]() { return !m_running; }))
+            {
+                return;
+            }
+        }
+
+        performInline(std::chrono::steady_clock::time_point::max());
+        {
+            std::lock_guard<std::recursive_mutex> workerLock(m_asyncWorker->mutex);
+            m_asyncWorker->transport = nullptr;
+            std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+            m_running = false;
+        }
+        m_asyncWorker->release();
+        m_taskDoneConditionVariable.notify_all();
+    }
 }
 
 void Transport::run()
@@ -103,6 +233,7 @@ void Transport::run()
     while(!m_shouldStop)
     {
         perform();
+        runPeriodicTasks();
     }
     // perform until the list of events to send is empty
     while(!m_tasks.empty())
@@ -112,14 +243,150 @@ void Transport::run()
     m_running = false;
 }
 
-template<typename F>
-void Transport::addActionToQueue(F actionToEnqueue)
+void Transport::runAsyncStep()
 {
+    AsyncWorker& worker = *m_asyncWorker;
+    if (m_shouldStop && isQueueEmpty())
+    {
+        worker.transport = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+            m_running = false;
+        }
+        m_taskDoneConditionVariable.notify_all();
+        return;
+    }
+
+    if (!m_shouldStop)
+    {
+        runPeriodicTasks();
+    }
+
+    const std::chrono::milliseconds paused = sendingPausedFor();
+    if (paused.count() == 0 && !isQueueEmpty())
+    {
+        // a few tasks per handler, the handlers of the application run in between
+        for (size_t i=0; i<ASYNC_WORKER_TASKS_PER_STEP && m_state == State::SEND_EVENTS && !isQueueEmpty(); i++)
+        {
+            runNextTask();
+        }
+        worker.post();
+        return;
+    }
+
+    // a task queued or a periodic task added from now on wakes the worker up
+    worker.sleeping = true;
+
+    // the timer is armed only for a deadline, with nothing due the worker leaves no work on the event loop
+    bool hasDeadline = paused.count() > 0;
+    auto wakeUp = std::chrono::steady_clock::now() + paused;
     if (!m_shouldStop)
     {
         std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
-        m_tasks.push(actionToEnqueue);
+        for (const auto& periodicTask : m_periodicTasks)
+        {
+            wakeUp = hasDeadline ? std::min(wakeUp, periodicTask.nextRun) : periodicTask.nextRun;
+            hasDeadline = true;
+        }
     }
+
+    const bool queueEmpty = isQueueEmpty();
+    if ((!queueEmpty && paused.count() == 0) || (queueEmpty && m_shouldStop))
+    {
+        // queued meanwhile, or stopped
+        worker.sleeping = false;
+        worker.post();
+        return;
+    }
+    if (hasDeadline)
+    {
+        worker.waitUntil(wakeUp);
+    }
+}
+
+bool Transport::asyncWorkerBlocked() const
+{
+    return m_ioContext->stopped() || m_ioContext->get_executor().running_in_this_thread();
+}
+
+bool Transport::performInline(std::chrono::steady_clock::time_point deadline)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_asyncWorker->mutex);
+    while (!isQueueEmpty() && std::chrono::steady_clock::now() < deadline)
+    {
+        perform();
+    }
+    return isQueueEmpty();
+}
+
+void Transport::addActionToQueue(std::function<void()> actionToEnqueue)
+{
+    if (!m_shouldStop)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+            m_tasks.push(std::move(actionToEnqueue));
+        }
+        SdkStats::instance().add(StatCounter::QUEUE_DEPTH);
+        m_conditionVariable.notify_one();
+        if (m_asyncWorker != nullptr)
+        {
+            m_asyncWorker->wake();
+        }
+    }
+}
+
+void Transport::addPeriodicTask(std::chrono::milliseconds interval, std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+        m_periodicTasks.push_back({interval, std::chrono::steady_clock::now() + interval, std::move(task)});
+    }
+    if (m_asyncWorker != nullptr)
+    {
+        m_asyncWorker->wake();
+    }
+}
+
+bool Transport::flush(std::chrono::milliseconds timeout)
+{
+    if (m_asyncWorker != nullptr && m_running && asyncWorkerBlocked())
+    {
+        return performInline(std::chrono::steady_clock::now() + timeout);
+    }
+
+    // a failed event is queued again before its task is done, so an empty queue and no task mean all were handled
+    std::unique_lock<std::mutex> lock(m_tasksQueueMutex);
+    return m_taskDoneConditionVariable.wait_for(lock, timeout, [this]() { return m_tasks.empty() && !m_taskInProgress; });
+}
+
+void Transport::runPeriodicTasks()
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::function<void()>> dueTasks;
+    {
+        std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+        for (auto& periodicTask : m_periodicTasks)
+        {
+            if (now >= periodicTask.nextRun)
+            {
+                dueTasks.push_back(periodicTask.task);
+                periodicTask.nextRun = now + periodicTask.interval;
+            }
+        }
+    }
+
+    for (auto& task : dueTasks)
+    {
+        task();
+    }
+}
+
+void Transport::waitFor(std::chrono::milliseconds timeout)
+{
+    // wakes up earlier when a new task arrives or the transport is stopped
+    std::unique_lock<std::mutex> lock(m_tasksQueueMutex);
+    m_conditionVariable.wait_for(lock, timeout, [this]() { return m_shouldStop || !m_tasks.empty(); });
 }
 
 void Transport::perform()
@@ -138,6 +405,8 @@ void Transport::perform()
         break;
 
     case State::DROP_EVENTS:
+
+        performDropEvents();
         break;
 
     default:
@@ -148,13 +417,40 @@ void Transport::perform()
 
 void Transport::performNoConnection()
 {
-    if (reconnectTimeoutReached())
+    if (sendingPausedFor().count() > 0)
     {
-        changeState(State::SEND_EVENTS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_IDLE_WAIT_MILLISECONDS));
     }
-    else
+}
+
+std::chrono::milliseconds Transport::sendingPausedFor()
+{
+    const auto now = std::chrono::system_clock::now();
+    switch (m_state)
     {
-        // do nothing
+    case State::NO_CONNECTION:
+        if (reconnectTimeoutReached())
+        {
+            // exponential backoff, so a short outage does not stall the queue for the full timeout
+            // reset after the first successful request
+            m_reconnectTimeoutMilliseconds = std::min(2 * m_reconnectTimeoutMilliseconds, RECONNECTION_TIMEOUT_MILLISECONDS);
+            changeState(State::SEND_EVENTS);
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::ceil<std::chrono::milliseconds>(m_lastConnectionRequestTime
+                                                            + std::chrono::milliseconds(m_reconnectTimeoutMilliseconds) - now);
+
+    case State::DROP_EVENTS:
+        if (droppingEventsTimeoutReached())
+        {
+            changeState(State::SEND_EVENTS);
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::ceil<std::chrono::milliseconds>(m_lastRequestBeforeDroppingTime
+                                                            + std::chrono::milliseconds(m_retryAfterMilliseconds) - now);
+
+    default:
+        return std::chrono::milliseconds(0);
     }
 }
 
@@ -162,37 +458,61 @@ bool Transport::reconnectTimeoutReached()
 {
     auto timeSinceLastRequest = std::chrono::system_clock::now() - m_lastConnectionRequestTime;
 
-    return (std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceLastRequest).count() >= RECONNECTION_TIMEOUT_MILLISECONDS);
+    return (std::chrono::duration_cast<std::chrono::milliseconds>(timeSinceLastRequest).count() >= m_reconnectTimeoutMilliseconds);
+}
+
+void Transport::handleConnectionError()
+{
+    changeState(State::NO_CONNECTION);
+    m_lastConnectionRequestTime = std::chrono::system_clock::now();
 }
 
 void Transport::performSendEvents()
 {
     if (m_tasks.empty())
+    {
+        waitFor(std::chrono::milliseconds(WORKER_IDLE_WAIT_MILLISECONDS));
         return;
+    }
+
+    runNextTask();
+}
+
+bool Transport::isQueueEmpty() const
+{
+    std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+    return m_tasks.empty();
+}
 
+void Transport::runNextTask()
+{
     std::function<void()>  funcToExecute;
     {
         std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
         assert(m_tasks.size() > 0);
-        funcToExecute = m_tasks.front();
+        funcToExecute = std::move(m_tasks.front());
         m_tasks.pop();
+        m_taskInProgress = true;
     }
+    SdkStats::instance().subtract(StatCounter::QUEUE_DEPTH);
 
     if (funcToExecute)
     {
         funcToExecute();
     }
+
+    {
+        std::lock_guard<std::mutex> lock(m_tasksQueueMutex);
+        m_taskInProgress = false;
+    }
+    m_taskDoneConditionVariable.notify_all();
 }
 
 void Transport::performDropEvents()
 {
-    if (droppingEventsTimeoutReached())
+    if (sendingPausedFor().count() > 0)
     {
-        changeState(State::SEND_EVENTS);
-    }
-    else
-    {
-        // do nothing
+        std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_IDLE_WAIT_MILLISECONDS));
     }
 }
 
@@ -211,142 +531,133 @@ void Transport::changeState(State newState)
     m_state = newState;
 }
 
+void Transport::setEventLimits(const EventLimits& limits)
+{
+    m_eventLimits = limits;
+}
+
 void Transport::sendEvent(const std::string& contents)
 {
-    auto actionToEnqueue = [=] () { sendPost(contents); };
+    auto actionToEnqueue = [=] () { send(contents, 0); };
 
     addActionToQueue(actionToEnqueue);
 }
 
-void Transport::sendEventRetry(const std::string& contents, const http::Header& header)
+void Transport::sendEvent(json event, EventProcessor processor, std::vector<Attachment> attachments)
 {
-    auto actionToEnqueue = [=]() { sendPost(contents, header, true); };
+    auto actionToEnqueue = [this, event, processor, attachments] () mutable
+    {
+        if (processor && !processor(event))
+        {
+            SdkStats::instance().add(StatCounter::EVENTS_DROPPED);
+            return;
+        }
+
+        std::string contents;
+        {
+            ScopedStatTimer timer(StatCounter::SERIALIZATIONS, StatCounter::SERIALIZATION_TIME_NS);
+            contents = EventSerializer::serializeEvent(event, m_eventLimits);
+        }
+        if (attachments.empty())
+        {
+            send(contents, 0);
+        }
+        else
+        {
+            sendStreamed(std::make_shared<StreamedEnvelope>(event.value("event_id", ""), contents, std::move(attachments)), 0);
+        }
+    };
 
     addActionToQueue(actionToEnqueue);
 }
 
-void Transport::sendPost(const std::string& content)
+void Transport::sendEnvelope(std::shared_ptr<const StreamedEnvelope> envelope)
 {
-    if (m_pHttpClient == nullptr)
-    {
-        //raise - client not set!
-        return;
-    }
-    auto header = createHeader();
-
-#ifdef DEBUG_SENTRYCPP
-    std::stringstream ss;
-    ss << "Path: " << m_dsnStruct.sentry_endpoint_path << "Request headers: " << std::endl;
-    for (auto h : header) {
-        ss << h.first << ": " << h.second << std::endl;
-    }
-    ss << "Request contents: " << content << std::endl;
-    ss << "Http client url: " << m_dsnStruct.sentry_endpoint << std::endl;
-    LOG_SENTRY_DEBUG(ss.str());
-#endif // DEBUG_SENTRYCPP
+    auto actionToEnqueue = [this, envelope]() { sendStreamed(envelope, 0); };
 
-    sendPost(content, header);
+    addActionToQueue(actionToEnqueue);
 }
 
-void Transport::sendPost(const std::string& content, const http::Header& header, bool isRetrying)
+void Transport::sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt)
 {
-    try
+    const OpenedEnvelope opened(*envelope);
+    std::string contents;
+    contents.reserve(opened.size());
+    for (const EnvelopePart& part : opened.parts())
     {
-        auto response = m_pHttpClient->request(POST, m_dsnStruct.sentry_endpoint, content, header);
-
-        //check response
-        bool ok = checkResponse(response);
-        if ((!ok) && (!isRetrying))
+        contents.append(part.data);
+        const size_t start = contents.size();
+        contents.resize(start + part.length);
+        size_t done = 0;
+        while (done < part.length)
         {
-            sendEventRetry(content, header);
+            const ssize_t bytesRead = pread(part.descriptor, &contents[start + done], part.length - done,
+                                            part.offset + static_cast<off_t>(done));
+            if (bytesRead < 0 && errno == EINTR)
+                continue;
+            if (bytesRead <= 0)
+            {
+                // shorter than when it was opened, sent again from the start
+                handleSendFailure(envelope, attempt);
+                return;
+            }
+            done += static_cast<size_t>(bytesRead);
         }
-
-    }
-    catch(SimpleWeb::system_error& e)
-    {
-#ifdef DEBUG_SENTRYCPP
-        LOG_SENTRY_DEBUG("Could not send event! ");
-        LOG_SENTRY_DEBUG(e.code().message());
-        LOG_SENTRY_DEBUG(e.what());
-#endif
-        changeState(State::NO_CONNECTION); // ? does every error mean that?
-        m_lastConnectionRequestTime = std::chrono::system_clock::now();
     }
+    send(contents, attempt);
 }
 
-http::Header Transport::createHeader()
+void Transport::sendEventRetry(const std::string& contents, unsigned int attempt)
 {
-    /*
-     * Authentication header:
-     * X-Sentry-Auth: Sentry sentry_version=5,
-      sentry_client=<client version, arbitrary>,
-      sentry_timestamp=<current timestamp>,
-      sentry_key=<public api key>,
-      sentry_secret=<secret api key>
-    */
+    auto actionToEnqueue = [=]() { send(contents, attempt); };
 
-    http::Header header;
-    std::string client_version = "sentry_cpp/0.1";
-    const auto tp = std::chrono::system_clock::now();
-    const auto dur = tp.time_since_epoch();
-    std::string timestamp = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(dur).count());
+    addActionToQueue(actionToEnqueue);
+}
 
-    std::string header_info;
+void Transport::handleSendFailure(const std::string& content, unsigned int attempt)
+{
+    // the event goes to the back of the queue and is sent once the transport leaves NO_CONNECTION / DROP_EVENTS
+    if (attempt + 1 < MAX_SEND_ATTEMPTS)
     {
-    std::stringstream ss;
-    ss << "Sentry " << "sentry_version=" << SENTRY_VERSION << ", "
-       << "sentry_client=" << client_version << ", "
-       << "sentry_timestamp=" << timestamp << ", "
-       << "sentry_key=" << m_dsnStruct.publicKey;
-    if (m_dsnStruct.secretKey != "")
-        ss << ", " << "sentry_secret=" << m_dsnStruct.secretKey;
-    header_info = ss.str();
+        sendEventRetry(content, attempt + 1);
+    }
+    else
+    {
+        SdkStats::instance().add(StatCounter::EVENTS_FAILED);
     }
-
-    header.emplace("X-Sentry-Auth", header_info);
-    header.emplace("Content-Type", "application/json");
-    header.emplace("User-Agent", client_version);
-
-    return header;
 }
 
-bool Transport::checkResponse(std::shared_ptr<http::Response> response)
+void Transport::handleSendFailure(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt)
 {
-    if (SimpleWeb::status_code(response->status_code) == SimpleWeb::StatusCode::success_ok)
-    {
-        return true;
-    }
-    else if (SimpleWeb::status_code(response->status_code) == SimpleWeb::StatusCode::client_error_too_many_requests)
+    if (attempt + 1 < MAX_SEND_ATTEMPTS)
     {
-        handleTooManyRequests(response);
-        return true;
+        auto actionToEnqueue = [this, envelope, attempt]() { sendStreamed(envelope, attempt + 1); };
+        addActionToQueue(actionToEnqueue);
     }
     else
     {
-#ifdef DEBUG_SENTRYCPP
-            std::stringstream ss;
-            ss << "Response "
-               << "status code: " << response->status_code << std::endl;
-            ss << "Response headers" << std::endl;
-            for (auto h : response->header) {
-                ss << h.first << ": " << h.second << std::endl;
-            }
-            ss << "Response content: " << response->content.string() << std::endl;
-            LOG_SENTRY_DEBUG(ss.str());
-#endif //DEBUG_SENTRYCPP
-        return false;
+        SdkStats::instance().add(StatCounter::EVENTS_FAILED);
     }
 }
 
-void Transport::handleTooManyRequests(std::shared_ptr<http::Response> errorResponse)
+void Transport::handleSendSuccess(size_t contentsSize)
 {
-    m_retryAfterMilliseconds = RECONNECTION_TIMEOUT_MILLISECONDS; // default
-    for (auto& h : errorResponse->header) {
-        if (h.first == "Retry-After")
-        {
-            m_retryAfterMilliseconds = std::stoul(h.second.c_str()) * MILLISECONDS_IN_SECOND;
-        }
-    }
+    SdkStats& stats = SdkStats::instance();
+    stats.add(StatCounter::EVENTS_SENT);
+    stats.add(StatCounter::BYTES_SENT, contentsSize);
+    m_reconnectTimeoutMilliseconds = INITIAL_RECONNECTION_TIMEOUT_MILLISECONDS;
+}
+
+void Transport::handleSendSuccess(const OpenedEnvelope& envelope)
+{
+    SdkStats::instance().add(StatCounter::ATTACHMENTS_SENT, envelope.attachments());
+    handleSendSuccess(static_cast<size_t>(envelope.size()));
+}
+
+void Transport::pauseSending(uint64_t milliseconds)
+{
+    m_retryAfterMilliseconds = milliseconds;
+    m_lastRequestBeforeDroppingTime = std::chrono::system_clock::now();
     changeState(State::DROP_EVENTS);
 }
 
@@ -1,18 +1,29 @@
 #ifndef SENTRY_TRANSPORT_H
 #define SENTRY_TRANSPORT_H
 
+#include "envelope.h"
+#include "eventserializer.h"
+#include "sentry.h"
 #include "sentry_common.h"
 
-#include "client_http.hpp"
+#include "json.h"
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 
+namespace asio
+{
+class io_context;
+}
+
 /*
  * From: https://docs.sentry.io/development/sdk-dev/unified-api/ :
      * The transport is an internal construct of the client that abstracts away the event sending.
@@ -21,17 +32,30 @@
      * The transport might also persist unsent events across restarts if needed.
 */
 
+/*
+ * Transport is the common part: the worker thread, the queue, periodic tasks, retries and the backoff
+ * after connection errors. The implementations (selected with SentryOptions::transport) only deliver
+ * a serialized event: HttpTransport (httptransport.h, the default), MemoryTransport (memorytransport.h),
+ * FileTransport and UnixSocketTransport (linetransport.h). Envelopes (envelope.h) take the same path.
+ *
+ * With SentryOptions::ioContext the worker has no thread: its steps are handlers on a strand of the event loop
+ * of the application, up to ASYNC_WORKER_TASKS_PER_STEP tasks each, and it waits (the backoff, a pause after
+ * 429, the next periodic task) on a timer, which a new task cancels. With no deadline it arms no timer and a new
+ * task posts a step, so an idle transport without periodic tasks keeps no work on the loop. A send itself is
+ * still synchronous within its handler.
+ * When nothing would run the strand - the loop stopped, or stop/flush called on a thread running the loop,
+ * e.g. by the crash handlers - the queue is sent from the calling thread.
+ */
 
-namespace http
-{
-using Client = ::SimpleWeb::Client<::SimpleWeb::HTTP>;
-using Header = ::SimpleWeb::CaseInsensitiveMultimap;
-using Response = ::SimpleWeb::ClientBase<asio::basic_stream_socket<asio::ip::tcp>>::Response;
-}
 
 namespace
 {
 constexpr unsigned int RECONNECTION_TIMEOUT_MILLISECONDS = 10000;
+constexpr unsigned int INITIAL_RECONNECTION_TIMEOUT_MILLISECONDS = 100;  // doubled on every failed reconnection
+constexpr unsigned int MAX_SEND_ATTEMPTS = 10;
+constexpr unsigned int WORKER_IDLE_WAIT_MILLISECONDS = 100;
+constexpr unsigned int ASYNC_WORKER_STOP_WAIT_MILLISECONDS = 1000;  // for the event loop to send the queue, then stop does
+constexpr size_t ASYNC_WORKER_TASKS_PER_STEP = 32;
 }
 
 namespace Sentry
@@ -44,7 +68,10 @@ public:
     std::string protocol;
     std::string publicKey;
     std::string secretKey;
-    std::string hostPath;
+    std::string hostPath;       // {HOST}[:{PORT}] as in the DSN
+    std::string host;           // without the brackets of IPv6 literals
+    unsigned short port = 0;    // explicit or the protocol default
+    std::string path;           // prefix of the API endpoints, empty or e.g. /sentry
     std::string projectID;
 
     // {BASE_URI} = '{PROTOCOL}://{HOST}{PATH}'
@@ -54,6 +81,10 @@ public:
     std::string sentry_endpoint;
     std::string sentry_endpoint_path; // without host
 
+    // envelope endpoint = '{BASE_URI}/api/{PROJECT_ID}/envelope/', for transactions etc.
+    std::string envelope_endpoint;
+    std::string envelope_endpoint_path;
+
     static EErrorCode parseDSN(const std::string &dsn, SentryDSN* newDSNStruct);
 };
 
@@ -61,17 +92,66 @@ class Transport
 {
 public:
 
-    Transport();
-    ~Transport();
+    // not set up nor started
+    static std::shared_ptr<Transport> create(TransportType type);
+
+    virtual ~Transport();
+
+    // dsn is empty (not parsed) when none was given, only HttpTransport needs one
+    virtual EErrorCode setup(const SentryDSN& dsn, const SentryOptions& options) = 0;
+
+    // for the events serialized on the worker, set before start
+    void setEventLimits(const EventLimits& limits);
+    // the worker runs on a strand of ioContext instead of a thread of its own, set before start
+    void setIoContext(asio::io_context* ioContext);
 
     void start();
     void stop();
-    EErrorCode setupClient(SentryDSN dsn);
     void sendEvent(const std::string& contents);
-    void sendEventRetry(const std::string& contents, const http::Header& header);
+    // runs processor and serializes the event on the worker, sent in a StreamedEnvelope with attachments
+    void sendEvent(json event, EventProcessor processor, std::vector<Attachment> attachments = {});
+    void sendEventRetry(const std::string& contents, unsigned int attempt);
+    void sendEnvelope(std::shared_ptr<const StreamedEnvelope> envelope);
+
+    // task is run on the worker thread every interval
+    void addPeriodicTask(std::chrono::milliseconds interval, std::function<void()> task);
+
+    // waits until every queued event was sent (or given up), false on timeout
+    bool flush(std::chrono::milliseconds timeout);
+
+protected:
+
+    Transport();
+
+    // delivers one serialized event or envelope, runs on the worker thread
+    // attempt counts the earlier, failed sends of the same contents, see handleSendFailure
+    virtual void send(const std::string& contents, unsigned int attempt) = 0;
+    // the same for an event with attachments, a part at a time from the files; unless overridden the files are
+    // read into memory and the whole envelope goes to send
+    virtual void sendStreamed(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt);
+
+    void addActionToQueue(std::function<void()> actionToEnqueue);
+
+    // no events are sent until the reconnection timeout (exponential backoff) is reached
+    void handleConnectionError();
+    // the event goes to the back of the queue, unless it failed MAX_SEND_ATTEMPTS times already
+    void handleSendFailure(const std::string& contents, unsigned int attempt);
+    void handleSendFailure(const std::shared_ptr<const StreamedEnvelope>& envelope, unsigned int attempt);
+    // resets the backoff and the statistics of a delivered event
+    void handleSendSuccess(size_t contentsSize);
+    void handleSendSuccess(const OpenedEnvelope& envelope);
+    // no events are sent (they wait in the queue) for the given time, e.g. after HTTP 429
+    void pauseSending(uint64_t milliseconds);
 
 private:
 
+    struct PeriodicTask
+    {
+        std::chrono::milliseconds interval;
+        std::chrono::steady_clock::time_point nextRun;
+        std::function<void()> task;
+    };
+
     enum class State
     {
         NO_CONNECTION,
@@ -84,51 +164,59 @@ private:
     Transport(const Transport&&) = delete;
     Transport&& operator=(const Transport&&) = delete;
 
-    void run();
+    struct AsyncWorker;     // the strand and the timer, see transport.cpp
 
-    template<typename F>
-    void addActionToQueue(F actionToEnqueue);
+    void run();
+    // one step of the worker on the strand, scheduling the next one
+    void runAsyncStep();
+    // the worker can not run on the event loop, it is run on the calling thread until the queue is sent
+    bool asyncWorkerBlocked() const;
+    bool performInline(std::chrono::steady_clock::time_point deadline);
 
     void perform();
 
     void performNoConnection();
     void performSendEvents();
     void performDropEvents();
+    // the first task of the queue, on the worker
+    void runNextTask();
+    bool isQueueEmpty() const;
+    // how long NO_CONNECTION or DROP_EVENTS still hold the events back, zero once back to SEND_EVENTS
+    std::chrono::milliseconds sendingPausedFor();
 
     void changeState(State newState);
 
+    void runPeriodicTasks();
+    void waitFor(std::chrono::milliseconds timeout);
+
     std::chrono::time_point<std::chrono::system_clock> m_lastConnectionRequestTime;
+    unsigned int m_reconnectTimeoutMilliseconds;
     bool reconnectTimeoutReached();
 
     uint64_t m_retryAfterMilliseconds;
     std::chrono::time_point<std::chrono::system_clock> m_lastRequestBeforeDroppingTime;
     bool droppingEventsTimeoutReached();
 
-    void sendPost(const std::string& contents);
-    void sendPost(const std::string& contents, const http::Header& header, bool isRetrying = false);
-    bool checkResponse(std::shared_ptr<http::Response> response);
-
-    void handleTooManyRequests(std::shared_ptr<http::Response> errorResponse);
-
-    //const std::string create_autentication_string();
-    http::Header createHeader();
-
     // its own thread / worker
     std::thread m_thread;
+    // or handlers on the event loop of the application
+    asio::io_context* m_ioContext;
+    std::shared_ptr<AsyncWorker> m_asyncWorker;
     // tasks queue
     std::queue<std::function<void()>> m_tasks;
+    std::vector<PeriodicTask> m_periodicTasks;
+    bool m_taskInProgress;
     mutable std::mutex m_tasksQueueMutex;
+    std::condition_variable m_taskDoneConditionVariable;    // for flush
 
     std::atomic_bool m_running;
     std::atomic_bool m_shouldStop;
 
-    SentryDSN m_dsnStruct;
-
-    std::shared_ptr<http::Client> m_pHttpClient;
-
     mutable std::mutex m_actionInProgressMutex;
     std::condition_variable m_conditionVariable;
 
+    EventLimits m_eventLimits;
+
     State m_state;
     mutable std::mutex m_stateMutex;
 };
@@ -0,0 +1,881 @@
+#include "unwinder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <execinfo.h>
+#include <link.h>
+#include <mutex>
+#include <pthread.h>
+#include <ucontext.h>
+
+
+extern "C" void* __libc_stack_end;     // glibc, the top of the stack of the main thread
+
+namespace
+{
+
+using Sentry::StackUnwinder;
+
+constexpr uintptr_t UNWINDER_MAX_STACK_BYTES = uintptr_t(1) << 30;
+
+// pointer encodings of .eh_frame (DW_EH_PE_*)
+constexpr uint8_t EH_PE_OMIT = 0xff;
+constexpr uint8_t EH_PE_FORMAT_MASK = 0x0f;
+constexpr uint8_t EH_PE_APPLICATION_MASK = 0x70;
+constexpr uint8_t EH_PE_INDIRECT = 0x80;
+constexpr uint8_t EH_PE_ABSPTR = 0x00;
+constexpr uint8_t EH_PE_ULEB128 = 0x01;
+constexpr uint8_t EH_PE_UDATA2 = 0x02;
+constexpr uint8_t EH_PE_UDATA4 = 0x03;
+constexpr uint8_t EH_PE_UDATA8 = 0x04;
+constexpr uint8_t EH_PE_SLEB128 = 0x09;
+constexpr uint8_t EH_PE_SDATA2 = 0x0a;
+constexpr uint8_t EH_PE_SDATA4 = 0x0b;
+constexpr uint8_t EH_PE_SDATA8 = 0x0c;
+constexpr uint8_t EH_PE_PCREL = 0x10;
+constexpr uint8_t EH_PE_DATAREL = 0x30;
+
+// the x86_64 DWARF register numbers used for unwinding
+constexpr uint64_t DWARF_REGISTER_RBP = 6;
+constexpr uint64_t DWARF_REGISTER_RSP = 7;
+constexpr uint64_t DWARF_TRACKED_REGISTERS = 17;    // rax .. r15 and the return address
+constexpr size_t CFA_STATE_STACK_DEPTH = 4;         // DW_CFA_remember_state nesting
+
+struct UnwindModule
+{
+    uintptr_t start;
+    uintptr_t end;
+    const uint8_t* ehFrameHeader;   // nullptr - no unwind tables
+};
+
+struct ModuleTable
+{
+    size_t count;
+    UnwindModule modules[UNWINDER_MAX_MODULES];
+};
+
+// double buffered, readers (in signal handlers too) never wait - a refresh fills the table not in use;
+// a reader still using a table two refreshes later may see it half filled, the checks of the walk keep it safe
+ModuleTable moduleTables[2];
+std::atomic<const ModuleTable*> currentModules(nullptr);
+std::mutex refreshMutex;
+unsigned long long loadedObjects = 0;       // dlpi_adds of the cached list
+unsigned long long unloadedObjects = 0;     // dlpi_subs
+
+class UnwindState
+{
+public:
+    uintptr_t instructionPointer = 0;
+    uintptr_t stackPointer = 0;
+    uintptr_t framePointer = 0;
+    bool returnAddress = false;     // the instruction pointer is after a call, looked up one byte before
+    uintptr_t stackBottom = 0;      // nothing outside [stackBottom, stackTop) is read
+    uintptr_t stackTop = 0;
+};
+
+#if defined(__x86_64__)
+
+uintptr_t findStackTop(uintptr_t stackPointer)
+{
+    // glibc keeps the descriptor of a thread right above its stack, the main thread has its own
+    const uintptr_t thread = reinterpret_cast<uintptr_t>(pthread_self());
+    if (thread > stackPointer && thread - stackPointer < UNWINDER_MAX_STACK_BYTES)
+        return thread;
+
+    const uintptr_t mainThread = reinterpret_cast<uintptr_t>(__libc_stack_end);
+    if (mainThread > stackPointer && mainThread - stackPointer < UNWINDER_MAX_STACK_BYTES)
+        return mainThread;
+
+    return 0;   // e.g. on an alternative signal stack, only the first frame is known
+}
+
+bool readStack(const UnwindState& state, uintptr_t address, uintptr_t& value)
+{
+    if (address < state.stackBottom || state.stackTop < sizeof(uintptr_t) || address > state.stackTop - sizeof(uintptr_t))
+        return false;
+
+    std::memcpy(&value, reinterpret_cast<const void*>(address), sizeof(value));
+    return true;
+}
+
+bool stepFramePointer(UnwindState& state)
+{
+    // the frame pointer points at the saved frame pointer of the caller, followed by the return address
+    const uintptr_t framePointer = state.framePointer;
+    uintptr_t callerFramePointer = 0;
+    uintptr_t returnAddress = 0;
+    if (framePointer < state.stackPointer || (framePointer & (sizeof(uintptr_t) - 1)) != 0
+        || !readStack(state, framePointer, callerFramePointer)
+        || !readStack(state, framePointer + sizeof(uintptr_t), returnAddress)
+        || returnAddress == 0)
+        return false;
+
+    state.instructionPointer = returnAddress;
+    state.stackPointer = framePointer + 2 * sizeof(uintptr_t);
+    state.framePointer = callerFramePointer;
+    state.returnAddress = true;
+    return true;
+}
+
+const UnwindModule* findModule(const ModuleTable* table, uintptr_t address)
+{
+    const UnwindModule* end = table->modules + std::min(table->count, UNWINDER_MAX_MODULES);
+    const UnwindModule* module = std::upper_bound(table->modules, end, address,
+                                                  [](uintptr_t value, const UnwindModule& m) { return value < m.start; });
+    if (module == table->modules)
+        return nullptr;
+    --module;
+    return (address < module->end) ? module : nullptr;
+}
+
+uint64_t readUleb128(const uint8_t*& p)
+{
+    uint64_t value = 0;
+    unsigned int shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = *p++;
+        if (shift < 64)
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        shift += 7;
+    }
+    while (byte & 0x80);
+    return value;
+}
+
+int64_t readSleb128(const uint8_t*& p)
+{
+    int64_t value = 0;
+    unsigned int shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = *p++;
+        if (shift < 64)
+            value |= static_cast<int64_t>(static_cast<uint64_t>(byte & 0x7f) << shift);
+        shift += 7;
+    }
+    while (byte & 0x80);
+    if (shift < 64 && (byte & 0x40))
+        value |= -(static_cast<int64_t>(1) << shift);
+    return value;
+}
+
+template<typename T>
+T readValue(const uint8_t*& p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return value;
+}
+
+bool readEncoded(const uint8_t*& p, uint8_t encoding, uintptr_t dataBase, uintptr_t& value)
+{
+    if (encoding == EH_PE_OMIT)
+        return false;
+
+    const uintptr_t position = reinterpret_cast<uintptr_t>(p);
+    uintptr_t result = 0;
+    switch (encoding & EH_PE_FORMAT_MASK)
+    {
+    case EH_PE_ABSPTR:  result = readValue<uintptr_t>(p); break;
+    case EH_PE_ULEB128: result = static_cast<uintptr_t>(readUleb128(p)); break;
+    case EH_PE_UDATA2:  result = readValue<uint16_t>(p); break;
+    case EH_PE_UDATA4:  result = readValue<uint32_t>(p); break;
+    case EH_PE_UDATA8:  result = static_cast<uintptr_t>(readValue<uint64_t>(p)); break;
+    case EH_PE_SLEB128: result = static_cast<uintptr_t>(readSleb128(p)); break;
+    case EH_PE_SDATA2:  result = static_cast<uintptr_t>(static_cast<intptr_t>(readValue<int16_t>(p))); break;
+    case EH_PE_SDATA4:  result = static_cast<uintptr_t>(static_cast<intptr_t>(readValue<int32_t>(p))); break;
+    case EH_PE_SDATA8:  result = static_cast<uintptr_t>(readValue<int64_t>(p)); break;
+    default:
+        return false;
+    }
+
+    switch (encoding & EH_PE_APPLICATION_MASK)
+    {
+    case 0:
+        break;
+    case EH_PE_PCREL:
+        result += position;
+        break;
+    case EH_PE_DATAREL:
+        result += dataBase;
+        break;
+    default:
+        return false;
+    }
+
+    if (encoding & EH_PE_INDIRECT)
+    {
+        std::memcpy(&result, reinterpret_cast<const void*>(result), sizeof(result));
+    }
+    value = result;
+    return true;
+}
+
+// the initial length of a CIE or FDE, p is moved to the id, end to the end of the entry
+bool readEntryLength(const uint8_t*& p, const uint8_t*& end, bool& is64Bit)
+{
+    uint64_t length = readValue<uint32_t>(p);
+    is64Bit = (length == 0xffffffff);
+    if (is64Bit)
+    {
+        length = readValue<uint64_t>(p);
+    }
+    end = p + length;
+    return length != 0;     // the terminator
+}
+
+class CommonInformation
+{
+public:
+    uint64_t codeAlignment = 1;
+    int64_t dataAlignment = 1;
+    uint64_t returnAddressRegister = 16;
+    uint8_t fdeEncoding = EH_PE_ABSPTR;
+    bool hasAugmentationData = false;
+    const uint8_t* instructions = nullptr;
+    const uint8_t* end = nullptr;
+};
+
+bool parseCie(const uint8_t* cie, CommonInformation& information)
+{
+    const uint8_t* p = cie;
+    bool is64Bit = false;
+    if (!readEntryLength(p, information.end, is64Bit))
+        return false;
+    const uint64_t id = is64Bit ? readValue<uint64_t>(p) : readValue<uint32_t>(p);
+    if (id != 0)
+        return false;
+
+    const uint8_t version = *p++;
+    const char* augmentation = reinterpret_cast<const char*>(p);
+    p += std::strlen(augmentation) + 1;
+    if (augmentation[0] != '\0' && augmentation[0] != 'z')
+        return false;   // the old "eh" augmentation, not produced by current compilers
+
+    information.codeAlignment = readUleb128(p);
+    information.dataAlignment = readSleb128(p);
+    information.returnAddressRegister = (version == 1) ? *p++ : readUleb128(p);
+
+    if (augmentation[0] == 'z')
+    {
+        information.hasAugmentationData = true;
+        const uint64_t augmentationLength = readUleb128(p);
+        const uint8_t* augmentationEnd = p + augmentationLength;
+        for (const char* a = augmentation + 1; *a != '\0' && p < augmentationEnd; ++a)
+        {
+            uintptr_t ignored;
+            switch (*a)
+            {
+            case 'L':
+                ++p;    // LSDA encoding
+                break;
+            case 'P':
+            {
+                const uint8_t encoding = *p++;
+                if (!readEncoded(p, encoding & ~EH_PE_INDIRECT, 0, ignored))   // the personality routine is not needed
+                    return false;
+                break;
+            }
+            case 'R':
+                information.fdeEncoding = *p++;
+                break;
+            default:
+                p = augmentationEnd;    // 'S' (signal frame) has no data, unknown ones end the list
+                break;
+            }
+        }
+        p = augmentationEnd;
+    }
+
+    information.instructions = p;
+    return information.returnAddressRegister < DWARF_TRACKED_REGISTERS;
+}
+
+enum class RuleType : uint8_t
+{
+    SAME_VALUE,
+    UNDEFINED,
+    OFFSET,         // saved at CFA + value
+    VAL_OFFSET,     // is CFA + value
+    OTHER           // in another register or given by an expression - not followed
+};
+
+struct RegisterRule
+{
+    RuleType type;
+    int64_t value;
+};
+
+struct UnwindRow
+{
+    uint64_t cfaRegister;
+    int64_t cfaOffset;
+    bool cfaExpression;
+    RegisterRule rules[DWARF_TRACKED_REGISTERS];
+};
+
+void setRule(UnwindRow& row, uint64_t reg, RuleType type, int64_t value = 0)
+{
+    if (reg < DWARF_TRACKED_REGISTERS)
+    {
+        row.rules[reg] = {type, value};
+    }
+}
+
+// runs the CFA instructions of the locations up to target, initial is the row after the CIE instructions
+bool executeInstructions(const uint8_t* p, const uint8_t* end, const CommonInformation& cie,
+                         uintptr_t location, uintptr_t target, UnwindRow& row, const UnwindRow& initial)
+{
+    UnwindRow rememberedRows[CFA_STATE_STACK_DEPTH];
+    size_t remembered = 0;
+
+    while (p < end)
+    {
+        const uint8_t instruction = *p++;
+        const uint8_t operand = instruction & 0x3f;
+        switch (instruction & 0xc0)
+        {
+        case 0x40:  // DW_CFA_advance_loc
+            location += operand * cie.codeAlignment;
+            if (location > target)
+                return true;
+            continue;
+        case 0x80:  // DW_CFA_offset
+            setRule(row, operand, RuleType::OFFSET, static_cast<int64_t>(readUleb128(p)) * cie.dataAlignment);
+            continue;
+        case 0xc0:  // DW_CFA_restore
+            if (operand < DWARF_TRACKED_REGISTERS)
+                row.rules[operand] = initial.rules[operand];
+            continue;
+        default:
+            break;
+        }
+
+        switch (instruction)
+        {
+        case 0x00:  // DW_CFA_nop
+            break;
+        case 0x01:  // DW_CFA_set_loc
+            if (!readEncoded(p, cie.fdeEncoding, 0, location))
+                return false;
+            if (location > target)
+                return true;
+            break;
+        case 0x02:  // DW_CFA_advance_loc1
+            location += readValue<uint8_t>(p) * cie.codeAlignment;
+            if (location > target)
+                return true;
+            break;
+        case 0x03:  // DW_CFA_advance_loc2
+            location += readValue<uint16_t>(p) * cie.codeAlignment;
+            if (location > target)
+                return true;
+            break;
+        case 0x04:  // DW_CFA_advance_loc4
+            location += readValue<uint32_t>(p) * cie.codeAlignment;
+            if (location > target)
+                return true;
+            break;
+        case 0x05:  // DW_CFA_offset_extended
+        {
+            const uint64_t reg = readUleb128(p);
+            setRule(row, reg, RuleType::OFFSET, static_cast<int64_t>(readUleb128(p)) * cie.dataAlignment);
+            break;
+        }
+        case 0x06:  // DW_CFA_restore_extended
+        {
+            const uint64_t reg = readUleb128(p);
+            if (reg < DWARF_TRACKED_REGISTERS)
+                row.rules[reg] = initial.rules[reg];
+            break;
+        }
+        case 0x07:  // DW_CFA_undefined
+            setRule(row, readUleb128(p), RuleType::UNDEFINED);
+            break;
+        case 0x08:  // DW_CFA_same_value
+            setRule(row, readUleb128(p), RuleType::SAME_VALUE);
+            break;
+        case 0x09:  // DW_CFA_register
+        {
+            const uint64_t reg = readUleb128(p);
+            readUleb128(p);
+            setRule(row, reg, RuleType::OTHER);
+            break;
+        }
+        case 0x0a:  // DW_CFA_remember_state
+            if (remembered == CFA_STATE_STACK_DEPTH)
+                return false;
+            rememberedRows[remembered++] = row;
+            break;
+        case 0x0b:  // DW_CFA_restore_state
+            if (remembered == 0)
+                return false;
+            row = rememberedRows[--remembered];
+            break;
+        case 0x0c:  // DW_CFA_def_cfa
+            row.cfaRegister = readUleb128(p);
+            row.cfaOffset = static_cast<int64_t>(readUleb128(p));
+            row.cfaExpression = false;
+            break;
+        case 0x0d:  // DW_CFA_def_cfa_register
+            row.cfaRegister = readUleb128(p);
+            row.cfaExpression = false;
+            break;
+        case 0x0e:  // DW_CFA_def_cfa_offset
+            row.cfaOffset = static_cast<int64_t>(readUleb128(p));
+            break;
+        case 0x0f:  // DW_CFA_def_cfa_expression, e.g. in the PLT
+            p += readUleb128(p);
+            row.cfaExpression = true;
+            break;
+        case 0x10:  // DW_CFA_expression
+        case 0x16:  // DW_CFA_val_expression
+        {
+            const uint64_t reg = readUleb128(p);
+            p += readUleb128(p);
+            setRule(row, reg, RuleType::OTHER);
+            break;
+        }
+        case 0x11:  // DW_CFA_offset_extended_sf
+        {
+            const uint64_t reg = readUleb128(p);
+            setRule(row, reg, RuleType::OFFSET, readSleb128(p) * cie.dataAlignment);
+            break;
+        }
+        case 0x12:  // DW_CFA_def_cfa_sf
+            row.cfaRegister = readUleb128(p);
+            row.cfaOffset = readSleb128(p) * cie.dataAlignment;
+            row.cfaExpression = false;
+            break;
+        case 0x13:  // DW_CFA_def_cfa_offset_sf
+            row.cfaOffset = readSleb128(p) * cie.dataAlignment;
+            break;
+        case 0x14:  // DW_CFA_val_offset
+        {
+            const uint64_t reg = readUleb128(p);
+            setRule(row, reg, RuleType::VAL_OFFSET, static_cast<int64_t>(readUleb128(p)) * cie.dataAlignment);
+            break;
+        }
+        case 0x15:  // DW_CFA_val_offset_sf
+        {
+            const uint64_t reg = readUleb128(p);
+            setRule(row, reg, RuleType::VAL_OFFSET, readSleb128(p) * cie.dataAlignment);
+            break;
+        }
+        case 0x2e:  // DW_CFA_GNU_args_size
+            readUleb128(p);
+            break;
+        case 0x2f:  // DW_CFA_GNU_negative_offset_extended
+        {
+            const uint64_t reg = readUleb128(p);
+            setRule(row, reg, RuleType::OFFSET, -static_cast<int64_t>(readUleb128(p)) * cie.dataAlignment);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+// the FDE covering address, from the binary search table of .eh_frame_hdr
+const uint8_t* findFde(const uint8_t* header, uintptr_t address)
+{
+    if (header == nullptr || header[0] != 1)
+        return nullptr;
+
+    const uint8_t* p = header + 4;
+    const uintptr_t headerAddress = reinterpret_cast<uintptr_t>(header);
+    uintptr_t ehFrame = 0;
+    uintptr_t count = 0;
+    if (!readEncoded(p, header[1], headerAddress, ehFrame) || !readEncoded(p, header[2], headerAddress, count) || count == 0)
+        return nullptr;
+    if (header[3] != (EH_PE_DATAREL | EH_PE_SDATA4))
+        return nullptr;     // the only encoding of the table the linkers produce
+
+    // pairs of the initial location and the FDE, relative to the header, sorted by the location
+    auto entry = [p](size_t i, size_t field)
+    {
+        const uint8_t* position = p + (2 * i + field) * sizeof(int32_t);
+        return readValue<int32_t>(position);
+    };
+    size_t low = 0;
+    size_t high = count;
+    while (high - low > 1)
+    {
+        const size_t middle = low + (high - low) / 2;
+        if (headerAddress + static_cast<intptr_t>(entry(middle, 0)) <= address)
+            low = middle;
+        else
+            high = middle;
+    }
+    if (headerAddress + static_cast<intptr_t>(entry(low, 0)) > address)
+        return nullptr;
+    return header + entry(low, 1);
+}
+
+// mov $__NR_rt_sigreturn, %rax; syscall - the restorer glibc sets for every signal handler
+bool isSignalTrampoline(const UnwindModule& module, uintptr_t address)
+{
+    static const uint8_t code[] = {0x48, 0xc7, 0xc0, 0x0f, 0x00, 0x00, 0x00, 0x0f, 0x05};
+    return address + sizeof(code) <= module.end && std::memcmp(reinterpret_cast<const void*>(address), code, sizeof(code)) == 0;
+}
+
+bool stepSignalFrame(UnwindState& state)
+{
+    // the handler returned into the trampoline, the stack pointer points at the ucontext of the interrupted code
+    const uintptr_t context = state.stackPointer;
+    if (context < state.stackBottom || context + sizeof(ucontext_t) > state.stackTop)
+        return false;
+
+    const ucontext_t* signalContext = reinterpret_cast<const ucontext_t*>(context);
+    state.instructionPointer = static_cast<uintptr_t>(signalContext->uc_mcontext.gregs[REG_RIP]);
+    state.stackPointer = static_cast<uintptr_t>(signalContext->uc_mcontext.gregs[REG_RSP]);
+    state.framePointer = static_cast<uintptr_t>(signalContext->uc_mcontext.gregs[REG_RBP]);
+    state.returnAddress = false;
+    return state.stackPointer > context;     // the interrupted frames are above the handler's
+}
+
+// how the caller's frame is found from a frame, the part of a CFA row the unwinder uses
+class FrameRule
+{
+public:
+    bool cfaFromFramePointer = false;   // else from the stack pointer
+    int64_t cfaOffset = 0;
+    int64_t returnAddressOffset = 0;    // saved at CFA + offset
+    RuleType framePointerRule = RuleType::SAME_VALUE;
+    int64_t framePointerOffset = 0;
+};
+
+bool findFrameRule(const UnwindModule& module, uintptr_t address, FrameRule& frameRule)
+{
+    const uint8_t* fde = findFde(module.ehFrameHeader, address);
+    if (fde == nullptr)
+        return false;
+
+    const uint8_t* p = fde;
+    const uint8_t* fdeEnd = nullptr;
+    bool is64Bit = false;
+    if (!readEntryLength(p, fdeEnd, is64Bit))
+        return false;
+    const uint8_t* ciePointerField = p;
+    const uint64_t cieOffset = is64Bit ? readValue<uint64_t>(p) : readValue<uint32_t>(p);
+
+    CommonInformation cie;
+    if (cieOffset == 0 || !parseCie(ciePointerField - cieOffset, cie))
+        return false;
+
+    uintptr_t functionStart = 0;
+    uintptr_t functionLength = 0;
+    if (!readEncoded(p, cie.fdeEncoding, 0, functionStart)
+        || !readEncoded(p, cie.fdeEncoding & EH_PE_FORMAT_MASK, 0, functionLength)
+        || address < functionStart || address - functionStart >= functionLength)
+        return false;
+    if (cie.hasAugmentationData)
+    {
+        p += readUleb128(p);
+    }
+
+    UnwindRow initial;
+    initial.cfaRegister = DWARF_REGISTER_RSP;
+    initial.cfaOffset = 0;
+    initial.cfaExpression = false;
+    for (auto& rule : initial.rules)
+    {
+        rule = {RuleType::SAME_VALUE, 0};
+    }
+    if (!executeInstructions(cie.instructions, cie.end, cie, 0, UINTPTR_MAX, initial, initial))
+        return false;
+    UnwindRow row = initial;
+    if (!executeInstructions(p, fdeEnd, cie, functionStart, address, row, initial) || row.cfaExpression)
+        return false;
+    if (row.cfaRegister != DWARF_REGISTER_RSP && row.cfaRegister != DWARF_REGISTER_RBP)
+        return false;
+
+    const RegisterRule& returnAddressRule = row.rules[cie.returnAddressRegister];
+    if (returnAddressRule.type != RuleType::OFFSET)
+        return false;   // undefined at the start of a thread
+
+    frameRule.cfaFromFramePointer = (row.cfaRegister == DWARF_REGISTER_RBP);
+    frameRule.cfaOffset = row.cfaOffset;
+    frameRule.returnAddressOffset = returnAddressRule.value;
+    // all the rules but these two lose the frame pointer
+    const RuleType framePointerRule = row.rules[DWARF_REGISTER_RBP].type;
+    frameRule.framePointerRule = (framePointerRule == RuleType::OTHER) ? RuleType::UNDEFINED : framePointerRule;
+    frameRule.framePointerOffset = row.rules[DWARF_REGISTER_RBP].value;
+    return true;
+}
+
+// a rule packed into one word - cfaOffset 20 bits, framePointerOffset 12 bits, the register and the rule
+// type 3 bits - tagged with the address bits not implied by the index into the cache; the return address
+// is at CFA - 8 in all the code compilers emit, rules with anything else or larger offsets are not cached
+constexpr uint64_t PACKED_RULE_TAG_SHIFT = 35;
+constexpr int64_t CACHED_RETURN_ADDRESS_OFFSET = -8;
+
+bool fitsSigned(int64_t value, unsigned int bits)
+{
+    const int64_t limit = static_cast<int64_t>(1) << (bits - 1);
+    return value >= -limit && value < limit;
+}
+
+uint64_t ruleTag(uintptr_t address)
+{
+    return (address / UNWINDER_CACHE_ENTRIES) & ((uint64_t(1) << (64 - PACKED_RULE_TAG_SHIFT)) - 1);
+}
+
+bool packRule(const FrameRule& rule, uintptr_t address, uint64_t& packed)
+{
+    if (rule.returnAddressOffset != CACHED_RETURN_ADDRESS_OFFSET || !fitsSigned(rule.cfaOffset, 20)
+        || !fitsSigned(rule.framePointerOffset, 12) || static_cast<uint64_t>(rule.framePointerRule) > 3)
+        return false;
+
+    packed = (static_cast<uint64_t>(rule.cfaOffset) & 0xfffff)
+             | ((static_cast<uint64_t>(rule.framePointerOffset) & 0xfff) << 20)
+             | (static_cast<uint64_t>(rule.cfaFromFramePointer) << 32)
+             | (static_cast<uint64_t>(rule.framePointerRule) << 33)
+             | (ruleTag(address) << PACKED_RULE_TAG_SHIFT);
+    return true;
+}
+
+int64_t signExtend(uint64_t value, unsigned int bits)
+{
+    const uint64_t sign = uint64_t(1) << (bits - 1);
+    return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+bool unpackRule(uint64_t packed, uintptr_t address, FrameRule& rule)
+{
+    if (packed == 0 || (packed >> PACKED_RULE_TAG_SHIFT) != ruleTag(address))
+        return false;
+
+    rule.cfaOffset = signExtend(packed & 0xfffff, 20);
+    rule.framePointerOffset = signExtend((packed >> 20) & 0xfff, 12);
+    rule.cfaFromFramePointer = ((packed >> 32) & 1) != 0;
+    rule.framePointerRule = static_cast<RuleType>((packed >> 33) & 3);
+    rule.returnAddressOffset = CACHED_RETURN_ADDRESS_OFFSET;
+    return true;
+}
+
+// the rules found so far by the address they were looked up at, the CFI of a frame is interpreted once;
+// an entry is a single word, so a reader never sees half of a rule written by another thread
+std::atomic<uint64_t> ruleCache[UNWINDER_CACHE_ENTRIES];
+
+bool stepEhFrame(UnwindState& state, const ModuleTable* modules)
+{
+    const UnwindModule* module = findModule(modules, state.instructionPointer);
+    if (module == nullptr)
+        return false;
+    if (isSignalTrampoline(*module, state.instructionPointer))
+        return stepSignalFrame(state);
+
+    const uintptr_t address = state.returnAddress ? state.instructionPointer - 1 : state.instructionPointer;
+    std::atomic<uint64_t>& cached = ruleCache[address % UNWINDER_CACHE_ENTRIES];
+    FrameRule rule;
+    if (!unpackRule(cached.load(std::memory_order_relaxed), address, rule))
+    {
+        if (!findFrameRule(*module, address, rule))
+            return false;
+        uint64_t packed = 0;
+        if (packRule(rule, address, packed))
+        {
+            cached.store(packed, std::memory_order_relaxed);
+        }
+    }
+
+    const uintptr_t cfa = (rule.cfaFromFramePointer ? state.framePointer : state.stackPointer) + static_cast<uintptr_t>(rule.cfaOffset);
+    uintptr_t returnAddress = 0;
+    if (!readStack(state, cfa + static_cast<uintptr_t>(rule.returnAddressOffset), returnAddress))
+        return false;
+
+    uintptr_t framePointer = state.framePointer;
+    if (rule.framePointerRule == RuleType::OFFSET)
+    {
+        if (!readStack(state, cfa + static_cast<uintptr_t>(rule.framePointerOffset), framePointer))
+            return false;
+    }
+    else if (rule.framePointerRule == RuleType::VAL_OFFSET)
+    {
+        framePointer = cfa + static_cast<uintptr_t>(rule.framePointerOffset);
+    }
+    else if (rule.framePointerRule != RuleType::SAME_VALUE)
+    {
+        framePointer = 0;
+    }
+
+    state.instructionPointer = returnAddress;
+    state.stackPointer = cfa;
+    state.framePointer = framePointer;
+    state.returnAddress = true;
+    return true;
+}
+
+int addModule(struct dl_phdr_info* info, size_t, void* data)
+{
+    ModuleTable* table = static_cast<ModuleTable*>(data);
+
+    const uint8_t* ehFrameHeader = nullptr;
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+    {
+        if (info->dlpi_phdr[i].p_type == PT_GNU_EH_FRAME)
+        {
+            ehFrameHeader = reinterpret_cast<const uint8_t*>(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+        }
+    }
+
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum && table->count < UNWINDER_MAX_MODULES; ++i)
+    {
+        const ElfW(Phdr)& header = info->dlpi_phdr[i];
+        if (header.p_type == PT_LOAD && (header.p_flags & PF_X) != 0)
+        {
+            UnwindModule& module = table->modules[table->count++];
+            module.start = info->dlpi_addr + header.p_vaddr;
+            module.end = module.start + header.p_memsz;
+            module.ehFrameHeader = ehFrameHeader;
+        }
+    }
+    return 0;
+}
+
+size_t walk(StackUnwinder method, UnwindState state, void** frames, size_t maxFrames)
+{
+    state.stackBottom = state.stackPointer;
+    state.stackTop = findStackTop(state.stackPointer);
+    const ModuleTable* modules = (method == StackUnwinder::EH_FRAME) ? currentModules.load(std::memory_order_acquire) : nullptr;
+
+    size_t count = 0;
+    while (count < maxFrames && state.instructionPointer != 0)
+    {
+        frames[count++] = reinterpret_cast<void*>(state.instructionPointer);
+
+        const uintptr_t stackPointer = state.stackPointer;
+        bool stepped = false;
+        if (modules != nullptr)
+        {
+            stepped = stepEhFrame(state, modules);
+        }
+        // also for code without unwind tables (e.g. generated at runtime)
+        if (!stepped && !stepFramePointer(state))
+            break;
+        if (state.stackPointer <= stackPointer)
+            break;  // the callers' frames are above, anything else is a loop
+    }
+    return count;
+}
+
+#endif // __x86_64__
+
+size_t unwindWithBacktrace(void** frames, size_t maxFrames, size_t skip)
+{
+    const int count = backtrace(frames, static_cast<int>(maxFrames));
+    if (count <= static_cast<int>(skip))
+        return 0;
+    std::memmove(frames, frames + skip, (static_cast<size_t>(count) - skip) * sizeof(void*));
+    return static_cast<size_t>(count) - skip;
+}
+
+} // namespace
+
+namespace Sentry
+{
+
+__attribute__((noinline)) size_t Unwinder::unwind(StackUnwinder method, void** frames, size_t maxFrames)
+{
+#if defined(__x86_64__)
+    if (method != StackUnwinder::BACKTRACE)
+    {
+        // the frame address makes this function keep a frame pointer, the caller's state is right above it
+        const uintptr_t* frame = static_cast<const uintptr_t*>(__builtin_frame_address(0));
+        UnwindState state;
+        state.instructionPointer = frame[1];
+        state.stackPointer = reinterpret_cast<uintptr_t>(frame + 2);
+        state.framePointer = frame[0];
+        state.returnAddress = true;
+        return walk(method, state, frames, maxFrames);
+    }
+#endif
+    return unwindWithBacktrace(frames, maxFrames, 1);   // without this function
+}
+
+size_t Unwinder::unwindContext(StackUnwinder method, const void* signalContext, void** frames, size_t maxFrames)
+{
+    const ucontext_t* context = static_cast<const ucontext_t*>(signalContext);
+#if defined(__x86_64__)
+    if (method != StackUnwinder::BACKTRACE && context != nullptr)
+    {
+        UnwindState state;
+        state.instructionPointer = static_cast<uintptr_t>(context->uc_mcontext.gregs[REG_RIP]);
+        state.stackPointer = static_cast<uintptr_t>(context->uc_mcontext.gregs[REG_RSP]);
+        state.framePointer = static_cast<uintptr_t>(context->uc_mcontext.gregs[REG_RBP]);
+        state.returnAddress = false;
+        return walk(method, state, frames, maxFrames);
+    }
+#endif
+
+    // backtrace() goes through the handler and the signal trampoline, the interrupted instruction is where it begins
+    const size_t count = unwindWithBacktrace(frames, maxFrames, 0);
+#if defined(__x86_64__)
+    if (context != nullptr)
+    {
+        void* interrupted = reinterpret_cast<void*>(context->uc_mcontext.gregs[REG_RIP]);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (frames[i] == interrupted)
+            {
+                std::memmove(frames, frames + i, (count - i) * sizeof(void*));
+                return count - i;
+            }
+        }
+    }
+#endif
+    return count;
+}
+
+void Unwinder::refreshModules()
+{
+#if defined(__x86_64__)
+    std::lock_guard<std::mutex> lock(refreshMutex);
+
+    // the counters of loaded and unloaded objects come with every object, the first one is enough
+    unsigned long long counters[2] = {0, 0};
+    dl_iterate_phdr([](struct dl_phdr_info* info, size_t size, void* data)
+    {
+        if (size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs))
+        {
+            unsigned long long* objects = static_cast<unsigned long long*>(data);
+            objects[0] = info->dlpi_adds;
+            objects[1] = info->dlpi_subs;
+        }
+        return 1;
+    }, counters);
+
+    const ModuleTable* current = currentModules.load(std::memory_order_relaxed);
+    if (current != nullptr && counters[0] == loadedObjects && counters[1] == unloadedObjects)
+    {
+        return;
+    }
+
+    // the addresses of unloaded objects may be reused by others
+    for (auto& rule : ruleCache)
+    {
+        rule.store(0, std::memory_order_relaxed);
+    }
+
+    ModuleTable* table = (current == &moduleTables[0]) ? &moduleTables[1] : &moduleTables[0];
+    table->count = 0;
+    dl_iterate_phdr(addModule, table);
+    std::sort(table->modules, table->modules + table->count,
+              [](const UnwindModule& a, const UnwindModule& b) { return a.start < b.start; });
+    currentModules.store(table, std::memory_order_release);
+
+    loadedObjects = counters[0];
+    unloadedObjects = counters[1];
+#endif
+}
+
+} // namespace Sentry
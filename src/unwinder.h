@@ -0,0 +1,48 @@
+#ifndef SENTRY_UNWINDER_H
+#define SENTRY_UNWINDER_H
+
+#include "sentry.h"
+
+#include <cstddef>
+
+
+/*
+ * Stack unwinding without the dynamic loader lock and without allocations, so it can run in signal handlers.
+ *
+ * FRAME_POINTER follows the chain of saved frame pointers. EH_FRAME looks the caller up in the unwind
+ * tables the linker puts into every object (.eh_frame_hdr, a sorted table of the FDEs) and interprets
+ * the DWARF CFI of the frame; frames without unwind information fall back to the frame pointer, and signal
+ * frames (the return into the signal trampoline) continue with the interrupted context. The list of loaded
+ * objects is cached by refreshModules, objects loaded after it are unwound along the frame pointers only.
+ * The rule found for an address is cached, a stack seen before is walked without reading the CFI again.
+ *
+ * Only the stack of the calling thread is read, between the stack pointer and the top of the stack. FRAME_POINTER
+ * and EH_FRAME are implemented for x86_64, other architectures use backtrace().
+ */
+
+namespace
+{
+constexpr size_t UNWINDER_MAX_MODULES = 512;    // executable segments of the loaded objects
+constexpr size_t UNWINDER_CACHE_ENTRIES = 4096; // the unwind rules of this many return addresses are remembered
+}
+
+namespace Sentry
+{
+
+class Unwinder
+{
+public:
+
+    // the return addresses of the callers, newest first - the first one is in the caller of unwind
+    static size_t unwind(StackUnwinder method, void** frames, size_t maxFrames);
+
+    // from a signal handler: the interrupted instruction, then the return addresses of its callers
+    static size_t unwindContext(StackUnwinder method, const void* signalContext, void** frames, size_t maxFrames);
+
+    // caches the unwind tables of the loaded objects if they changed since the last call, not from a signal handler
+    static void refreshModules();
+};
+
+} // namespace Sentry
+
+#endif // SENTRY_UNWINDER_H